@@ -26,9 +26,12 @@ public:
 	void init(thread_t * h_thd, workload * h_wl, uint64_t part_id); 
 	RC run_txn(int type, int access_num);
 	RC run_txn(base_query * m_query) { assert(false); };
+	void checkIndexInsert(int txn_cnt);
 private:
 	RC testReadwrite(int access_num);
 	RC testConflict(int access_num);
+	RC testIndexInsert(int access_num);
+	idx_key_t insertKey(int access_num);
 	
 	TestWorkload * _wl;
 };
@@ -1,5 +1,6 @@
 #include "test.h"
 #include "row.h"
+#include "thread.h"
 
 void TestTxnMan::init(thread_t * h_thd, workload * h_wl, uint64_t thd_id) {
 	txn_man::init(h_thd, h_wl, thd_id);
@@ -12,6 +13,8 @@ RC TestTxnMan::run_txn(int type, int access_num) {
 		return testReadwrite(access_num);
 	case CONFLICT:
 		return testConflict(access_num);
+	case INSERT_ABORT:
+		return testIndexInsert(access_num);
 	default:
 		assert(false);
 	}
@@ -80,3 +83,60 @@ TestTxnMan::testConflict(int access_num)
 	rc = finish(rc);
 	return rc;
 }
+
+// The keys of all threads interleave, so the threads share the 16 buckets
+// of MAIN_INDEX, insert into empty ones at the same time and link new keys 
+// next to each other's.
+idx_key_t 
+TestTxnMan::insertKey(int access_num)
+{
+	return 10 + access_num * g_thread_cnt + get_thd_id();
+}
+
+RC 
+TestTxnMan::testIndexInsert(int access_num)
+{
+#if CC_ALG == RLU || CC_ALG == MVRLU
+	rlu_thread_data_t * self = h_thd->p_rlu_td;
+	RLU_READER_LOCK(self);
+#endif
+	row_t * row = (row_t *) index_read(_wl->the_index, 0, 0)->location;
+	RC rc = index_insert(_wl->the_index, insertKey(access_num), &row, 1, 0);
+	// the items and node linked by an aborted txn must not stay visible
+	if (access_num % 2 == 1)
+		rc = Abort;
+	rc = finish(rc);
+#if CC_ALG == RLU || CC_ALG == MVRLU
+	if (rc == Abort)
+		RLU_ABORT(self);
+	else
+		RLU_READER_UNLOCK(self);
+#endif
+	return rc;
+}
+
+void 
+TestTxnMan::checkIndexInsert(int txn_cnt)
+{
+#if CC_ALG == RLU || CC_ALG == MVRLU
+	rlu_thread_data_t * self = h_thd->p_rlu_td;
+	// with ORDO timestamps, a commit is only visible to sections that 
+	// start more than the ORDO boundary after it.
+	usleep(1);
+	RLU_READER_LOCK(self);
+#endif
+	row_t * row = (row_t *) index_read(_wl->the_index, 0, 0)->location;
+	for (int i = 0; i < txn_cnt; i ++) {
+		itemid_t * m_item = index_read(_wl->the_index, insertKey(i), 0);
+		if (i % 2 == 1) {
+			assert(m_item == NULL);
+			continue;
+		}
+		// one item per committed key
+		assert(m_item != NULL && m_item->next == NULL);
+		assert(m_item->location == row);
+	}
+#if CC_ALG == RLU || CC_ALG == MVRLU
+	RLU_READER_UNLOCK(self);
+#endif
+}
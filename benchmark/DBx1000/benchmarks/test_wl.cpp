@@ -65,5 +65,6 @@ void TestWorkload::summarize() {
 			total_wait_cnt += stats._stats[tid]->wait_cnt;
 		}
 		printf("CONFLICT TEST. PASSED.\n");
-	}
+	} else if (g_test_case == INSERT_ABORT)
+		printf("INSERT_ABORT TEST. PASSED.\n");
 }
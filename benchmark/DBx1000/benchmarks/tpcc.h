@@ -33,8 +33,13 @@ public:
 	INDEX * 	i_order; // key = (w_id, d_id, o_id)
 	INDEX * 	i_orderline; // key = (w_id, d_id, o_id)
 	INDEX * 	i_orderline_wd; // key = (w_id, d_id). 
+	INDEX * 	i_neworder; // key = (w_id, d_id, o_id)
+	INDEX * 	i_order_cust; // key = (w_id, d_id, c_id), newest order first
 	
 	bool ** delivering;
+	// per district (distKey), a lower bound of the oldest undelivered o_id.
+	// Delivery starts its new-order probe here instead of at the first order.
+	uint64_t * deliv_hint;
 	uint32_t next_tid;
 private:
 	uint64_t num_wh;
@@ -45,7 +45,8 @@ public:
 	uint64_t o_carrier_id;
 	uint64_t ol_delivery_d;
 	// for order-status
-
+	// Input for stock-level
+	uint64_t threshold;
 
 private:
 	// warehouse id to partition id mapping
@@ -53,6 +54,8 @@ private:
 	void gen_payment(uint64_t thd_id);
 	void gen_new_order(uint64_t thd_id);
 	void gen_order_status(uint64_t thd_id);
+	void gen_delivery(uint64_t thd_id);
+	void gen_stock_level(uint64_t thd_id);
 };
 
 #endif
@@ -30,12 +30,12 @@ RC tpcc_txn_man::run_txn(base_query * query) {
 			rc =  run_payment(m_query); break;
 		case TPCC_NEW_ORDER :
 			rc =  run_new_order(m_query); break;
-/*		case TPCC_ORDER_STATUS :
-			return run_order_status(m_query); break;
+		case TPCC_ORDER_STATUS :
+			rc =  run_order_status(m_query); break;
 		case TPCC_DELIVERY :
-			return run_delivery(m_query); break;
+			rc =  run_delivery(m_query); break;
 		case TPCC_STOCK_LEVEL :
-			return run_stock_level(m_query); break;*/
+			rc =  run_stock_level(m_query); break;
 		default:
 			//assert(false);
 			rc =  RCOK; break;
@@ -321,35 +321,56 @@ RC tpcc_txn_man::run_new_order(tpcc_query * query) {
 	int64_t o_id;
 	//d_tax = *(double *) r_dist_local->get_value(D_TAX);
 	o_id = *(int64_t *) r_dist_local->get_value(D_NEXT_O_ID);
-	o_id ++;
-	r_dist_local->set_value(D_NEXT_O_ID, o_id);
+	// o_ids stay dense per district; delivery and stock-level rely on it.
+	int64_t next_o_id = o_id + 1;
+	r_dist_local->set_value(D_NEXT_O_ID, next_o_id);
 
 	/*========================================================================================+
 	EXEC SQL INSERT INTO ORDERS (o_id, o_d_id, o_w_id, o_c_id, o_entry_d, o_ol_cnt, o_all_local)
 		VALUES (:o_id, :d_id, :w_id, :c_id, :datetime, :o_ol_cnt, :o_all_local);
 	+========================================================================================*/
-//	row_t * r_order;
-//	uint64_t row_id;
-//	_wl->t_order->get_new_row(r_order, 0, row_id);
-//	r_order->set_value(O_ID, o_id);
-//	r_order->set_value(O_C_ID, c_id);
-//	r_order->set_value(O_D_ID, d_id);
-//	r_order->set_value(O_W_ID, w_id);
-//	r_order->set_value(O_ENTRY_D, o_entry_d);
-//	r_order->set_value(O_OL_CNT, ol_cnt);
-//	int64_t all_local = (remote? 0 : 1);
-//	r_order->set_value(O_ALL_LOCAL, all_local);
-//	insert_row(r_order, _wl->t_order);
+	// Under MV-RLU the index links new rows into the txn's write set, so the
+	// inserts become visible atomically at commit. The other CCs publish 
+	// them at their commit point, before the district row is released 
+	// (see txn_man::cleanup).
+	row_t * r_order;
+	uint64_t row_id;
+	_wl->t_order->get_new_row(r_order, 0, row_id);
+	r_order->set_value(O_ID, o_id);
+	r_order->set_value(O_C_ID, c_id);
+	r_order->set_value(O_D_ID, d_id);
+	r_order->set_value(O_W_ID, w_id);
+	r_order->set_value(O_ENTRY_D, query->o_entry_d);
+	int64_t o_carrier_id = 0;
+	r_order->set_value(O_CARRIER_ID, o_carrier_id);
+	r_order->set_value(O_OL_CNT, ol_cnt);
+	int64_t all_local = (remote? 0 : 1);
+	r_order->set_value(O_ALL_LOCAL, all_local);
+	insert_row(r_order, _wl->t_order);
+	if (index_insert(_wl->i_order, orderPrimaryKey(w_id, d_id, o_id), 
+					&r_order, 1, wh_to_part(w_id)) == Abort) {
+		return finish(Abort);
+	}
+	if (index_insert(_wl->i_order_cust, custKey(c_id, d_id, w_id), 
+					&r_order, 1, wh_to_part(w_id)) == Abort) {
+		return finish(Abort);
+	}
 	/*=======================================================+
     EXEC SQL INSERT INTO NEW_ORDER (no_o_id, no_d_id, no_w_id)
         VALUES (:o_id, :d_id, :w_id);
     +=======================================================*/
-//	row_t * r_no;
-//	_wl->t_neworder->get_new_row(r_no, 0, row_id);
-//	r_no->set_value(NO_O_ID, o_id);
-//	r_no->set_value(NO_D_ID, d_id);
-//	r_no->set_value(NO_W_ID, w_id);
-//	insert_row(r_no, _wl->t_neworder);
+	row_t * r_no;
+	_wl->t_neworder->get_new_row(r_no, 0, row_id);
+	r_no->set_value(NO_O_ID, o_id);
+	r_no->set_value(NO_D_ID, d_id);
+	r_no->set_value(NO_W_ID, w_id);
+	insert_row(r_no, _wl->t_neworder);
+	if (index_insert(_wl->i_neworder, orderPrimaryKey(w_id, d_id, o_id), 
+					&r_no, 1, wh_to_part(w_id)) == Abort) {
+		return finish(Abort);
+	}
+	// order lines share one key and are indexed together after the loop.
+	row_t * r_ols[MAX_OL_PER_ORDER];
 	for (UInt32 ol_number = 0; ol_number < ol_cnt; ol_number++) {
 
 		uint64_t ol_i_id = query->items[ol_number].ol_i_id;
@@ -439,30 +460,43 @@ RC tpcc_txn_man::run_new_order(tpcc_query * query) {
 				:ol_quantity, :ol_amount, :ol_dist_info);
 		+====================================================*/
 		// XXX district info is not inserted.
-//		row_t * r_ol;
-//		uint64_t row_id;
-//		_wl->t_orderline->get_new_row(r_ol, 0, row_id);
-//		r_ol->set_value(OL_O_ID, &o_id);
-//		r_ol->set_value(OL_D_ID, &d_id);
-//		r_ol->set_value(OL_W_ID, &w_id);
-//		r_ol->set_value(OL_NUMBER, &ol_number);
-//		r_ol->set_value(OL_I_ID, &ol_i_id);
+		row_t * r_ol;
+		_wl->t_orderline->get_new_row(r_ol, 0, row_id);
+		r_ol->set_value(OL_O_ID, o_id);
+		r_ol->set_value(OL_D_ID, d_id);
+		r_ol->set_value(OL_W_ID, w_id);
+		r_ol->set_value(OL_NUMBER, ol_number);
+		r_ol->set_value(OL_I_ID, ol_i_id);
 #if !TPCC_SMALL
-//		int w_tax=1, d_tax=1;
-//		int64_t ol_amount = ol_quantity * i_price * (1 + w_tax + d_tax) * (1 - c_discount);
-//		r_ol->set_value(OL_SUPPLY_W_ID, &ol_supply_w_id);
-//		r_ol->set_value(OL_QUANTITY, &ol_quantity);
-//		r_ol->set_value(OL_AMOUNT, &ol_amount);
+		int w_tax=1, d_tax=1;
+		double ol_amount = ol_quantity * i_price * (1 + w_tax + d_tax) * (1 - c_discount);
+		int64_t ol_delivery_d = 0;
+		r_ol->set_value(OL_SUPPLY_W_ID, ol_supply_w_id);
+		r_ol->set_value(OL_DELIVERY_D, ol_delivery_d);
+		r_ol->set_value(OL_QUANTITY, ol_quantity);
+		r_ol->set_value(OL_AMOUNT, ol_amount);
 #endif		
-//		insert_row(r_ol, _wl->t_orderline);
+		insert_row(r_ol, _wl->t_orderline);
+		r_ols[ol_number] = r_ol;
+	}
+	if (index_insert(_wl->i_orderline, orderlineKey(w_id, d_id, o_id), 
+					r_ols, ol_cnt, wh_to_part(w_id)) == Abort) {
+		return finish(Abort);
 	}
 	assert( rc == RCOK );
 	return finish(rc);
 }
 
+// The TPC-C order tables would need an ordered index for "the newest order of
+// a customer", "the oldest new order of a district" and "the last 20 orders of
+// a district". o_ids are dense within a district, so the ordered scans below 
+// are done as point probes over an o_id range of the hash indexes. Under 
+// MV-RLU all probes and row reads of a txn come from the same snapshot.
+
 RC 
 tpcc_txn_man::run_order_status(tpcc_query * query) {
-/*	row_t * r_cust;
+	itemid_t * item;
+	row_t * r_cust;
 	if (query->by_last_name) {
 		// EXEC SQL SELECT count(c_id) INTO :namecnt FROM customer
 		// WHERE c_last=:c_last AND c_d_id=:d_id AND c_w_id=:w_id;
@@ -481,8 +515,8 @@ tpcc_txn_man::run_order_status(tpcc_query * query) {
 		// XXX: the list is not sorted. But let's assume it's sorted... 
 		// The performance won't be much different.
 		INDEX * index = _wl->i_customer_last;
-		uint64_t thd_id = get_thd_id();
-		itemid_t * item = index_read(index, key, wh_to_part(query->c_w_id));
+		item = index_read(index, key, wh_to_part(query->c_w_id));
+		assert(item != NULL);
 		int cnt = 0;
 		itemid_t * it = item;
 		itemid_t * mid = item;
@@ -500,49 +534,32 @@ tpcc_txn_man::run_order_status(tpcc_query * query) {
 		// WHERE c_id=:c_id AND c_d_id=:d_id AND c_w_id=:w_id;
 		uint64_t key = custKey(query->c_id, query->c_d_id, query->c_w_id);
 		INDEX * index = _wl->i_customer_id;
-		itemid_t * item = index_read(index, key, wh_to_part(query->c_w_id));
+		item = index_read(index, key, wh_to_part(query->c_w_id));
+		assert(item != NULL);
 		r_cust = (row_t *) item->location;
 	}
-#if TPCC_ACCESS_ALL
-
 	row_t * r_cust_local = get_row(r_cust, RD);
 	if (r_cust_local == NULL) {
 		return finish(Abort);
 	}
-	double c_balance;
-	r_cust_local->get_value(C_BALANCE, c_balance);
-	char * c_first = r_cust_local->get_value(C_FIRST);
-	char * c_middle = r_cust_local->get_value(C_MIDDLE);
-	char * c_last = r_cust_local->get_value(C_LAST);
-#endif
+	uint64_t c_id;
+	r_cust_local->get_value(C_ID, c_id);
+
 	// EXEC SQL SELECT o_id, o_carrier_id, o_entry_d
 	// INTO :o_id, :o_carrier_id, :entdate FROM orders
 	// ORDER BY o_id DESC;
-	uint64_t key = custKey(query->c_id, query->c_d_id, query->c_w_id);
-	INDEX * index = _wl->i_order;
-	itemid_t * item = index_read(index, key, wh_to_part(query->c_w_id));
+	// i_order_cust keeps the orders of a customer newest first.
+	uint64_t key = custKey(c_id, query->c_d_id, query->c_w_id);
+	item = index_read(_wl->i_order_cust, key, wh_to_part(query->c_w_id));
+	if (item == NULL)
+		return finish(RCOK);
 	row_t * r_order = (row_t *) item->location;
 	row_t * r_order_local = get_row(r_order, RD);
 	if (r_order_local == NULL) {
-		assert(false); 
 		return finish(Abort);
 	}
-
-	uint64_t o_id, o_entry_d, o_carrier_id;
+	int64_t o_id;
 	r_order_local->get_value(O_ID, o_id);
-#if TPCC_ACCESS_ALL
-	r_order_local->get_value(O_ENTRY_D, o_entry_d);
-	r_order_local->get_value(O_CARRIER_ID, o_carrier_id);
-#endif
-#if DEBUG_ASSERT
-	itemid_t * it = item;
-	while (it != NULL && it->next != NULL) {
-		uint64_t o_id_1, o_id_2;
-		((row_t *)it->location)->get_value(O_ID, o_id_1);
-		((row_t *)it->next->location)->get_value(O_ID, o_id_2);
-		assert(o_id_1 > o_id_2);
-	}
-#endif
 
 	// EXEC SQL DECLARE c_line CURSOR FOR SELECT ol_i_id, ol_supply_w_id, ol_quantity,
 	// ol_amount, ol_delivery_d
@@ -556,92 +573,206 @@ tpcc_txn_man::run_order_status(tpcc_query * query) {
 	//		EXEC SQL FETCH c_line
 	//		INTO :ol_i_id[i], :ol_supply_w_id[i], :ol_quantity[i], :ol_amount[i], :ol_delivery_d[i];
 	// }
-	key = orderlineKey(query->w_id, query->d_id, o_id);
-	index = _wl->i_orderline;
-	item = index_read(index, key, wh_to_part(query->w_id));
-	assert(item != NULL);
-#if TPCC_ACCESS_ALL
-	// TODO the rows are simply read without any locking mechanism
+	key = orderlineKey(query->c_w_id, query->c_d_id, o_id);
+	item = index_read(_wl->i_orderline, key, wh_to_part(query->c_w_id));
 	while (item != NULL) {
-		row_t * r_orderline = (row_t *) item->location;
-		int64_t ol_i_id, ol_supply_w_id, ol_quantity, ol_amount, ol_delivery_d;
-		r_orderline->get_value(OL_I_ID, ol_i_id);
-		r_orderline->get_value(OL_SUPPLY_W_ID, ol_supply_w_id);
-		r_orderline->get_value(OL_QUANTITY, ol_quantity);
-		r_orderline->get_value(OL_AMOUNT, ol_amount);
-		r_orderline->get_value(OL_DELIVERY_D, ol_delivery_d);
+		row_t * r_ol_local = get_row((row_t *) item->location, RD);
+		if (r_ol_local == NULL) {
+			return finish(Abort);
+		}
+		int64_t ol_i_id;
+		r_ol_local->get_value(OL_I_ID, ol_i_id);
+#if !TPCC_SMALL
+		int64_t ol_supply_w_id, ol_quantity, ol_delivery_d;
+		double ol_amount;
+		r_ol_local->get_value(OL_SUPPLY_W_ID, ol_supply_w_id);
+		r_ol_local->get_value(OL_QUANTITY, ol_quantity);
+		r_ol_local->get_value(OL_AMOUNT, ol_amount);
+		r_ol_local->get_value(OL_DELIVERY_D, ol_delivery_d);
+#endif
 		item = item->next;
 	}
-#endif
-
-final:
-	assert( rc == RCOK );
-	return finish(rc)*/
-	return RCOK;
+	return finish(RCOK);
 }
 
-
-//TODO concurrency for index related operations is not completely supported yet.
-// In correct states may happen with the current code.
-
 RC 
 tpcc_txn_man::run_delivery(tpcc_query * query) {
-/*
-	// XXX HACK if another delivery txn is running on this warehouse, simply commit.
-	if ( !ATOM_CAS(_wl->delivering[query->w_id], false, true) )
-		return finish(RCOK);
-
-	for (int d_id = 1; d_id <= DIST_PER_WARE; d_id++) {
-		uint64_t key = distKey(d_id, query->w_id);
-		INDEX * index = _wl->i_orderline_wd;
-		itemid_t * item = index_read(index, key, wh_to_part(query->w_id));
-		assert(item != NULL);
-		while (item->next != NULL) {
-#if DEBUG_ASSERT
-			uint64_t o_id_1, o_id_2;
-			((row_t *)item->location)->get_value(OL_O_ID, o_id_1);
-			((row_t *)item->next->location)->get_value(OL_O_ID, o_id_2);
-			assert(o_id_1 > o_id_2);
+	uint64_t w_id = query->w_id;
+	int part_id = wh_to_part(w_id);
+#if CC_ALG == RLU || CC_ALG == MVRLU
+	// probes only read an order; the one delivered is locked below.
+	access_t probe_type = RD;
+#else
+	// the other CCs cannot upgrade a row the txn has already read 
+	// (2PL holds a shared lock, SILO validates the read against its own lock).
+	access_t probe_type = WR;
 #endif
-			item = item->next;
+	// the o_id delivered in each district, 0 if none.
+	uint64_t delivered[DIST_PER_WARE + 1];
+	for (uint64_t d_id = 1; d_id <= DIST_PER_WARE; d_id++) {
+		delivered[d_id] = 0;
+		// EXEC SQL DECLARE c_no CURSOR FOR SELECT no_o_id
+		// FROM new_order
+		// WHERE no_d_id = :d_id AND no_w_id = :w_id
+		// ORDER BY no_o_id ASC;
+		// EXEC SQL OPEN c_no;
+		// EXEC SQL FETCH c_no INTO :no_o_id;
+		// New-order rows are not removed; a non-zero o_carrier_id marks the 
+		// order as delivered, and deliv_hint skips the delivered prefix.
+		uint64_t no_o_id = _wl->deliv_hint[distKey(d_id, w_id)];
+		row_t * r_order_local = NULL;
+		while (true) {
+			uint64_t key = orderPrimaryKey(w_id, d_id, no_o_id);
+			if (index_read(_wl->i_neworder, key, part_id) == NULL)
+				break;
+			itemid_t * item = index_read(_wl->i_order, key, part_id);
+			assert(item != NULL);
+			row_t * r_order = (row_t *) item->location;
+			r_order_local = get_row(r_order, probe_type);
+			if (r_order_local == NULL) {
+				return finish(Abort);
+			}
+			int64_t o_carrier_id;
+			r_order_local->get_value(O_CARRIER_ID, o_carrier_id);
+			if (o_carrier_id == 0 && probe_type == RD) {
+				// only the order that is delivered is written.
+				r_order_local = get_row(r_order, WR);
+				if (r_order_local == NULL) {
+					return finish(Abort);
+				}
+				r_order_local->get_value(O_CARRIER_ID, o_carrier_id);
+			}
+			if (o_carrier_id == 0)
+				break;
+			r_order_local = NULL;
+			no_o_id ++;
 		}
-		uint64_t no_o_id;
-		row_t * r_orderline = (row_t *)item->location;
-		r_orderling->get_value(OL_O_ID, no_o_id);
-		// TODO the orderline row should be removed from the table and indexes.
-		
-		index = _wl->i_order;
-		key = orderPrimaryKey(query->w_id, d_id, no_o_id);
-		itemid_t * item = index_read(index, key, wh_to_part(query->w_id));
-		row_t * r_order = (row_t *)item->location;
-		row_t * r_order_local = get_row(r_order, WR);
-
-		uint64_t o_c_id;
+		// no outstanding order in this district
+		if (r_order_local == NULL)
+			continue;
+
+		// EXEC SQL SELECT o_c_id INTO :c_id FROM orders
+		// WHERE o_id = :no_o_id AND o_d_id = :d_id AND o_w_id = :w_id;
+		// EXEC SQL UPDATE orders SET o_carrier_id = :o_carrier_id
+		// WHERE o_id = :no_o_id AND o_d_id = :d_id AND o_w_id = :w_id;
+		int64_t o_c_id;
+		int64_t o_carrier_id = query->o_carrier_id;
 		r_order_local->get_value(O_C_ID, o_c_id);
-		r_order_local->set_value(O_CARRIER_ID, query->o_carrier_id);
-
-		item = index_read(_wl->i_order_line, orderlineKey(query->w_id, d_id, no_o_id));
-		double sum_ol_amount;
-		double ol_amount;
+		r_order_local->set_value(O_CARRIER_ID, o_carrier_id);
+
+		// EXEC SQL UPDATE order_line SET ol_delivery_d = :datetime
+		// WHERE ol_o_id = :no_o_id AND ol_d_id = :d_id AND ol_w_id = :w_id;
+		// EXEC SQL SELECT SUM(ol_amount) INTO :ol_total FROM order_line
+		// WHERE ol_o_id = :no_o_id AND ol_d_id = :d_id AND ol_w_id = :w_id;
+		double ol_total = 0;
+		itemid_t * item = index_read(_wl->i_orderline, 
+						orderlineKey(w_id, d_id, no_o_id), part_id);
 		while (item != NULL) {
-			// TODO the row is not locked
-			row_t * r_orderline = (row_t *)item->location;
-			r_orderline->set_value(OL_DELIVERY_D, query->ol_delivery_d);
-			r_orderline->get_value(OL_AMOUNT, ol_amount);
-			sum_ol_amount += ol_amount;
+			row_t * r_ol_local = get_row((row_t *) item->location, WR);
+			if (r_ol_local == NULL) {
+				return finish(Abort);
+			}
+#if !TPCC_SMALL
+			int64_t ol_delivery_d = query->ol_delivery_d;
+			double ol_amount;
+			r_ol_local->set_value(OL_DELIVERY_D, ol_delivery_d);
+			r_ol_local->get_value(OL_AMOUNT, ol_amount);
+			ol_total += ol_amount;
+#endif
+			item = item->next;
+		}
+
+		// EXEC SQL UPDATE customer SET c_balance = c_balance + :ol_total,
+		// c_delivery_cnt = c_delivery_cnt + 1
+		// WHERE c_id = :c_id AND c_d_id = :d_id AND c_w_id = :w_id;
+		item = index_read(_wl->i_customer_id, custKey(o_c_id, d_id, w_id), part_id);
+		assert(item != NULL);
+		row_t * r_cust_local = get_row((row_t *) item->location, WR);
+		if (r_cust_local == NULL) {
+			return finish(Abort);
 		}
-		
-		key = custKey(o_c_id, d_id, query->w_id);
-		itemid_t * item = index_read(_wl->i_customer_id, key, wh_to_part(query->w_id));
-		row_t * r_cust = (row_t *)item->location;
 		double c_balance;
-		uint64_t c_delivery_cnt;
+		r_cust_local->get_value(C_BALANCE, c_balance);
+		r_cust_local->set_value(C_BALANCE, c_balance + ol_total);
+#if !TPCC_SMALL
+		int64_t c_delivery_cnt;
+		r_cust_local->get_value(C_DELIVERY_CNT, c_delivery_cnt);
+		c_delivery_cnt ++;
+		r_cust_local->set_value(C_DELIVERY_CNT, c_delivery_cnt);
+#endif
+		delivered[d_id] = no_o_id;
+	}
+	RC rc = finish(RCOK);
+	if (rc == RCOK) {
+		// The txn can no longer abort, so the hints may move past the orders
+		// it delivered.
+		for (uint64_t d_id = 1; d_id <= DIST_PER_WARE; d_id++) {
+			if (delivered[d_id] == 0)
+				continue;
+			uint64_t * hint = &_wl->deliv_hint[distKey(d_id, w_id)];
+			uint64_t old_hint = *hint;
+			while (old_hint <= delivered[d_id] && 
+					!ATOM_CAS(*hint, old_hint, delivered[d_id] + 1))
+				old_hint = *hint;
+		}
 	}
-*/
-	return RCOK;
+	return rc;
 }
 
 RC 
 tpcc_txn_man::run_stock_level(tpcc_query * query) {
-	return RCOK;
+	uint64_t w_id = query->w_id;
+	uint64_t d_id = query->d_id;
+	int part_id = wh_to_part(w_id);
+	// EXEC SQL SELECT d_next_o_id INTO :o_id
+	// FROM district
+	// WHERE d_w_id=:w_id AND d_id=:d_id;
+	itemid_t * item = index_read(_wl->i_district, distKey(d_id, w_id), part_id);
+	assert(item != NULL);
+	row_t * r_dist_local = get_row((row_t *) item->location, RD);
+	if (r_dist_local == NULL) {
+		return finish(Abort);
+	}
+	int64_t d_next_o_id;
+	r_dist_local->get_value(D_NEXT_O_ID, d_next_o_id);
+
+	// EXEC SQL SELECT COUNT(DISTINCT (s_i_id)) INTO :stock_count
+	// FROM order_line, stock
+	// WHERE ol_w_id=:w_id AND
+	// ol_d_id=:d_id AND ol_o_id<:o_id AND
+	// ol_o_id>=:o_id-20 AND s_w_id=:w_id AND
+	// s_i_id=ol_i_id AND s_quantity < :threshold;
+	uint64_t i_ids[20 * MAX_OL_PER_ORDER];
+	uint64_t i_id_cnt = 0;
+	for (int64_t o_id = d_next_o_id - 20; o_id < d_next_o_id; o_id++) {
+		item = index_read(_wl->i_orderline, orderlineKey(w_id, d_id, o_id), part_id);
+		while (item != NULL) {
+			row_t * r_ol_local = get_row((row_t *) item->location, RD);
+			if (r_ol_local == NULL) {
+				return finish(Abort);
+			}
+			int64_t ol_i_id;
+			r_ol_local->get_value(OL_I_ID, ol_i_id);
+			bool found = false;
+			for (uint64_t i = 0; i < i_id_cnt && !found; i++)
+				found = (i_ids[i] == (uint64_t) ol_i_id);
+			if (!found) {
+				assert(i_id_cnt < 20 * MAX_OL_PER_ORDER);
+				i_ids[i_id_cnt ++] = ol_i_id;
+			}
+			item = item->next;
+		}
+	}
+	// the count is not returned, so only the stock rows are read.
+	for (uint64_t i = 0; i < i_id_cnt; i++) {
+		item = index_read(_wl->i_stock, stockKey(i_ids[i], w_id), part_id);
+		assert(item != NULL);
+		row_t * r_stock_local = get_row((row_t *) item->location, RD);
+		if (r_stock_local == NULL) {
+			return finish(Abort);
+		}
+		int64_t s_quantity;
+		r_stock_local->get_value(S_QUANTITY, s_quantity);
+	}
+	return finish(RCOK);
 }
@@ -47,11 +47,19 @@ RC tpcc_wl::init_schema(const char * schema_file) {
 	i_customer_id = indexes["CUSTOMER_ID_IDX"];
 	i_customer_last = indexes["CUSTOMER_LAST_IDX"];
 	i_stock = indexes["STOCK_IDX"];
+	i_order = indexes["ORDER_IDX"];
+	i_orderline = indexes["ORDER-LINE_IDX"];
+	i_neworder = indexes["NEW-ORDER_IDX"];
+	i_order_cust = indexes["ORDER_CUST_IDX"];
 	return RCOK;
 }
 
 RC tpcc_wl::init_table() {
 	num_wh = g_num_wh;
+	uint64_t dist_cnt = distKey(DIST_PER_WARE, g_num_wh) + 1;
+	deliv_hint = new uint64_t [dist_cnt];
+	for (uint64_t i = 0; i < dist_cnt; i++)
+		deliv_hint[i] = 2101;
 
 /******** fill in data ************/
 // data filling process:
@@ -257,7 +265,7 @@ void tpcc_wl::init_tab_cust(uint64_t did, uint64_t wid) {
 		row->set_value(C_PHONE, phone);
 		row->set_value(C_SINCE, 0);
 		row->set_value(C_CREDIT_LIM, 50000);
-		row->set_value(C_DELIVERY_CNT, 0);
+		row->set_value(C_DELIVERY_CNT, (int64_t)0);
 		char c_data[500];
         MakeAlphaString(300, 500, c_data, wid-1);
 		row->set_value(C_DATA, c_data);
@@ -320,10 +328,12 @@ void tpcc_wl::init_tab_order(uint64_t did, uint64_t wid) {
 		if (oid < 2101)
 			row->set_value(O_CARRIER_ID, URand(1, 10, wid-1));
 		else 
-			row->set_value(O_CARRIER_ID, 0);
+			row->set_value(O_CARRIER_ID, (int64_t)0);
 		o_ol_cnt = URand(5, 15, wid-1);
 		row->set_value(O_OL_CNT, o_ol_cnt);
 		row->set_value(O_ALL_LOCAL, 1);
+		index_insert(i_order, orderPrimaryKey(wid, did, oid), row, wh_to_part(wid));
+		index_insert(i_order_cust, custKey(cid, did, wid), row, wh_to_part(wid));
 		
 		// ORDER-LINE	
 #if !TPCC_SMALL
@@ -337,15 +347,16 @@ void tpcc_wl::init_tab_order(uint64_t did, uint64_t wid) {
 			row->set_value(OL_SUPPLY_W_ID, wid);
 			if (oid < 2101) {
 				row->set_value(OL_DELIVERY_D, o_entry);
-				row->set_value(OL_AMOUNT, 0);
+				row->set_value(OL_AMOUNT, (double)0);
 			} else {
-				row->set_value(OL_DELIVERY_D, 0);
+				row->set_value(OL_DELIVERY_D, (int64_t)0);
 				row->set_value(OL_AMOUNT, (double)URand(1, 999999, wid-1)/100);
 			}
-			row->set_value(OL_QUANTITY, 5);
+			row->set_value(OL_QUANTITY, (int64_t)5);
 			char ol_dist_info[24];
 	        MakeAlphaString(24, 24, ol_dist_info, wid-1);
 			row->set_value(OL_DIST_INFO, ol_dist_info);
+			index_insert(i_orderline, orderlineKey(wid, did, oid), row, wh_to_part(wid));
 		}
 #endif
 		// NEW ORDER
@@ -354,6 +365,7 @@ void tpcc_wl::init_tab_order(uint64_t did, uint64_t wid) {
 			row->set_value(NO_O_ID, oid);
 			row->set_value(NO_D_ID, did);
 			row->set_value(NO_W_ID, wid);
+			index_insert(i_neworder, orderPrimaryKey(wid, did, oid), row, wh_to_part(wid));
 		}
 	}
 }
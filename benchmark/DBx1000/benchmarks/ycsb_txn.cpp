@@ -32,6 +32,17 @@ RC ycsb_txn_man::run_txn(base_query * query) {
 	ycsb_wl * wl = (ycsb_wl *) h_wl;
 	itemid_t * m_item = NULL;
   	row_cnt = 0;
+#if CC_ALG == RLU || CC_ALG == MVRLU
+	rlu_thread_data_t* self = this->h_thd->p_rlu_td;
+	ts_t starttime;
+#if YCSB_RLU_TXN_SECTION
+	// the index is read inside the section so that it is consistent
+	// with the row snapshot.
+	starttime = get_sys_clock();
+	RLU_READER_LOCK(self);
+	INC_TMP_STATS(get_thd_id(), time_wait, get_sys_clock() - starttime);
+#endif
+#endif
 
 	for (uint32_t rid = 0; rid < m_query->request_cnt; rid ++) {
 		ycsb_request * req = &m_query->requests[rid];
@@ -39,26 +50,29 @@ RC ycsb_txn_man::run_txn(base_query * query) {
 		bool finish_req = false;
 		UInt32 iteration = 0;
 		while ( !finish_req ) {
+#if (CC_ALG == RLU || CC_ALG == MVRLU) && !YCSB_RLU_TXN_SECTION
+        starttime = get_sys_clock();
+        RLU_READER_LOCK(self);
+        INC_TMP_STATS(get_thd_id(), time_wait, get_sys_clock() - starttime);
+#endif
 			if (iteration == 0) {
 				m_item = index_read(_wl->the_index, req->key, part_id);
 			} 
 #if INDEX_STRUCT == IDX_BTREE
 			else {
 				_wl->the_index->index_next(get_thd_id(), m_item);
-				if (m_item == NULL)
+				if (m_item == NULL) {
+#if (CC_ALG == RLU || CC_ALG == MVRLU) && !YCSB_RLU_TXN_SECTION
+					RLU_READER_UNLOCK(self);
+#endif
 					break;
+				}
 			}
 #endif
 			row_t * row = ((row_t *)m_item->location);
 			row_t * row_local; 
 			access_t type = req->rtype;
 			
-#if CC_ALG == RLU || CC_ALG == MVRLU
-        ts_t starttime = get_sys_clock();
-        rlu_thread_data_t* self = this->h_thd->p_rlu_td;
-        RLU_READER_LOCK(self);
-        INC_TMP_STATS(get_thd_id(), time_wait, get_sys_clock() - starttime);
-#endif
 			row_local = get_row(row, type);
 			if (row_local == NULL) {
 				rc = Abort;
@@ -81,24 +95,34 @@ RC ycsb_txn_man::run_txn(base_query * query) {
                     assert(req->rtype == WR);
 //					for (int fid = 0; fid < schema->get_field_cnt(); fid++) {
 						int fid = 0;
+#if CC_ALG == MVRLU
+						// write the locked copy; it becomes visible at commit.
+						char * data = row_local->get_data();
+#else
 						char * data = row->get_data();
+#endif
 						*(uint64_t *)(&data[fid * 10]) = 0;
 //					}
                 } 
             }
-#if CC_ALG == RLU || CC_ALG == MVRLU
+#if (CC_ALG == RLU || CC_ALG == MVRLU) && !YCSB_RLU_TXN_SECTION
         starttime = get_sys_clock();
         RLU_READER_UNLOCK(self);
         INC_TMP_STATS(get_thd_id(), time_wait, get_sys_clock() - starttime);
 #endif
 
-
 			iteration ++;
 			if (req->rtype == RD || req->rtype == WR || iteration == req->scan_len)
 				finish_req = true;
 		}
 	}
 	rc = RCOK;
+#if (CC_ALG == RLU || CC_ALG == MVRLU) && YCSB_RLU_TXN_SECTION
+	// commit all the writes of the query at once
+	starttime = get_sys_clock();
+	RLU_READER_UNLOCK(self);
+	INC_TMP_STATS(get_thd_id(), time_wait, get_sys_clock() - starttime);
+#endif
 final:
 	rc = finish(rc);
 	return rc;
@@ -23,6 +23,8 @@ txn_man::validate_hekaton(RC rc)
 		}
 	}
 #endif
+	if (rc == RCOK)
+		apply_index_inserts(rc);
 	// postprocess 
 	for (int rid = 0; rid < row_cnt; rid ++) {
 		if (accesses[rid]->type == RD)
@@ -22,7 +22,12 @@ RC Row_rlu::access(txn_man *txn, TsType type, row_t *row)
                 return rc;
         } else if(type == P_REQ){
                 row_t *update_row = _row;
+#if CC_ALG == MVRLU
+                // copy the inline tuple along with the row header
+                if(!mvrlu_try_lock_full(self, &update_row)){
+#else
                 if(!RLU_TRY_LOCK(self, &update_row)){
+#endif
                         rc = Abort;
                         return rc;
                 }
@@ -230,6 +230,7 @@ final:
 	} else {
 		if (commit_wts > _max_wts)
 			_max_wts = commit_wts;
+		apply_index_inserts(rc);
 
 		if (_write_copy_ptr) {
 			assert(false);
@@ -105,8 +105,9 @@
 /***********************************************/
 // Benchmark
 /***********************************************/
-// max number of rows touched per transaction
-#define MAX_ROW_PER_TXN			32
+// max number of rows a transaction inserts; the access array starts at
+// this size and grows for the TPC-C scans (Delivery, Stock-Level).
+#define MAX_ROW_PER_TXN			64
 #define QUERY_INTVL 				1UL
 #define MAX_TXN_PER_PART 			100000
 #define FIRST_PART_LOCAL 			true
@@ -123,6 +124,9 @@
 #define PERC_MULTI_PART				1
 #define REQ_PER_QUERY				16
 #define FIELD_PER_TUPLE				10
+// [RLU, MVRLU] run a whole query in one RLU section, i.e., one snapshot and
+// one commit. If false, every request takes its own section.
+#define YCSB_RLU_TXN_SECTION		true
 // ==== [TPCC] ====
 // For large warehouse count, the tables do not fit in memory
 // small tpcc schemas shrink the table size.
@@ -144,11 +148,17 @@ extern TPCCTxnType 					g_tpcc_txn_type;
 
 //#define TXN_TYPE					TPCC_ALL
 #define PERC_PAYMENT 				0.5
+// The rest of the TPC-C mix. New-Order takes what is left.
+// The standard mix is 43% Payment and 4% for each of the following.
+#define PERC_ORDER_STATUS			0
+#define PERC_DELIVERY				0
+#define PERC_STOCK_LEVEL			0
 #define FIRSTNAME_MINLEN 			8
 #define FIRSTNAME_LEN 				16
 #define LASTNAME_LEN 				16
 
 #define DIST_PER_WARE				10
+#define MAX_OL_PER_ORDER			15
 
 /***********************************************/
 // TODO centralized CC management. 
@@ -166,8 +176,11 @@ extern TPCCTxnType 					g_tpcc_txn_type;
 #define TEST_ALL					true
 enum TestCases {
 	READ_WRITE,
-	CONFLICT
+	CONFLICT,
+	INSERT_ABORT
 };
+// txns per thread of the INSERT_ABORT test
+#define INSERT_ABORT_TXN_CNT		1000
 extern TestCases					g_test_case;
 /***********************************************/
 // DEBUG info /***********************************************/
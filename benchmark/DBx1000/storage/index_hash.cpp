@@ -82,6 +82,27 @@ RC IndexHash::index_read(idx_key_t key, itemid_t * &item,
 	return rc;
 }
 
+#if CC_ALG == MVRLU
+RC IndexHash::index_insert(idx_key_t key, itemid_t * item, 
+						int part_id, rlu_thread_data_t * self,
+						BucketNode *& new_node) {
+	uint64_t bkt_idx = hash(key);
+	assert(bkt_idx < _bucket_cnt_per_part);
+	BucketHeader * cur_bkt = &_buckets[part_id][bkt_idx];
+	// no latch. conflicting inserts are detected by RLU_TRY_LOCK.
+	return cur_bkt->insert_item(key, item, self, new_node);
+}
+
+RC IndexHash::index_read(idx_key_t key, itemid_t * &item, 
+						int part_id, rlu_thread_data_t * self) {
+	uint64_t bkt_idx = hash(key);
+	assert(bkt_idx < _bucket_cnt_per_part);
+	BucketHeader * cur_bkt = &_buckets[part_id][bkt_idx];
+	cur_bkt->read_item(key, item, self);
+	return RCOK;
+}
+#endif
+
 /************** BucketHeader Operations ******************/
 
 void BucketHeader::init() {
@@ -103,8 +124,12 @@ void BucketHeader::insert_item(idx_key_t key,
 		cur_node = cur_node->next;
 	}
 	if (cur_node == NULL) {		
+#if CC_ALG == MVRLU
+		BucketNode * new_node = (BucketNode *) RLU_ALLOC(sizeof(BucketNode));
+#else
 		BucketNode * new_node = (BucketNode *) 
 			mem_allocator.alloc(sizeof(BucketNode), part_id );
+#endif
 		new_node->init(key);
 		new_node->items = item;
 		if (prev_node != NULL) {
@@ -128,6 +153,74 @@ void BucketHeader::read_item(idx_key_t key, itemid_t * &item, const char * tname
 			break;
 		cur_node = cur_node->next;
 	}
-	M_ASSERT(cur_node->key == key, "Key does not exist!");
-	item = cur_node->items;
+	// keys inserted at runtime may not exist yet.
+	item = (cur_node == NULL)? NULL : cur_node->items;
+}
+
+#if CC_ALG == MVRLU
+RC BucketHeader::insert_item(idx_key_t key, 
+		itemid_t * item, 
+		rlu_thread_data_t * self,
+		BucketNode *& new_node) 
+{
+	new_node = NULL;
+	BucketNode * head = (BucketNode *) RLU_DEREF(self, first_node);
+	if (head == NULL) {
+		// An empty bucket has no node to lock, so its first node is 
+		// published with a CAS outside the write set. This is safe because 
+		// the node has no items: readers treat it as absent, and a txn that 
+		// aborts after publishing it leaves no state to roll back. The items 
+		// are linked below under RLU_TRY_LOCK, as for any other key, and a 
+		// txn that loses the race frees a node nobody has seen.
+		BucketNode * empty_node = (BucketNode *) RLU_ALLOC(sizeof(BucketNode));
+		empty_node->init(key);
+		if (!ATOM_CAS(first_node, NULL, empty_node))
+			RLU_FREE(NULL, empty_node);
+		head = (BucketNode *) RLU_DEREF(self, first_node);
+	}
+	// find the key and the node with the closest smaller key
+	BucketNode * prev_node = head;
+	BucketNode * cur_node = head;
+	while (cur_node != NULL) {
+		if (cur_node->key == key)
+			break;
+		if (cur_node->key < key && 
+				(prev_node->key > key || prev_node->key < cur_node->key))
+			prev_node = cur_node;
+		cur_node = (BucketNode *) RLU_DEREF(self, cur_node->next);
+	}
+	if (cur_node != NULL) {
+		// add the item to the existing key
+		if (!RLU_TRY_LOCK(self, &cur_node))
+			return Abort;
+		itemid_t * tail = item;
+		while (tail->next != NULL)
+			tail = tail->next;
+		tail->next = cur_node->items;
+		cur_node->items = item;
+		return RCOK;
+	}
+	// link a new node after prev_node; it is only reachable from the locked
+	// copy, so it disappears with the write set if the txn aborts.
+	if (!RLU_TRY_LOCK(self, &prev_node))
+		return Abort;
+	new_node = (BucketNode *) RLU_ALLOC(sizeof(BucketNode));
+	new_node->init(key);
+	new_node->items = item;
+	new_node->next = prev_node->next;
+	RLU_ASSIGN_PTR(self, &prev_node->next, new_node);
+	return RCOK;
+}
+
+void BucketHeader::read_item(idx_key_t key, itemid_t * &item, 
+		rlu_thread_data_t * self) 
+{
+	BucketNode * cur_node = (BucketNode *) RLU_DEREF(self, first_node);
+	while (cur_node != NULL) {
+		if (cur_node->key == key)
+			break;
+		cur_node = (BucketNode *) RLU_DEREF(self, cur_node->next);
+	}
+	item = (cur_node == NULL)? NULL : cur_node->items;
 }
+#endif
@@ -3,6 +3,9 @@
 #include "global.h"
 #include "helper.h"
 #include "index_base.h"
+#if CC_ALG == MVRLU
+#include "mvrlu.h"
+#endif
 
 //TODO make proper variables private
 // each BucketNode contains items sharing the same key
@@ -22,11 +25,24 @@ public:
 };
 
 // BucketHeader does concurrency control of Hash
+// With MV-RLU, every BucketNode is an MV-RLU object. Readers walk the chain
+// with RLU_DEREF inside the transaction's read section and writers link new
+// items by locking the node they modify. A new key is linked after the node
+// with the closest smaller key, so inserts of different keys into a bucket
+// lock different nodes. A node whose item list is empty (the first node of
+// a bucket, see insert_item) is treated as absent.
+// MV-RLU does not let a txn re-lock its own copy, so a txn must insert all
+// items of a key at once, passing them as a chain linked through next.
 class BucketHeader {
 public:
 	void init();
 	void insert_item(idx_key_t key, itemid_t * item, int part_id);
 	void read_item(idx_key_t key, itemid_t * &item, const char * tname);
+#if CC_ALG == MVRLU
+	RC insert_item(idx_key_t key, itemid_t * item, rlu_thread_data_t * self,
+					BucketNode *& new_node);
+	void read_item(idx_key_t key, itemid_t * &item, rlu_thread_data_t * self);
+#endif
 	BucketNode * 	first_node;
 	uint64_t 		node_cnt;
 	bool 			locked;
@@ -46,6 +62,16 @@ public:
 	RC	 		index_read(idx_key_t key, itemid_t * &item, int part_id=-1);	
 	RC	 		index_read(idx_key_t key, itemid_t * &item,
 							int part_id=-1, int thd_id=0);
+#if CC_ALG == MVRLU
+	// the following calls must be made inside an MV-RLU read section.
+	// index_insert returns Abort if a bucket node is locked by another txn.
+	// Otherwise new_node is the node it linked for a new key, or NULL; the
+	// caller frees it with the items if the txn aborts later on.
+	RC 			index_insert(idx_key_t key, itemid_t * item, int part_id,
+							rlu_thread_data_t * self, BucketNode *& new_node);
+	RC	 		index_read(idx_key_t key, itemid_t * &item, int part_id,
+							rlu_thread_data_t * self);
+#endif
 private:
 	void get_latch(BucketHeader * bucket);
 	void release_latch(BucketHeader * bucket);
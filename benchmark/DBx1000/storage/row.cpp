@@ -21,15 +21,21 @@ row_t::init(table_t * host_table, uint64_t part_id, uint64_t row_id) {
 	_row_id = row_id;
 	_part_id = part_id;
 	this->table = host_table;
+#if CC_ALG != MVRLU
 	Catalog * schema = host_table->get_schema();
 	int tuple_size = schema->get_tuple_size();
 	data = (char *) _mm_malloc(sizeof(char) * tuple_size, 64);
+#endif
 	return RCOK;
 }
 void 
 row_t::init(int size) 
 {
+#if CC_ALG == MVRLU
+	assert(false);
+#else
 	data = (char *) _mm_malloc(size, 64);
+#endif
 }
 
 RC 
@@ -132,7 +138,9 @@ void row_t::copy(row_t * src) {
 }
 
 void row_t::free_row() {
+#if CC_ALG != MVRLU
 	free(data);
+#endif
 }
 
 RC row_t::get_row(access_t type, txn_man * txn, row_t *& row) {
@@ -103,11 +103,20 @@ public:
   #elif CC_ALG == RLU || CC_ALG == MVRLU
   	Row_rlu * manager;
   #endif
+#if CC_ALG != MVRLU
 	char * data;
+#endif
 	table_t * table;
 private:
 	// primary key should be calculated from the data stored in the row.
 	uint64_t 		_primary_key;
 	uint64_t		_part_id;
 	uint64_t 		_row_id;
+#if CC_ALG == MVRLU
+public:
+	// MV-RLU versions a row as a single object, so the tuple is stored 
+	// inline after the header and RLU_TRY_LOCK copies it with the row.
+	// The row must be allocated with sizeof(row_t) + tuple size.
+	char data[0];
+#endif
 };
@@ -26,7 +26,10 @@ RC table_t::get_new_row(row_t *& row, uint64_t part_id, uint64_t &row_id) {
 	RC rc = RCOK;
 	cur_tab_size ++;
 
-#if CC_ALG == RLU || CC_ALG == MVRLU
+#if CC_ALG == MVRLU
+        row = (row_t *)RLU_ALLOC(sizeof(row_t) + schema->get_tuple_size());
+        assert(row != NULL);
+#elif CC_ALG == RLU
         row = (row_t *)RLU_ALLOC(sizeof(row_t));
         assert(row != NULL);
 #else
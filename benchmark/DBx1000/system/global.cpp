@@ -56,6 +56,9 @@ UInt32 g_init_parallelism = INIT_PARALLELISM;
 
 UInt32 g_num_wh = NUM_WH;
 double g_perc_payment = PERC_PAYMENT;
+double g_perc_order_status = PERC_ORDER_STATUS;
+double g_perc_delivery = PERC_DELIVERY;
+double g_perc_stock_level = PERC_STOCK_LEVEL;
 bool g_wh_update = WH_UPDATE;
 char * output_file = NULL;
 
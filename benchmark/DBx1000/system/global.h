@@ -105,6 +105,9 @@ extern UInt32 g_init_parallelism;
 // TPCC
 extern UInt32 g_num_wh;
 extern double g_perc_payment;
+extern double g_perc_order_status;
+extern double g_perc_delivery;
+extern double g_perc_stock_level;
 extern bool g_wh_update;
 extern char * output_file;
 extern UInt32 g_max_items;
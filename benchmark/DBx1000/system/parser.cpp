@@ -34,10 +34,14 @@ void print_usage() {
 	printf("  [TPCC]:\n");
 	printf("\t-nINT       ; NUM_WH\n");
 	printf("\t-TpFLOAT    ; PERC_PAYMENT\n");
+	printf("\t-ToFLOAT    ; PERC_ORDER_STATUS\n");
+	printf("\t-TdFLOAT    ; PERC_DELIVERY\n");
+	printf("\t-TsFLOAT    ; PERC_STOCK_LEVEL\n");
 	printf("\t-TuINT      ; WH_UPDATE\n");
 	printf("  [TEST]:\n");
 	printf("\t-Ar         ; Test READ_WRITE\n");
 	printf("\t-Ac         ; Test CONFLIT\n");
+	printf("\t-Ai         ; Test INSERT_ABORT\n");
 }
 
 void parser(int argc, char * argv[]) {
@@ -103,6 +107,12 @@ void parser(int argc, char * argv[]) {
 		} else if (argv[i][1] == 'T') {
 			if (argv[i][2] == 'p')
 				g_perc_payment = atof( &argv[i][3] );
+			if (argv[i][2] == 'o')
+				g_perc_order_status = atof( &argv[i][3] );
+			if (argv[i][2] == 'd')
+				g_perc_delivery = atof( &argv[i][3] );
+			if (argv[i][2] == 's')
+				g_perc_stock_level = atof( &argv[i][3] );
 			if (argv[i][2] == 'u')
 				g_wh_update = atoi( &argv[i][3] );
 		} else if (argv[i][1] == 'A') {
@@ -110,6 +120,8 @@ void parser(int argc, char * argv[]) {
 				g_test_case = READ_WRITE;
 			if (argv[i][2] == 'c')
 				g_test_case = CONFLICT;
+			if (argv[i][2] == 'i')
+				g_test_case = INSERT_ABORT;
 		}
 		else if (argv[i][1] == 'o') {
 			i++;
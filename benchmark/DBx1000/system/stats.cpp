@@ -6,6 +6,8 @@
 #define BILLION 1000000000UL
 
 void Stats_thd::init(uint64_t thd_id) {
+	lat = (struct lat_hist *)
+		_mm_malloc(sizeof(struct lat_hist) * LAT_TXN_TYPES, 64);
 	clear();
 	all_debug1 = (uint64_t *)
 		_mm_malloc(sizeof(uint64_t) * MAX_TXN_PER_PART, 64);
@@ -29,6 +31,8 @@ void Stats_thd::clear() {
 	time_wait = 0;
 	time_ts_alloc = 0;
 	latency = 0;
+	for (int i = 0; i < LAT_TXN_TYPES; i++)
+		lat_hist_init(&lat[i]);
 	time_query = 0;
 }
 
@@ -103,6 +107,11 @@ void Stats::abort(uint64_t thd_id) {
 		tmp_stats[thd_id]->init();
 }
 
+void Stats::add_lat(uint64_t thd_id, uint64_t type, uint64_t latency) {
+	if (STATS_ENABLE)
+		lat_hist_record(&_stats[thd_id]->lat[type], latency);
+}
+
 void Stats::print() {
 	
 	uint64_t total_txn_cnt = 0;
@@ -174,6 +183,7 @@ void Stats::print() {
 			total_debug4, // / BILLION,
 			total_debug5 / BILLION
 		);
+		print_lat(outf);
 		fclose(outf);
 	}
 	printf("[summary] txn_cnt=%ld, abort_cnt=%ld"
@@ -202,10 +212,37 @@ void Stats::print() {
 		total_debug4, // / BILLION,
 		total_debug5  // / BILLION 
 	);
+	print_lat(stdout);
 	if (g_prt_lat_distr)
 		print_lat_distr();
 }
 
+void Stats::print_lat(FILE * outf) {
+	static const char * names[LAT_TXN_TYPES] = {
+		WORKLOAD == YCSB ? "ycsb" : "all", "payment", "new_order", 
+		"order_status", "delivery", "stock_level"};
+	struct lat_hist * lat = (struct lat_hist *) 
+		_mm_malloc(sizeof(struct lat_hist), 64);
+	for (int type = 0; type < LAT_TXN_TYPES; type ++) {
+		lat_hist_init(lat);
+		for (uint64_t tid = 0; tid < g_thread_cnt; tid ++)
+			lat_hist_merge(lat, &_stats[tid]->lat[type]);
+		if (lat->count == 0)
+			continue;
+		// get_sys_clock() counts ns
+		fprintf(outf, "[latency txn=%s] cnt=%ld, p50_us=%f, p99_us=%f"
+			", p999_us=%f, max_us=%f\n",
+			names[type], 
+			lat->count,
+			lat_hist_quantile(lat, 0.5) / 1000.0,
+			lat_hist_quantile(lat, 0.99) / 1000.0,
+			lat_hist_quantile(lat, 0.999) / 1000.0,
+			lat->max / 1000.0
+		);
+	}
+	_mm_free(lat);
+}
+
 void Stats::print_lat_distr() {
 	FILE * outf;
 	if (output_file != NULL) {
@@ -1,5 +1,10 @@
 #pragma once 
 
+#include "lat_hist.h"
+
+// latency histograms are kept per TPCCTxnType; YCSB uses the first one.
+#define LAT_TXN_TYPES				(TPCC_STOCK_LEVEL + 1)
+
 class Stats_thd {
 public:
 	void init(uint64_t thd_id);
@@ -24,6 +29,8 @@ public:
 	uint64_t debug5;
 	
 	uint64_t latency;
+	// latency of the committed txns, from the first try to the commit.
+	struct lat_hist * lat;
 	uint64_t * all_debug1;
 	uint64_t * all_debug2;
 	char _pad[CL_SIZE];
@@ -59,6 +66,9 @@ public:
 	void add_debug(uint64_t thd_id, uint64_t value, uint32_t select);
 	void commit(uint64_t thd_id);
 	void abort(uint64_t thd_id);
+	void add_lat(uint64_t thd_id, uint64_t type, uint64_t latency);
 	void print();
 	void print_lat_distr();
+private:
+	void print_lat(FILE * outf);
 };
@@ -61,6 +61,8 @@ RC thread_t::run() {
 	glob_manager->set_txn_man(m_txn);
 
 	base_query * m_query = NULL;
+	// when the current query was first tried
+	ts_t query_start = 0;
 	uint64_t thd_txn_id = 0;
 	UInt64 txn_cnt = 0;
 
@@ -77,6 +79,7 @@ RC thread_t::run() {
 						for (int i = 0; i < _abort_buffer_size; i++) {
 							if (_abort_buffer[i].query != NULL && curr_time > _abort_buffer[i].ready_time) {
 								m_query = _abort_buffer[i].query;
+								query_start = _abort_buffer[i].start_time;
 								_abort_buffer[i].query = NULL;
 								_abort_buffer_empty_slots ++;
 								break;
@@ -92,6 +95,7 @@ RC thread_t::run() {
 					}
 					else if (m_query == NULL) {
 						m_query = query_queue->get_next_query( _thd_id );
+						query_start = starttime;
 					#if CC_ALG == WAIT_DIE
 						m_txn->set_ts(get_next_ts());
 					#endif
@@ -100,8 +104,10 @@ RC thread_t::run() {
 						break;
 				}
 			} else {
-				if (rc == RCOK)
+				if (rc == RCOK) {
 					m_query = query_queue->get_next_query( _thd_id );
+					query_start = starttime;
+				}
 			}
 		}
 		INC_STATS(_thd_id, time_query, get_sys_clock() - starttime);
@@ -166,6 +172,7 @@ RC thread_t::run() {
 					if (_abort_buffer[i].query == NULL) {
 						_abort_buffer[i].query = m_query;
 						_abort_buffer[i].ready_time = get_sys_clock() + penalty;
+						_abort_buffer[i].start_time = query_start;
 						_abort_buffer_empty_slots --;
 						break;
 					}
@@ -180,6 +187,12 @@ RC thread_t::run() {
 		//stats.add_lat(get_thd_id(), timespan);
 		if (rc == RCOK) {
 			INC_STATS(get_thd_id(), txn_cnt, 1);
+#if WORKLOAD == TPCC
+			stats.add_lat(get_thd_id(), ((tpcc_query *) m_query)->type, 
+				endtime - query_start);
+#elif WORKLOAD == YCSB
+			stats.add_lat(get_thd_id(), 0, endtime - query_start);
+#endif
 			stats.commit(get_thd_id());
 			txn_cnt ++;
 		} else if (rc == Abort) {
@@ -249,6 +262,16 @@ RC thread_t::runTest(txn_man * txn)
 		else 
 			return rc;
 	}
+	else if (g_test_case == INSERT_ABORT) {
+		// even txns retry until they commit, odd ones abort on purpose.
+		for (int i = 0; i < INSERT_ABORT_TXN_CNT; i ++) {
+			do {
+				rc = ((TestTxnMan *)txn)->run_txn(g_test_case, i);
+			} while (rc == Abort && i % 2 == 0);
+		}
+		((TestTxnMan *)txn)->checkIndexInsert(INSERT_ABORT_TXN_CNT);
+		return FINISH;
+	}
 	assert(false);
 	return RCOK;
 }
@@ -49,6 +49,7 @@ private:
 	// A restart buffer for aborted txns.
 	struct AbortBufferEntry	{
 		ts_t ready_time;
+		ts_t start_time;
 		base_query * query;
 	};
 	AbortBufferEntry * _abort_buffer;
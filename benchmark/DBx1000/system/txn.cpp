@@ -19,8 +19,10 @@ void txn_man::init(thread_t * h_thd, workload * h_wl, uint64_t thd_id) {
 	row_cnt = 0;
 	wr_cnt = 0;
 	insert_cnt = 0;
-	accesses = (Access **) _mm_malloc(sizeof(Access *) * MAX_ROW_PER_TXN, 64);
-	for (int i = 0; i < MAX_ROW_PER_TXN; i++)
+	index_insert_cnt = 0;
+	max_accesses = MAX_ROW_PER_TXN;
+	accesses = (Access **) _mm_malloc(sizeof(Access *) * max_accesses, 64);
+	for (int i = 0; i < max_accesses; i++)
 		accesses[i] = NULL;
 	num_accesses_alloc = 0;
 #if CC_ALG == TICTOC || CC_ALG == SILO
@@ -67,6 +69,12 @@ ts_t txn_man::get_ts() {
 }
 
 void txn_man::cleanup(RC rc) {
+	// publish the index inserts while the written rows are still locked, 
+	// so a txn that sees the new D_NEXT_O_ID also finds the new order. 
+	// SILO, TICTOC and HEKATON release their locks before cleanup and 
+	// publish them at their own commit point.
+	if (rc == RCOK)
+		apply_index_inserts(rc);
 #if CC_ALG == HEKATON
 	row_cnt = 0;
 	wr_cnt = 0;
@@ -108,7 +116,12 @@ void txn_man::cleanup(RC rc) {
 			mem_allocator.free(row->manager, 0);
 #endif
 			row->free_row();
+#if CC_ALG == RLU || CC_ALG == MVRLU
+			// the row was never published; release it right away.
+			RLU_FREE(NULL, row);
+#else
 			mem_allocator.free(row, sizeof(row));
+#endif
 		}
 	}
 	row_cnt = 0;
@@ -124,6 +137,17 @@ row_t * txn_man::get_row(row_t * row, access_t type) {
 		return row;
 	uint64_t starttime = get_sys_clock();
 	RC rc = RCOK;
+	if (row_cnt == max_accesses) {
+		// only the TPC-C scans get here; the array keeps its size after.
+		Access ** new_accesses = (Access **) 
+			_mm_malloc(sizeof(Access *) * max_accesses * 2, 64);
+		memcpy(new_accesses, accesses, sizeof(Access *) * max_accesses);
+		for (int i = max_accesses; i < max_accesses * 2; i++)
+			new_accesses[i] = NULL;
+		_mm_free(accesses);
+		accesses = new_accesses;
+		max_accesses *= 2;
+	}
 	if (accesses[row_cnt] == NULL) {
 		Access * access = (Access *) _mm_malloc(sizeof(Access), 64);
 		accesses[row_cnt] = access;
@@ -184,11 +208,88 @@ void txn_man::insert_row(row_t * row, table_t * table) {
 	insert_rows[insert_cnt ++] = row;
 }
 
+RC 
+txn_man::index_insert(INDEX * index, idx_key_t key, 
+		row_t ** rows, uint64_t cnt, int part_id) {
+	uint64_t starttime = get_sys_clock();
+	RC rc = RCOK;
+	itemid_t * items = NULL;
+	for (int i = cnt - 1; i >= 0; i--) {
+		itemid_t * m_item =
+			(itemid_t *) mem_allocator.alloc( sizeof(itemid_t), part_id );
+		m_item->init();
+		m_item->type = DT_row;
+		m_item->location = rows[i];
+		m_item->valid = true;
+		m_item->next = items;
+		items = m_item;
+	}
+#if CC_ALG == MVRLU && INDEX_STRUCT == IDX_HASH
+	BucketNode * node;
+	rc = index->index_insert(key, items, part_id, h_thd->p_rlu_td, node);
+	if (rc == Abort) {
+		while (items != NULL) {
+			itemid_t * next = items->next;
+			mem_allocator.free(items, sizeof(itemid_t));
+			items = next;
+		}
+		INC_TMP_STATS(get_thd_id(), time_index, get_sys_clock() - starttime);
+		return rc;
+	}
+	// the items and node are only linked in the write set; they are freed
+	// if the txn aborts (see apply_index_inserts).
+#endif
+	// other CCs do not track the index, so the rows are only published 
+	// once the txn can no longer abort, before it releases its locks (see 
+	// apply_index_inserts).
+	assert(index_insert_cnt < MAX_ROW_PER_TXN);
+	IndexInsert * ins = &index_inserts[index_insert_cnt ++];
+	ins->index = index;
+	ins->key = key;
+	ins->items = items;
+	ins->cnt = cnt;
+	ins->part_id = part_id;
+#if CC_ALG == MVRLU && INDEX_STRUCT == IDX_HASH
+	ins->node = node;
+#endif
+	INC_TMP_STATS(get_thd_id(), time_index, get_sys_clock() - starttime);
+	return rc;
+}
+
+void 
+txn_man::apply_index_inserts(RC rc) {
+	for (UInt32 i = 0; i < index_insert_cnt; i ++) {
+		IndexInsert * ins = &index_inserts[i];
+		itemid_t * items = ins->items;
+#if CC_ALG == MVRLU && INDEX_STRUCT == IDX_HASH
+		// already linked by the write set, or dropped with it
+		if (rc == RCOK)
+			continue;
+		RLU_FREE(NULL, ins->node);
+#endif
+		// the last item may already point to the items of the key
+		for (uint64_t n = 0; n < ins->cnt; n ++) {
+			itemid_t * next = items->next;
+			if (rc == RCOK) {
+				items->next = NULL;
+				ins->index->index_insert(ins->key, items, ins->part_id);
+			} else 
+				mem_allocator.free(items, sizeof(itemid_t));
+			items = next;
+		}
+	}
+	index_insert_cnt = 0;
+}
+
 itemid_t *
 txn_man::index_read(INDEX * index, idx_key_t key, int part_id) {
 	uint64_t starttime = get_sys_clock();
 	itemid_t * item;
+#if CC_ALG == MVRLU && INDEX_STRUCT == IDX_HASH
+	index->index_read(key, item, part_id, h_thd->p_rlu_td);
+#else
 	index->index_read(key, item, part_id, get_thd_id());
+#endif
 	INC_TMP_STATS(get_thd_id(), time_index, get_sys_clock() - starttime);
 	return item;
 }
@@ -196,12 +297,17 @@ txn_man::index_read(INDEX * index, idx_key_t key, int part_id) {
 void 
 txn_man::index_read(INDEX * index, idx_key_t key, int part_id, itemid_t *& item) {
 	uint64_t starttime = get_sys_clock();
+#if CC_ALG == MVRLU && INDEX_STRUCT == IDX_HASH
+	index->index_read(key, item, part_id, h_thd->p_rlu_td);
+#else
 	index->index_read(key, item, part_id, get_thd_id());
+#endif
 	INC_TMP_STATS(get_thd_id(), time_index, get_sys_clock() - starttime);
 }
 
 RC txn_man::finish(RC rc) {
 #if CC_ALG == HSTORE
+	apply_index_inserts(rc);
 	return RCOK;
 #endif
 	uint64_t starttime = get_sys_clock();
@@ -226,6 +332,7 @@ RC txn_man::finish(RC rc) {
 #else 
 	cleanup(rc);
 #endif
+	apply_index_inserts(rc);
 	uint64_t timespan = get_sys_clock() - starttime;
 	INC_TMP_STATS(get_thd_id(), time_man,  timespan);
 	INC_STATS(get_thd_id(), time_cleanup,  timespan);
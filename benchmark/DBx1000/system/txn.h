@@ -9,6 +9,7 @@ class row_t;
 class table_t;
 class base_query;
 class INDEX;
+class BucketNode;
 
 // each thread has a txn_man. 
 // a txn_man corresponds to a single transaction.
@@ -35,6 +36,20 @@ public:
 
 };
 
+// an index insert that is applied only once the txn commits, or with 
+// MV-RLU, whose items and node are freed if the txn aborts.
+class IndexInsert {
+public:
+	INDEX * 	index;
+	idx_key_t 	key;
+	itemid_t * 	items;
+	uint64_t 	cnt;
+	int 		part_id;
+#if CC_ALG == MVRLU
+	BucketNode * node;
+#endif
+};
+
 class txn_man
 {
 public:
@@ -85,6 +100,7 @@ public:
 	int	 			wr_cnt;
 	Access **		accesses;
 	int 			num_accesses_alloc;
+	int 			max_accesses;
 
 	// For VLL
 	TxnType 		vll_txn_type;
@@ -93,10 +109,19 @@ public:
 	row_t * 		get_row(row_t * row, access_t type);
 protected:	
 	void 			insert_row(row_t * row, table_t * table);
+	// link rows inserted by this txn into an index at runtime. All rows
+	// sharing a key must be passed in one call (see IndexHash).
+	RC 				index_insert(INDEX * index, idx_key_t key, 
+						row_t ** rows, uint64_t cnt, int part_id);
 private:
 	// insert rows
 	uint64_t 		insert_cnt;
 	row_t * 		insert_rows[MAX_ROW_PER_TXN];
+	// index inserts deferred to the commit point, or undone on abort with 
+	// MVRLU. apply_index_inserts() is a no-op once they are applied.
+	uint64_t 		index_insert_cnt;
+	IndexInsert 	index_inserts[MAX_ROW_PER_TXN];
+	void 			apply_index_inserts(RC rc);
 	txnid_t 		txn_id;
 	ts_t 			timestamp;
 
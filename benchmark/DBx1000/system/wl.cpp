@@ -88,7 +88,7 @@ RC workload::init_schema(string schema_file) {
 #if INDEX_STRUCT == IDX_HASH
 	#if WORKLOAD == YCSB
 			index->init(part_cnt, tables[tname], g_synth_table_size * 2);
-	#elif WORKLOAD == TPCC
+	#elif WORKLOAD == TPCC || WORKLOAD == TEST
 			assert(tables[tname] != NULL);
 			index->init(part_cnt, tables[tname], stoi( items[1] ) * part_cnt);
 	#endif
@@ -0,0 +1,406 @@
+// SPDX-FileCopyrightText: Copyright (c) 2018-2019 Virginia Tech
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * MV-RLU diff copy and copy kernel benchmark
+ *
+ * A table of fixed-size rows is updated by transactions that change a
+ * couple of 8-byte fields of one row and read by lookups that check a
+ * whole row. Every row carries a version and a checksum of its fields,
+ * so a reader that sees a torn copy counts a mismatch. The mode picks
+ * how a writer locks a row:
+ *
+ *  range  mvrlu_try_lock_range() on a row from mvrlu_alloc(), which
+ *         still copies the full row
+ *  diff   the same on a row from mvrlu_alloc_diff(); the copies in the
+ *         log only keep the dirty chunks
+ *  copy   mvrlu_try_lock_full(), moving an amount between the first and
+ *         the last field, so every commit copies the whole row into the
+ *         log and back; with a list of row sizes it compares the copy
+ *         kernels (MVRLU_COPY_KERNEL) over the object size
+ *
+ * The benchmark reports the throughput, the log bytes and the
+ * write-back bytes per committed transaction for every row size.
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mvrlu.h"
+#include "bench_harness.h"
+#include "bench_mvrlu.h"
+
+#define DEFAULT_THREADS 4
+#define DEFAULT_DURATION_MS 5000
+#define DEFAULT_ROWS 1024
+#define DEFAULT_ROW_SIZE "1024"
+#define DEFAULT_COPY_SIZES "64,256,1024,4096,16384"
+#define DEFAULT_UPDATE_PCT 50
+#define FIELDS_PER_UPDATE 2
+#define MAX_SIZES 32
+
+enum { MODE_RANGE, MODE_DIFF, MODE_COPY };
+
+static const char *mode_names[] = { "range", "diff", "copy" };
+
+struct row {
+	unsigned long version;
+	unsigned long sum; /* of all fields */
+	unsigned long fields[0];
+};
+
+struct table {
+	unsigned long nr_rows;
+	unsigned long nr_fields;
+	int update_pct;
+	int mode;
+	struct row **rows;
+};
+
+/* Worker counters (bench_worker_t.cnt) */
+enum { CNT_MISMATCHES };
+
+struct options {
+	bench_opts_t bench;
+	const char *prog;
+	unsigned long nr_rows;
+	unsigned long sizes[MAX_SIZES];
+	int nr_sizes;
+	int update_pct;
+	int mode;
+};
+
+static int check_row(struct table *table, struct row *r)
+{
+	unsigned long i, sum = 0;
+
+	for (i = 0; i < table->nr_fields; ++i)
+		sum += r->fields[i];
+	return sum == r->sum;
+}
+
+static void lookup(bench_worker_t *w, mvrlu_thread_struct_t *self)
+{
+	struct table *table = w->arg;
+	uint64_t start = lat_hist_now();
+	struct row *r;
+
+	mvrlu_reader_lock(self);
+	r = mvrlu_deref(self, table->rows[rand_r(&w->seed) % table->nr_rows]);
+	if (!check_row(table, r))
+		w->cnt[CNT_MISMATCHES]++;
+	mvrlu_reader_unlock(self);
+	bench_op_done(w, LAT_READ, start, 0);
+}
+
+/* Move an amount between the first and the last field of a whole row */
+static void update_full(bench_worker_t *w, mvrlu_thread_struct_t *self)
+{
+	struct table *table = w->arg;
+	unsigned long amount = rand_r(&w->seed) % 16;
+	uint64_t start = lat_hist_now();
+	struct row *r;
+	int aborted = 0;
+
+restart:
+	mvrlu_reader_lock(self);
+	r = mvrlu_deref(self, table->rows[rand_r(&w->seed) % table->nr_rows]);
+	if (!mvrlu_try_lock_full(self, &r)) {
+		mvrlu_abort(self);
+		w->res.nr_abort++;
+		aborted = 1;
+		goto restart;
+	}
+	r->fields[0] -= amount;
+	r->fields[table->nr_fields - 1] += amount;
+	r->version++;
+	mvrlu_reader_unlock(self);
+	bench_op_done(w, LAT_WRITE, start, aborted);
+}
+
+/* Move an amount between two fields of a row, keeping the sum */
+static void update(bench_worker_t *w, mvrlu_thread_struct_t *self)
+{
+	struct table *table = w->arg;
+	unsigned long f[FIELDS_PER_UPDATE], amount;
+	uint64_t start = lat_hist_now();
+	struct row *r;
+	int k, aborted = 0;
+
+	for (k = 0; k < FIELDS_PER_UPDATE; ++k)
+		f[k] = rand_r(&w->seed) % table->nr_fields;
+	amount = rand_r(&w->seed) % 16;
+restart:
+	mvrlu_reader_lock(self);
+	r = mvrlu_deref(self, table->rows[rand_r(&w->seed) % table->nr_rows]);
+	if (!mvrlu_try_lock_range(self, &r, offsetof(struct row, fields[f[0]]),
+				  sizeof(r->fields[0]))) {
+		mvrlu_abort(self);
+		w->res.nr_abort++;
+		aborted = 1;
+		goto restart;
+	}
+	mvrlu_mark_dirty(self, r, 0, offsetof(struct row, fields));
+	mvrlu_mark_dirty(self, r, offsetof(struct row, fields[f[1]]),
+			 sizeof(r->fields[0]));
+	r->fields[f[0]] -= amount;
+	r->fields[f[1]] += amount;
+	r->version++;
+	mvrlu_reader_unlock(self);
+	bench_op_done(w, LAT_WRITE, start, aborted);
+}
+
+static void *worker_main(void *arg)
+{
+	bench_worker_t *w = arg;
+	struct table *table = w->arg;
+	mvrlu_thread_struct_t *self;
+
+	self = mvrlu_thread_alloc();
+	mvrlu_thread_init(self);
+	while (!*w->stop) {
+		if ((int)(rand_r(&w->seed) % 100) >= table->update_pct)
+			lookup(w, self);
+		else if (table->mode == MODE_COPY)
+			update_full(w, self);
+		else
+			update(w, self);
+	}
+	mvrlu_thread_finish(self);
+	mvrlu_thread_free(self);
+	return NULL;
+}
+
+static int check_table(struct table *table)
+{
+	mvrlu_thread_struct_t *self;
+	unsigned long i, nr_bad = 0;
+
+	self = mvrlu_thread_alloc();
+	mvrlu_thread_init(self);
+	mvrlu_reader_lock(self);
+	for (i = 0; i < table->nr_rows; ++i)
+		nr_bad += !check_row(table,
+				     mvrlu_deref(self, table->rows[i]));
+	mvrlu_reader_unlock(self);
+	mvrlu_thread_finish(self);
+	mvrlu_thread_free(self);
+
+	if (nr_bad) {
+		fprintf(stderr, "%lu rows with a wrong sum\n", nr_bad);
+		return -1;
+	}
+	return 0;
+}
+
+static double stat_delta(const mvrlu_stat_t *st0, const mvrlu_stat_t *st1,
+			 int idx)
+{
+	return st1->cnt[idx] - st0->cnt[idx];
+}
+
+/* Run one row size. The rows stay allocated until the process exits
+ * since freeing them would need a write set per row. */
+static int run_size(struct options *o, unsigned long size)
+{
+	struct table table;
+	bench_run_t brun;
+	bench_result_t res = { 0 };
+	bench_extra_t extra[8];
+	mvrlu_stat_t st0, st1;
+	unsigned long i, j;
+	double commits, bytes;
+	int failed;
+
+	table.nr_rows = o->nr_rows;
+	table.nr_fields = (size - sizeof(struct row)) /
+			  sizeof(table.rows[0]->fields[0]);
+	table.update_pct = o->update_pct;
+	table.mode = o->mode;
+	table.rows = calloc(o->nr_rows, sizeof(table.rows[0]));
+	if (!table.rows)
+		return 1;
+	for (i = 0; i < o->nr_rows; ++i) {
+		struct row *r = o->mode == MODE_DIFF ? mvrlu_alloc_diff(size) :
+						       mvrlu_alloc(size);
+
+		if (!r)
+			return 1;
+		r->version = 0;
+		r->sum = 0;
+		for (j = 0; j < table.nr_fields; ++j) {
+			r->fields[j] = i + j;
+			r->sum += i + j;
+		}
+		table.rows[i] = r;
+	}
+	if (o->bench.format == BENCH_FMT_TEXT)
+		printf("%d threads, %lu rows of %lu bytes (%s), %d%% updates\n",
+		       o->bench.nr_threads, o->nr_rows, size,
+		       mode_names[o->mode], o->update_pct);
+
+	mvrlu_get_stats(&st0, MVRLU_STAT_LIVE);
+	if (bench_run(&brun, o->bench.nr_threads, o->bench.duration,
+		      worker_main, &table, 1))
+		return 1;
+	mvrlu_get_stats(&st1, MVRLU_STAT_LIVE);
+
+	commits = 0;
+	for (i = 0; i < (unsigned long)brun.nr_threads; ++i)
+		commits += brun.threads[i].nr_write;
+	if (!commits)
+		commits = 1;
+	bytes = stat_delta(&st0, &st1, MVRLU_STAT_sum_log_bytes) +
+		stat_delta(&st0, &st1, MVRLU_STAT_sum_writeback_bytes);
+	extra[0] = (bench_extra_t){ "row_size", size };
+	extra[1] = (bench_extra_t){ "mode", o->mode };
+	extra[2] = (bench_extra_t){
+		"log_bytes_per_txn",
+		stat_delta(&st0, &st1, MVRLU_STAT_sum_log_bytes) / commits };
+	extra[3] = (bench_extra_t){
+		"writeback_bytes_per_txn",
+		stat_delta(&st0, &st1, MVRLU_STAT_sum_writeback_bytes) / commits };
+	extra[4] = (bench_extra_t){ "copy_gb_per_sec",
+				    bytes / brun.duration / 1e6 };
+	extra[5] = (bench_extra_t){
+		"diff_copies", stat_delta(&st0, &st1, MVRLU_STAT_n_diff_copy) };
+	extra[6] = (bench_extra_t){
+		"overlays", stat_delta(&st0, &st1, MVRLU_STAT_n_diff_overlay) };
+	extra[7] = (bench_extra_t){ "mismatches", brun.cnt[CNT_MISMATCHES] };
+	res.backend = bench_lookup_backend(o->prog);
+	res.init_size = o->nr_rows;
+	res.value_range = o->nr_rows;
+	res.update_ratio = 10 * o->update_pct;
+	res.seed = 1;
+	res.extra = extra;
+	res.nr_extra = 8;
+	bench_run_result(&brun, &res);
+	bench_report(stdout, o->bench.format, &res);
+
+	failed = check_table(&table) || brun.cnt[CNT_MISMATCHES];
+	bench_run_free(&brun);
+	free(table.rows);
+	return failed;
+}
+
+static int run(struct options *o)
+{
+	const char *kernel = getenv("MVRLU_COPY_KERNEL");
+	int k;
+
+	if (mvrlu_init())
+		return 1;
+	bench_set_lib_stats(bench_mvrlu_stats);
+	if (o->bench.format == BENCH_FMT_TEXT && o->mode == MODE_COPY)
+		printf("copy kernel %s\n", kernel ? kernel : "(default)");
+	for (k = 0; k < o->nr_sizes; ++k) {
+		if (run_size(o, o->sizes[k])) {
+			fprintf(stderr, "FAILED\n");
+			return 1;
+		}
+	}
+
+	mvrlu_finish();
+	if (o->bench.format == BENCH_FMT_TEXT) {
+		printf("rows ok\n");
+		mvrlu_print_stats();
+	}
+	return 0;
+}
+
+static int parse_mode(const char *s)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(mode_names) / sizeof(mode_names[0]); ++i) {
+		if (!strcmp(s, mode_names[i]))
+			return i;
+	}
+	return -1;
+}
+
+static int parse_sizes(struct options *o, char *arg)
+{
+	char *tok;
+
+	o->nr_sizes = 0;
+	for (tok = strtok(arg, ","); tok; tok = strtok(NULL, ",")) {
+		if (o->nr_sizes == MAX_SIZES)
+			return -1;
+		o->sizes[o->nr_sizes] = strtoul(tok, NULL, 0);
+		if (o->sizes[o->nr_sizes] <
+		    sizeof(struct row) + 2 * sizeof(unsigned long))
+			return -1;
+		o->nr_sizes++;
+	}
+	return o->nr_sizes ? 0 : -1;
+}
+
+static void usage(const bench_opts_t *defaults)
+{
+	printf("Usage: bench-diff-mvrlu-ordo [options]\n");
+	bench_print_opts(defaults);
+	printf("  -m <mode>      range, diff or copy (default range)\n");
+	printf("  -r <rows>      number of rows (default %d)\n", DEFAULT_ROWS);
+	printf("  -s <sizes>     comma-separated row sizes in bytes "
+	       "(default %s,\n"
+	       "                 %s in the copy mode)\n",
+	       DEFAULT_ROW_SIZE, DEFAULT_COPY_SIZES);
+	printf("  -u <pct>       percentage of updates (default %d)\n",
+	       DEFAULT_UPDATE_PCT);
+}
+
+int main(int argc, char **argv)
+{
+	const bench_opts_t defaults = {
+		.nr_threads = DEFAULT_THREADS,
+		.duration = DEFAULT_DURATION_MS,
+		.format = BENCH_FMT_TEXT,
+	};
+	struct options o = {
+		.bench = defaults,
+		.prog = argv[0],
+		.nr_rows = DEFAULT_ROWS,
+		.update_pct = DEFAULT_UPDATE_PCT,
+		.mode = MODE_RANGE,
+	};
+	char row_size[] = DEFAULT_ROW_SIZE, copy_sizes[] = DEFAULT_COPY_SIZES;
+	char *sizes = NULL;
+	int c, rc;
+
+	while ((c = getopt(argc, argv, BENCH_OPTS "m:r:s:u:")) != -1) {
+		switch (c) {
+		case 'm':
+			o.mode = parse_mode(optarg);
+			break;
+		case 'r':
+			o.nr_rows = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			sizes = optarg;
+			break;
+		case 'u':
+			o.update_pct = atoi(optarg);
+			break;
+		default:
+			rc = bench_parse_opt(&o.bench, c, optarg);
+			if (rc) {
+				usage(&defaults);
+				return rc < 0;
+			}
+		}
+	}
+	if (!sizes)
+		sizes = o.mode == MODE_COPY ? copy_sizes : row_size;
+	if (o.mode < 0 || o.nr_rows < 1 || parse_sizes(&o, sizes) ||
+	    o.update_pct < 0 || o.update_pct > 100) {
+		usage(&defaults);
+		return 1;
+	}
+
+	return run(&o);
+}
@@ -0,0 +1,48 @@
+# Build rules of the single-binary MV-RLU drivers (diff, durable, shm,
+# task). A directory sets CUR_DIR and BENCH and includes this file; its
+# $(BENCH)_bench.c is linked with the harness in versioning/ and the
+# harness objects listed in HARNESS_OBJS, such as bench_bank.o.
+include $(CUR_DIR)/../../Makefile.inc
+
+HARNESS_DIR := $(CUR_DIR)/../versioning
+
+CC := gcc
+LD := gcc
+
+CFLAGS += -Wall
+CFLAGS += -O3 -g
+CFLAGS += -I$(INC_DIR) -I$(HARNESS_DIR) -I$(CUR_DIR)
+
+LDFLAGS += -lpthread $(MEMMGR)
+
+.PHONY: all clean
+
+BINS = bench-$(BENCH)-mvrlu-ordo
+
+all: $(BINS)
+	@for d in $(BINS); \
+                do ( cp $$d $(BIN_DIR); \
+                ); \
+        done
+
+numa-config.h:
+	$(TOOLS_DIR)/cpu-topology.py > $(CUR_DIR)/numa-config.h
+
+bench_harness.o: $(HARNESS_DIR)/bench_harness.c $(HARNESS_DIR)/bench_harness.h numa-config.h
+	$(CC) $(CFLAGS) -c -o $@ $<
+
+bench_bank.o: $(HARNESS_DIR)/bench_bank.c $(HARNESS_DIR)/bench_bank.h
+	$(CC) $(CFLAGS) -c -o $@ $<
+
+$(BENCH)_bench.o: $(BENCH)_bench.c $(wildcard $(HARNESS_DIR)/bench_*.h)
+	$(CC) $(CFLAGS) -c -o $@ $<
+
+bench-$(BENCH)-mvrlu-ordo: $(BENCH)_bench.o bench_harness.o $(HARNESS_OBJS) $(LIB_DIR)/libmvrlu-ordo.a
+	$(LD) -o $@ $^ $(LDFLAGS)
+
+clean:
+	rm -f $(BINS) *.o $(CUR_DIR)/numa-config.h
+	@for d in $(BINS); \
+                do ( rm -f $(BIN_DIR)/$$d; \
+                ); \
+        done
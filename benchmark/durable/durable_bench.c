@@ -0,0 +1,361 @@
+// SPDX-FileCopyrightText: Copyright (c) 2018-2019 Virginia Tech
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * Durable MV-RLU benchmark and kill-and-recover test
+ *
+ * Threads move money between random accounts of a bank kept in a
+ * durable file. By default it reports the commit throughput and
+ * latency of the chosen sync mode. With -k it repeatedly kills a
+ * running child with SIGKILL, recovers the file in a fresh process and
+ * checks that the total balance is intact and that every transfer the
+ * child reported as committed survived.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "mvrlu.h"
+#include "bench_harness.h"
+#include "bench_mvrlu.h"
+#include "bench_bank.h"
+
+#define DEFAULT_PATH "/dev/shm/mvrlu-durable.bank"
+#define DEFAULT_SIZE_MB 256
+#define DEFAULT_THREADS 1
+#define DEFAULT_DURATION_MS 5000
+#define DEFAULT_CRASH_MS 200
+
+struct options {
+	bench_opts_t bench;
+	const char *prog;
+	const char *path;
+	unsigned long size_mb;
+	int sync;
+	unsigned long nr_accounts;
+	int rounds;
+	int crash_ms;
+};
+
+/* Shared with the parent in kill-and-recover mode */
+struct progress {
+	volatile unsigned long committed[BANK_MAX_THREADS];
+} __attribute__((aligned(64)));
+
+struct workload {
+	struct bank *bank;
+	struct progress *progress;
+};
+static const char *sync_names[] = { "none", "msync", "clwb" };
+
+static int parse_sync(const char *s)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(sync_names) / sizeof(sync_names[0]); ++i) {
+		if (!strcmp(s, sync_names[i]))
+			return i;
+	}
+	return -1;
+}
+
+static struct bank *open_bank(struct options *o, int *recovered)
+{
+	struct bank *bank;
+	int rc;
+
+	rc = mvrlu_durable_init(o->path, o->size_mb << 20, o->sync);
+	if (rc < 0) {
+		fprintf(stderr, "mvrlu_durable_init(%s): %s\n", o->path,
+			strerror(-rc));
+		return NULL;
+	}
+	if (recovered)
+		*recovered = rc;
+	bench_set_lib_stats(bench_mvrlu_stats);
+
+	bank = mvrlu_durable_get_root();
+	if (bank)
+		return bank;
+
+	/* A new file, or a crash before the bank was complete */
+	bank = bank_create(o->nr_accounts);
+	if (!bank)
+		return NULL;
+	mvrlu_durable_set_root(bank);
+	return bank;
+}
+
+static void *worker_main(void *arg)
+{
+	bench_worker_t *w = arg;
+	struct workload *wl = w->arg;
+	struct bank *bank = wl->bank;
+	volatile unsigned long *committed = NULL;
+	unsigned long i, j, reported = 0;
+	mvrlu_thread_struct_t *self;
+	uint64_t start;
+	long amount;
+	int aborted;
+
+	if (wl->progress) {
+		committed = &wl->progress->committed[w->id];
+		reported = *committed;
+	}
+	self = mvrlu_thread_alloc();
+	mvrlu_thread_init(self);
+
+	while (!*w->stop) {
+		bank_pick(bank, &w->seed, &i, &j, &amount);
+
+		start = lat_hist_now();
+		aborted = 0;
+	restart:
+		mvrlu_reader_lock(self);
+		if (!bank_transfer(self, bank, i, j, amount)) {
+			mvrlu_abort(self);
+			w->res.nr_abort++;
+			aborted = 1;
+			goto restart;
+		}
+		mvrlu_reader_unlock(self);
+
+		/* The transfer is durable now */
+		bench_op_done(w, LAT_WRITE, start, aborted);
+		if (committed)
+			*committed = ++reported;
+	}
+
+	mvrlu_thread_finish(self);
+	mvrlu_thread_free(self);
+	return NULL;
+}
+
+static int benchmark(struct options *o)
+{
+	struct workload wl = { 0 };
+	bench_run_t run;
+	bench_result_t res = { 0 };
+	bench_extra_t extra[2];
+	unsigned int seed = getpid();
+	unsigned long updates;
+	int recovered;
+
+	wl.bank = open_bank(o, &recovered);
+	if (!wl.bank)
+		return 1;
+	if (o->bench.format == BENCH_FMT_TEXT)
+		printf("file %s (%s), sync %s, %lu accounts, %d threads\n",
+		       o->path, recovered ? "recovered" : "new",
+		       sync_names[o->sync], wl.bank->nr_accounts,
+		       o->bench.nr_threads);
+
+	if (bench_run(&run, o->bench.nr_threads, o->bench.duration,
+		      worker_main, &wl, seed))
+		return 1;
+
+	extra[0] = (bench_extra_t){ "sync_mode", o->sync };
+	extra[1] = (bench_extra_t){ "recovered", recovered };
+	res.backend = bench_lookup_backend(o->prog);
+	res.init_size = wl.bank->nr_accounts;
+	res.value_range = wl.bank->nr_accounts;
+	res.update_ratio = 1000;
+	res.seed = seed;
+	res.extra = extra;
+	res.nr_extra = 2;
+	bench_run_result(&run, &res);
+	bench_report(stdout, o->bench.format, &res);
+	bench_run_free(&run);
+
+	if (bank_check(wl.bank, &updates))
+		return 1;
+	mvrlu_finish();
+	return 0;
+}
+
+/* Child: run transfers until the parent kills it */
+static int crash_child(struct options *o, struct progress *progress)
+{
+	struct workload wl = { .progress = progress };
+	bench_run_t run;
+
+	wl.bank = open_bank(o, NULL);
+	if (!wl.bank)
+		return 1;
+	if (bench_run_start(&run, o->bench.nr_threads, worker_main, &wl,
+			    NULL, getpid()))
+		return 1;
+	for (;;)
+		pause();
+	return 1;
+}
+
+/* Child: recover the file and check it against the reported commits */
+static int verify_child(struct options *o, struct progress *progress)
+{
+	unsigned long committed = 0, updates;
+	struct bank *bank;
+	int recovered, t;
+
+	bank = open_bank(o, &recovered);
+	if (!bank)
+		return 1;
+	if (bank_check(bank, &updates))
+		return 1;
+	for (t = 0; t < o->bench.nr_threads; ++t)
+		committed += progress->committed[t];
+
+	/* A thread may be killed between a durable commit and its report */
+	if (updates / 2 < committed ||
+	    updates / 2 > committed + o->bench.nr_threads) {
+		fprintf(stderr,
+			"lost transfers: %lu durable, %lu reported committed\n",
+			updates / 2, committed);
+		return 1;
+	}
+	printf("  %s, %lu transfers durable, %lu reported\n",
+	       recovered ? "recovered" : "new", updates / 2, committed);
+
+	/* Resume counting from the recovered state */
+	for (t = 0; t < o->bench.nr_threads; ++t)
+		progress->committed[t] = 0;
+	progress->committed[0] = updates / 2;
+	mvrlu_finish();
+	fflush(stdout);
+	return 0;
+}
+
+static int wait_child(pid_t pid)
+{
+	int status;
+
+	if (waitpid(pid, &status, 0) < 0)
+		return -1;
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static int kill_and_recover(struct options *o)
+{
+	struct progress *progress;
+	unsigned int seed = getpid();
+	pid_t pid;
+	int r, ms;
+
+	progress = mmap(NULL, sizeof(*progress), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (progress == MAP_FAILED)
+		return 1;
+
+	/* Start from a new file so the reported commits add up */
+	unlink(o->path);
+	memset((void *)progress, 0, sizeof(*progress));
+
+	for (r = 0; r < o->rounds; ++r) {
+		/* Children must not inherit buffered output */
+		fflush(stdout);
+		pid = fork();
+		if (pid < 0)
+			return 1;
+		if (pid == 0)
+			_exit(crash_child(o, progress));
+		ms = o->crash_ms / 2 + rand_r(&seed) % (o->crash_ms / 2 + 1);
+		usleep(ms * 1000);
+		kill(pid, SIGKILL);
+		wait_child(pid);
+
+		printf("round %d: killed after %d ms\n", r, ms);
+		fflush(stdout);
+		pid = fork();
+		if (pid < 0)
+			return 1;
+		if (pid == 0)
+			_exit(verify_child(o, progress));
+		if (wait_child(pid)) {
+			printf("round %d: FAILED\n", r);
+			return 1;
+		}
+	}
+	printf("%d rounds passed\n", o->rounds);
+	return 0;
+}
+
+static void usage(const bench_opts_t *defaults)
+{
+	printf("Usage: bench-durable-mvrlu-ordo [options]\n");
+	bench_print_opts(defaults);
+	printf("  -p <file>      durable file (default %s)\n", DEFAULT_PATH);
+	printf("  -s <MB>        size of a new file (default %d)\n",
+	       DEFAULT_SIZE_MB);
+	printf("  -m <sync>      none, msync or clwb (default none)\n");
+	printf("  -a <accounts>  number of accounts (default %d)\n",
+	       BANK_DEFAULT_ACCOUNTS);
+	printf("  -k <rounds>    kill-and-recover test instead of benchmark\n");
+	printf("  -c <ms>        longest run before a kill (default %d)\n",
+	       DEFAULT_CRASH_MS);
+}
+
+int main(int argc, char **argv)
+{
+	const bench_opts_t defaults = {
+		.nr_threads = DEFAULT_THREADS,
+		.duration = DEFAULT_DURATION_MS,
+		.format = BENCH_FMT_TEXT,
+	};
+	struct options o = {
+		.bench = defaults,
+		.prog = argv[0],
+		.path = DEFAULT_PATH,
+		.size_mb = DEFAULT_SIZE_MB,
+		.sync = MVRLU_DURABLE_SYNC_NONE,
+		.nr_accounts = BANK_DEFAULT_ACCOUNTS,
+		.rounds = 0,
+		.crash_ms = DEFAULT_CRASH_MS,
+	};
+	int c, rc;
+
+	while ((c = getopt(argc, argv, BENCH_OPTS "p:s:m:a:k:c:")) != -1) {
+		switch (c) {
+		case 'p':
+			o.path = optarg;
+			break;
+		case 's':
+			o.size_mb = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			o.sync = parse_sync(optarg);
+			break;
+		case 'a':
+			o.nr_accounts = strtoul(optarg, NULL, 0);
+			break;
+		case 'k':
+			o.rounds = atoi(optarg);
+			break;
+		case 'c':
+			o.crash_ms = atoi(optarg);
+			break;
+		default:
+			rc = bench_parse_opt(&o.bench, c, optarg);
+			if (rc) {
+				usage(&defaults);
+				return rc < 0;
+			}
+		}
+	}
+	if (o.sync < 0 || o.bench.nr_threads > BANK_MAX_THREADS ||
+	    o.nr_accounts < 2 || o.crash_ms < 2) {
+		usage(&defaults);
+		return 1;
+	}
+
+	if (o.rounds)
+		return kill_and_recover(&o);
+	return benchmark(&o);
+}
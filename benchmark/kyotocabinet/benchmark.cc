@@ -203,17 +203,23 @@ class ThreadBench : public kc::Thread {
 };
 
 void print_usage() {
-	printf("Usage: ./benchmark -t num\n");
+	printf("Usage: ./benchmark -t num [-c capsiz] [-r]\n");
 }
 
 int main(int argc, char *argv[])
 {
 	int thnum = -1;
+	int64_t capsiz = -1;
+	bool rtt = false;
 	int option = 0;
-	while ((option = getopt(argc, argv, "t:")) != -1) {
+	while ((option = getopt(argc, argv, "t:c:r")) != -1) {
 		switch(option) {
 			case 't': thnum = atoi(optarg);
 				  break;
+			case 'c': capsiz = atoll(optarg);
+				  break;
+			case 'r': rtt = true;
+				  break;
 			default: print_usage();
 				 exit(EXIT_FAILURE);
 		}
@@ -228,6 +234,8 @@ int main(int argc, char *argv[])
 	//db.tune_logger(stdlogger(g_progname, &std::cout),
 	//		lv ? kc::UINT32MAX : kc::BasicDB::Logger::WARN | kc::BasicDB::Logger::ERROR);
 
+	if (capsiz > 0) db.cap_size(capsiz);
+	if (rtt) db.switch_rotation(true);
 	if (!db.open("*", kc::CacheDB::OWRITER | kc::CacheDB::OCREATE | kc::CacheDB::OTRUNCATE)) {
 		printf("Error Opening DB\n");
 		assert(0);
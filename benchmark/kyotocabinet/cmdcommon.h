@@ -317,6 +317,33 @@ inline void printdb(kc::BasicDB* db, bool px) {
 }
 
 
+#if defined(RLU) || defined(MVRLU)
+// attach an RLU or MV-RLU context to the calling thread as kc::Thread does for its own threads
+inline void rluattach() {
+#if defined(MVRLU)
+  mvrlu_init();
+  kc::self = (rlu_thread_data_t*)RLU_THREAD_ALLOC();
+#else
+  kc::self = (rlu_thread_data_t*)malloc(sizeof(rlu_thread_data_t));
+#endif
+  RLU_THREAD_INIT(kc::self);
+}
+
+
+// detach the RLU or MV-RLU context of the calling thread
+inline void rludetach() {
+#if defined(MVRLU)
+  kc::finish_sections();
+  RLU_THREAD_FINISH(kc::self);
+#else
+  RLU_THREAD_FINISH(kc::self);
+  free(kc::self);
+#endif
+  kc::self = NULL;
+}
+#endif
+
+
 #endif                                   // duplication check
 
 // END OF FILE
@@ -60,10 +60,18 @@ class CacheDB : public BasicDB {
   class Setter;
   class Remover;
   class ScopedVisitor;
+#if defined(RLU) || defined(MVRLU)
+  class CursorVisitor;
+  struct LockSet;
+#endif
   /** An alias of list of cursors. */
   typedef std::list<Cursor*> CursorList;
   /** An alias of list of transaction logs. */
   typedef std::list<TranLog> TranLogList;
+#if defined(RLU) || defined(MVRLU)
+  /** An alias of map of records in the order of scanning. */
+  typedef std::map<uint64_t, Record*> RecordOrder;
+#endif
   /** The number of slot tables. */
   static const int32_t SLOTNUM = 16;
   /** The default bucket number. */
@@ -78,9 +86,28 @@ class CacheDB : public BasicDB {
   static const size_t OPAQUESIZ = 16;
   /** The threshold of busy loop and sleep for locking. */
   static const uint32_t LOCKBUSYLOOP = 8192;
+#if defined(RLU) || defined(MVRLU)
+  /** The maximum number of records locked by an update. */
+  static const size_t LOCKSETMAX = 4;
+  /** The maximum number of trees sampled to pick a record to delete. */
+  static const size_t EVICTSAMPLE = 8;
+  /** The number of buckets scanned to pick a record to delete once one is found. */
+  static const size_t EVICTSCAN = 16;
+#endif
+#if defined(RLU) || defined(MVRLU)
+  /** The number of records visited in a snapshot before it is renewed. */
+  static const size_t REPINCNT = 256;
+#endif
+#if defined(MVRLU)
+  /** The maximum number of records freed in an MV-RLU section. */
+  static const size_t RELBATCH = 256;
+#endif
  public:
   /**
    * Cursor to indicate a record.
+   * @note With RLU or MV-RLU, the position of a cursor is the key and the order stamp of its
+   * record and updating threads are not blocked.  Records are scanned in the order of their last
+   * insertion or renewal as the LRU list used to be, and no section is kept between operations.
    */
   class Cursor : public BasicDB::Cursor {
     friend class CacheDB;
@@ -89,7 +116,11 @@ class CacheDB : public BasicDB {
      * Constructor.
      * @param db the container database object.
      */
+#if defined(RLU) || defined(MVRLU)
+    explicit Cursor(CacheDB* db) : db_(db), sidx_(-1), order_(0), key_() {
+#else
     explicit Cursor(CacheDB* db) : db_(db), sidx_(-1), rec_(NULL) {
+#endif
       _assert_(db);
       ScopedRWLock lock(&db_->mlock_, true);
       db_->curs_.push_back(this);
@@ -114,9 +145,12 @@ class CacheDB : public BasicDB {
      * be performed in this function.
      */
     bool accept(Visitor* visitor, bool writable = true, bool step = false) {
-      _assert_(0);
       _assert_(visitor);
+#if defined(RLU) || defined(MVRLU)
+      ScopedRWLock lock(&db_->mlock_, false);
+#else
       ScopedRWLock lock(&db_->mlock_, true);
+#endif
       if (db_->omode_ == 0) {
         db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
         return false;
@@ -125,6 +159,60 @@ class CacheDB : public BasicDB {
         db_->set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
         return false;
       }
+#if defined(RLU) || defined(MVRLU)
+      if (sidx_ < 0) {
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
+      rlu_thread_data_t* ctx = enter_section();
+      bool hit = false;
+      bool rmv = false;
+      Record* rec;
+      while (sidx_ >= 0) {
+        if (!(rec = find(ctx))) {
+          // the record was removed after the cursor reached it
+          seek(sidx_, order_);
+          continue;
+        }
+        if (!writable) {
+          uint32_t rksiz = rec->ksiz & KSIZMAX;
+          char* dbuf = (char*)rec + sizeof(*rec);
+          const char* rvbuf = dbuf + rksiz;
+          size_t rvsiz = rec->vsiz;
+          char* zbuf = NULL;
+          size_t zsiz = 0;
+          if (db_->comp_) {
+            zbuf = db_->comp_->decompress(rvbuf, rvsiz, &zsiz);
+            if (zbuf) {
+              rvbuf = zbuf;
+              rvsiz = zsiz;
+            }
+          }
+          size_t vsiz;
+          visitor->visit_full(dbuf, rksiz, rvbuf, rvsiz, &vsiz);
+          delete[] zbuf;
+          hit = true;
+          break;
+        }
+        // the visitor is called on the latest version with the record locked
+        Slot* slot = db_->slots_ + sidx_;
+        uint64_t hash = db_->hash_record(key_.data(), key_.size()) / SLOTNUM;
+        CursorVisitor cvis(visitor);
+        db_->accept_impl(slot, hash, key_.data(), key_.size(), &cvis, db_->comp_, false);
+        if (cvis.hit()) {
+          hit = true;
+          rmv = cvis.removed();
+          break;
+        }
+      }
+      if (hit && (step || rmv)) seek(sidx_, order_);
+      leave_section(ctx);
+      if (!hit) {
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
+      return true;
+#else
       if (sidx_ < 0 || !rec_) {
         db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
         return false;
@@ -160,6 +248,7 @@ class CacheDB : public BasicDB {
         if (step) step_impl();
       }
       return true;
+#endif
     }
     /**
      * Jump the cursor to the first record for forward scan.
@@ -167,11 +256,18 @@ class CacheDB : public BasicDB {
      */
     bool jump() {
       _assert_(true);
+#if defined(RLU) || defined(MVRLU)
+      ScopedRWLock lock(&db_->mlock_, false);
+#else
       ScopedRWLock lock(&db_->mlock_, true);
+#endif
       if (db_->omode_ == 0) {
         db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
         return false;
       }
+#if defined(RLU) || defined(MVRLU)
+      if (seek(0, 0)) return true;
+#else
       for (int32_t i = 0; i < SLOTNUM; i++) {
         Slot* slot = db_->slots_ + i;
         if (slot->first) {
@@ -180,9 +276,10 @@ class CacheDB : public BasicDB {
           return true;
         }
       }
+      rec_ = NULL;
+#endif
       db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
       sidx_ = -1;
-      rec_ = NULL;
       return false;
     }
     /**
@@ -193,7 +290,11 @@ class CacheDB : public BasicDB {
      */
     bool jump(const char* kbuf, size_t ksiz) {
       _assert_(kbuf && ksiz <= MEMMAXSIZ);
+#if defined(RLU) || defined(MVRLU)
+      ScopedRWLock lock(&db_->mlock_, false);
+#else
       ScopedRWLock lock(&db_->mlock_, true);
+#endif
       if (db_->omode_ == 0) {
         db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
         return false;
@@ -204,9 +305,40 @@ class CacheDB : public BasicDB {
       hash /= SLOTNUM;
       Slot* slot = db_->slots_ + sidx;
       size_t bidx = hash % slot->bnum;
+      uint32_t fhash = db_->fold_hash(hash) & ~KSIZMAX;
+#if defined(RLU) || defined(MVRLU)
+      Record* head = slot->buckets[bidx];
+      if (head) {
+        rlu_thread_data_t* ctx = enter_section();
+        Record* rec = (Record*)RLU_DEREF(ctx, ((Record*)RLU_DEREF(ctx, head))->left);
+        while (rec) {
+          uint32_t rhash = rec->ksiz & ~KSIZMAX;
+          int32_t kcmp;
+          if (fhash > rhash) {
+            kcmp = -1;
+          } else if (fhash < rhash) {
+            kcmp = 1;
+          } else {
+            kcmp = db_->compare_keys(kbuf, ksiz, (char*)rec + sizeof(*rec), rec->ksiz & KSIZMAX);
+            if (kcmp == 0) {
+              sidx_ = sidx;
+              order_ = rec->order;
+              key_.assign(kbuf, ksiz);
+              leave_section(ctx);
+              return true;
+            }
+          }
+          if (kcmp < 0) {
+            rec = (Record*)RLU_DEREF(ctx, rec->left);
+          } else {
+            rec = (Record*)RLU_DEREF(ctx, rec->right);
+          }
+        }
+        leave_section(ctx);
+      }
+#else
       Record* rec = slot->buckets[bidx];
       Record** entp = slot->buckets + bidx;
-      uint32_t fhash = db_->fold_hash(hash) & ~KSIZMAX;
       while (rec) {
         uint32_t rhash = rec->ksiz & ~KSIZMAX;
         uint32_t rksiz = rec->ksiz & KSIZMAX;
@@ -232,9 +364,10 @@ class CacheDB : public BasicDB {
           }
         }
       }
+      rec_ = NULL;
+#endif
       db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
       sidx_ = -1;
-      rec_ = NULL;
       return false;
     }
     /**
@@ -293,11 +426,26 @@ class CacheDB : public BasicDB {
      */
     bool step() {
       _assert_(true);
+#if defined(RLU) || defined(MVRLU)
+      ScopedRWLock lock(&db_->mlock_, false);
+#else
       ScopedRWLock lock(&db_->mlock_, true);
+#endif
       if (db_->omode_ == 0) {
         db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
         return false;
       }
+#if defined(RLU) || defined(MVRLU)
+      if (sidx_ < 0) {
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
+      if (!seek(sidx_, order_)) {
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
+      return true;
+#else
       if (sidx_ < 0 || !rec_) {
         db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
         return false;
@@ -305,6 +453,7 @@ class CacheDB : public BasicDB {
       bool err = false;
       if (!step_impl()) err = true;
       return !err;
+#endif
     }
     /**
      * Step the cursor to the previous record.
@@ -329,6 +478,73 @@ class CacheDB : public BasicDB {
       return db_;
     }
    private:
+#if defined(RLU) || defined(MVRLU)
+    /**
+     * Enter the section of an operation.
+     * @return the RLU context of the section.
+     */
+    rlu_thread_data_t* enter_section() {
+      _assert_(true);
+#if defined(MVRLU)
+      return begin_section();
+#else
+      rlu_thread_data_t* ctx = get_thread_data();
+      RLU_READER_LOCK(ctx);
+      return ctx;
+#endif
+    }
+    /**
+     * Leave the section of an operation.
+     * @param ctx the RLU context of the section.
+     */
+    void leave_section(rlu_thread_data_t* ctx) {
+      _assert_(ctx);
+#if defined(MVRLU)
+      end_section(ctx);
+#else
+      RLU_READER_UNLOCK(ctx);
+#endif
+    }
+    /**
+     * Find the current record.
+     * @param ctx the RLU context of the section.
+     * @return the newest version of the record in the section, or NULL if it was removed.
+     */
+    Record* find(rlu_thread_data_t* ctx) {
+      _assert_(ctx && sidx_ >= 0);
+      Slot* slot = db_->slots_ + sidx_;
+      uint64_t hash = db_->hash_record(key_.data(), key_.size()) / SLOTNUM;
+      Record* prev;
+      int32_t dir;
+      return db_->search_record(ctx, slot, hash, key_.data(), key_.size(), &prev, &dir);
+    }
+    /**
+     * Set the cursor to the first record after a position in the order of scanning.
+     * @param sidx the index of the slot to search first.
+     * @param order the order stamp of the position, or 0 for the first record of the slot.
+     * @return true on success, or false if no record follows.
+     * @note Only the order lock of each slot is taken, so no section is needed.
+     */
+    bool seek(int32_t sidx, uint64_t order) {
+      _assert_(sidx >= 0);
+      while (sidx < SLOTNUM) {
+        Slot* slot = db_->slots_ + sidx;
+        ScopedSpinLock lock(&slot->olock);
+        RecordOrder::iterator it = slot->order.upper_bound(order);
+        if (it != slot->order.end()) {
+          Record* rec = it->second;
+          sidx_ = sidx;
+          order_ = it->first;
+          key_.assign((char*)rec + sizeof(*rec), rec->ksiz & KSIZMAX);
+          return true;
+        }
+        sidx++;
+        order = 0;
+      }
+      sidx_ = -1;
+      return false;
+    }
+#else
     /**
      * Step the cursor to the next record.
      * @return true on success, or false on failure.
@@ -352,6 +568,7 @@ class CacheDB : public BasicDB {
       }
       return true;
     }
+#endif
     /** Dummy constructor to forbid the use. */
     Cursor(const Cursor&);
     /** Dummy Operator to forbid the use. */
@@ -360,8 +577,15 @@ class CacheDB : public BasicDB {
     CacheDB* db_;
     /** The index of the current slot. */
     int32_t sidx_;
+#if defined(RLU) || defined(MVRLU)
+    /** The order stamp of the current record. */
+    uint64_t order_;
+    /** The current key. */
+    std::string key_;
+#else
     /** The current record. */
     Record* rec_;
+#endif
   };
   /**
    * Tuning options.
@@ -435,24 +659,28 @@ class CacheDB : public BasicDB {
     int32_t sidx = hash % SLOTNUM;
     hash /= SLOTNUM;
     Slot* slot = slots_ + sidx;
-
-#if defined(RLU) || defined(MVRLU)
-    if(writable)
-#endif
-	slot->lock.lock();
-
 #if defined(RLU) || defined(MVRLU)
-    rlu_thread_data_t *self = get_thread_data();
+#if defined(MVRLU)
+    rlu_thread_data_t* self = begin_section();
+#else
+    rlu_thread_data_t* self = get_thread_data();
     RLU_READER_LOCK(self);
 #endif
-
-    accept_impl(slot, hash, kbuf, ksiz, visitor, comp_, rttmode_);
-
-#if defined(RLU) || defined(MVRLU)
+    if (writable) {
+      accept_impl(slot, hash, kbuf, ksiz, visitor, comp_, rttmode_);
+    } else {
+      read_impl(slot, hash, kbuf, ksiz, visitor, comp_, rttmode_);
+    }
+#if defined(MVRLU)
+    end_section(self);
+#else
     RLU_READER_UNLOCK(self);
-    if(writable)
 #endif
-	slot->lock.unlock();
+#else
+    slot->lock.lock();
+    accept_impl(slot, hash, kbuf, ksiz, visitor, comp_, rttmode_);
+    slot->lock.unlock();
+#endif
     return true;
   }
   /**
@@ -463,7 +691,8 @@ class CacheDB : public BasicDB {
    * @return true on success, or false on failure.
    * @note The operations for specified records are performed atomically and other threads
    * accessing the same records are blocked.  To avoid deadlock, any explicit database operation
-   * must not be performed in this function.
+   * must not be performed in this function.  With RLU or MV-RLU, each record is updated in a
+   * section of its own and the records are not updated atomically as a whole.
    */
   bool accept_bulk(const std::vector<std::string>& keys, Visitor* visitor,
                    bool writable = true) {
@@ -499,6 +728,28 @@ class CacheDB : public BasicDB {
       sidxs.insert(rkey->sidx);
       rkey->hash /= SLOTNUM;
     }
+#if defined(RLU) || defined(MVRLU)
+    for (size_t i = 0; i < knum; i++) {
+      RecordKey* rkey = rkeys + i;
+      Slot* slot = slots_ + rkey->sidx;
+#if defined(MVRLU)
+      rlu_thread_data_t* self = begin_section();
+#else
+      rlu_thread_data_t* self = get_thread_data();
+      RLU_READER_LOCK(self);
+#endif
+      if (writable) {
+        accept_impl(slot, rkey->hash, rkey->kbuf, rkey->ksiz, visitor, comp_, rttmode_);
+      } else {
+        read_impl(slot, rkey->hash, rkey->kbuf, rkey->ksiz, visitor, comp_, rttmode_);
+      }
+#if defined(MVRLU)
+      end_section(self);
+#else
+      RLU_READER_UNLOCK(self);
+#endif
+    }
+#else
     std::set<int32_t>::iterator sit = sidxs.begin();
     std::set<int32_t>::iterator sitend = sidxs.end();
     while (sit != sitend) {
@@ -518,6 +769,7 @@ class CacheDB : public BasicDB {
       slot->lock.unlock();
       ++sit;
     }
+#endif
     delete[] rkeys;
     return true;
   }
@@ -528,11 +780,17 @@ class CacheDB : public BasicDB {
    * @param checker a progress checker object.  If it is NULL, no checking is performed.
    * @return true on success, or false on failure.
    * @note The whole iteration is performed atomically and other threads are blocked.  To avoid
-   * deadlock, any explicit database operation must not be performed in this function.
+   * deadlock, any explicit database operation must not be performed in this function.  With RLU
+   * or MV-RLU, other threads are not blocked and the records are visited in snapshots renewed
+   * after every REPINCNT records.
    */
   bool iterate(Visitor *visitor, bool writable = true, ProgressChecker* checker = NULL) {
     _assert_(visitor);
+#if defined(RLU) || defined(MVRLU)
+    ScopedRWLock lock(&mlock_, false);
+#else
     ScopedRWLock lock(&mlock_, true);
+#endif
     if (omode_ == 0) {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
       return false;
@@ -548,6 +806,78 @@ class CacheDB : public BasicDB {
       return false;
     }
     int64_t curcnt = 0;
+#if defined(RLU) || defined(MVRLU)
+    std::string key;
+    std::string value;
+    for (int32_t i = 0; i < SLOTNUM; i++) {
+      Slot* slot = slots_ + i;
+      size_t bidx = 0;
+      uint32_t rhash = 0;
+      bool start = true;
+#if defined(MVRLU)
+      rlu_thread_data_t* self = begin_section();
+#else
+      rlu_thread_data_t* self = get_thread_data();
+      RLU_READER_LOCK(self);
+#endif
+      size_t vnum = 0;
+      while (true) {
+        if (vnum >= REPINCNT) {
+          RLU_READER_UNLOCK(self);
+          RLU_READER_LOCK(self);
+          vnum = 0;
+        }
+        Record* rec = seek_record(self, slot, &bidx, rhash,
+                                  start ? NULL : key.data(), key.size(), true);
+        if (!rec) break;
+        start = false;
+        rhash = rec->ksiz & ~KSIZMAX;
+        uint32_t rksiz = rec->ksiz & KSIZMAX;
+        char* dbuf = (char*)rec + sizeof(*rec);
+        key.assign(dbuf, rksiz);
+        const char* rvbuf = dbuf + rksiz;
+        size_t rvsiz = rec->vsiz;
+        char* zbuf = NULL;
+        size_t zsiz = 0;
+        if (comp_) {
+          zbuf = comp_->decompress(rvbuf, rvsiz, &zsiz);
+          if (zbuf) {
+            rvbuf = zbuf;
+            rvsiz = zsiz;
+          }
+        }
+        size_t vsiz;
+        const char* vbuf = visitor->visit_full(dbuf, rksiz, rvbuf, rvsiz, &vsiz);
+        if (vbuf != Visitor::NOP && vbuf != Visitor::REMOVE) value.assign(vbuf, vsiz);
+        delete[] zbuf;
+        vnum++;
+        if (vbuf == Visitor::REMOVE) {
+          uint64_t hash = hash_record(key.data(), key.size()) / SLOTNUM;
+          Repeater repeater(Visitor::REMOVE, 0);
+          accept_impl(slot, hash, key.data(), key.size(), &repeater, comp_, false);
+        } else if (vbuf != Visitor::NOP) {
+          uint64_t hash = hash_record(key.data(), key.size()) / SLOTNUM;
+          Repeater repeater(value.data(), value.size());
+          accept_impl(slot, hash, key.data(), key.size(), &repeater, comp_, false);
+        }
+        curcnt++;
+        if (checker && !checker->check("iterate", "processing", curcnt, allcnt)) {
+#if defined(MVRLU)
+          end_section(self);
+#else
+          RLU_READER_UNLOCK(self);
+#endif
+          set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+          return false;
+        }
+      }
+#if defined(MVRLU)
+      end_section(self);
+#else
+      RLU_READER_UNLOCK(self);
+#endif
+    }
+#else
     for (int32_t i = 0; i < SLOTNUM; i++) {
       Slot* slot = slots_ + i;
       Record* rec = slot->first;
@@ -586,6 +916,7 @@ class CacheDB : public BasicDB {
         }
       }
     }
+#endif
     if (checker && !checker->check("iterate", "ending", -1, allcnt)) {
       set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
       return false;
@@ -601,7 +932,8 @@ class CacheDB : public BasicDB {
    * @return true on success, or false on failure.
    * @note This function is for reading records and not for updating ones.  The return value of
    * the visitor is just ignored.  To avoid deadlock, any explicit database operation must not
-   * be performed in this function.
+   * be performed in this function.  With RLU or MV-RLU, each worker scans its slots in its own
+   * sections, which are renewed after every REPINCNT records, and writers are not blocked.
    */
   bool scan_parallel(Visitor *visitor, size_t thnum, ProgressChecker* checker = NULL) {
     _assert_(visitor && thnum <= MEMMAXSIZ);
@@ -644,6 +976,63 @@ class CacheDB : public BasicDB {
         Compressor* comp = db->comp_;
         std::vector<Slot*>::iterator sit = slots_.begin();
         std::vector<Slot*>::iterator sitend = slots_.end();
+#if defined(RLU) || defined(MVRLU)
+        std::string key;
+        while (sit != sitend && error_ == Error::SUCCESS) {
+          Slot* slot = *sit;
+          size_t bidx = 0;
+          uint32_t rhash = 0;
+          bool start = true;
+#if defined(MVRLU)
+          rlu_thread_data_t* self = begin_section();
+#else
+          rlu_thread_data_t* self = get_thread_data();
+          RLU_READER_LOCK(self);
+#endif
+          size_t vnum = 0;
+          while (true) {
+            if (vnum >= REPINCNT) {
+              RLU_READER_UNLOCK(self);
+              RLU_READER_LOCK(self);
+              vnum = 0;
+            }
+            Record* rec = db->seek_record(self, slot, &bidx, rhash,
+                                          start ? NULL : key.data(), key.size(), true);
+            if (!rec) break;
+            start = false;
+            rhash = rec->ksiz & ~KSIZMAX;
+            uint32_t rksiz = rec->ksiz & KSIZMAX;
+            char* dbuf = (char*)rec + sizeof(*rec);
+            key.assign(dbuf, rksiz);
+            const char* rvbuf = dbuf + rksiz;
+            size_t rvsiz = rec->vsiz;
+            char* zbuf = NULL;
+            size_t zsiz = 0;
+            if (comp) {
+              zbuf = comp->decompress(rvbuf, rvsiz, &zsiz);
+              if (zbuf) {
+                rvbuf = zbuf;
+                rvsiz = zsiz;
+              }
+            }
+            size_t vsiz;
+            visitor->visit_full(dbuf, rksiz, rvbuf, rvsiz, &vsiz);
+            delete[] zbuf;
+            vnum++;
+            if (checker && !checker->check("scan_parallel", "processing", -1, allcnt)) {
+              db->set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+              error_ = db->error();
+              break;
+            }
+          }
+#if defined(MVRLU)
+          end_section(self);
+#else
+          RLU_READER_UNLOCK(self);
+#endif
+          ++sit;
+        }
+#else
         while (sit != sitend) {
           Slot* slot = *sit;
           Record* rec = slot->first;
@@ -674,6 +1063,7 @@ class CacheDB : public BasicDB {
           }
           ++sit;
         }
+#endif
       }
       CacheDB* db_;
       Visitor* visitor_;
@@ -949,7 +1339,18 @@ class CacheDB : public BasicDB {
     for (int32_t i = 0; i < SLOTNUM; i++) {
       if (!commit) apply_slot_trlogs(slots_ + i);
       slots_[i].trlogs.clear();
+#if defined(MVRLU)
+      rlu_thread_data_t* self = begin_section();
       adjust_slot_capacity(slots_ + i);
+      end_section(self);
+#elif defined(RLU)
+      rlu_thread_data_t* self = get_thread_data();
+      RLU_READER_LOCK(self);
+      adjust_slot_capacity(slots_ + i);
+      RLU_READER_UNLOCK(self);
+#else
+      adjust_slot_capacity(slots_ + i);
+#endif
     }
     tran_ = false;
     trigger_meta(commit ? MetaTrigger::COMMITTRAN : MetaTrigger::ABORTTRAN, "end_transaction");
@@ -1196,7 +1597,8 @@ class CacheDB : public BasicDB {
    * Switch the mode of LRU rotation.
    * @param rttmode true to enable LRU rotation, false to disable LRU rotation.
    * @return true on success, or false on failure.
-   * @note This function can be called while the database is opened.
+   * @note This function can be called while the database is opened.  With RLU or MV-RLU, a
+   * rotated record only gets a new access stamp, which read-only access stores without a lock.
    */
   bool switch_rotation(bool rttmode) {
     _assert_(true);
@@ -1527,17 +1929,13 @@ class CacheDB : public BasicDB {
     uint32_t vsiz;                       ///< size of the value
     Record* left;                        ///< left child record
     Record* right;                       ///< right child record
+#if defined(RLU) || defined(MVRLU)
+    uint64_t stamp;                      ///< access stamp
+    uint64_t order;                      ///< order stamp of scanning
+#else
     Record* prev;                        ///< privious record
     Record* next;                        ///< next record
-    char dbuf[1024];
-  };
-  struct Record_dummy {
-    uint32_t ksiz;                       ///< size of the key
-    uint32_t vsiz;                       ///< size of the value
-    Record* left;                        ///< left child record
-    Record* right;                       ///< right child record
-    Record* prev;                        ///< privious record
-    Record* next;                        ///< next record
+#endif
   };
   /**
    * Transaction log.
@@ -1565,30 +1963,75 @@ class CacheDB : public BasicDB {
     size_t bnum;                         ///< number of buckets
     size_t capcnt;                       ///< cap of record number
     size_t capsiz;                       ///< cap of memory usage
+#if defined(RLU) || defined(MVRLU)
+    uint64_t tick;                       ///< clock of access and order stamps
+    size_t ebidx;                        ///< bucket index to sample next for deletion
+    SpinLock olock;                      ///< lock of the order
+    RecordOrder order;                   ///< records in the order of scanning
+#else
     Record* first;                       ///< first record
     Record* last;                        ///< last record
+#endif
     size_t count;                        ///< number of records
     size_t size;                         ///< total size of records
     TranLogList trlogs;                  ///< transaction logs
     size_t trsize;                       ///< size before transaction
   };
+#if defined(RLU) || defined(MVRLU)
   /**
-   * Repeating visitor.
+   * Visitor of a cursor to tell whether the record was found.
    */
-  class Repeater : public Visitor {
+  class CursorVisitor : public Visitor {
    public:
     /** constructor */
-    explicit Repeater(const char* vbuf, size_t vsiz) : vbuf_(vbuf), vsiz_(vsiz) {}
+    explicit CursorVisitor(Visitor* visitor) : visitor_(visitor), hit_(false), rmv_(false) {}
+    /** whether the record was visited */
+    bool hit() {
+      return hit_;
+    }
+    /** whether the record was removed */
+    bool removed() {
+      return rmv_;
+    }
    private:
     /** process a full record */
     const char* visit_full(const char* kbuf, size_t ksiz,
                            const char* vbuf, size_t vsiz, size_t* sp) {
       _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ && sp);
-      *sp = vsiz_;
-      return vbuf_;
+      hit_ = true;
+      const char* rv = visitor_->visit_full(kbuf, ksiz, vbuf, vsiz, sp);
+      rmv_ = rv == REMOVE;
+      return rv;
     }
-    const char* vbuf_;                   ///< region of the value
-    size_t vsiz_;                        ///< size of the value
+    Visitor* visitor_;                   ///< visitor
+    bool hit_;                           ///< flag whether the record was visited
+    bool rmv_;                           ///< flag whether the record was removed
+  };
+  /**
+   * Records locked by an update in progress.
+   */
+  struct LockSet {
+    Record* recs[LOCKSETMAX];            ///< writable copies
+    size_t num;                          ///< number of locked records
+  };
+#endif
+  /**
+   * Repeating visitor.
+   */
+  class Repeater : public Visitor {
+   public:
+    /** constructor */
+    explicit Repeater(const char* vbuf, size_t vsiz) : vbuf_(vbuf), vsiz_(vsiz) {}
+   private:
+    /** process a full record */
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ && sp);
+      *sp = vsiz_;
+      return vbuf_;
+    }
+    const char* vbuf_;                   ///< region of the value
+    size_t vsiz_;                        ///< size of the value
   };
   /**
    * Setting visitor.
@@ -1658,248 +2101,487 @@ class CacheDB : public BasicDB {
   void accept_impl(Slot* slot, uint64_t hash, const char* kbuf, size_t ksiz, Visitor* visitor,
                    Compressor* comp, bool rtt) {
     _assert_(slot && kbuf && ksiz <= MEMMAXSIZ && visitor);
-    //Get the thread data
     rlu_thread_data_t* self = get_thread_data();
-    _assert_(self->uniq_id < 64);
+    std::string key;
+    int32_t rv;
+    while ((rv = try_accept_impl(self, slot, hash, kbuf, ksiz, visitor, comp, rtt)) < 0) {
+      if (kbuf != key.data()) {
+        key.assign(kbuf, ksiz);
+        kbuf = key.data();
+      }
+      RLU_ABORT(self);
+      RLU_READER_LOCK(self);
+    }
+    if (rv > 0) {
+      RLU_READER_UNLOCK(self);
+    } else {
+      RLU_ABORT(self);
+    }
+    RLU_READER_LOCK(self);
+    if (rv > 0 && !tran_) adjust_slot_capacity(slot);
+  }
+  /**
+   * Try to accept a visitor to a record within the current section.
+   * @param self the RLU context of the section.
+   * @param slot the slot of the record.
+   * @param hash the hash value of the key.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param visitor a visitor object.
+   * @param comp the data compressor.
+   * @param rtt whether to renew the access stamp of the record.
+   * @return 1 if the slot was updated, 0 if nothing was updated, or -1 if a lock could not be
+   * taken and the section must be aborted and retried.
+   * @note Every record which the update may modify is locked before the visitor is called, so
+   * the visitor sees the latest value and is called only once.  These are the tree parent, the
+   * record and, for a removal with two children, the pivot and its parent.  The LRU order is kept
+   * by access stamps outside of the write set, so an update locks nothing shared by the slot.  The
+   * order of scanning is updated under the order lock once no lock can fail any more.
+   */
+  int32_t try_accept_impl(rlu_thread_data_t* self, Slot* slot, uint64_t hash,
+                          const char* kbuf, size_t ksiz, Visitor* visitor, Compressor* comp,
+                          bool rtt) {
+    _assert_(self && slot && kbuf && ksiz <= MEMMAXSIZ && visitor);
+    Record* prev;
+    int32_t dir;
+    Record* rec = search_record(self, slot, hash, kbuf, ksiz, &prev, &dir);
+    LockSet locks;
+    locks.num = 0;
+    Record* lprev = lock_record(self, &locks, prev);
+    if (!lprev) return -1;
+    if (!rec) {
+      size_t vsiz;
+      const char* vbuf = visitor->visit_empty(kbuf, ksiz, &vsiz);
+      if (vbuf == Visitor::NOP || vbuf == Visitor::REMOVE) return 0;
+      char* zbuf = NULL;
+      size_t zsiz = 0;
+      if (comp) {
+        zbuf = comp->compress(vbuf, vsiz, &zsiz);
+        if (zbuf) {
+          vbuf = zbuf;
+          vsiz = zsiz;
+        }
+      }
+      rec = (Record*)RLU_ALLOC(sizeof(*rec) + ksiz + vsiz);
+      char* dbuf = (char*)rec + sizeof(*rec);
+      std::memcpy(dbuf, kbuf, ksiz);
+      rec->ksiz = ksiz | (fold_hash(hash) & ~KSIZMAX);
+      std::memcpy(dbuf + ksiz, vbuf, vsiz);
+      rec->vsiz = vsiz;
+      rec->left = NULL;
+      rec->right = NULL;
+      delete[] zbuf;
+      insert_order(slot, rec, rec);
+      rec->stamp = rec->order;
+      if (dir == 0) {
+        RLU_ASSIGN_PTR(self, &(lprev->left), rec);
+      } else {
+        RLU_ASSIGN_PTR(self, &(lprev->right), rec);
+      }
+      if (tran_) {
+        ScopedMutex lock(&slot->lock);
+        TranLog log(kbuf, ksiz);
+        slot->trlogs.push_back(log);
+      }
+      __sync_add_and_fetch(&slot->count, 1);
+      __sync_add_and_fetch(&slot->size, sizeof(Record) + ksiz + vsiz);
+      return 1;
+    }
+    Record* lrec = lock_record(self, &locks, rec);
+    if (!lrec) return -1;
+    Record* pivot = NULL;
+    Record* lpivot = NULL;
+    Record* lpivot_prev = NULL;
+    if (lrec->left && lrec->right) {
+      Record* pivot_prev = NULL;
+      pivot = (Record*)RLU_DEREF(self, lrec->left);
+      while (pivot->right) {
+        pivot_prev = pivot;
+        pivot = (Record*)RLU_DEREF(self, pivot->right);
+      }
+      if (pivot_prev && !(lpivot_prev = lock_record(self, &locks, pivot_prev))) return -1;
+      if (!(lpivot = lock_record(self, &locks, pivot))) return -1;
+    }
+    uint32_t rksiz = lrec->ksiz & KSIZMAX;
+    char* dbuf = (char*)lrec + sizeof(*lrec);
+    const char* ovbuf = dbuf + rksiz;
+    size_t ovsiz = lrec->vsiz;
+    const char* rvbuf = ovbuf;
+    size_t rvsiz = ovsiz;
+    char* zbuf = NULL;
+    size_t zsiz = 0;
+    if (comp) {
+      zbuf = comp->decompress(rvbuf, rvsiz, &zsiz);
+      if (zbuf) {
+        rvbuf = zbuf;
+        rvsiz = zsiz;
+      }
+    }
+    size_t vsiz;
+    const char* vbuf = visitor->visit_full(dbuf, rksiz, rvbuf, rvsiz, &vsiz);
+    delete[] zbuf;
+    if (vbuf == Visitor::NOP) return 0;
+    if (vbuf == Visitor::REMOVE) {
+      Record* child;
+      if (lrec->left && !lrec->right) {
+        child = lrec->left;
+      } else if (!lrec->left && lrec->right) {
+        child = lrec->right;
+      } else if (!lrec->left) {
+        child = NULL;
+      } else {
+        if (lpivot_prev) {
+          RLU_ASSIGN_PTR(self, &(lpivot_prev->right), lpivot->left);
+          RLU_ASSIGN_PTR(self, &(lpivot->left), lrec->left);
+        }
+        RLU_ASSIGN_PTR(self, &(lpivot->right), lrec->right);
+        child = pivot;
+      }
+      if (dir == 0) {
+        RLU_ASSIGN_PTR(self, &(lprev->left), child);
+      } else {
+        RLU_ASSIGN_PTR(self, &(lprev->right), child);
+      }
+      if (tran_) {
+        ScopedMutex lock(&slot->lock);
+        TranLog log(kbuf, ksiz, ovbuf, ovsiz);
+        slot->trlogs.push_back(log);
+      }
+      __sync_sub_and_fetch(&slot->count, 1);
+      __sync_sub_and_fetch(&slot->size, sizeof(Record) + rksiz + ovsiz);
+      remove_order(slot, lrec->order);
+      RLU_FREE(self, lrec);
+      return 1;
+    }
+    zbuf = NULL;
+    if (comp) {
+      zbuf = comp->compress(vbuf, vsiz, &zsiz);
+      if (zbuf) {
+        vbuf = zbuf;
+        vsiz = zsiz;
+      }
+    }
+    if (tran_) {
+      ScopedMutex lock(&slot->lock);
+      TranLog log(kbuf, ksiz, ovbuf, ovsiz);
+      slot->trlogs.push_back(log);
+    }
+    bool grow = vsiz > ovsiz;
+    Record* nrec = lrec;
+    if (grow) {
+      nrec = (Record*)RLU_ALLOC(sizeof(*nrec) + rksiz + vsiz);
+      nrec->ksiz = lrec->ksiz;
+      nrec->left = lrec->left;
+      nrec->right = lrec->right;
+      nrec->stamp = lrec->stamp;
+      nrec->order = lrec->order;
+      std::memcpy((char*)nrec + sizeof(*nrec), dbuf, rksiz);
+    }
+    std::memcpy((char*)nrec + sizeof(*nrec) + rksiz, vbuf, vsiz);
+    nrec->vsiz = vsiz;
+    delete[] zbuf;
+    if (rtt) {
+      remove_order(slot, nrec->order);
+      insert_order(slot, grow ? nrec : (dir == 0 ? prev->left : prev->right), nrec);
+      nrec->stamp = nrec->order;
+    } else if (grow) {
+      ScopedSpinLock lock(&slot->olock);
+      slot->order[nrec->order] = nrec;
+    }
+    if (grow) {
+      if (dir == 0) {
+        RLU_ASSIGN_PTR(self, &(lprev->left), nrec);
+      } else {
+        RLU_ASSIGN_PTR(self, &(lprev->right), nrec);
+      }
+      RLU_FREE(self, lrec);
+    }
+    __sync_add_and_fetch(&slot->size, vsiz - ovsiz);
+    return 1;
+  }
+  /**
+   * Accept a visitor to a record without locking it.
+   * @param slot the slot of the record.
+   * @param hash the hash value of the key.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param visitor a visitor object.
+   * @param comp the data compressor.
+   * @param rtt whether to renew the access stamp of the record.
+   * @note The return value of the visitor is just ignored.  The access stamp is stored into the
+   * actual record without a lock, as a lost stamp only makes the deletion order less exact.
+   */
+  void read_impl(Slot* slot, uint64_t hash, const char* kbuf, size_t ksiz, Visitor* visitor,
+                 Compressor* comp, bool rtt) {
+    _assert_(slot && kbuf && ksiz <= MEMMAXSIZ && visitor);
+    rlu_thread_data_t* self = get_thread_data();
+    Record* prev;
+    int32_t dir;
+    Record* rec = search_record(self, slot, hash, kbuf, ksiz, &prev, &dir);
+    size_t vsiz;
+    if (!rec) {
+      visitor->visit_empty(kbuf, ksiz, &vsiz);
+      return;
+    }
+    if (rtt) {
+      Record* arec = dir == 0 ? prev->left : prev->right;
+      arec->stamp = slot->tick;
+    }
+    uint32_t rksiz = rec->ksiz & KSIZMAX;
+    char* dbuf = (char*)rec + sizeof(*rec);
+    const char* rvbuf = dbuf + rksiz;
+    size_t rvsiz = rec->vsiz;
+    char* zbuf = NULL;
+    size_t zsiz = 0;
+    if (comp) {
+      zbuf = comp->decompress(rvbuf, rvsiz, &zsiz);
+      if (zbuf) {
+        rvbuf = zbuf;
+        rvsiz = zsiz;
+      }
+    }
+    visitor->visit_full(dbuf, rksiz, rvbuf, rvsiz, &vsiz);
+    delete[] zbuf;
+  }
+  /**
+   * Search the binary tree of a bucket for a record.
+   * @param self the RLU context of the section.
+   * @param slot the slot of the record.
+   * @param hash the hash value of the key.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param prevp the pointer to the variable into which the parent of the record is assigned.
+   * @param dirp the pointer to the variable into which 0 is assigned if the record is the left
+   * child of the parent or 1 if it is the right child.
+   * @return the record, or NULL if no record corresponds.
+   * @note The bucket head is allocated on demand and serves as the parent of the root.
+   */
+  Record* search_record(rlu_thread_data_t* self, Slot* slot, uint64_t hash,
+                        const char* kbuf, size_t ksiz, Record** prevp, int32_t* dirp) {
+    _assert_(self && slot && kbuf && ksiz <= MEMMAXSIZ && prevp && dirp);
     size_t bidx = hash % slot->bnum;
     Record* head = slot->buckets[bidx];
     if (!head) {
-        head = (Record*)RLU_ALLOC(sizeof(Record));
-        head->left = NULL;
-	slot->buckets[bidx] = head;
+      head = (Record*)RLU_ALLOC(sizeof(*head));
+      head->ksiz = 0;
+      head->vsiz = 0;
+      head->left = NULL;
+      head->right = NULL;
+      if (!__sync_bool_compare_and_swap(slot->buckets + bidx, (Record*)NULL, head)) {
+        RLU_FREE(NULL, head);
+        head = slot->buckets[bidx];
+      }
     }
     Record* prev = (Record*)RLU_DEREF(self, head);
-
-    Record* rec = prev->left; //Root of tree
-    rec = (Record*) RLU_DEREF(self, rec);
-
-    int direction = 0;
-
+    Record* rec = (Record*)RLU_DEREF(self, prev->left);
+    int32_t dir = 0;
     uint32_t fhash = fold_hash(hash) & ~KSIZMAX;
     while (rec) {
       uint32_t rhash = rec->ksiz & ~KSIZMAX;
-      uint32_t rksiz = rec->ksiz & KSIZMAX;
+      int32_t kcmp;
       if (fhash > rhash) {
-        prev = rec;
-        direction = 0;
-        rec = (Record*) RLU_DEREF(self,rec->left);
+        kcmp = -1;
       } else if (fhash < rhash) {
-        prev = rec;
-        direction = 1;
-        rec = (Record*) RLU_DEREF(self,rec->right);
+        kcmp = 1;
       } else {
-        char* dbuf = (char*)rec->dbuf;
-        int32_t kcmp = compare_keys(kbuf, ksiz, dbuf, rksiz);
-        if (kcmp < 0) {
-          prev = rec;
-          direction = 0;
-          rec = (Record*) RLU_DEREF(self, rec->left);
-        } else if (kcmp > 0) {
-          prev = rec;
-          direction = 1;
-          rec = (Record*)RLU_DEREF(self, rec->right);
-        } else {
-          const char* rvbuf = dbuf + rksiz;
-          size_t rvsiz = rec->vsiz;
-          char* zbuf = NULL;
-          size_t zsiz = 0;
-          if (comp) {
-            zbuf = comp->decompress(rvbuf, rvsiz, &zsiz);
-            if (zbuf) {
-              rvbuf = zbuf;
-              rvsiz = zsiz;
-            }
-          }
-          size_t vsiz;
-          const char* vbuf = visitor->visit_full(dbuf, rksiz, rvbuf, rvsiz, &vsiz);
-          delete[] zbuf;
-          if (vbuf == Visitor::REMOVE) {
-            if (tran_) {
-              TranLog log(kbuf, ksiz, dbuf + rksiz, rec->vsiz);
-              slot->trlogs.push_back(log);
-            }
-            if (!curs_.empty()) escape_cursors(rec);
-            if (RLU_IS_SAME_PTRS(rec, slot->first)) {
-                    RLU_ASSIGN_PTR(self, &(slot->first),rec->next);
-            }
-            if (RLU_IS_SAME_PTRS(rec, slot->last)) {
-                    RLU_ASSIGN_PTR(self, &(slot->last),rec->prev);
-            }
-            if (rec->prev){
-              Record* prevp = rec->prev;
-              RLU_TRY_LOCK(self, &(prevp));
-              RLU_ASSIGN_PTR(self, &(prevp->next), rec->next);
-            }
-            if (rec->next){
-              Record* nextp = rec->next;
-              RLU_TRY_LOCK(self, &(nextp));
-              RLU_ASSIGN_PTR(self, &(nextp->prev), rec->prev);
-            }
-            
-	    assert(prev != NULL);
-	    RLU_TRY_LOCK(self, &rec);
-	    RLU_TRY_LOCK(self, &prev);
-            
-            if (rec->left && !rec->right) {
-              if(direction == 0)
-                      RLU_ASSIGN_PTR(self, &(prev->left), rec->left);
-              else
-                      RLU_ASSIGN_PTR(self, &(prev->right), rec->left);
-            } else if (!rec->left && rec->right) {
-              if (direction == 0)
-                      RLU_ASSIGN_PTR(self, &(prev->left), rec->right);
-              else
-                      RLU_ASSIGN_PTR(self, &(prev->right), rec->right);
-            } else if (!rec->left) {
-              if (direction == 0)
-                      prev->left = NULL;
-              else
-                      prev->right = NULL;
-            } else {
-              Record* pivot = (Record*) RLU_DEREF(self, rec->left);
-              Record* pivot_prev;
-              int pivot_direction = 1;
-              if (pivot->right) {
-                pivot_prev = pivot;
-                pivot_direction = 1;
-                pivot = (Record*)RLU_DEREF(self, pivot->right);
-                while (pivot->right) {
-                  pivot_prev = pivot;
-                  pivot_direction = 1;
-                  pivot = (Record*)RLU_DEREF(self, pivot->right);
-                }
-		assert(pivot_prev != NULL);
-                RLU_TRY_LOCK(self, &(pivot_prev));
-                if(direction == 0)
-                        RLU_ASSIGN_PTR(self, &(prev->left), pivot);
-                else
-                        RLU_ASSIGN_PTR(self, &(prev->right), pivot);
-                
-                if(pivot_direction == 0)
-                        RLU_ASSIGN_PTR(self, &(pivot_prev->left), pivot->left);
-                else
-                        RLU_ASSIGN_PTR(self, &(pivot_prev->right), pivot->left);
-
-                RLU_ASSIGN_PTR(self, &(pivot->left), rec->left);
-                RLU_ASSIGN_PTR(self, &(pivot->right),rec->right);
-              } else {
-                if(direction == 0)
-                        RLU_ASSIGN_PTR(self, &(prev->left), pivot);
-                else
-                        RLU_ASSIGN_PTR(self, &(prev->right), pivot);
-                RLU_ASSIGN_PTR(self, &(pivot->right), rec->right);
-              }
-            }
-            slot->count--;
-            //slot->size -= sizeof(Record) + rksiz + rec->vsiz;
-            slot->size -= sizeof(Record);
-            RLU_FREE(self, rec);
+        kcmp = compare_keys(kbuf, ksiz, (char*)rec + sizeof(*rec), rec->ksiz & KSIZMAX);
+        if (kcmp == 0) break;
+      }
+      prev = rec;
+      if (kcmp < 0) {
+        dir = 0;
+        rec = (Record*)RLU_DEREF(self, rec->left);
+      } else {
+        dir = 1;
+        rec = (Record*)RLU_DEREF(self, rec->right);
+      }
+    }
+    *prevp = prev;
+    *dirp = dir;
+    return rec;
+  }
+  /**
+   * Seek the first record at or after a position in the order of scanning.
+   * @param self the RLU context of the section.
+   * @param slot the slot of the records.
+   * @param bidxp the pointer to the variable of the index of the bucket to search first.  The
+   * index of the bucket of the found record is assigned to it.
+   * @param rhash the folded hash value of the key of the position.
+   * @param kbuf the pointer to the key region of the position, or NULL to seek the first record
+   * of the bucket.
+   * @param ksiz the size of the key region.
+   * @param after true to skip the record of the key itself, or false to include it.
+   * @return the newest version of the record, or NULL if no record follows in the slot.
+   * @note Records are scanned bucket by bucket in the order of each binary tree.  As the
+   * position is a key, it stays valid while the record is removed or replaced.
+   */
+  Record* seek_record(rlu_thread_data_t* self, Slot* slot, size_t* bidxp, uint32_t rhash,
+                      const char* kbuf, size_t ksiz, bool after) {
+    _assert_(self && slot && bidxp && ksiz <= MEMMAXSIZ);
+    for (size_t bidx = *bidxp; bidx < slot->bnum; bidx++) {
+      Record* head = slot->buckets[bidx];
+      if (!head) {
+        kbuf = NULL;
+        continue;
+      }
+      Record* rec = (Record*)RLU_DEREF(self, ((Record*)RLU_DEREF(self, head))->left);
+      Record* cand = NULL;
+      while (rec) {
+        int32_t kcmp = -1;
+        if (kbuf) {
+          uint32_t xhash = rec->ksiz & ~KSIZMAX;
+          if (rhash > xhash) {
+            kcmp = -1;
+          } else if (rhash < xhash) {
+            kcmp = 1;
           } else {
-            bool adj = false;
-            if (vbuf != Visitor::NOP) {
-              char* zbuf = NULL;
-              size_t zsiz = 0;
-              if (comp) {
-                zbuf = comp->compress(vbuf, vsiz, &zsiz);
-                if (zbuf) {
-                  vbuf = zbuf;
-                  vsiz = zsiz;
-                }
-              }
-              if (tran_) {
-                TranLog log(kbuf, ksiz, dbuf + rksiz, rec->vsiz);
-                slot->trlogs.push_back(log);
-              } else {
-                adj = vsiz > rec->vsiz;
-              }
-              slot->size -= rec->vsiz;
-              slot->size += vsiz;
-              if (vsiz > rec->vsiz) {
-                assert(0 && "Value resize required");
-                Record* old = rec;
-                rec = (Record*)xrealloc(rec, sizeof(*rec) + ksiz + vsiz);
-                if (rec != old) {
-                  if (!curs_.empty()) adjust_cursors(old, rec);
-                  if (slot->first == old) slot->first = rec;
-                  if (slot->last == old) slot->last = rec;
-                  if (rec->prev) rec->prev->next = rec;
-                  if (rec->next) rec->next->prev = rec;
-                  dbuf = (char*)rec + sizeof(*rec);
-                }
-              }
-	      assert(rec != NULL); 
-              RLU_TRY_LOCK(self, &rec);
-              dbuf = (char*)rec->dbuf;
-              std::memcpy(dbuf + ksiz, vbuf, vsiz);
-              rec->vsiz = vsiz;
-              delete[] zbuf;
-            }
-#if 0
-            if (rtt && slot->last != rec) {
-              if (!curs_.empty()) escape_cursors(rec);
-              if (RLU_IS_SAME_PTRS(head->next,rec)) RLU_ASSIGN_PTR(self, &(head->next), rec->next);
-              if (rec->prev) RLU_ASSIGN_PTR(self, &(rec->prev->next), rec->next);
-              if (rec->next) RLU_ASSIGN_PTR(self, &(rec->next->prev), rec->prev);
-              RLU_ASSIGN_PTR(self, &(rec->prev), head->prev);
-              rec->next = NULL;
-              RLU_ASSIGN_PTR(self, &(RLU_head->prev->next), rec);
-              RLU_ASSIGN_PTR(self, &(slot->last), rec);
+            kcmp = compare_keys(kbuf, ksiz, (char*)rec + sizeof(*rec), rec->ksiz & KSIZMAX);
+            if (kcmp == 0 && !after) {
+              cand = rec;
+              break;
             }
-#endif
-            //if (adj) adjust_slot_capacity(slot);
           }
-          return;
         }
+        if (kcmp < 0) {
+          cand = rec;
+          rec = (Record*)RLU_DEREF(self, rec->left);
+        } else {
+          rec = (Record*)RLU_DEREF(self, rec->right);
+        }
+      }
+      if (cand) {
+        *bidxp = bidx;
+        return cand;
       }
+      kbuf = NULL;
     }
-    size_t vsiz;
-    const char* vbuf = visitor->visit_empty(kbuf, ksiz, &vsiz);
-    if (vbuf != Visitor::NOP && vbuf != Visitor::REMOVE) {
-      char* zbuf = NULL;
-      size_t zsiz = 0;
-      if (comp) {
-        zbuf = comp->compress(vbuf, vsiz, &zsiz);
-        if (zbuf) {
-          vbuf = zbuf;
-          vsiz = zsiz;
+    return NULL;
+  }
+  /**
+   * Append a record to the order of scanning.
+   * @param slot the slot of the record.
+   * @param rec the actual record, whose key is read by cursors.
+   * @param cur the version of the record into which the order stamp is stored.
+   * @note The stamp is taken under the order lock, so the order is that of appending.
+   */
+  void insert_order(Slot* slot, Record* rec, Record* cur) {
+    _assert_(slot && rec && cur);
+    ScopedSpinLock lock(&slot->olock);
+    cur->order = __sync_add_and_fetch(&slot->tick, 1);
+    slot->order[cur->order] = rec;
+  }
+  /**
+   * Remove a record from the order of scanning.
+   * @param slot the slot of the record.
+   * @param order the order stamp of the record.
+   * @note The record must be removed before it is freed, as cursors read its key.
+   */
+  void remove_order(Slot* slot, uint64_t order) {
+    _assert_(slot);
+    ScopedSpinLock lock(&slot->olock);
+    slot->order.erase(order);
+  }
+  /**
+   * Lock a record for an update unless it is already locked by the update.
+   * @param self the RLU context of the section.
+   * @param locks the records locked by the update.
+   * @param rec the record.
+   * @return the writable copy of the record, or NULL if it is locked by another thread.
+   * @note The copy covers the key and the value, whose region never grows in place.
+   */
+  Record* lock_record(rlu_thread_data_t* self, LockSet* locks, Record* rec) {
+    _assert_(self && locks && rec);
+    for (size_t i = 0; i < locks->num; i++) {
+      if (RLU_IS_SAME_PTRS(locks->recs[i], rec)) return locks->recs[i];
+    }
+    _assert_(locks->num < LOCKSETMAX);
+    Record* cur = (Record*)RLU_DEREF(self, rec);
+    size_t size = sizeof(*cur) + (cur->ksiz & KSIZMAX) + cur->vsiz;
+#if defined(MVRLU)
+    if (!_mvrlu_try_lock(self, (void**)&rec, size)) return NULL;
+#else
+    if (!rlu_try_lock(self, (intptr_t**)&rec, size)) return NULL;
+#endif
+    locks->recs[locks->num++] = rec;
+    return rec;
+  }
+  /**
+   * Pick a record to delete from a slot table over the capacity.
+   * @param self the RLU context of the section.
+   * @param slot the slot table.
+   * @return the newest version of the record with the oldest access stamp among the sampled
+   * ones, or NULL if the slot has no record.
+   * @note The LRU order is approximated by searching the trees of the buckets following the ones
+   * sampled last, up to EVICTSAMPLE trees or EVICTSCAN buckets once a record is found.
+   */
+  Record* sample_victim(rlu_thread_data_t* self, Slot* slot) {
+    _assert_(self && slot);
+    size_t bnum = slot->bnum;
+    size_t bidx = slot->ebidx % bnum;
+    size_t snum = 0;
+    Record* victim = NULL;
+    uint64_t vstamp = 0;
+    std::vector<Record*> stack;
+    for (size_t i = 0; i < bnum && snum < EVICTSAMPLE && (!victim || i < EVICTSCAN); i++) {
+      Record* head = slot->buckets[bidx];
+      bidx = (bidx + 1) % bnum;
+      // an empty tree is skipped by the actual head, as the sample needs not be exact
+      if (!head || !head->left) continue;
+      Record* root = ((Record*)RLU_DEREF(self, head))->left;
+      if (!root) continue;
+      snum++;
+      stack.push_back(root);
+      while (!stack.empty()) {
+        Record* arec = stack.back();
+        stack.pop_back();
+        Record* rec = (Record*)RLU_DEREF(self, arec);
+        // readers stamp the actual record and writers stamp their copy
+        uint64_t stamp = arec->stamp > rec->stamp ? arec->stamp : rec->stamp;
+        if (!victim || stamp < vstamp) {
+          victim = rec;
+          vstamp = stamp;
         }
+        if (rec->left) stack.push_back(rec->left);
+        if (rec->right) stack.push_back(rec->right);
       }
-      if (tran_) {
-        TranLog log(kbuf, ksiz);
-        slot->trlogs.push_back(log);
-      }
-      slot->size += sizeof(Record);
-      _assert_(ksiz + vsiz < 1024);
-      rec = (Record*)RLU_ALLOC(sizeof(*rec));
-      char* dbuf = (char*) rec->dbuf;
-      std::memcpy(dbuf, kbuf, ksiz);
-      rec->ksiz = ksiz | fhash;
-      std::memcpy(dbuf + ksiz, vbuf, vsiz);
-      rec->vsiz = vsiz;
-      rec->left = NULL;
-      rec->right = NULL;
-      rec->prev = slot->last;
-      rec->next = NULL;
-      assert(prev != NULL);
-      if(!RLU_TRY_LOCK(self, &(prev)))
-	      printf("prev try lock failed\n");
-      if(direction == 0)
-              RLU_ASSIGN_PTR(self, &(prev->left), rec);
-      else
-              RLU_ASSIGN_PTR(self, &(prev->right), rec);
-      if (!slot->first) slot->first = rec;
-      //TODO make this try lock
-      if (slot->last){
-              Record* last = slot->last;
-              RLU_TRY_LOCK(self, &last);
-              last->next = rec;
+    }
+    slot->ebidx = bidx;
+    return victim;
+  }
+  /**
+   * Collect the actual records of the trees of a slot table.
+   * @param ctx the RLU context of the section to read the newest versions, or NULL to read the
+   * actual records.
+   * @param slot the slot table.
+   * @param recs the vector into which the records are pushed.
+   * @note With transaction, the records are logged as well.  The bucket heads are not collected.
+   */
+  void collect_slot_records(rlu_thread_data_t* ctx, Slot* slot, std::vector<Record*>* recs) {
+    _assert_(slot && recs);
+    Record** buckets = slot->buckets;
+    size_t bnum = slot->bnum;
+    std::vector<Record*> stack;
+    for (size_t i = 0; i < bnum; i++) {
+      if (!buckets[i]) continue;
+      Record* head = ctx ? (Record*)RLU_DEREF(ctx, buckets[i]) : buckets[i];
+      if (head->left) stack.push_back(head->left);
+      while (!stack.empty()) {
+        Record* rec = stack.back();
+        stack.pop_back();
+        Record* cur = ctx ? (Record*)RLU_DEREF(ctx, rec) : rec;
+        if (tran_) {
+          uint32_t rksiz = cur->ksiz & KSIZMAX;
+          char* dbuf = (char*)cur + sizeof(*cur);
+          TranLog log(dbuf, rksiz, dbuf + rksiz, cur->vsiz);
+          slot->trlogs.push_back(log);
+        }
+        recs->push_back(rec);
+        if (cur->left) stack.push_back(cur->left);
+        if (cur->right) stack.push_back(cur->right);
       }
-      slot->last = rec;
-      slot->count++;
-      //if (!tran_) adjust_slot_capacity(slot);
-      delete[] zbuf;
     }
   }
+
 #else
   void accept_impl(Slot* slot, uint64_t hash, const char* kbuf, size_t ksiz, Visitor* visitor,
                    Compressor* comp, bool rtt) {
@@ -2119,8 +2801,13 @@ class CacheDB : public BasicDB {
     slot->bnum = bnum;
     slot->capcnt = capcnt;
     slot->capsiz = capsiz;
+#if defined(RLU) || defined(MVRLU)
+    slot->tick = 0;
+    slot->ebidx = 0;
+#else
     slot->first = NULL;
     slot->last = NULL;
+#endif
     slot->count = 0;
     slot->size = 0;
   }
@@ -2131,12 +2818,28 @@ class CacheDB : public BasicDB {
   void destroy_slot(Slot* slot) {
     _assert_(slot);
     slot->trlogs.clear();
+#if defined(RLU) || defined(MVRLU)
+    slot->order.clear();
+#endif
+#if defined(MVRLU)
+    release_slot(slot);
+#elif defined(RLU)
+    std::vector<Record*> recs;
+    collect_slot_records(NULL, slot, &recs);
+    for (size_t i = 0; i < recs.size(); i++) {
+      RLU_FREE(NULL, recs[i]);
+    }
+    for (size_t i = 0; i < slot->bnum; i++) {
+      RLU_FREE(NULL, slot->buckets[i]);
+    }
+#else
     Record* rec = slot->last;
     while (rec) {
       Record* prev = rec->prev;
       xfree(rec);
       rec = prev;
     }
+#endif
     if (slot->bnum >= ZMAPBNUM) {
       mapfree(slot->buckets);
     } else {
@@ -2149,6 +2852,26 @@ class CacheDB : public BasicDB {
    */
   void clear_slot(Slot* slot) {
     _assert_(slot);
+#if defined(RLU) || defined(MVRLU)
+    slot->olock.lock();
+    slot->order.clear();
+    slot->olock.unlock();
+#endif
+#if defined(MVRLU)
+    release_slot(slot);
+#elif defined(RLU)
+    std::vector<Record*> recs;
+    collect_slot_records(NULL, slot, &recs);
+    for (size_t i = 0; i < recs.size(); i++) {
+      RLU_FREE(NULL, recs[i]);
+    }
+    Record** buckets = slot->buckets;
+    size_t bnum = slot->bnum;
+    for (size_t i = 0; i < bnum; i++) {
+      RLU_FREE(NULL, buckets[i]);
+      buckets[i] = NULL;
+    }
+#else
     Record* rec = slot->last;
     while (rec) {
       if (tran_) {
@@ -2168,9 +2891,76 @@ class CacheDB : public BasicDB {
     }
     slot->first = NULL;
     slot->last = NULL;
+#endif
     slot->count = 0;
     slot->size = 0;
   }
+#if defined(MVRLU)
+  /**
+   * Unlink and free all records and bucket heads of a slot table.
+   * @param slot the slot table.
+   * @note The trees are walked through the newest versions and the records are freed in MV-RLU
+   * sections, so that no version left in the log is written back into a freed record.  A
+   * thread without its own MV-RLU context borrows a temporary one.
+   */
+  void release_slot(Slot* slot) {
+    _assert_(slot);
+    rlu_thread_data_t* tmp = NULL;
+    if (!self) {
+      tmp = (rlu_thread_data_t*)RLU_THREAD_ALLOC();
+      RLU_THREAD_INIT(tmp);
+    }
+    std::vector<Record*> recs;
+    rlu_thread_data_t* ctx = tmp;
+    if (ctx) {
+      RLU_READER_LOCK(ctx);
+    } else {
+      ctx = begin_section();
+    }
+    collect_slot_records(ctx, slot, &recs);
+    if (tmp) {
+      RLU_READER_UNLOCK(ctx);
+    } else {
+      end_section(ctx);
+    }
+    Record** buckets = slot->buckets;
+    size_t bnum = slot->bnum;
+    for (size_t i = 0; i < bnum; i++) {
+      if (buckets[i]) {
+        recs.push_back(buckets[i]);
+        buckets[i] = NULL;
+      }
+    }
+    size_t ridx = 0;
+    while (ridx < recs.size()) {
+      ctx = tmp;
+      if (ctx) {
+        RLU_READER_LOCK(ctx);
+      } else {
+        ctx = begin_section();
+      }
+      // a record committed just now can not be locked until the clock passes its version
+      size_t rend = ridx;
+      while (rend < recs.size() && rend - ridx < RELBATCH) {
+        if (!RLU_TRY_LOCK_CONST(ctx, recs[rend])) break;
+        rend++;
+      }
+      for (size_t i = ridx; i < rend; i++) {
+        RLU_FREE(ctx, recs[i]);
+      }
+      if (tmp) {
+        RLU_READER_UNLOCK(ctx);
+      } else {
+        end_section(ctx);
+      }
+      ridx = rend;
+    }
+    if (tmp) {
+      RLU_THREAD_FINISH(tmp);
+      RLU_THREAD_FREE(tmp);
+    }
+  }
+#endif
   /**
    * Apply transaction logs of a slot table.
    * @param slot the slot table.
@@ -2187,6 +2977,12 @@ class CacheDB : public BasicDB {
       const char* vbuf = it->value.c_str();
       size_t vsiz = it->value.size();
       uint64_t hash = hash_record(kbuf, ksiz) / SLOTNUM;
+#if defined(MVRLU)
+      rlu_thread_data_t* self = begin_section();
+#elif defined(RLU)
+      rlu_thread_data_t* self = get_thread_data();
+      RLU_READER_LOCK(self);
+#endif
       if (it->full) {
         Setter setter(vbuf, vsiz);
         accept_impl(slot, hash, kbuf, ksiz, &setter, NULL, false);
@@ -2194,6 +2990,11 @@ class CacheDB : public BasicDB {
         Remover remover;
         accept_impl(slot, hash, kbuf, ksiz, &remover, NULL, false);
       }
+#if defined(MVRLU)
+      end_section(self);
+#elif defined(RLU)
+      RLU_READER_UNLOCK(self);
+#endif
     }
   }
   /**
@@ -2202,8 +3003,14 @@ class CacheDB : public BasicDB {
    */
   void adjust_slot_capacity(Slot* slot) {
     _assert_(slot);
+#if defined(RLU) || defined(MVRLU)
+    if (slot->count > slot->capcnt || slot->size > slot->capsiz) {
+      Record* rec = sample_victim(get_thread_data(), slot);
+      if (!rec) return;
+#else
     if ((slot->count > slot->capcnt || slot->size > slot->capsiz) && slot->first) {
       Record* rec = slot->first;
+#endif
       uint32_t rksiz = rec->ksiz & KSIZMAX;
       char* dbuf = (char*)rec + sizeof(*rec);
       char stack[RECBUFSIZ];
@@ -2211,6 +3018,7 @@ class CacheDB : public BasicDB {
       std::memcpy(kbuf, dbuf, rksiz);
       uint64_t hash = hash_record(kbuf, rksiz) / SLOTNUM;
       Remover remover;
+      accept_impl(slot, hash, kbuf, rksiz, &remover, NULL, false);
       if (kbuf != stack) delete[] kbuf;
     }
   }
@@ -2248,6 +3056,7 @@ class CacheDB : public BasicDB {
     if (asiz != bsiz) return (int32_t)asiz - (int32_t)bsiz;
     return std::memcmp(abuf, bbuf, asiz);
   }
+#if !defined(RLU) && !defined(MVRLU)
   /**
    * Escape cursors on a shifted or removed records.
    * @param rec the record.
@@ -2281,6 +3090,7 @@ class CacheDB : public BasicDB {
       ++cit;
     }
   }
+#endif
   /**
    * Disable all cursors.
    */
@@ -2292,7 +3102,9 @@ class CacheDB : public BasicDB {
     while (cit != citend) {
       Cursor* cur = *cit;
       cur->sidx_ = -1;
+#if !defined(RLU) && !defined(MVRLU)
       cur->rec_ = NULL;
+#endif
       ++cit;
     }
   }
@@ -46,6 +46,10 @@ namespace kyotocabinet {                 // common namespace
  * BasicDB::close method when the database is no longer in use.  It is forbidden for multible
  * database objects in a process to open the same database at the same time.  It is forbidden to
  * share a database object with child processes.
+ * @note In the MV-RLU build, each cached leaf node also keeps a snapshot of its records, of which
+ * a modification replaces only the records it changes, and read-only visits of single records
+ * search the snapshot without locking the node.  Cached nodes are found by hints without locking
+ * their slots, and the order of the cache is settled when a node is flushed.
  */
 template <class BASEDB, uint8_t DBTYPE>
 class PlantDB : public BasicDB {
@@ -60,6 +64,9 @@ class PlantDB : public BasicDB {
   struct InnerNode;
   struct LeafSlot;
   struct InnerSlot;
+#if defined(MVRLU)
+  struct LeafView;
+#endif
   class ScopedVisitor;
   /** An alias of array of records. */
   typedef std::vector<Record*> RecordArray;
@@ -111,6 +118,10 @@ class PlantDB : public BasicDB {
   static const int32_t ATRANCNUM = 256;
   /** The threshold of busy loop and sleep for locking. */
   static const uint32_t LOCKBUSYLOOP = 8192;
+#if defined(MVRLU)
+  /** The number of hints of cached nodes in each slot. */
+  static const int32_t HINTNUM = 256;
+#endif
  public:
   /**
    * Cursor to indicate a record.
@@ -544,6 +555,9 @@ class PlantDB : public BasicDB {
                     step = false;
                   }
                 }
+#if defined(MVRLU)
+                db_->update_leaf_view(node, rit - recs.begin(), VOREMOVE);
+#endif
                 recs.erase(rit);
               } else if (vbuf != Visitor::NOP) {
                 int64_t diff = (int64_t)vsiz - (int64_t)rec->vsiz;
@@ -557,6 +571,9 @@ class PlantDB : public BasicDB {
                 }
                 std::memcpy(kbuf + rec->ksiz, vbuf, vsiz);
                 rec->vsiz = vsiz;
+#if defined(MVRLU)
+                db_->update_leaf_view(node, rit - recs.begin(), VOREPLACE);
+#endif
                 if (node->size > db_->psiz_ && recs.size() > 1) {
                   lsiz = sizeof(Link) + ksiz;
                   lbuf = lsiz > sizeof(lstack) ? new char[lsiz] : lstack;
@@ -733,6 +750,9 @@ class PlantDB : public BasicDB {
               set_position(*ritnext, node->id);
             }
           }
+#if defined(MVRLU)
+          db_->update_leaf_view(node, rit - recs.begin(), VOREMOVE);
+#endif
           recs.erase(rit);
           if (recs.empty()) reorg = true;
         } else if (vbuf != Visitor::NOP) {
@@ -747,6 +767,9 @@ class PlantDB : public BasicDB {
           }
           std::memcpy(kbuf + rec->ksiz, vbuf, vsiz);
           rec->vsiz = vsiz;
+#if defined(MVRLU)
+          db_->update_leaf_view(node, rit - recs.begin(), VOREPLACE);
+#endif
           if (node->size > db_->psiz_ && recs.size() > 1) reorg = true;
         }
         if (step) {
@@ -1037,7 +1060,9 @@ class PlantDB : public BasicDB {
    * @return true on success, or false on failure.
    * @note The operation for each record is performed atomically and other threads accessing the
    * same record are blocked.  To avoid deadlock, any explicit database operation must not be
-   * performed in this function.
+   * performed in this function.  In the MV-RLU build, a read-only operation of a thread with an
+   * MV-RLU context is not blocked by writers of the leaf node and visits a snapshot of the
+   * record, so the return value of the visitor is ignored.
    */
   bool accept(const char* kbuf, size_t ksiz, Visitor* visitor, bool writable = true) {
     _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
@@ -1080,6 +1105,22 @@ class PlantDB : public BasicDB {
     rec->ksiz = ksiz;
     rec->vsiz = 0;
     std::memcpy(rbuf + sizeof(*rec), kbuf, ksiz);
+#if defined(MVRLU)
+    bool locked = writable || !self;
+    if (!locked) {
+      rlu_thread_data_t* ctx = begin_section();
+      read_leaf_view(node, rec, visitor);
+      end_section(ctx);
+    } else if (writable) {
+      node->lock.lock_writer();
+    } else {
+      node->lock.lock_reader();
+    }
+    bool reorg = locked ? accept_impl(node, rec, visitor) : false;
+    bool atran = autotran_ && !tran_ && node->dirty;
+    bool async = autosync_ && !autotran_ && !tran_ && node->dirty;
+    if (locked) node->lock.unlock();
+#else
     if (writable) {
       node->lock.lock_writer();
     } else {
@@ -1089,6 +1130,7 @@ class PlantDB : public BasicDB {
     bool atran = autotran_ && !tran_ && node->dirty;
     bool async = autosync_ && !autotran_ && !tran_ && node->dirty;
     node->lock.unlock();
+#endif
     bool flush = false;
     bool err = false;
     int64_t id = node->id;
@@ -1490,6 +1532,9 @@ class PlantDB : public BasicDB {
    */
   bool open(const std::string& path, uint32_t mode = OWRITER | OCREATE) {
     _assert_(true);
+#if defined(MVRLU)
+    mvrlu_init();
+#endif
     ScopedRWLock lock(&mlock_, true);
     if (omode_ != 0) {
       set_error(_KCCODELINE_, Error::INVALID, "already opened");
@@ -2323,7 +2368,31 @@ class PlantDB : public BasicDB {
     bool hot;                            ///< whether in the hot cache
     bool dirty;                          ///< whether to be written back
     bool dead;                           ///< whether to be removed
+#if defined(MVRLU)
+    LeafView* view;                      ///< snapshot of the records for lock-free readers
+    bool touched;                        ///< whether accessed since the cache order was settled
+#endif
+  };
+#if defined(MVRLU)
+  /**
+   * Snapshot of the records of a leaf node.
+   * @note This is an MV-RLU object, and each record in it is an MV-RLU object which is never
+   * modified.
+   */
+  struct LeafView {
+    uint32_t rnum;                       ///< number of records
+    uint32_t cap;                        ///< capacity of the record array
+    Record* recs[1];                     ///< sorted array of records
+  };
+  /**
+   * Modification of a snapshot.
+   */
+  enum ViewOperation {
+    VOINSERT,                            ///< insert a record
+    VOREPLACE,                           ///< replace a record
+    VOREMOVE                             ///< remove a record
   };
+#endif
   /**
    * Link to a node.
    */
@@ -2359,6 +2428,9 @@ class PlantDB : public BasicDB {
     int64_t size;                        ///< total size of links
     bool dirty;                          ///< whether to be written back
     bool dead;                           ///< whether to be removed
+#if defined(MVRLU)
+    bool touched;                        ///< whether accessed since the cache order was settled
+#endif
   };
   /**
    * Slot cache of leaf nodes.
@@ -2367,6 +2439,9 @@ class PlantDB : public BasicDB {
     Mutex lock;                          ///< lock
     LeafCache* hot;                      ///< hot cache
     LeafCache* warm;                     ///< warm cache
+#if defined(MVRLU)
+    LeafNode* hints[HINTNUM];            ///< cached nodes found without the lock
+#endif
   };
   /**
    * Slot cache of inner nodes.
@@ -2374,6 +2449,9 @@ class PlantDB : public BasicDB {
   struct InnerSlot {
     Mutex lock;                          ///< lock
     InnerCache* warm;                    ///< warm cache
+#if defined(MVRLU)
+    InnerNode* hints[HINTNUM];           ///< cached nodes found without the lock
+#endif
   };
   /**
    * Scoped visitor.
@@ -2404,6 +2482,9 @@ class PlantDB : public BasicDB {
     for (int32_t i = 0; i < SLOTNUM; i++) {
       lslots_[i].hot = new LeafCache(bnum);
       lslots_[i].warm = new LeafCache(bnum);
+#if defined(MVRLU)
+      std::memset(lslots_[i].hints, 0, sizeof(lslots_[i].hints));
+#endif
     }
   }
   /**
@@ -2453,10 +2534,18 @@ class PlantDB : public BasicDB {
     _assert_(slot);
     bool err = false;
     if (slot->warm->count() > 0) {
+#if defined(MVRLU)
+      LeafNode* node = first_leaf_node(slot->warm);
+#else
       LeafNode* node = slot->warm->first_value();
+#endif
       if (!flush_leaf_node(node, true)) err = true;
     } else if (slot->hot->count() > 0) {
+#if defined(MVRLU)
+      LeafNode* node = first_leaf_node(slot->hot);
+#else
       LeafNode* node = slot->hot->first_value();
+#endif
       if (!flush_leaf_node(node, true)) err = true;
     }
     return !err;
@@ -2498,14 +2587,40 @@ class PlantDB : public BasicDB {
     bool err = false;
     ScopedMutex lock(&slot->lock);
     if (slot->warm->count() > 0) {
+#if defined(MVRLU)
+      LeafNode* node = first_leaf_node(slot->warm);
+#else
       LeafNode* node = slot->warm->first_value();
+#endif
       if (!save_leaf_node(node)) err = true;
     } else if (slot->hot->count() > 0) {
+#if defined(MVRLU)
+      LeafNode* node = first_leaf_node(slot->hot);
+#else
       LeafNode* node = slot->hot->first_value();
+#endif
       if (!save_leaf_node(node)) err = true;
     }
     return !err;
   }
+#if defined(MVRLU)
+  /**
+   * Get the node to be flushed first from a leaf cache.
+   * @param cache the leaf cache, which must not be empty.
+   * @return the first node which has not been accessed since the order of the cache was settled.
+   * @note The nodes accessed without the lock of the slot are moved to the last on the way.
+   */
+  LeafNode* first_leaf_node(LeafCache* cache) {
+    _assert_(cache && cache->count() > 0);
+    LeafNode* node = cache->first_value();
+    for (int64_t i = cache->count(); i > 1 && node->touched; i--) {
+      node->touched = false;
+      cache->get(node->id, LeafCache::MLAST);
+      node = cache->first_value();
+    }
+    return node;
+  }
+#endif
   /**
    * Create a new leaf node.
    * @param prev the ID of the previous node.
@@ -2523,6 +2638,10 @@ class PlantDB : public BasicDB {
     node->hot = false;
     node->dirty = true;
     node->dead = false;
+#if defined(MVRLU)
+    node->view = build_leaf_view(node);
+    node->touched = false;
+#endif
     int32_t sidx = node->id % SLOTNUM;
     LeafSlot* slot = lslots_ + sidx;
     slot->warm->set(node->id, node, LeafCache::MLAST);
@@ -2546,8 +2665,16 @@ class PlantDB : public BasicDB {
       xfree(rec);
       ++rit;
     }
+#if defined(MVRLU)
+    free_leaf_view(node->view);
+#endif
     int32_t sidx = node->id % SLOTNUM;
     LeafSlot* slot = lslots_ + sidx;
+#if defined(MVRLU)
+    // the whole database is locked exclusively, so no reader sees the hint any longer
+    LeafNode** hint = slot->hints + (node->id / SLOTNUM) % HINTNUM;
+    if (*hint == node) *hint = NULL;
+#endif
     if (node->hot) {
       slot->hot->remove(node->id);
     } else {
@@ -2600,9 +2727,32 @@ class PlantDB : public BasicDB {
    * @param id the ID number of the leaf node.
    * @param prom whether to promote the warm cache.
    * @return the loaded leaf node.
+   * @note In the MV-RLU build, a node in the hints of its slot is returned without locking the
+   * slot, and the access moves it to the last when the order of the cache is settled.
    */
   LeafNode* load_leaf_node(int64_t id, bool prom) {
     _assert_(id > 0);
+#if defined(MVRLU)
+    // a node is flushed only with the whole database locked exclusively, so a hint is valid
+    LeafNode** hint = lslots_[id % SLOTNUM].hints + (id / SLOTNUM) % HINTNUM;
+    LeafNode* node = *(LeafNode* volatile*)hint;
+    if (node && node->id == id && (node->hot || !prom)) {
+      if (!node->touched) node->touched = true;
+      return node;
+    }
+    node = fetch_leaf_node(id, prom);
+    if (node) *hint = node;
+    return node;
+  }
+  /**
+   * Load a leaf node with the lock of its slot.
+   * @param id the ID number of the leaf node.
+   * @param prom whether to promote the warm cache.
+   * @return the loaded leaf node.
+   */
+  LeafNode* fetch_leaf_node(int64_t id, bool prom) {
+    _assert_(id > 0);
+#endif
     int32_t sidx = id % SLOTNUM;
     LeafSlot* slot = lslots_ + sidx;
     ScopedMutex lock(&slot->lock);
@@ -2610,8 +2760,14 @@ class PlantDB : public BasicDB {
     if (np) return *np;
     if (prom) {
       if (slot->hot->count() * WARMRATIO > slot->warm->count() + WARMRATIO) {
+#if defined(MVRLU)
+        LeafNode* cold = first_leaf_node(slot->hot);
+        cold->hot = false;
+        slot->hot->migrate(cold->id, slot->warm, LeafCache::MLAST);
+#else
         slot->hot->first_value()->hot = false;
         slot->hot->migrate(slot->hot->first_key(), slot->warm, LeafCache::MLAST);
+#endif
       }
       np = slot->warm->migrate(id, slot->hot, LeafCache::MLAST);
       if (np) {
@@ -2696,6 +2852,10 @@ class PlantDB : public BasicDB {
     node->hot = false;
     node->dirty = false;
     node->dead = false;
+#if defined(MVRLU)
+    node->view = build_leaf_view(node);
+    node->touched = false;
+#endif
     slot->warm->set(id, node, LeafCache::MLAST);
     cusage_ += node->size;
     return node;
@@ -2740,6 +2900,9 @@ class PlantDB : public BasicDB {
         node->size -= rsiz;
         node->dirty = true;
         xfree(rec);
+#if defined(MVRLU)
+        update_leaf_view(node, rit - recs.begin(), VOREMOVE);
+#endif
         recs.erase(rit);
         if (recs.empty()) reorg = true;
       } else if (vbuf != Visitor::NOP) {
@@ -2754,6 +2917,9 @@ class PlantDB : public BasicDB {
         }
         std::memcpy(kbuf + rec->ksiz, vbuf, vsiz);
         rec->vsiz = vsiz;
+#if defined(MVRLU)
+        update_leaf_view(node, rit - recs.begin(), VOREPLACE);
+#endif
         if (node->size > psiz_ && recs.size() > 1) reorg = true;
       }
     } else {
@@ -2773,12 +2939,215 @@ class PlantDB : public BasicDB {
         char* dbuf = (char*)rec + sizeof(*rec);
         std::memcpy(dbuf, kbuf, ksiz);
         std::memcpy(dbuf + ksiz, vbuf, vsiz);
+#if defined(MVRLU)
+        size_t ridx = rit - recs.begin();
+        recs.insert(rit, rec);
+        update_leaf_view(node, ridx, VOINSERT);
+#else
         recs.insert(rit, rec);
+#endif
         if (node->size > psiz_ && recs.size() > 1) reorg = true;
       }
     }
     return reorg;
   }
+#if defined(MVRLU)
+  /**
+   * Build the snapshot of the records of a leaf node.
+   * @param node the leaf node.
+   * @return the snapshot, which has room for a quarter more records.
+   */
+  LeafView* build_leaf_view(LeafNode* node) {
+    _assert_(node);
+    RecordArray& recs = node->recs;
+    size_t rnum = recs.size();
+    LeafView* view = alloc_leaf_view(rnum + rnum / 4 + 1);
+    for (size_t i = 0; i < rnum; i++) {
+      view->recs[i] = copy_view_record(recs[i]);
+    }
+    view->rnum = rnum;
+    return view;
+  }
+  /**
+   * Allocate an empty snapshot.
+   * @param cap the capacity of the record array.
+   * @return the snapshot.
+   */
+  LeafView* alloc_leaf_view(size_t cap) {
+    _assert_(cap > 0);
+    LeafView* view = (LeafView*)RLU_ALLOC(sizeof(*view) + sizeof(Record*) * (cap - 1));
+    view->rnum = 0;
+    view->cap = cap;
+    return view;
+  }
+  /**
+   * Copy a snapshot into a new one with twice the capacity.
+   * @param view the snapshot.
+   * @return the new snapshot.
+   */
+  LeafView* grow_leaf_view(LeafView* view) {
+    _assert_(view);
+    LeafView* nview = alloc_leaf_view(view->cap * 2);
+    std::memcpy(nview->recs, view->recs, sizeof(Record*) * view->rnum);
+    nview->rnum = view->rnum;
+    return nview;
+  }
+  /**
+   * Copy a record for a snapshot.
+   * @param rec the record.
+   * @return the copy, which is an MV-RLU object.
+   */
+  Record* copy_view_record(Record* rec) {
+    _assert_(rec);
+    size_t rsiz = sizeof(*rec) + rec->ksiz + rec->vsiz;
+    Record* vrec = (Record*)RLU_ALLOC(rsiz);
+    std::memcpy(vrec, rec, rsiz);
+    return vrec;
+  }
+  /**
+   * Replace the snapshot of a leaf node with one built from all of its records.
+   * @param node the leaf node.
+   * @note The whole database must be locked exclusively.
+   */
+  void publish_leaf_view(LeafNode* node) {
+    _assert_(node);
+    LeafView* oview = node->view;
+    RLU_ASSIGN_PTR(self, &node->view, build_leaf_view(node));
+    free_leaf_view(oview);
+  }
+  /**
+   * Free a snapshot and its records.
+   * @param view the snapshot.
+   * @note The whole database must be locked exclusively, so no reader sees the snapshot any
+   * longer.  The records are never locked, so they are freed at once.  A thread without an
+   * MV-RLU context frees the snapshot at once too, which is safe only if it is the only thread.
+   */
+  void free_leaf_view(LeafView* view) {
+    _assert_(view);
+    if (!self) {
+      for (uint32_t i = 0; i < view->rnum; i++) {
+        RLU_FREE(NULL, view->recs[i]);
+      }
+      RLU_FREE(NULL, view);
+      return;
+    }
+    // the snapshot may have copies in the logs, so it is freed with them
+    rlu_thread_data_t* ctx = begin_section();
+    while (!RLU_TRY_LOCK_CONST(ctx, view)) {
+      RLU_ABORT(ctx);
+      RLU_READER_LOCK(ctx);
+    }
+    LeafView* cview = (LeafView*)RLU_DEREF(ctx, view);
+    for (uint32_t i = 0; i < cview->rnum; i++) {
+      RLU_FREE(NULL, cview->recs[i]);
+    }
+    RLU_FREE(ctx, view);
+    end_section(ctx);
+  }
+  /**
+   * Apply the modification of a record to the snapshot of a leaf node.
+   * @param node the leaf node, which must be locked for writing.
+   * @param idx the index of the record in the records of the node.
+   * @param op VOINSERT for a record inserted at the index, VOREPLACE for a record modified at
+   * the index, or VOREMOVE for a record removed from the index.
+   * @note Only the modified record and the record array are copied.  The old record is freed
+   * after the readers seeing it finish.  A thread without an MV-RLU context modifies the snapshot
+   * in place, which is safe only if it is the only thread.
+   */
+  void update_leaf_view(LeafNode* node, size_t idx, ViewOperation op) {
+    _assert_(node);
+    Record* nrec = op == VOREMOVE ? NULL : copy_view_record(node->recs[idx]);
+    if (!self) {
+      LeafView* view = node->view;
+      if (op == VOINSERT && view->rnum >= view->cap) {
+        node->view = grow_leaf_view(view);
+        RLU_FREE(NULL, view);
+        view = node->view;
+      }
+      RLU_FREE(NULL, splice_leaf_view(view, idx, op, nrec));
+      return;
+    }
+    rlu_thread_data_t* ctx = begin_section();
+    LeafView* view;
+    Record* orec;
+    while (true) {
+      view = node->view;
+      if (mvrlu_try_lock_full(ctx, &view)) {
+        orec = op == VOINSERT ? NULL : view->recs[idx];
+        if (!orec || RLU_TRY_LOCK_CONST(ctx, orec)) break;
+      }
+      RLU_ABORT(ctx);
+      RLU_READER_LOCK(ctx);
+    }
+    if (op == VOINSERT && view->rnum >= view->cap) {
+      // the new snapshot is seen before the commit, so it is completed first
+      LeafView* nview = grow_leaf_view(view);
+      splice_leaf_view(nview, idx, op, nrec);
+      RLU_FREE(ctx, view);
+      RLU_ASSIGN_PTR(ctx, &node->view, nview);
+    } else {
+      splice_leaf_view(view, idx, op, nrec);
+    }
+    if (orec) RLU_FREE(ctx, orec);
+    end_section(ctx);
+  }
+  /**
+   * Apply the modification of a record to the record array of a snapshot.
+   * @param view the snapshot.
+   * @param idx the index of the record.
+   * @param op the operation.
+   * @param rec the new record, or NULL for VOREMOVE.
+   * @return the record taken out of the snapshot, or NULL for VOINSERT.
+   */
+  Record* splice_leaf_view(LeafView* view, size_t idx, ViewOperation op, Record* rec) {
+    _assert_(view);
+    Record** recs = view->recs;
+    Record* orec = NULL;
+    switch (op) {
+      case VOINSERT: {
+        std::memmove(recs + idx + 1, recs + idx, sizeof(*recs) * (view->rnum - idx));
+        recs[idx] = rec;
+        view->rnum++;
+        break;
+      }
+      case VOREPLACE: {
+        orec = recs[idx];
+        recs[idx] = rec;
+        break;
+      }
+      case VOREMOVE: {
+        orec = recs[idx];
+        std::memmove(recs + idx, recs + idx + 1, sizeof(*recs) * (view->rnum - idx - 1));
+        view->rnum--;
+        break;
+      }
+    }
+    return orec;
+  }
+  /**
+   * Accept a read-only visitor at the snapshot of a leaf node.
+   * @param node the leaf node.
+   * @param rec the record containing the key only.
+   * @param visitor a visitor object.
+   * @note This must be called in an MV-RLU section.  The return value of the visitor is
+   * ignored.
+   */
+  void read_leaf_view(LeafNode* node, Record* rec, Visitor* visitor) {
+    _assert_(node && rec && visitor);
+    LeafView* view = (LeafView*)RLU_DEREF(get_thread_data(), node->view);
+    Record** rpend = view->recs + view->rnum;
+    Record** rp = std::lower_bound(view->recs, rpend, rec, reccomp_);
+    size_t vsiz;
+    if (rp != rpend && !reccomp_(rec, *rp)) {
+      Record* vrec = *rp;
+      char* kbuf = (char*)vrec + sizeof(*vrec);
+      visitor->visit_full(kbuf, vrec->ksiz, kbuf + vrec->ksiz, vrec->vsiz, &vsiz);
+    } else {
+      const char* kbuf = (char*)rec + sizeof(*rec);
+      visitor->visit_empty(kbuf, rec->ksiz, &vsiz);
+    }
+  }
+#endif
   /**
    * Devide a leaf node into two.
    * @param node the leaf node.
@@ -2814,6 +3183,10 @@ class PlantDB : public BasicDB {
     }
     escape_cursors(node->id, node->next, *mid);
     recs.erase(mid, ritend);
+#if defined(MVRLU)
+    publish_leaf_view(node);
+    publish_leaf_view(newnode);
+#endif
     return newnode;
   }
   /**
@@ -2826,6 +3199,9 @@ class PlantDB : public BasicDB {
     bnum = nearbyprime(bnum);
     for (int32_t i = 0; i < SLOTNUM; i++) {
       islots_[i].warm = new InnerCache(bnum);
+#if defined(MVRLU)
+      std::memset(islots_[i].hints, 0, sizeof(islots_[i].hints));
+#endif
     }
   }
   /**
@@ -2867,11 +3243,33 @@ class PlantDB : public BasicDB {
     _assert_(slot);
     bool err = false;
     if (slot->warm->count() > 0) {
+#if defined(MVRLU)
+      InnerNode* node = first_inner_node(slot->warm);
+#else
       InnerNode* node = slot->warm->first_value();
+#endif
       if (!flush_inner_node(node, true)) err = true;
     }
     return !err;
   }
+#if defined(MVRLU)
+  /**
+   * Get the node to be flushed first from an inner cache.
+   * @param cache the inner cache, which must not be empty.
+   * @return the first node which has not been accessed since the order of the cache was settled.
+   * @note The nodes accessed without the lock of the slot are moved to the last on the way.
+   */
+  InnerNode* first_inner_node(InnerCache* cache) {
+    _assert_(cache && cache->count() > 0);
+    InnerNode* node = cache->first_value();
+    for (int64_t i = cache->count(); i > 1 && node->touched; i--) {
+      node->touched = false;
+      cache->get(node->id, InnerCache::MLAST);
+      node = cache->first_value();
+    }
+    return node;
+  }
+#endif
   /**
    * Clean all of the inner cache.
    * @return true on success, or false on failure.
@@ -2906,6 +3304,9 @@ class PlantDB : public BasicDB {
     node->size = sizeof(int64_t);
     node->dirty = true;
     node->dead = false;
+#if defined(MVRLU)
+    node->touched = false;
+#endif
     int32_t sidx = node->id % SLOTNUM;
     InnerSlot* slot = islots_ + sidx;
     slot->warm->set(node->id, node, InnerCache::MLAST);
@@ -2931,6 +3332,11 @@ class PlantDB : public BasicDB {
     }
     int32_t sidx = node->id % SLOTNUM;
     InnerSlot* slot = islots_ + sidx;
+#if defined(MVRLU)
+    // the whole database is locked exclusively, so no reader sees the hint any longer
+    InnerNode** hint = slot->hints + (node->id / SLOTNUM) % HINTNUM;
+    if (*hint == node) *hint = NULL;
+#endif
     slot->warm->remove(node->id);
     cusage_ -= node->size;
     delete node;
@@ -2974,9 +3380,31 @@ class PlantDB : public BasicDB {
    * Load an inner node.
    * @param id the ID number of the inner node.
    * @return the loaded inner node.
+   * @note In the MV-RLU build, a node in the hints of its slot is returned without locking the
+   * slot, and the access moves it to the last when the order of the cache is settled.
    */
   InnerNode* load_inner_node(int64_t id) {
     _assert_(id > 0);
+#if defined(MVRLU)
+    // a node is flushed only with the whole database locked exclusively, so a hint is valid
+    InnerNode** hint = islots_[id % SLOTNUM].hints + (id / SLOTNUM) % HINTNUM;
+    InnerNode* node = *(InnerNode* volatile*)hint;
+    if (node && node->id == id) {
+      if (!node->touched) node->touched = true;
+      return node;
+    }
+    node = fetch_inner_node(id);
+    if (node) *hint = node;
+    return node;
+  }
+  /**
+   * Load an inner node with the lock of its slot.
+   * @param id the ID number of the inner node.
+   * @return the loaded inner node.
+   */
+  InnerNode* fetch_inner_node(int64_t id) {
+    _assert_(id > 0);
+#endif
     int32_t sidx = id % SLOTNUM;
     InnerSlot* slot = islots_ + sidx;
     ScopedMutex lock(&slot->lock);
@@ -3045,6 +3473,9 @@ class PlantDB : public BasicDB {
     node->id = id;
     node->dirty = false;
     node->dead = false;
+#if defined(MVRLU)
+    node->touched = false;
+#endif
     slot->warm->set(id, node, InnerCache::MLAST);
     cusage_ += node->size;
     return node;
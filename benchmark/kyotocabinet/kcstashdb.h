@@ -39,6 +39,10 @@ namespace kyotocabinet {                 // common namespace
  * database file by the StashDB::close method when the database is no longer in use.  It is
  * forbidden for multible database objects in a process to open the same database at the same
  * time.  It is forbidden to share a database object with child processes.
+ * @note In the MV-RLU build, read-only visits take no lock and see a snapshot of the bucket
+ * chain, and updates copy the records they touch and publish them at the end of an MV-RLU
+ * section.  Every database operation must then be called from a thread started by the Thread
+ * class, which owns the MV-RLU context of the thread.
  */
 class StashDB : public BasicDB {
  public:
@@ -64,6 +68,10 @@ class StashDB : public BasicDB {
   static const uint32_t LOCKBUSYLOOP = 8192;
   /** The mininum number of buckets to use mmap. */
   static const size_t MAPZMAPBNUM = 32768;
+#if defined(MVRLU)
+  /** The maximum number of records freed in an MV-RLU section. */
+  static const size_t RELBATCH = 256;
+#endif
  public:
   /**
    * Cursor to indicate a record.
@@ -114,7 +122,12 @@ class StashDB : public BasicDB {
         db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
         return false;
       }
+#if defined(MVRLU)
+      rlu_thread_data_t* self = begin_section();
+      Record rec((char*)RLU_DEREF(self, rbuf_));
+#else
       Record rec(rbuf_);
+#endif
       size_t vsiz;
       const char* vbuf = visitor->visit_full(rec.kbuf_, rec.ksiz_, rec.vbuf_, rec.vsiz_, &vsiz);
       if (vbuf == Visitor::REMOVE) {
@@ -127,6 +140,9 @@ class StashDB : public BasicDB {
         db_->accept_impl(rec.kbuf_, rec.ksiz_, &repeater, bidx_);
         if (step && rbuf_) step_impl();
       }
+#if defined(MVRLU)
+      end_section(self);
+#endif
       return true;
     }
     /**
@@ -170,6 +186,20 @@ class StashDB : public BasicDB {
       rbuf_ = NULL;
       size_t bidx = db_->hash_record(kbuf, ksiz) % db_->bnum_;
       char* rbuf = db_->buckets_[bidx];
+#if defined(MVRLU)
+      rlu_thread_data_t* self = begin_section();
+      while (rbuf) {
+        Record rec((char*)RLU_DEREF(self, rbuf));
+        if (rec.ksiz_ == ksiz && !std::memcmp(rec.kbuf_, kbuf, ksiz)) {
+          bidx_ = bidx;
+          rbuf_ = rbuf;
+          end_section(self);
+          return true;
+        }
+        rbuf = rec.child_;
+      }
+      end_section(self);
+#else
       while (rbuf) {
         Record rec(rbuf);
         if (rec.ksiz_ == ksiz && !std::memcmp(rec.kbuf_, kbuf, ksiz)) {
@@ -179,6 +209,7 @@ class StashDB : public BasicDB {
         }
         rbuf = rec.child_;
       }
+#endif
       db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
       return false;
     }
@@ -248,7 +279,13 @@ class StashDB : public BasicDB {
         return false;
       }
       bool err = false;
+#if defined(MVRLU)
+      rlu_thread_data_t* self = begin_section();
       if (!step_impl()) err = true;
+      end_section(self);
+#else
+      if (!step_impl()) err = true;
+#endif
       return !err;
     }
     /**
@@ -277,10 +314,15 @@ class StashDB : public BasicDB {
     /**
      * Step the cursor to the next record.
      * @return true on success, or false on failure.
+     * @note In the MV-RLU build, this must be called in an MV-RLU section.
      */
     bool step_impl() {
       _assert_(true);
+#if defined(MVRLU)
+      Record rec((char*)RLU_DEREF(get_thread_data(), rbuf_));
+#else
       Record rec(rbuf_);
+#endif
       rbuf_ = rec.child_;
       if (!rbuf_) {
         while (++bidx_ < (int64_t)db_->bnum_) {
@@ -343,10 +385,23 @@ class StashDB : public BasicDB {
    * @return true on success, or false on failure.
    * @note The operation for each record is performed atomically and other threads accessing the
    * same record are blocked.  To avoid deadlock, any explicit database operation must not be
-   * performed in this function.
+   * performed in this function.  In the MV-RLU build, read-only operations are never blocked
+   * and visit a snapshot of the record, so the return value of the visitor is ignored.
    */
   bool accept(const char* kbuf, size_t ksiz, Visitor* visitor, bool writable = true) {
     _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+#if defined(MVRLU)
+    if (!writable) {
+      if (omode_ == 0) {
+        set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      rlu_thread_data_t* self = begin_section();
+      read_impl(kbuf, ksiz, visitor, hash_record(kbuf, ksiz) % bnum_);
+      end_section(self);
+      return true;
+    }
+#endif
     ScopedRWLock lock(&mlock_, false);
     if (omode_ == 0) {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
@@ -363,7 +418,13 @@ class StashDB : public BasicDB {
     } else {
       rlock_.lock_reader(lidx);
     }
+#if defined(MVRLU)
+    rlu_thread_data_t* self = begin_section();
+    accept_impl(kbuf, ksiz, visitor, bidx);
+    end_section(self);
+#else
     accept_impl(kbuf, ksiz, visitor, bidx);
+#endif
     rlock_.unlock(lidx);
     return true;
   }
@@ -375,7 +436,8 @@ class StashDB : public BasicDB {
    * @return true on success, or false on failure.
    * @note The operations for specified records are performed atomically and other threads
    * accessing the same records are blocked.  To avoid deadlock, any explicit database operation
-   * must not be performed in this function.
+   * must not be performed in this function.  In the MV-RLU build, each record is visited in its
+   * own MV-RLU section, so lock-free readers may see some of the updates before the others.
    */
   bool accept_bulk(const std::vector<std::string>& keys, Visitor* visitor,
                    bool writable = true) {
@@ -417,10 +479,23 @@ class StashDB : public BasicDB {
       }
       ++lit;
     }
+#if defined(MVRLU)
+    for (size_t i = 0; i < knum; i++) {
+      RecordKey* rkey = rkeys + i;
+      rlu_thread_data_t* self = begin_section();
+      if (writable) {
+        accept_impl(rkey->kbuf, rkey->ksiz, visitor, rkey->bidx);
+      } else {
+        read_impl(rkey->kbuf, rkey->ksiz, visitor, rkey->bidx);
+      }
+      end_section(self);
+    }
+#else
     for (size_t i = 0; i < knum; i++) {
       RecordKey* rkey = rkeys + i;
       accept_impl(rkey->kbuf, rkey->ksiz, visitor, rkey->bidx);
     }
+#endif
     lit = lidxs.begin();
     litend = lidxs.end();
     while (lit != litend) {
@@ -459,9 +534,17 @@ class StashDB : public BasicDB {
     int64_t curcnt = 0;
     for (size_t i = 0; i < bnum_; i++) {
       char* rbuf = buckets_[i];
+#if defined(MVRLU)
+      if (!rbuf) continue;
+      rlu_thread_data_t* self = begin_section();
+#endif
       while (rbuf) {
         curcnt++;
+#if defined(MVRLU)
+        Record rec((char*)RLU_DEREF(self, rbuf));
+#else
         Record rec(rbuf);
+#endif
         rbuf = rec.child_;
         size_t vsiz;
         const char* vbuf = visitor->visit_full(rec.kbuf_, rec.ksiz_,
@@ -475,9 +558,15 @@ class StashDB : public BasicDB {
         }
         if (checker && !checker->check("iterate", "processing", curcnt, allcnt)) {
           set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+#if defined(MVRLU)
+          end_section(self);
+#endif
           return false;
         }
       }
+#if defined(MVRLU)
+      end_section(self);
+#endif
     }
     if (checker && !checker->check("iterate", "ending", -1, allcnt)) {
       set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
@@ -539,8 +628,16 @@ class StashDB : public BasicDB {
         char** buckets = db->buckets_;
         for (size_t i = begidx_; i < endidx; i++) {
           char* rbuf = buckets[i];
+#if defined(MVRLU)
+          if (!rbuf) continue;
+          rlu_thread_data_t* self = begin_section();
+#endif
           while (rbuf) {
+#if defined(MVRLU)
+            Record rec((char*)RLU_DEREF(self, rbuf));
+#else
             Record rec(rbuf);
+#endif
             rbuf = rec.child_;
             size_t vsiz;
             visitor->visit_full(rec.kbuf_, rec.ksiz_, rec.vbuf_, rec.vsiz_, &vsiz);
@@ -550,6 +647,9 @@ class StashDB : public BasicDB {
               break;
             }
           }
+#if defined(MVRLU)
+          end_section(self);
+#endif
         }
       }
       StashDB* db_;
@@ -639,6 +739,9 @@ class StashDB : public BasicDB {
    */
   bool open(const std::string& path, uint32_t mode = OWRITER | OCREATE) {
     _assert_(true);
+#if defined(MVRLU)
+    mvrlu_init();
+#endif
     ScopedRWLock lock(&mlock_, true);
     if (omode_ != 0) {
       set_error(_KCCODELINE_, Error::INVALID, "already opened");
@@ -673,6 +776,9 @@ class StashDB : public BasicDB {
     report(_KCCODELINE_, Logger::DEBUG, "closing the database (path=%s)", path_.c_str());
     tran_ = false;
     trlogs_.clear();
+#if defined(MVRLU)
+    release_records();
+#else
     for (size_t i = 0; i < bnum_; i++) {
       char* rbuf = buckets_[i];
       while (rbuf) {
@@ -682,6 +788,7 @@ class StashDB : public BasicDB {
         rbuf = child;
       }
     }
+#endif
     if (bnum_ >= MAPZMAPBNUM) {
       mapfree(buckets_);
     } else {
@@ -858,6 +965,9 @@ class StashDB : public BasicDB {
     }
     disable_cursors();
     if (count_ > 0) {
+#if defined(MVRLU)
+      release_records();
+#else
       for (size_t i = 0; i < bnum_; i++) {
         char* rbuf = buckets_[i];
         while (rbuf) {
@@ -868,6 +978,7 @@ class StashDB : public BasicDB {
         }
         buckets_[i] = NULL;
       }
+#endif
       count_ = 0;
       size_ = 0;
     }
@@ -1145,11 +1256,20 @@ class StashDB : public BasicDB {
       wp += writevarnum(wp, vsiz);
       std::memcpy(wp, vbuf, vsiz);
     }
+    /** calculate the size of the serialized data */
+    uint64_t size() {
+      _assert_(true);
+      return sizeof(child_) + sizevarnum(ksiz_) + ksiz_ + sizevarnum(vsiz_) + vsiz_;
+    }
     /** serialize data into a buffer */
     char* serialize() {
       _assert_(true);
-      uint64_t rsiz = sizeof(child_) + sizevarnum(ksiz_) + ksiz_ + sizevarnum(vsiz_) + vsiz_;
+      uint64_t rsiz = size();
+#if defined(MVRLU)
+      char* rbuf = (char*)RLU_ALLOC(rsiz);
+#else
       char* rbuf = new char[rsiz];
+#endif
       char* wp = rbuf;
       *(char**)wp = child_;
       wp += sizeof(child_);
@@ -1275,6 +1395,204 @@ class StashDB : public BasicDB {
    private:
     Visitor* visitor_;                   ///< visitor
   };
+#if defined(MVRLU)
+  /**
+   * Accept a visitor to a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param visitor a visitor object.
+   * @param bidx the bucket index.
+   * @note This must be called in an MV-RLU section, which is aborted and restarted while the
+   * records to be updated can not be locked, and committed and restarted after an update so
+   * that later visits in the same section see it.  The visitor is called only once, after the
+   * locks are acquired.
+   */
+  void accept_impl(const char* kbuf, size_t ksiz, Visitor* visitor, size_t bidx) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+    rlu_thread_data_t* self = get_thread_data();
+    int32_t rv = try_accept_impl(self, kbuf, ksiz, visitor, bidx);
+    if (rv < 0) {
+      // the key may live in a record version which is reclaimed after the abort
+      std::string key(kbuf, ksiz);
+      do {
+        RLU_ABORT(self);
+        RLU_READER_LOCK(self);
+        rv = try_accept_impl(self, key.data(), key.size(), visitor, bidx);
+      } while (rv < 0);
+    }
+    if (rv > 0) {
+      RLU_READER_UNLOCK(self);
+    } else {
+      RLU_ABORT(self);
+    }
+    RLU_READER_LOCK(self);
+  }
+  /**
+   * Try to accept a visitor to a record in an MV-RLU section.
+   * @param self the MV-RLU context of the calling thread.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param visitor a visitor object.
+   * @param bidx the bucket index.
+   * @return 1 if the record is updated, 0 if not, or -1 if a record to be updated can not be
+   * locked before the visitor is called.  Unless 1 is returned, the locked copies are
+   * discarded by aborting the section.
+   */
+  int32_t try_accept_impl(rlu_thread_data_t* self, const char* kbuf, size_t ksiz, Visitor* visitor,
+                          size_t bidx) {
+    _assert_(self && kbuf && ksiz <= MEMMAXSIZ && visitor);
+    char** entp = buckets_ + bidx;
+    char* pbuf = NULL;
+    char* obuf = *entp;
+    while (obuf) {
+      char* rbuf = (char*)RLU_DEREF(self, obuf);
+      Record rec(rbuf);
+      if (rec.ksiz_ == ksiz && !std::memcmp(rec.kbuf_, kbuf, ksiz)) {
+        if (pbuf && !lock_record(self, &pbuf)) return -1;
+        if (!lock_record(self, &rbuf)) return -1;
+        size_t vsiz;
+        const char* vbuf = visitor->visit_full(rec.kbuf_, rec.ksiz_,
+                                               rec.vbuf_, rec.vsiz_, &vsiz);
+        if (pbuf) entp = (char**)pbuf;
+        if (vbuf == Visitor::REMOVE) {
+          if (tran_) {
+            ScopedMutex lock(&flock_);
+            TranLog log(rec.kbuf_, rec.ksiz_, rec.vbuf_, rec.vsiz_);
+            trlogs_.push_back(log);
+          }
+          count_ -= 1;
+          size_ -= rec.ksiz_ + rec.vsiz_;
+          escape_cursors(obuf);
+          RLU_ASSIGN_PTR(self, entp, rec.child_);
+          RLU_FREE(self, obuf);
+        } else if (vbuf != Visitor::NOP) {
+          int32_t oh = (int32_t)sizevarnum(vsiz) - (int32_t)sizevarnum(rec.vsiz_);
+          int64_t diff = (int64_t)rec.vsiz_ - (int64_t)(vsiz + oh);
+          if (tran_) {
+            ScopedMutex lock(&flock_);
+            TranLog log(rec.kbuf_, rec.ksiz_, rec.vbuf_, rec.vsiz_);
+            trlogs_.push_back(log);
+          }
+          size_ += (int64_t)vsiz - (int64_t)rec.vsiz_;
+          if (diff >= 0) {
+            rec.overwrite(rbuf, vbuf, vsiz);
+          } else {
+            Record nrec(rec.child_, kbuf, ksiz, vbuf, vsiz);
+            char* nbuf = nrec.serialize();
+            adjust_cursors(obuf, nbuf);
+            RLU_ASSIGN_PTR(self, entp, nbuf);
+            RLU_FREE(self, obuf);
+          }
+        } else {
+          return 0;
+        }
+        return 1;
+      }
+      pbuf = rbuf;
+      obuf = rec.child_;
+    }
+    if (pbuf && !lock_record(self, &pbuf)) return -1;
+    size_t vsiz;
+    const char* vbuf = visitor->visit_empty(kbuf, ksiz, &vsiz);
+    if (vbuf != Visitor::REMOVE && vbuf != Visitor::NOP) {
+      if (tran_) {
+        ScopedMutex lock(&flock_);
+        TranLog log(kbuf, ksiz);
+        trlogs_.push_back(log);
+      }
+      Record nrec(NULL, kbuf, ksiz, vbuf, vsiz);
+      if (pbuf) entp = (char**)pbuf;
+      RLU_ASSIGN_PTR(self, entp, nrec.serialize());
+      count_ += 1;
+      size_ += ksiz + vsiz;
+      return 1;
+    }
+    return 0;
+  }
+  /**
+   * Visit a record without updating it.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param visitor a visitor object.
+   * @param bidx the bucket index.
+   * @note This must be called in an MV-RLU section.  The return value of the visitor is
+   * ignored.
+   */
+  void read_impl(const char* kbuf, size_t ksiz, Visitor* visitor, size_t bidx) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+    rlu_thread_data_t* self = get_thread_data();
+    char* rbuf = buckets_[bidx];
+    size_t vsiz;
+    while (rbuf) {
+      Record rec((char*)RLU_DEREF(self, rbuf));
+      if (rec.ksiz_ == ksiz && !std::memcmp(rec.kbuf_, kbuf, ksiz)) {
+        visitor->visit_full(rec.kbuf_, rec.ksiz_, rec.vbuf_, rec.vsiz_, &vsiz);
+        return;
+      }
+      rbuf = rec.child_;
+    }
+    visitor->visit_empty(kbuf, ksiz, &vsiz);
+  }
+  /**
+   * Lock a record buffer in an MV-RLU section.
+   * @param self the MV-RLU context of the calling thread.
+   * @param rbufp the pointer to the variable of the record buffer, which is replaced with the
+   * private copy to be modified on success.
+   * @return true on success, or false on failure.
+   */
+  bool lock_record(rlu_thread_data_t* self, char** rbufp) {
+    _assert_(self && rbufp && *rbufp);
+    return mvrlu_try_lock_full(self, rbufp);
+  }
+  /**
+   * Unlink and free all records.
+   * @note Records are freed in MV-RLU sections so that lock-free readers never see a freed
+   * record.  A thread without its own MV-RLU context borrows a temporary one.
+   */
+  void release_records() {
+    _assert_(true);
+    rlu_thread_data_t* tmp = NULL;
+    if (!self) {
+      tmp = (rlu_thread_data_t*)RLU_THREAD_ALLOC();
+      RLU_THREAD_INIT(tmp);
+    }
+    char* rbufs[RELBATCH];
+    for (size_t i = 0; i < bnum_; i++) {
+      while (buckets_[i]) {
+        rlu_thread_data_t* ctx = tmp;
+        if (ctx) {
+          RLU_READER_LOCK(ctx);
+        } else {
+          ctx = begin_section();
+        }
+        // a record committed just now can not be locked until the clock passes its version
+        size_t rnum = 0;
+        char* rbuf = buckets_[i];
+        while (rbuf && rnum < RELBATCH) {
+          if (!RLU_TRY_LOCK_CONST(ctx, rbuf)) break;
+          rbufs[rnum++] = rbuf;
+          Record rec((char*)RLU_DEREF(ctx, rbuf));
+          rbuf = rec.child_;
+        }
+        if (rnum > 0) {
+          RLU_ASSIGN_PTR(ctx, buckets_ + i, rbuf);
+          for (size_t j = 0; j < rnum; j++) {
+            RLU_FREE(ctx, rbufs[j]);
+          }
+        }
+        if (tmp) {
+          RLU_READER_UNLOCK(ctx);
+        } else {
+          end_section(ctx);
+        }
+      }
+    }
+    if (tmp) {
+      RLU_THREAD_FINISH(tmp);
+      RLU_THREAD_FREE(tmp);
+    }
+  }
+#else
   /**
    * Accept a visitor to a record.
    * @param kbuf the pointer to the key region.
@@ -1341,6 +1659,7 @@ class StashDB : public BasicDB {
       size_ += ksiz + vsiz;
     }
   }
+#endif
   /**
    * Get the hash value of a record.
    * @param kbuf the pointer to the key region.
@@ -1421,6 +1740,9 @@ class StashDB : public BasicDB {
       const char* vbuf = it->value.c_str();
       size_t vsiz = it->value.size();
       size_t bidx = hash_record(kbuf, ksiz) % bnum_;
+#if defined(MVRLU)
+      rlu_thread_data_t* self = begin_section();
+#endif
       if (it->full) {
         Setter setter(vbuf, vsiz);
         accept_impl(kbuf, ksiz, &setter, bidx);
@@ -1428,6 +1750,9 @@ class StashDB : public BasicDB {
         Remover remover;
         accept_impl(kbuf, ksiz, &remover, bidx);
       }
+#if defined(MVRLU)
+      end_section(self);
+#endif
     }
   }
   /** Dummy constructor to forbid the use. */
@@ -49,6 +49,9 @@ int main(int argc, char** argv) {
   g_memusage = memusage();
   kc::setstdiobin();
   if (argc < 2) usage();
+#if defined(MVRLU)
+  rluattach();
+#endif
   int32_t rv = 0;
   if (!std::strcmp(argv[1], "order")) {
     rv = runorder(argc, argv);
@@ -68,6 +71,9 @@ int main(int argc, char** argv) {
     }
     oprintf("\n\n");
   }
+#if defined(MVRLU)
+  rludetach();
+#endif
   return rv;
 }
 
@@ -26,12 +26,76 @@
 namespace kyotocabinet {                 // common namespace
 
 thread_local rlu_thread_data_t *self;
+#if defined(MVRLU)
+namespace {
+const int32_t SECTNESTMAX = 8;           ///< maximum depth of nested MV-RLU sections
+thread_local int32_t sectdepth;          ///< depth of the running MV-RLU sections
+thread_local rlu_thread_data_t* sectctxs[SECTNESTMAX];  ///< contexts of nested sections
+}
+#endif
 rlu_thread_data_t* get_thread_data(){
+#if defined(MVRLU)
+  rlu_thread_data_t* dummy = sectdepth > 1 ? sectctxs[sectdepth-2] : self;
+#else
   rlu_thread_data_t* dummy = self;
+#endif
   if(dummy == NULL)
     throw std::runtime_error("self is NULL");
   return dummy;
 }
+#if defined(MVRLU)
+/**
+ * Enter an MV-RLU section.
+ * A context can not run two sections at once, so a section entered in another one, as by a
+ * visitor which operates another database, runs in a context of its own.  Such a section can
+ * not wait for its log at the high mark, since the reclamation waits for the outer section, so
+ * the logs of the nested contexts are reclaimed down to the low mark before the outermost
+ * section.  The nested sections in one outer section can take a quarter of a log then.
+ */
+rlu_thread_data_t* begin_section(){
+  rlu_thread_data_t* ctx = self;
+  if(ctx == NULL)
+    throw std::runtime_error("self is NULL");
+  if(sectdepth == 0){
+    for(int32_t i = 0; i < SECTNESTMAX && sectctxs[i]; i++){
+      mvrlu_reclaim_log(sectctxs[i]);
+    }
+  } else {
+    if(sectdepth > SECTNESTMAX)
+      throw std::runtime_error("too deep sections");
+    ctx = sectctxs[sectdepth-1];
+    if(ctx == NULL){
+      ctx = (rlu_thread_data_t*)RLU_THREAD_ALLOC();
+      if(ctx == NULL)
+        throw std::runtime_error("ctx is null");
+      RLU_THREAD_INIT(ctx);
+      sectctxs[sectdepth-1] = ctx;
+    }
+  }
+  sectdepth++;
+  RLU_READER_LOCK(ctx);
+  return ctx;
+}
+/**
+ * Leave the innermost MV-RLU section.
+ */
+void end_section(rlu_thread_data_t* ctx){
+  RLU_READER_UNLOCK(ctx);
+  sectdepth--;
+}
+/**
+ * Release the contexts of nested MV-RLU sections of the calling thread.
+ */
+void finish_sections(){
+  for(int32_t i = 0; i < SECTNESTMAX; i++){
+    if(sectctxs[i] == NULL)
+      continue;
+    RLU_THREAD_FINISH(sectctxs[i]);
+    RLU_THREAD_FREE(sectctxs[i]);
+    sectctxs[i] = NULL;
+  }
+}
+#endif
 /**
  * Constants for implementation.
  */
@@ -311,6 +375,9 @@ static void* threadrun(void* arg) {
 #endif
   Thread* thread = (Thread*)arg;
   thread->run();
+#if defined(MVRLU)
+  finish_sections();
+#endif
 #if defined(RLU) || defined(MVRLU)
   RLU_THREAD_FINISH(self);
 #endif
@@ -31,6 +31,11 @@ namespace kyotocabinet {                 // common namespace
 
 extern thread_local rlu_thread_data_t* self;
 rlu_thread_data_t* get_thread_data(void);
+#if defined(MVRLU)
+rlu_thread_data_t* begin_section(void);
+void end_section(rlu_thread_data_t* ctx);
+void finish_sections(void);
+#endif
 
 /**
  * Threading device.
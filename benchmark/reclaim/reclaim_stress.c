@@ -0,0 +1,225 @@
+// SPDX-FileCopyrightText: Copyright (c) 2018-2019 Virginia Tech
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * MV-RLU log reclamation stress
+ *
+ * Threads read and rewrite a small array of slots, each pointing to a
+ * blob filled with one byte value. A rewrite either refills the blob in
+ * place or replaces it with a blob of another size and frees the old
+ * one, and some replacements abort. Copies of up to a few KB fill the
+ * logs quickly, so writers keep hitting the high mark and quiescent
+ * periods run back to back. A reader that sees a blob whose bytes
+ * differ, or crashes on one, read a copy or an object that was
+ * reclaimed under it. Threads finish with logs that are not empty and
+ * are freed only after all of them are joined, while the qp thread
+ * reclaims their logs and reaps them as zombies.
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mvrlu.h"
+
+#define DEFAULT_THREADS 8
+#define DEFAULT_DURATION_MS 3000
+#define DEFAULT_MAX_SIZE 3000
+#define NR_SLOTS 64
+#define MAX_THREADS 64
+
+struct blob {
+	unsigned long len;
+	unsigned char fill;
+	unsigned char data[0];
+};
+
+struct slot {
+	struct blob *blob;
+};
+
+struct worker {
+	pthread_t thread;
+	mvrlu_thread_struct_t *self;
+	unsigned int seed;
+	unsigned long ops, replaces, aborts, bad;
+};
+
+static struct slot *g_slots[NR_SLOTS];
+static volatile int g_stop;
+static unsigned long g_max_size = DEFAULT_MAX_SIZE;
+
+static struct blob *blob_alloc(unsigned long len, unsigned char fill)
+{
+	struct blob *b;
+
+	b = mvrlu_alloc(sizeof(*b) + len);
+	if (!b)
+		return NULL;
+	b->len = len;
+	b->fill = fill;
+	memset(b->data, fill, len);
+	return b;
+}
+
+static int blob_is_consistent(const struct blob *b)
+{
+	unsigned long i;
+
+	for (i = 0; i < b->len; ++i) {
+		if (b->data[i] != b->fill)
+			return 0;
+	}
+	return 1;
+}
+
+/* Swap the blob of @s for a new one of another size */
+static int replace_blob(mvrlu_thread_struct_t *self, struct worker *w,
+			struct slot *s, struct blob *b)
+{
+	struct blob *nb;
+
+	if (!mvrlu_try_lock(self, &s) ||
+	    !_mvrlu_try_lock(self, (void **)&b, sizeof(*b) + b->len))
+		return 0;
+
+	nb = blob_alloc(1 + rand_r(&w->seed) % g_max_size, b->fill + 1);
+	if (!nb)
+		return 0;
+	mvrlu_assign_ptr(self, &s->blob, nb);
+	mvrlu_free(self, b);
+
+	/* An aborted replacement must leave no trace */
+	if (rand_r(&w->seed) % 4 == 0) {
+		mvrlu_abort(self);
+		mvrlu_free(NULL, nb);
+		w->aborts++;
+		return -1;
+	}
+	w->replaces++;
+	return 1;
+}
+
+static void *worker_main(void *arg)
+{
+	struct worker *w = arg;
+	mvrlu_thread_struct_t *self;
+	struct slot *s;
+	struct blob *b;
+	int rc;
+
+	self = w->self;
+	mvrlu_thread_init(self);
+
+	while (!g_stop) {
+		mvrlu_reader_lock(self);
+		s = mvrlu_deref(self, g_slots[rand_r(&w->seed) % NR_SLOTS]);
+		b = mvrlu_deref(self, s->blob);
+		if (!blob_is_consistent(b))
+			w->bad++;
+
+		switch (rand_r(&w->seed) % 4) {
+		case 0:
+			break;
+		case 1:
+		case 2:
+			if (!_mvrlu_try_lock(self, (void **)&b,
+					     sizeof(*b) + b->len)) {
+				mvrlu_abort(self);
+				continue;
+			}
+			b->fill++;
+			memset(b->data, b->fill, b->len);
+			break;
+		default:
+			rc = replace_blob(self, w, s, b);
+			if (rc < 0)
+				continue;
+			if (rc == 0) {
+				mvrlu_abort(self);
+				continue;
+			}
+			break;
+		}
+		mvrlu_reader_unlock(self);
+		w->ops++;
+	}
+
+	mvrlu_thread_finish(self);
+	return NULL;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-n threads] [-d msec] [-s max blob bytes]\n"
+		"  defaults: -n %d -d %d -s %d\n",
+		prog, DEFAULT_THREADS, DEFAULT_DURATION_MS, DEFAULT_MAX_SIZE);
+}
+
+int main(int argc, char *argv[])
+{
+	struct worker workers[MAX_THREADS];
+	unsigned long ops = 0, replaces = 0, aborts = 0, bad = 0;
+	int nr_threads = DEFAULT_THREADS;
+	int duration_ms = DEFAULT_DURATION_MS;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "n:d:s:h")) != -1) {
+		switch (c) {
+		case 'n':
+			nr_threads = atoi(optarg);
+			break;
+		case 'd':
+			duration_ms = atoi(optarg);
+			break;
+		case 's':
+			g_max_size = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (nr_threads < 1 || nr_threads > MAX_THREADS || duration_ms < 1 ||
+	    g_max_size < 1) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	mvrlu_init();
+	for (i = 0; i < NR_SLOTS; ++i) {
+		g_slots[i] = mvrlu_alloc(sizeof(struct slot));
+		if (!g_slots[i] || !(g_slots[i]->blob = blob_alloc(100, 1))) {
+			fprintf(stderr, "out of memory\n");
+			return 1;
+		}
+	}
+
+	memset(workers, 0, sizeof(workers));
+	for (i = 0; i < nr_threads; ++i) {
+		workers[i].seed = i * 31 + 7;
+		workers[i].self = mvrlu_thread_alloc();
+		pthread_create(&workers[i].thread, NULL, worker_main,
+			       &workers[i]);
+	}
+	usleep(duration_ms * 1000);
+	g_stop = 1;
+	for (i = 0; i < nr_threads; ++i) {
+		pthread_join(workers[i].thread, NULL);
+		ops += workers[i].ops;
+		replaces += workers[i].replaces;
+		aborts += workers[i].aborts;
+		bad += workers[i].bad;
+	}
+	for (i = 0; i < nr_threads; ++i)
+		mvrlu_thread_free(workers[i].self);
+	mvrlu_finish();
+
+	printf("threads %d ops %lu replaces %lu aborted %lu inconsistent %lu\n",
+	       nr_threads, ops, replaces, aborts, bad);
+	return bad ? 1 : 0;
+}
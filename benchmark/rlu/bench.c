@@ -16,6 +16,7 @@
 #include <time.h>
 
 #include "hash-list.h"
+#include "lat_hist.h"
 #include "numa-config.h"
 #include "zipf/zipf.h"
 int getCPUid(int index, bool reset);
@@ -39,6 +40,8 @@ int getCPUid(int index, bool reset);
 #define DEFAULT_SEED                    0
 #define DEFAULT_UPDATE                  200
 #define DEFAULT_ZIPF_DIST_VAL           0
+#define DEFAULT_LAT_INTERVAL            0
+#define DEFAULT_STATS_INTERVAL          0
 
 #define XSTR(s)                         STR(s)
 #define STR(s)                          #s
@@ -70,6 +73,8 @@ typedef struct thread_data {
 	int alternate;	
 	int zipf;
 	double zipf_dist_val;
+	int lat_interval;
+	struct lat_hist lat[LAT_NR];
 	rlu_thread_data_t *p_rlu_td;
 #ifndef IS_MVRLU
         rlu_thread_data_t rlu_td;
@@ -183,6 +188,38 @@ static void thread_finish(thread_data_t *d) {
 	RCU_THREAD_FINISH();
 }
 
+static long thread_aborts(thread_data_t *d) {
+#if defined(IS_MVRLU)
+	mvrlu_stat_t stat;
+
+	mvrlu_get_thread_stats(d->p_rlu_td, &stat);
+	return stat.cnt[MVRLU_STAT_n_aborts];
+#elif defined(IS_RLU)
+	return d->p_rlu_td->n_aborts;
+#else
+	return 0;
+#endif
+}
+
+#ifdef IS_MVRLU
+static void print_live_stats(struct timeval *start) {
+	mvrlu_stat_t stat;
+	struct timeval now;
+
+	RLU_GET_STATS(&stat, MVRLU_STAT_ALL);
+	gettimeofday(&now, NULL);
+	printf("[%ld ms] starts %lu aborts %lu high_mark_block %lu "
+	       "log_used %lu (max %lu) qp_period %lu us (wait %lu us) "
+	       "qp_nap %lu us reclaim %lu B/s\n",
+	       (now.tv_sec - start->tv_sec) * 1000 + (now.tv_usec - start->tv_usec) / 1000,
+	       stat.cnt[MVRLU_STAT_n_starts], stat.cnt[MVRLU_STAT_n_aborts],
+	       stat.cnt[MVRLU_STAT_n_high_mark_block], stat.gauge.log_used_bytes,
+	       stat.gauge.max_thread_log_used_bytes, stat.gauge.qp_period_usec,
+	       stat.gauge.qp_wait_usec, stat.gauge.qp_nap_usec,
+	       stat.gauge.reclaim_bytes_per_sec);
+}
+#endif
+
 static void print_stats() {
 	RLU_PRINT_STATS();
 	RCU_PRINT_STATS();
@@ -291,7 +328,10 @@ static int hash_list_remove(thread_data_t *d, int key) {
 static void *test(void *data)
 {
 	int op, last = -1;
-	int key, rc;
+	int key, rc, kind;
+	int sample = 0;
+	long n_aborts = 0;
+	uint64_t lat_start = 0;
 	thread_data_t *d = (thread_data_t *)data;
 	struct zipf_state zs;
 
@@ -325,7 +365,13 @@ static void *test(void *data)
 
 	while (stop == 0) {
 		op = rand_range(1000, d->seed);
+		if (d->lat_interval && --sample <= 0) {
+			sample = d->lat_interval;
+			n_aborts = thread_aborts(d);
+			lat_start = lat_hist_now();
+		}
 		if (op < d->update) {
+			kind = LAT_WRITE;
 			if (d->alternate) {
 				/* Alternate insertions and removals */
 				if (last < 0) {
@@ -369,6 +415,7 @@ static void *test(void *data)
 				}
 			}
 		} else {
+			kind = LAT_READ;
 			/* Look for random value */
 			if (d->zipf)
 				key = zipf_next(&zs) + 1;
@@ -380,6 +427,12 @@ static void *test(void *data)
 			}
 			d->nb_contains++;
 		}
+		if (lat_start) {
+			if (thread_aborts(d) != n_aborts)
+				kind = LAT_ABORT;
+			lat_hist_record(&d->lat[kind], lat_hist_now() - lat_start);
+			lat_start = 0;
+		}
 	}
 
 	thread_finish(d);
@@ -433,12 +486,17 @@ int main(int argc, char **argv)
 			{"zipf-dist-val",             required_argument, NULL, 'z'},
 			{"rlu-max-ws",                required_argument, NULL, 'w'},
 			{"update-rate",               required_argument, NULL, 'u'},
+			{"latency",                   required_argument, NULL, 'l'},
+			{"stats-interval",            required_argument, NULL, 'S'},
 			{NULL, 0, NULL, 0}
 	};
 
 	hash_list_t *p_hash_list;
 	int i, c, size, size2;
 	unsigned long reads, updates;
+	struct lat_hist lat[LAT_NR];
+	uint64_t tsc_start, tsc_end;
+	double cycles_per_ns;
 	thread_data_t *data;
 	pthread_t *threads;
 	pthread_attr_t attr;
@@ -455,11 +513,13 @@ int main(int argc, char **argv)
 	double zipf_dist_val = DEFAULT_ZIPF_DIST_VAL;
 	int zipf = 0;
 	int alternate = 1;
+	int lat_interval = DEFAULT_LAT_INTERVAL;
+	int stats_interval = DEFAULT_STATS_INTERVAL;
 	sigset_t block_set;
 
 	while(1) {
 		i = 0;
-		c = getopt_long(argc, argv, "hab:d:i:n:r:s:w:u:z:", long_options, &i);
+		c = getopt_long(argc, argv, "hab:d:i:l:n:r:s:S:w:u:z:", long_options, &i);
 
 		if(c == -1)
 			break;
@@ -489,12 +549,16 @@ int main(int argc, char **argv)
 				"        Test duration in milliseconds (0=infinite, default=" XSTR(DEFAULT_DURATION) ")\n"
 				"  -i, --initial-size <int>\n"
 				"        Number of elements to insert before test (default=" XSTR(DEFAULT_INITIAL) ")\n"
+				"  -l, --latency <int>\n"
+				"        Record the latency of every Nth operation (0=off, default=" XSTR(DEFAULT_LAT_INTERVAL) ")\n"
 				"  -n, --num-threads <int>\n"
 				"        Number of threads (default=" XSTR(DEFAULT_NB_THREADS) ")\n"
 				"  -r, --range <int>\n"
 				"        Range of integer values inserted in set (default=" XSTR(DEFAULT_RANGE) ")\n"
 				"  -s, --seed <int>\n"
 				"        RNG seed (0=time-based, default=" XSTR(DEFAULT_SEED) ")\n"
+				"  -S, --stats-interval <int>\n"
+				"        Print MV-RLU statistics every N milliseconds during the run (0=off, default=" XSTR(DEFAULT_STATS_INTERVAL) ")\n"
 				"  -u, --update-rate <int>\n"
 				"        Percentage of update transactions (1000 = 100 percent) (default=" XSTR(DEFAULT_UPDATE) ")\n"				
 				"  -z, --zipf-dist-value <double>\n"
@@ -513,6 +577,9 @@ int main(int argc, char **argv)
 			case 'i':
 			initial = atoi(optarg);
 			break;
+			case 'l':
+			lat_interval = atoi(optarg);
+			break;
 			case 'n':
 			nb_threads = atoi(optarg);
 			break;
@@ -522,6 +589,9 @@ int main(int argc, char **argv)
 			case 's':
 			seed = atoi(optarg);
 			break;
+			case 'S':
+			stats_interval = atoi(optarg);
+			break;
 			case 'u':
 			update = atoi(optarg);
 			break;
@@ -543,6 +613,8 @@ int main(int argc, char **argv)
 	assert(range > 0 && range >= initial);
 	assert(update >= 0 && update <= 1000);
 	assert(zipf_dist_val >= 0.0);
+	assert(lat_interval >= 0);
+	assert(stats_interval >= 0);
 
 	/* If zipf dist. value is 0, uniform random dist. is choosen */
 	if (zipf_dist_val > 0)
@@ -559,6 +631,7 @@ int main(int argc, char **argv)
 	printf("Zipf dist    : %d\n", zipf);
 	printf("Zipf dist val: %lf\n", zipf_dist_val);
 	printf("Alternate    : %d\n", alternate);
+	printf("Latency      : %d\n", lat_interval);
 	printf("Node size    : %lu\n", sizeof(node_t));
 	printf("Type sizes   : int=%d/long=%d/ptr=%d/word=%d\n",
 		(int)sizeof(int),
@@ -633,6 +706,7 @@ int main(int argc, char **argv)
 		data[i].update = update;
 		data[i].zipf = zipf;
 		data[i].zipf_dist_val = zipf_dist_val;
+		data[i].lat_interval = lat_interval;
 		data[i].alternate = alternate;
 		data[i].nb_add = 0;
 		data[i].nb_remove = 0;
@@ -665,6 +739,23 @@ int main(int argc, char **argv)
 
 	printf("STARTING THREADS...\n");
 	gettimeofday(&start, NULL);
+	tsc_start = lat_hist_now();
+#ifdef IS_MVRLU
+	if (duration > 0 && stats_interval > 0) {
+		struct timespec interval;
+		int left = duration;
+
+		while (left > 0) {
+			int ms = left < stats_interval ? left : stats_interval;
+
+			interval.tv_sec = ms / 1000;
+			interval.tv_nsec = (ms % 1000) * 1000000;
+			nanosleep(&interval, NULL);
+			left -= ms;
+			print_live_stats(&start);
+		}
+	} else
+#endif
 	if (duration > 0) {
 		nanosleep(&timeout, NULL);
 	} else {
@@ -672,6 +763,7 @@ int main(int argc, char **argv)
 		sigsuspend(&block_set);
 	}
 	stop = 1;
+	tsc_end = lat_hist_now();
 	gettimeofday(&end, NULL);
 	printf("STOPPING THREADS...\n");
 
@@ -693,8 +785,11 @@ int main(int argc, char **argv)
 	global_finish();
 
 	duration = (end.tv_sec * 1000 + end.tv_usec / 1000) - (start.tv_sec * 1000 + start.tv_usec / 1000);
+	cycles_per_ns = (tsc_end - tsc_start) / (duration * 1000000.0);
 	reads = 0;
 	updates = 0;
+	for (i = 0; i < LAT_NR; i++)
+		lat_hist_init(&lat[i]);
 	for (i = 0; i < nb_threads; i++) {
 		printf("Thread %d\n", i);
 		printf("  #add        : %lu\n", data[i].nb_add);
@@ -704,6 +799,8 @@ int main(int argc, char **argv)
 		reads += data[i].nb_contains;
 		updates += (data[i].nb_add + data[i].nb_remove);
 		size += data[i].diff;
+		for (c = 0; c < LAT_NR; c++)
+			lat_hist_merge(&lat[c], &data[i].lat[c]);
 	}
 	size2 = hash_list_size(p_hash_list);
 	printf("Set size      : %d (expected: %d)\n", size2, size);
@@ -714,6 +811,10 @@ int main(int argc, char **argv)
 	printf("#ops          : %lu (%f / s)\n", reads + updates, (reads + updates) * 1000.0 / duration);
 	printf("#read ops     : %lu (%f / s)\n", reads, reads * 1000.0 / duration);
 	printf("#update ops   : %lu (%f / s)\n", updates, updates * 1000.0 / duration);
+	if (lat_interval) {
+		for (i = 0; i < LAT_NR; i++)
+			lat_hist_print(stdout, lat_hist_names[i], &lat[i], cycles_per_ns);
+	}
 
 	free(threads);
 	free(data);
@@ -617,7 +617,7 @@ int rlu_list_contains(rlu_thread_data_t *self, list_t *p_list, val_t val) {
 	val_t v;
 	node_t *p_prev, *p_next;
 
-	RLU_READER_LOCK(self);
+	RLU_READER_LOCK_RO(self);
 
 	p_prev = (node_t *)RLU_DEREF(self, (p_list->p_head));
 	p_next = (node_t *)RLU_DEREF(self, (p_prev->p_next));
@@ -635,7 +635,7 @@ int rlu_list_contains(rlu_thread_data_t *self, list_t *p_list, val_t val) {
 
 	result = (v == val);
 
-	RLU_READER_UNLOCK(self);
+	RLU_READER_UNLOCK_RO(self);
 
 	return result;
 }
@@ -835,7 +835,7 @@ int rcu_list_add(list_t *p_list, val_t val, int bucket) {
 
 int rlu_list_add(rlu_thread_data_t *self, list_t *p_list, val_t val) {
 	int result;
-	node_t *p_prev, *p_next;
+	node_t *p_prev, *p_next, *p_new_node = NULL;
 	val_t v;
 
 restart:
@@ -868,19 +868,23 @@ restart:
 			RLU_ABORT(self);
 			goto restart;
 		}
-		if (!RLU_TRY_LOCK(self, &p_next)) {
+		if (!RLU_TRACK_READ(self, p_next)) {
 			RLU_ABORT(self);
 			goto restart;
 		}
 
-		node_t *p_new_node = rlu_new_node();
+		p_new_node = rlu_new_node();
 		p_new_node->val = val;
 
 		RLU_ASSIGN_PTR(self, &(p_new_node->p_next), p_next);
 		RLU_ASSIGN_PTR(self, &(p_prev->p_next), p_new_node);
 	}
 
-	RLU_READER_UNLOCK(self);
+	if (!RLU_READER_UNLOCK_VALID(self)) {
+		/* Nobody has seen the new node */
+		RLU_FREE(NULL, p_new_node);
+		goto restart;
+	}
 
 	return result;
 }
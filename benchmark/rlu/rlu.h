@@ -205,6 +205,9 @@ void rlu_sync_checkpoint(rlu_thread_data_t *self);
 
 #define RLU_READER_LOCK(self) rlu_reader_lock(self)
 #define RLU_READER_UNLOCK(self) rlu_reader_unlock(self)
+#define RLU_READER_UNLOCK_VALID(self) (rlu_reader_unlock(self), 1)
+#define RLU_READER_LOCK_RO(self) rlu_reader_lock(self)
+#define RLU_READER_UNLOCK_RO(self) rlu_reader_unlock(self)
 
 #define RLU_ALLOC(obj_size) ((void *)rlu_alloc(obj_size))
 #define RLU_FREE(self, p_obj) rlu_free(self, (intptr_t *)p_obj)
@@ -214,6 +217,7 @@ void rlu_sync_checkpoint(rlu_thread_data_t *self);
 
 #define RLU_TRY_LOCK(self, p_p_obj) rlu_try_lock(self, (intptr_t **)p_p_obj, sizeof(**p_p_obj))
 #define RLU_TRY_LOCK_CONST(self, obj) RLU_TRY_LOCK(self, &(obj))
+#define RLU_TRACK_READ(self, obj) RLU_TRY_LOCK(self, &(obj))
 #define RLU_ABORT(self) rlu_abort(self)
 
 #define RLU_IS_SAME_PTRS(p_obj_1, p_obj_2) rlu_cmp_ptrs((intptr_t *)p_obj_1, (intptr_t *)p_obj_2)
@@ -0,0 +1,454 @@
+// SPDX-FileCopyrightText: Copyright (c) 2018-2019 Virginia Tech
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * Shared-memory MV-RLU benchmark and kill test
+ *
+ * Writer processes move money between random accounts of a bank that
+ * all processes share through mvrlu_shm_init(), while reader processes
+ * sum up every balance and check that the total never changes. With -k
+ * the parent kills random writers with SIGKILL during the run and
+ * starts new ones; the survivors have to keep committing and readers
+ * must never see a half-applied transfer. At the end a fresh process
+ * recovers the file and checks the total once more.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "mvrlu.h"
+#include "bench_harness.h"
+#include "bench_bank.h"
+
+#define DEFAULT_PATH "/dev/shm/mvrlu-shm.bank"
+#define DEFAULT_SIZE_MB 256
+#define DEFAULT_WRITERS 2
+#define DEFAULT_READERS 1
+#define DEFAULT_THREADS 1
+#define DEFAULT_DURATION_MS 5000
+#define MAX_PROCS 32
+
+struct options {
+	bench_opts_t bench; /* nr_threads is per process */
+	const char *prog;
+	const char *path;
+	unsigned long size_mb;
+	int nr_writers;
+	int nr_readers;
+	unsigned long nr_accounts;
+	int nr_kills;
+};
+
+/* Counters of one thread, in memory shared with the parent */
+struct slot {
+	bench_thread_result_t res;
+	unsigned long nr_mismatches;
+} __attribute__((aligned(64)));
+
+/* Writer processes come first, then the readers */
+struct shared {
+	volatile int stop;
+	struct slot threads[BANK_MAX_THREADS];
+	struct slot dead[BANK_MAX_THREADS]; /* of writers killed so far */
+	struct lat_hist lat[2 * MAX_PROCS][LAT_NR]; /* at exit */
+};
+
+struct workload {
+	struct bank *bank;
+	struct slot *slots; /* of the process */
+};
+
+static struct bank *open_bank(struct options *o)
+{
+	struct bank *bank;
+	int rc;
+
+	rc = mvrlu_shm_init(o->path, o->size_mb << 20);
+	if (rc < 0) {
+		fprintf(stderr, "mvrlu_shm_init(%s): %s\n", o->path,
+			strerror(-rc));
+		return NULL;
+	}
+	bank = mvrlu_durable_get_root();
+	if (!bank)
+		fprintf(stderr, "%s has no bank\n", o->path);
+	return bank;
+}
+
+/* Run by one process before the others attach */
+static int create_bank(struct options *o)
+{
+	struct bank *bank;
+	int rc;
+
+	rc = mvrlu_shm_init(o->path, o->size_mb << 20);
+	if (rc < 0) {
+		fprintf(stderr, "mvrlu_shm_init(%s): %s\n", o->path,
+			strerror(-rc));
+		return 1;
+	}
+	bank = bank_create(o->nr_accounts);
+	if (!bank)
+		return 1;
+	mvrlu_durable_set_root(bank);
+	mvrlu_finish();
+	return 0;
+}
+
+static void *writer_main(void *arg)
+{
+	bench_worker_t *w = arg;
+	struct workload *wl = w->arg;
+	struct bank *bank = wl->bank;
+	struct slot *slot = &wl->slots[w->id];
+	unsigned long i, j;
+	mvrlu_thread_struct_t *self;
+	uint64_t start;
+	long amount;
+	int aborted;
+
+	self = mvrlu_thread_alloc();
+	mvrlu_thread_init(self);
+
+	while (!*w->stop) {
+		bank_pick(bank, &w->seed, &i, &j, &amount);
+
+		start = lat_hist_now();
+		aborted = 0;
+	restart:
+		mvrlu_reader_lock(self);
+		if (!bank_transfer(self, bank, i, j, amount)) {
+			mvrlu_abort(self);
+			w->res.nr_abort++;
+			aborted = 1;
+			goto restart;
+		}
+		mvrlu_reader_unlock(self);
+		bench_op_done(w, LAT_WRITE, start, aborted);
+
+		/* The parent still counts it if this process is killed */
+		slot->res = w->res;
+	}
+
+	mvrlu_thread_finish(self);
+	mvrlu_thread_free(self);
+	return NULL;
+}
+
+static void *reader_main(void *arg)
+{
+	bench_worker_t *w = arg;
+	struct workload *wl = w->arg;
+	struct bank *bank = wl->bank;
+	struct slot *slot = &wl->slots[w->id];
+	mvrlu_thread_struct_t *self;
+	uint64_t start;
+	long sum;
+
+	self = mvrlu_thread_alloc();
+	mvrlu_thread_init(self);
+
+	while (!*w->stop) {
+		start = lat_hist_now();
+		mvrlu_reader_lock(self);
+		sum = bank_sum(self, bank, 0, bank->nr_accounts);
+		mvrlu_reader_unlock(self);
+		if (sum != bank_total(bank))
+			slot->nr_mismatches++;
+		bench_op_done(w, LAT_READ, start, 0);
+		slot->res = w->res;
+	}
+
+	mvrlu_thread_finish(self);
+	mvrlu_thread_free(self);
+	return NULL;
+}
+
+/* Child: run writer or reader threads until the parent stops it */
+static int run_child(struct options *o, struct shared *shared, int proc,
+		     void *(*fn)(void *))
+{
+	struct workload wl;
+	bench_run_t run;
+	int k;
+
+	wl.bank = open_bank(o);
+	if (!wl.bank)
+		return 1;
+	wl.slots = &shared->threads[proc * o->bench.nr_threads];
+	if (bench_run_start(&run, o->bench.nr_threads, fn, &wl,
+			    &shared->stop, getpid()))
+		return 1;
+	while (!shared->stop)
+		usleep(1000);
+	bench_run_stop(&run);
+	for (k = 0; k < LAT_NR; ++k)
+		shared->lat[proc][k] = run.lat[k];
+	bench_run_free(&run);
+	mvrlu_finish();
+	return 0;
+}
+
+/* Child: recover the file after everybody is gone and check it */
+static int verify_child(struct options *o)
+{
+	struct bank *bank;
+	int rc;
+
+	bank = open_bank(o);
+	if (!bank)
+		return 1;
+	rc = bank_check(bank, NULL);
+	mvrlu_finish();
+	return rc != 0;
+}
+
+static int wait_child(pid_t pid)
+{
+	int status;
+
+	if (waitpid(pid, &status, 0) < 0)
+		return -1;
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static pid_t start_child(struct options *o, struct shared *shared, int proc,
+			 void *(*fn)(void *))
+{
+	pid_t pid;
+
+	fflush(stdout);
+	pid = fork();
+	if (pid == 0)
+		_exit(run_child(o, shared, proc, fn));
+	return pid;
+}
+
+static void add_slot(struct slot *sum, const struct slot *s)
+{
+	sum->res.nr_read += s->res.nr_read;
+	sum->res.nr_write += s->res.nr_write;
+	sum->res.nr_txn += s->res.nr_txn;
+	sum->res.nr_abort += s->res.nr_abort;
+	sum->nr_mismatches += s->nr_mismatches;
+}
+
+static int report(struct options *o, struct shared *shared, int duration,
+		  double cycles_per_ns, unsigned int seed)
+{
+	int nr_procs = o->nr_writers + o->nr_readers;
+	int nr = nr_procs * o->bench.nr_threads, i, k;
+	bench_thread_result_t *threads;
+	struct lat_hist lat[LAT_NR];
+	bench_result_t res = { 0 };
+	bench_extra_t extra[5];
+	struct slot sum;
+
+	threads = calloc(nr, sizeof(*threads));
+	if (!threads)
+		return -1;
+	memset(&sum, 0, sizeof(sum));
+	for (i = 0; i < nr; ++i) {
+		add_slot(&shared->threads[i], &shared->dead[i]);
+		add_slot(&sum, &shared->threads[i]);
+		threads[i] = shared->threads[i].res;
+	}
+	memset(lat, 0, sizeof(lat));
+	for (i = 0; i < nr_procs; ++i) {
+		for (k = 0; k < LAT_NR; ++k)
+			lat_hist_merge(&lat[k], &shared->lat[i][k]);
+	}
+
+	extra[0] = (bench_extra_t){ "writers", o->nr_writers };
+	extra[1] = (bench_extra_t){ "readers", o->nr_readers };
+	extra[2] = (bench_extra_t){ "threads_per_proc", o->bench.nr_threads };
+	extra[3] = (bench_extra_t){ "kills", o->nr_kills };
+	extra[4] = (bench_extra_t){ "mismatches", sum.nr_mismatches };
+	res.backend = bench_lookup_backend(o->prog);
+	res.nr_threads = nr;
+	res.duration = duration;
+	res.init_size = o->nr_accounts;
+	res.value_range = o->nr_accounts;
+	res.update_ratio = -1;
+	res.seed = seed;
+	res.threads = threads;
+	res.lat = lat;
+	res.cycles_per_ns = cycles_per_ns;
+	res.extra = extra;
+	res.nr_extra = 5;
+	bench_report(stdout, o->bench.format, &res);
+	free(threads);
+	return sum.nr_mismatches ? -1 : 0;
+}
+
+static int benchmark(struct options *o)
+{
+	struct shared *shared;
+	struct timeval t0, t1;
+	pid_t writers[MAX_PROCS], readers[MAX_PROCS], pid;
+	unsigned int seed = getpid(), kill_seed = seed;
+	int p, t, k, failed = 0, duration;
+	uint64_t tsc0, tsc1;
+
+	shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED)
+		return 1;
+	memset(shared, 0, sizeof(*shared));
+
+	/* Start from a new file with a complete bank */
+	unlink(o->path);
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+		return 1;
+	if (pid == 0)
+		_exit(create_bank(o));
+	if (wait_child(pid))
+		return 1;
+	if (o->bench.format == BENCH_FMT_TEXT)
+		printf("file %s, %lu accounts, %d writers and %d readers "
+		       "of %d threads\n", o->path, o->nr_accounts,
+		       o->nr_writers, o->nr_readers, o->bench.nr_threads);
+
+	gettimeofday(&t0, NULL);
+	tsc0 = lat_hist_now();
+	for (p = 0; p < o->nr_readers; ++p)
+		readers[p] = start_child(o, shared, o->nr_writers + p,
+					 reader_main);
+	for (p = 0; p < o->nr_writers; ++p)
+		writers[p] = start_child(o, shared, p, writer_main);
+
+	/* Kill a random writer at even intervals and replace it */
+	for (k = 0; k < o->nr_kills; ++k) {
+		usleep(o->bench.duration * 1000ul / (o->nr_kills + 1));
+		p = rand_r(&kill_seed) % o->nr_writers;
+		kill(writers[p], SIGKILL);
+		wait_child(writers[p]);
+		for (t = p * o->bench.nr_threads;
+		     t < (p + 1) * o->bench.nr_threads; ++t) {
+			add_slot(&shared->dead[t], &shared->threads[t]);
+			memset(&shared->threads[t], 0, sizeof(shared->threads[t]));
+		}
+		writers[p] = start_child(o, shared, p, writer_main);
+		if (o->bench.format == BENCH_FMT_TEXT)
+			printf("kill %d: writer %d replaced\n", k, p);
+	}
+	usleep(o->bench.duration * 1000ul / (o->nr_kills + 1));
+
+	shared->stop = 1;
+	for (p = 0; p < o->nr_writers; ++p)
+		failed |= wait_child(writers[p]) != 0;
+	for (p = 0; p < o->nr_readers; ++p)
+		failed |= wait_child(readers[p]) != 0;
+	tsc1 = lat_hist_now();
+	gettimeofday(&t1, NULL);
+	duration = (t1.tv_sec - t0.tv_sec) * 1000 +
+		   (t1.tv_usec - t0.tv_usec) / 1000;
+	if (duration < 1)
+		duration = 1;
+
+	failed |= report(o, shared, duration,
+			 (tsc1 - tsc0) / (duration * 1000000.0), seed);
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+		return 1;
+	if (pid == 0)
+		_exit(verify_child(o));
+	failed |= wait_child(pid) != 0;
+
+	if (failed) {
+		fprintf(stderr, "FAILED\n");
+		return 1;
+	}
+	if (o->bench.format == BENCH_FMT_TEXT)
+		printf("balance ok\n");
+	return 0;
+}
+
+static void usage(const bench_opts_t *defaults)
+{
+	printf("Usage: bench-shm-mvrlu-ordo [options]\n");
+	bench_print_opts(defaults);
+	printf("  -p <file>      shared file (default %s)\n", DEFAULT_PATH);
+	printf("  -s <MB>        size of the file (default %d)\n",
+	       DEFAULT_SIZE_MB);
+	printf("  -w <procs>     writer processes (default %d, max %d)\n",
+	       DEFAULT_WRITERS, MAX_PROCS);
+	printf("  -r <procs>     reader processes (default %d, max %d)\n",
+	       DEFAULT_READERS, MAX_PROCS);
+	printf("  -a <accounts>  number of accounts (default %d)\n",
+	       BANK_DEFAULT_ACCOUNTS);
+	printf("  -k <kills>     writers killed during the run (default 0)\n");
+	printf("  (-n sets the threads of every process)\n");
+}
+
+int main(int argc, char **argv)
+{
+	const bench_opts_t defaults = {
+		.nr_threads = DEFAULT_THREADS,
+		.duration = DEFAULT_DURATION_MS,
+		.format = BENCH_FMT_TEXT,
+	};
+	struct options o = {
+		.bench = defaults,
+		.prog = argv[0],
+		.path = DEFAULT_PATH,
+		.size_mb = DEFAULT_SIZE_MB,
+		.nr_writers = DEFAULT_WRITERS,
+		.nr_readers = DEFAULT_READERS,
+		.nr_accounts = BANK_DEFAULT_ACCOUNTS,
+		.nr_kills = 0,
+	};
+	int c, rc;
+
+	while ((c = getopt(argc, argv, BENCH_OPTS "p:s:w:r:a:k:")) != -1) {
+		switch (c) {
+		case 'p':
+			o.path = optarg;
+			break;
+		case 's':
+			o.size_mb = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			o.nr_writers = atoi(optarg);
+			break;
+		case 'r':
+			o.nr_readers = atoi(optarg);
+			break;
+		case 'a':
+			o.nr_accounts = strtoul(optarg, NULL, 0);
+			break;
+		case 'k':
+			o.nr_kills = atoi(optarg);
+			break;
+		default:
+			rc = bench_parse_opt(&o.bench, c, optarg);
+			if (rc) {
+				usage(&defaults);
+				return rc < 0;
+			}
+		}
+	}
+	/* Leave a log per thread for the replacement of a killed writer */
+	if (o.nr_writers < 1 || o.nr_writers > MAX_PROCS ||
+	    o.nr_readers < 0 || o.nr_readers > MAX_PROCS ||
+	    o.nr_accounts < 2 || o.nr_kills < 0 ||
+	    (o.nr_writers + o.nr_readers + 1) * o.bench.nr_threads >
+		    BANK_MAX_THREADS) {
+		usage(&defaults);
+		return 1;
+	}
+
+	return benchmark(&o);
+}
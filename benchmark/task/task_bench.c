@@ -0,0 +1,358 @@
+// SPDX-FileCopyrightText: Copyright (c) 2018-2019 Virginia Tech
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * MV-RLU task driver
+ *
+ * A fixed pool of threads multiplexes many logical tasks the way an
+ * async server runs its coroutines. Each task is a small state machine
+ * that suspends in the middle of its critical section, as if it waited
+ * for I/O, and goes back to a shared run queue; any thread may resume
+ * it. Transfer tasks read an account, suspend, then move money between
+ * two accounts. Audit tasks sum up half of the balances, suspend, sum
+ * up the rest and check that the total is unchanged, which only holds
+ * if the snapshot survives the suspension.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mvrlu.h"
+#include "bench_harness.h"
+#include "bench_mvrlu.h"
+#include "bench_bank.h"
+
+#define DEFAULT_THREADS 4
+#define DEFAULT_TASKS 4096
+#define DEFAULT_DURATION_MS 5000
+#define DEFAULT_AUDIT_PCT 10
+
+enum { TASK_TRANSFER, TASK_AUDIT };
+
+struct task {
+	mvrlu_task_struct_t *mt;
+	int kind;
+	int step;
+	int retried;
+	uint64_t start; /* of the operation, 0 between two */
+	unsigned long i, j;
+	long amount;
+	long sum;
+	unsigned int seed;
+};
+
+/* Tasks ready to run */
+struct run_queue {
+	pthread_mutex_t lock;
+	struct task **ring;
+	unsigned long head, tail, size;
+};
+
+/* Worker counters (bench_worker_t.cnt) */
+enum { CNT_STEPS, CNT_EAGAIN, CNT_MISMATCHES };
+
+struct workload {
+	struct bank *bank;
+	struct run_queue *rq;
+};
+
+struct options {
+	bench_opts_t bench;
+	const char *prog;
+	int nr_tasks;
+	unsigned long nr_accounts;
+	int audit_pct;
+};
+
+static void rq_push(struct run_queue *rq, struct task *t)
+{
+	pthread_mutex_lock(&rq->lock);
+	rq->ring[rq->tail++ % rq->size] = t;
+	pthread_mutex_unlock(&rq->lock);
+}
+
+static struct task *rq_pop(struct run_queue *rq)
+{
+	struct task *t = NULL;
+
+	pthread_mutex_lock(&rq->lock);
+	if (rq->head != rq->tail)
+		t = rq->ring[rq->head++ % rq->size];
+	pthread_mutex_unlock(&rq->lock);
+	return t;
+}
+
+/* The log of this thread is nearly full: restart the task later and
+ * give the qp thread a chance to reclaim it */
+static void task_eagain(bench_worker_t *w, struct task *t)
+{
+	w->cnt[CNT_EAGAIN]++;
+	t->step = 0;
+	t->retried = 1;
+	sched_yield();
+}
+
+/* The operation spans every step and retry of the task */
+static void task_done(bench_worker_t *w, struct task *t, int kind)
+{
+	bench_op_done(w, kind, t->start, t->retried);
+	t->start = 0;
+	t->retried = 0;
+	t->step = 0;
+}
+
+/* Step 0: take a snapshot, read, suspend. Step 1: resume, update. */
+static void run_transfer(bench_worker_t *w, mvrlu_thread_struct_t *self,
+			 struct task *t)
+{
+	struct bank *bank = ((struct workload *)w->arg)->bank;
+	struct account *a;
+
+	if (t->step == 0) {
+		bank_pick(bank, &t->seed, &t->i, &t->j, &t->amount);
+		if (mvrlu_task_reader_lock(self, t->mt)) {
+			task_eagain(w, t);
+			return;
+		}
+		a = mvrlu_deref(self, bank->accounts[t->i]);
+		if (a->balance < t->amount)
+			t->amount = a->balance;
+		mvrlu_task_suspend(self, t->mt);
+		t->step = 1;
+		return;
+	}
+
+	if (mvrlu_task_resume(self, t->mt)) {
+		task_eagain(w, t);
+		return;
+	}
+	if (!bank_transfer(self, bank, t->i, t->j, t->amount)) {
+		mvrlu_task_abort(self, t->mt);
+		w->res.nr_abort++;
+		t->retried = 1;
+		t->step = 0;
+		return;
+	}
+	mvrlu_task_reader_unlock(self, t->mt);
+	task_done(w, t, LAT_WRITE);
+}
+
+/* Step 0: sum up the first half, suspend. Step 1: the second half. */
+static void run_audit(bench_worker_t *w, mvrlu_thread_struct_t *self,
+		      struct task *t)
+{
+	struct bank *bank = ((struct workload *)w->arg)->bank;
+	unsigned long nr = bank->nr_accounts;
+
+	if (t->step == 0) {
+		if (mvrlu_task_reader_lock(self, t->mt)) {
+			task_eagain(w, t);
+			return;
+		}
+		t->sum = bank_sum(self, bank, 0, nr / 2);
+		mvrlu_task_suspend(self, t->mt);
+		t->step = 1;
+		return;
+	}
+
+	if (mvrlu_task_resume(self, t->mt)) {
+		task_eagain(w, t);
+		return;
+	}
+	t->sum += bank_sum(self, bank, nr / 2, nr);
+	mvrlu_task_reader_unlock(self, t->mt);
+	if (t->sum != bank_total(bank))
+		w->cnt[CNT_MISMATCHES]++;
+	task_done(w, t, LAT_READ);
+}
+
+static void *worker_main(void *arg)
+{
+	bench_worker_t *w = arg;
+	struct run_queue *rq = ((struct workload *)w->arg)->rq;
+	mvrlu_thread_struct_t *self;
+	struct task *t;
+
+	self = mvrlu_thread_alloc();
+	mvrlu_thread_init(self);
+
+	while (!*w->stop) {
+		t = rq_pop(rq);
+		if (!t) {
+			sched_yield();
+			continue;
+		}
+		if (!t->start)
+			t->start = lat_hist_now();
+		if (t->kind == TASK_TRANSFER)
+			run_transfer(w, self, t);
+		else
+			run_audit(w, self, t);
+		w->cnt[CNT_STEPS]++;
+		rq_push(rq, t);
+	}
+
+	mvrlu_thread_finish(self);
+	mvrlu_thread_free(self);
+	return NULL;
+}
+
+/* Finish the tasks left suspended when the workers stopped */
+static void drain_tasks(struct task *tasks, int nr)
+{
+	mvrlu_thread_struct_t *self;
+	struct task *t;
+	int i;
+
+	self = mvrlu_thread_alloc();
+	mvrlu_thread_init(self);
+	for (i = 0; i < nr; ++i) {
+		t = &tasks[i];
+		if (t->step && !mvrlu_task_resume(self, t->mt))
+			mvrlu_task_abort(self, t->mt);
+	}
+	for (i = 0; i < nr; ++i) {
+		mvrlu_task_finish(tasks[i].mt);
+		mvrlu_task_free(tasks[i].mt);
+	}
+	mvrlu_thread_finish(self);
+	mvrlu_thread_free(self);
+}
+
+static int run(struct options *o)
+{
+	struct run_queue rq;
+	struct workload wl = { .rq = &rq };
+	struct task *tasks;
+	bench_run_t brun;
+	bench_result_t res = { 0 };
+	bench_extra_t extra[5];
+	int t;
+
+	if (mvrlu_init())
+		return 1;
+	bench_set_lib_stats(bench_mvrlu_stats);
+
+	wl.bank = bank_create(o->nr_accounts);
+	if (!wl.bank)
+		return 1;
+
+	tasks = calloc(o->nr_tasks, sizeof(*tasks));
+	pthread_mutex_init(&rq.lock, NULL);
+	rq.ring = calloc(o->nr_tasks, sizeof(rq.ring[0]));
+	rq.head = rq.tail = 0;
+	rq.size = o->nr_tasks;
+	if (!tasks || !rq.ring)
+		return 1;
+	for (t = 0; t < o->nr_tasks; ++t) {
+		tasks[t].mt = mvrlu_task_alloc();
+		if (!tasks[t].mt)
+			return 1;
+		mvrlu_task_init(tasks[t].mt);
+		tasks[t].kind = (t % 100) < o->audit_pct ? TASK_AUDIT :
+							   TASK_TRANSFER;
+		tasks[t].seed = t * 7919 + 1;
+		rq_push(&rq, &tasks[t]);
+	}
+	if (o->bench.format == BENCH_FMT_TEXT)
+		printf("%d threads, %d tasks (%d%% audits), %lu accounts\n",
+		       o->bench.nr_threads, o->nr_tasks, o->audit_pct,
+		       o->nr_accounts);
+
+	if (bench_run(&brun, o->bench.nr_threads, o->bench.duration,
+		      worker_main, &wl, 0))
+		return 1;
+
+	extra[0] = (bench_extra_t){ "tasks", o->nr_tasks };
+	extra[1] = (bench_extra_t){ "steps", brun.cnt[CNT_STEPS] };
+	extra[2] = (bench_extra_t){ "steps_per_sec",
+				    brun.cnt[CNT_STEPS] * 1000.0 /
+					    brun.duration };
+	extra[3] = (bench_extra_t){ "eagain", brun.cnt[CNT_EAGAIN] };
+	extra[4] = (bench_extra_t){ "mismatches", brun.cnt[CNT_MISMATCHES] };
+	res.backend = bench_lookup_backend(o->prog);
+	res.init_size = o->nr_accounts;
+	res.value_range = o->nr_accounts;
+	res.update_ratio = 1000 - 10 * o->audit_pct;
+	res.extra = extra;
+	res.nr_extra = 5;
+	bench_run_result(&brun, &res);
+	bench_report(stdout, o->bench.format, &res);
+
+	drain_tasks(tasks, o->nr_tasks);
+	if (bank_check(wl.bank, NULL) || brun.cnt[CNT_MISMATCHES]) {
+		fprintf(stderr, "FAILED\n");
+		return 1;
+	}
+	bench_run_free(&brun);
+	free(rq.ring);
+	free(tasks);
+	mvrlu_finish();
+	if (o->bench.format == BENCH_FMT_TEXT) {
+		printf("balance ok\n");
+		mvrlu_print_stats();
+	}
+	return 0;
+}
+
+static void usage(const bench_opts_t *defaults)
+{
+	printf("Usage: bench-task-mvrlu-ordo [options]\n");
+	bench_print_opts(defaults);
+	printf("  -t <tasks>     tasks multiplexed on the threads "
+	       "(default %d)\n", DEFAULT_TASKS);
+	printf("  -a <accounts>  number of accounts (default %d)\n",
+	       BANK_DEFAULT_ACCOUNTS);
+	printf("  -u <pct>       percentage of audit tasks (default %d)\n",
+	       DEFAULT_AUDIT_PCT);
+}
+
+int main(int argc, char **argv)
+{
+	const bench_opts_t defaults = {
+		.nr_threads = DEFAULT_THREADS,
+		.duration = DEFAULT_DURATION_MS,
+		.format = BENCH_FMT_TEXT,
+	};
+	struct options o = {
+		.bench = defaults,
+		.prog = argv[0],
+		.nr_tasks = DEFAULT_TASKS,
+		.nr_accounts = BANK_DEFAULT_ACCOUNTS,
+		.audit_pct = DEFAULT_AUDIT_PCT,
+	};
+	int c, rc;
+
+	while ((c = getopt(argc, argv, BENCH_OPTS "t:a:u:")) != -1) {
+		switch (c) {
+		case 't':
+			o.nr_tasks = atoi(optarg);
+			break;
+		case 'a':
+			o.nr_accounts = strtoul(optarg, NULL, 0);
+			break;
+		case 'u':
+			o.audit_pct = atoi(optarg);
+			break;
+		default:
+			rc = bench_parse_opt(&o.bench, c, optarg);
+			if (rc) {
+				usage(&defaults);
+				return rc < 0;
+			}
+		}
+	}
+	if (o.nr_tasks < 1 || o.nr_accounts < 2 || o.audit_pct < 0 ||
+	    o.audit_pct > 100) {
+		usage(&defaults);
+		return 1;
+	}
+
+	return run(&o);
+}
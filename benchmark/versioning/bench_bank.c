@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_bank.h"
+
+struct bank *bank_create(unsigned long nr_accounts)
+{
+	struct bank *bank;
+	struct account *acc;
+	unsigned long i;
+
+	bank = mvrlu_alloc(sizeof(*bank) +
+			   nr_accounts * sizeof(bank->accounts[0]));
+	if (!bank)
+		return NULL;
+	bank->nr_accounts = nr_accounts;
+	for (i = 0; i < nr_accounts; ++i) {
+		acc = mvrlu_alloc(sizeof(*acc));
+		if (!acc)
+			return NULL;
+		acc->balance = BANK_INITIAL_BALANCE;
+		acc->nr_updates = 0;
+		bank->accounts[i] = acc;
+	}
+	return bank;
+}
+
+void bank_pick(struct bank *bank, unsigned int *seed, unsigned long *i,
+	       unsigned long *j, long *amount)
+{
+	unsigned long nr = bank->nr_accounts;
+
+	*i = rand_r(seed) % nr;
+	*j = rand_r(seed) % (nr - 1);
+	if (*j >= *i)
+		++*j;
+	*amount = rand_r(seed) % 100;
+}
+
+int bank_transfer(mvrlu_thread_struct_t *self, struct bank *bank,
+		  unsigned long i, unsigned long j, long amount)
+{
+	struct account *a, *b;
+
+	a = mvrlu_deref(self, bank->accounts[i]);
+	b = mvrlu_deref(self, bank->accounts[j]);
+	if (!mvrlu_try_lock(self, &a) || !mvrlu_try_lock(self, &b))
+		return 0;
+	a->balance -= amount;
+	a->nr_updates++;
+	b->balance += amount;
+	b->nr_updates++;
+	return 1;
+}
+
+long bank_sum(mvrlu_thread_struct_t *self, struct bank *bank,
+	      unsigned long from, unsigned long to)
+{
+	struct account *acc;
+	long sum = 0;
+
+	for (; from < to; ++from) {
+		acc = mvrlu_deref(self, bank->accounts[from]);
+		sum += acc->balance;
+	}
+	return sum;
+}
+
+int bank_check(struct bank *bank, unsigned long *nr_updates)
+{
+	mvrlu_thread_struct_t *self;
+	struct account *acc;
+	unsigned long i, updates = 0;
+	long sum;
+
+	self = mvrlu_thread_alloc();
+	mvrlu_thread_init(self);
+	mvrlu_reader_lock(self);
+	sum = bank_sum(self, bank, 0, bank->nr_accounts);
+	for (i = 0; i < bank->nr_accounts; ++i) {
+		acc = mvrlu_deref(self, bank->accounts[i]);
+		updates += acc->nr_updates;
+	}
+	mvrlu_reader_unlock(self);
+	mvrlu_thread_finish(self);
+	mvrlu_thread_free(self);
+
+	if (nr_updates)
+		*nr_updates = updates;
+	if (sum != bank_total(bank)) {
+		fprintf(stderr, "balance mismatch: %ld != %ld\n", sum,
+			bank_total(bank));
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,55 @@
+#ifndef BENCH_BANK_H
+#define BENCH_BANK_H
+
+#include "mvrlu.h"
+
+/*
+ * The bank shared by the durable, shm and task drivers: transfers move
+ * money between two random accounts and a check sums up every balance,
+ * which never changes.  The bank and its accounts are MV-RLU objects,
+ * so the durable and shm drivers find the bank as the root of the file.
+ */
+
+#define BANK_INITIAL_BALANCE 1000
+#define BANK_DEFAULT_ACCOUNTS 1024
+#define BANK_MAX_THREADS 64 /* MVRLU_DURABLE_MAX_LOGS */
+
+struct account {
+	long balance;
+	unsigned long nr_updates;
+};
+
+struct bank {
+	unsigned long nr_accounts;
+	struct account *accounts[];
+};
+
+/* NULL if out of memory; call it after the MV-RLU heap is set up */
+struct bank *bank_create(unsigned long nr_accounts);
+
+/* Two distinct random accounts and an amount below 100 */
+void bank_pick(struct bank *bank, unsigned int *seed, unsigned long *i,
+	       unsigned long *j, long *amount);
+
+/* In a section: 0 if an account is locked and the caller must abort */
+int bank_transfer(mvrlu_thread_struct_t *self, struct bank *bank,
+		  unsigned long i, unsigned long j, long amount);
+
+/* In a section: the balances of the accounts [from, to) */
+long bank_sum(mvrlu_thread_struct_t *self, struct bank *bank,
+	      unsigned long from, unsigned long to);
+
+/* The total that bank_sum() of every account must return */
+static inline long bank_total(const struct bank *bank)
+{
+	return (long)bank->nr_accounts * BANK_INITIAL_BALANCE;
+}
+
+/*
+ * Sum up the bank in a thread of its own and report a mismatch on
+ * stderr; -1 on a mismatch.  nr_updates, if not NULL, gets the number
+ * of account updates, two per transfer.
+ */
+int bank_check(struct bank *bank, unsigned long *nr_updates);
+
+#endif /* BENCH_BANK_H */
@@ -0,0 +1,458 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench_harness.h"
+#include "numa-config.h"
+
+void barrier_init(barrier_t *b, int n)
+{
+	pthread_cond_init(&b->complete, NULL);
+	pthread_mutex_init(&b->mutex, NULL);
+	b->count = n;
+	b->crossing = 0;
+}
+
+void barrier_cross(barrier_t *b)
+{
+	pthread_mutex_lock(&b->mutex);
+	b->crossing++;
+	if (b->crossing < b->count)
+		pthread_cond_wait(&b->complete, &b->mutex);
+	else {
+		pthread_cond_broadcast(&b->complete);
+		b->crossing = 0;
+	}
+	pthread_mutex_unlock(&b->mutex);
+}
+
+/*
+ * CPU placement
+ */
+static int getCPUid(int index, int reset)
+{
+	static int cur_socket = 0;
+	static int cur_physical_cpu = 0;
+	static int cur_smt = 0;
+	int ret_val;
+
+	if (reset) {
+		cur_socket = 0;
+		cur_physical_cpu = 0;
+		cur_smt = 0;
+		return 1;
+	}
+
+	ret_val = OS_CPU_ID[cur_socket][cur_physical_cpu][cur_smt];
+	cur_physical_cpu++;
+
+	if (cur_physical_cpu == NUM_PHYSICAL_CPU_PER_SOCKET) {
+		cur_physical_cpu = 0;
+		cur_socket++;
+		if (cur_socket == NUM_SOCKET) {
+			cur_socket = 0;
+			cur_smt++;
+			if (cur_smt == SMT_LEVEL)
+				cur_smt = 0;
+		}
+	}
+
+	return ret_val;
+}
+
+static cpu_set_t *cpu_set;
+static int cpu_pinning;
+
+void bench_cpu_init(int nr_threads, int pinning)
+{
+	int i, cpuid;
+
+	cpu_pinning = pinning;
+	cpu_set = calloc(pinning ? nr_threads : 1, sizeof(cpu_set_t));
+	if (!cpu_set)
+		return;
+
+	getCPUid(0, 1);
+	CPU_ZERO(&cpu_set[0]);
+	for (i = 0; i < nr_threads; i++) {
+		cpuid = getCPUid(i, 0);
+		if (pinning) {
+			CPU_ZERO(&cpu_set[i]);
+			CPU_SET(cpuid, &cpu_set[i]);
+		} else
+			CPU_SET(cpuid, &cpu_set[0]);
+	}
+	getCPUid(0, 1);
+}
+
+void bench_cpu_bind(int id)
+{
+	if (!cpu_set)
+		return;
+	sched_setaffinity(0, sizeof(cpu_set_t),
+			  &cpu_set[cpu_pinning ? id : 0]);
+}
+
+/*
+ * Result schema
+ */
+int bench_parse_format(const char *name)
+{
+	if (!strcmp(name, "text"))
+		return BENCH_FMT_TEXT;
+	if (!strcmp(name, "json"))
+		return BENCH_FMT_JSON;
+	if (!strcmp(name, "csv"))
+		return BENCH_FMT_CSV;
+	return -1;
+}
+
+static const bench_backend_t bench_backends[] = {
+	{ "benchmark_list_spinlock",          "list",      "spinlock"   },
+	{ "benchmark_list_rcu",               "list",      "rcu"        },
+	{ "benchmark_list_rlu",               "list",      "rlu"        },
+	{ "benchmark_list_rlu_ordo",          "list",      "rlu-ordo"   },
+	{ "benchmark_list_mvrlu",             "list",      "mvrlu-gclk" },
+	{ "benchmark_list_mvrlu_ordo",        "list",      "mvrlu-ordo" },
+	{ "benchmark_list_harris",            "list",      "harris"     },
+	{ "benchmark_list_vlist",             "list",      "vlist"      },
+	{ "benchmark_list_move_spinlock",     "list_move", "spinlock"   },
+	{ "benchmark_list_move_rlu",          "list_move", "rlu"        },
+	{ "benchmark_list_move_vlist",        "list_move", "vlist"      },
+	{ "benchmark_tree_prcu_eer",          "tree",      "prcu-eer"   },
+	{ "benchmark_tree_prcu_d",            "tree",      "prcu-d"     },
+	{ "benchmark_tree_prcu_deer",         "tree",      "prcu-deer"  },
+	{ "benchmark_tree_rcu",               "tree",      "rcu"        },
+	{ "benchmark_tree_rlu",               "tree",      "rlu"        },
+	{ "benchmark_tree_rlu_ordo",          "tree",      "rlu-ordo"   },
+	{ "benchmark_tree_mvrlu",             "tree",      "mvrlu-gclk" },
+	{ "benchmark_tree_mvrlu_ordo",        "tree",      "mvrlu-ordo" },
+	{ "benchmark_tree_citrus_rlu",        "citrus",    "rlu"        },
+	{ "benchmark_tree_citrus_mvrlu_ordo", "citrus",    "mvrlu-ordo" },
+	{ "benchmark_tree_vtree",             "tree",      "vtree"      },
+	{ "benchmark_tree_bonsai",            "rbtree",    "bonsai"     },
+	{ "benchmark_tree_vrbtree",           "rbtree",    "vrbtree"    },
+	{ "bench-diff-mvrlu-ordo",            "table",     "mvrlu-ordo" },
+	{ "bench-durable-mvrlu-ordo",         "bank",      "mvrlu-ordo" },
+	{ "bench-shm-mvrlu-ordo",             "bank",      "mvrlu-ordo" },
+	{ "bench-task-mvrlu-ordo",            "bank",      "mvrlu-ordo" },
+	{ NULL,                               NULL,        NULL         },
+};
+
+const bench_backend_t *bench_lookup_backend(const char *argv0)
+{
+	static bench_backend_t unknown = { NULL, "unknown", "unknown" };
+	const bench_backend_t *b;
+	const char *prog;
+
+	prog = strrchr(argv0, '/');
+	prog = prog ? prog + 1 : argv0;
+	for (b = bench_backends; b->prog; b++) {
+		if (!strcmp(b->prog, prog))
+			return b;
+	}
+	unknown.prog = prog;
+	return &unknown;
+}
+
+static bench_lib_stats_fn bench_lib_stats;
+
+void bench_set_lib_stats(bench_lib_stats_fn fn)
+{
+	bench_lib_stats = fn;
+}
+
+static void bench_report_json(FILE *fp, const bench_result_t *res,
+			      const bench_thread_result_t *tot,
+			      const bench_extra_t *lib, int nr_lib)
+{
+	unsigned long ops;
+	int i;
+
+	ops = tot->nr_read + tot->nr_write;
+	fprintf(fp, "{\"prog\": \"%s\", \"ds\": \"%s\", \"sync\": \"%s\", ",
+		res->backend->prog, res->backend->ds, res->backend->sync);
+	fprintf(fp, "\"threads\": %d, \"duration_ms\": %d, "
+		"\"init_size\": %d, \"range\": %d, \"update_ratio\": %d, "
+		"\"zipf\": %f, \"seed\": %u, ",
+		res->nr_threads, res->duration, res->init_size,
+		res->value_range, res->update_ratio, res->zipf_dist_val,
+		res->seed);
+	fprintf(fp, "\"ops\": %lu, \"reads\": %lu, \"writes\": %lu, "
+		"\"txn\": %lu, \"aborts\": %lu, \"abort_ratio\": %f, "
+		"\"ops_per_sec\": %f, ",
+		ops, tot->nr_read, tot->nr_write, tot->nr_txn, tot->nr_abort,
+		ops + tot->nr_abort ?
+		1.0 * tot->nr_abort / (ops + tot->nr_abort) : 0.0,
+		ops * 1000.0 / res->duration);
+	fprintf(fp, "\"per_thread\": [");
+	for (i = 0; i < res->nr_threads; i++) {
+		const bench_thread_result_t *t = &res->threads[i];
+
+		fprintf(fp, "%s{\"id\": %d, \"ops\": %lu, \"aborts\": %lu, "
+			"\"ops_per_sec\": %f}", i ? ", " : "", i,
+			t->nr_read + t->nr_write, t->nr_abort,
+			(t->nr_read + t->nr_write) * 1000.0 / res->duration);
+	}
+	fprintf(fp, "]");
+	if (res->lat) {
+		double cpn = res->cycles_per_ns > 0.0 ? res->cycles_per_ns : 1.0;
+
+		fprintf(fp, ", \"latency_ns\": {");
+		for (i = 0; i < LAT_NR; i++) {
+			const struct lat_hist *h = &res->lat[i];
+
+			fprintf(fp, "%s\"%s\": {\"count\": %lu, \"p50\": %.0f, "
+				"\"p99\": %.0f, \"p999\": %.0f, \"max\": %.0f}",
+				i ? ", " : "", lat_hist_names[i],
+				(unsigned long)h->count,
+				lat_hist_quantile(h, 0.5) / cpn,
+				lat_hist_quantile(h, 0.99) / cpn,
+				lat_hist_quantile(h, 0.999) / cpn, h->max / cpn);
+		}
+		fprintf(fp, "}");
+	}
+	for (i = 0; i < res->nr_extra; i++)
+		fprintf(fp, ", \"%s\": %.15g", res->extra[i].name,
+			res->extra[i].val);
+	if (nr_lib) {
+		fprintf(fp, ", \"lib\": {");
+		for (i = 0; i < nr_lib; i++)
+			fprintf(fp, "%s\"%s\": %.15g", i ? ", " : "",
+				lib[i].name, lib[i].val);
+		fprintf(fp, "}");
+	}
+	fprintf(fp, "}\n");
+}
+
+static void bench_report_csv_row(FILE *fp, const bench_result_t *res,
+				 const char *id, const bench_thread_result_t *t,
+				 const bench_extra_t *lib, int nr_lib, int extra)
+{
+	unsigned long ops = t->nr_read + t->nr_write;
+	int i;
+
+	fprintf(fp, "%s,%s,%s,%d,%d,%d,%d,%d,%f,%u,%s,"
+		"%lu,%lu,%lu,%lu,%lu,%f,%f",
+		res->backend->prog, res->backend->ds, res->backend->sync,
+		res->nr_threads, res->duration, res->init_size,
+		res->value_range, res->update_ratio, res->zipf_dist_val,
+		res->seed, id, ops, t->nr_read, t->nr_write, t->nr_txn,
+		t->nr_abort,
+		ops + t->nr_abort ? 1.0 * t->nr_abort / (ops + t->nr_abort) : 0.0,
+		ops * 1000.0 / res->duration);
+	/* Extras only apply to the total */
+	for (i = 0; i < res->nr_extra; i++) {
+		if (extra)
+			fprintf(fp, ",%.15g", res->extra[i].val);
+		else
+			fprintf(fp, ",");
+	}
+	for (i = 0; i < nr_lib; i++) {
+		if (extra)
+			fprintf(fp, ",%.15g", lib[i].val);
+		else
+			fprintf(fp, ",");
+	}
+	fprintf(fp, "\n");
+}
+
+static void bench_report_csv(FILE *fp, const bench_result_t *res,
+			     const bench_thread_result_t *tot,
+			     const bench_extra_t *lib, int nr_lib)
+{
+	static int header_done;
+	char id[16];
+	int i;
+
+	if (!header_done) {
+		fprintf(fp, "prog,ds,sync,threads,duration_ms,init_size,range,"
+			"update_ratio,zipf,seed,thread,ops,reads,writes,txn,"
+			"aborts,abort_ratio,ops_per_sec");
+		for (i = 0; i < res->nr_extra; i++)
+			fprintf(fp, ",%s", res->extra[i].name);
+		for (i = 0; i < nr_lib; i++)
+			fprintf(fp, ",lib_%s", lib[i].name);
+		fprintf(fp, "\n");
+		header_done = 1;
+	}
+	bench_report_csv_row(fp, res, "total", tot, lib, nr_lib, 1);
+	for (i = 0; i < res->nr_threads; i++) {
+		snprintf(id, sizeof(id), "%d", i);
+		bench_report_csv_row(fp, res, id, &res->threads[i], lib,
+				     nr_lib, 0);
+	}
+}
+
+static void bench_report_text(FILE *fp, const bench_result_t *res,
+			      const bench_thread_result_t *tot)
+{
+	unsigned long ops = tot->nr_read + tot->nr_write;
+	int i;
+
+	fprintf(fp, "#ops: %lu (%.0f/s), #reads: %lu, #writes: %lu, "
+		"#aborts: %lu\n", ops, ops * 1000.0 / res->duration,
+		tot->nr_read, tot->nr_write, tot->nr_abort);
+	for (i = 0; i < res->nr_extra; i++)
+		fprintf(fp, "%s: %.15g\n", res->extra[i].name,
+			res->extra[i].val);
+	if (res->lat) {
+		for (i = 0; i < LAT_NR; i++) {
+			if (res->lat[i].count)
+				lat_hist_print(fp, lat_hist_names[i],
+					       &res->lat[i],
+					       res->cycles_per_ns);
+		}
+	}
+}
+
+void bench_report(FILE *fp, int format, const bench_result_t *res)
+{
+	bench_thread_result_t tot;
+	bench_extra_t lib[BENCH_MAX_LIB_STATS];
+	int nr_lib = 0;
+	int i;
+
+	memset(&tot, 0, sizeof(tot));
+	for (i = 0; i < res->nr_threads; i++) {
+		tot.nr_read += res->threads[i].nr_read;
+		tot.nr_write += res->threads[i].nr_write;
+		tot.nr_txn += res->threads[i].nr_txn;
+		tot.nr_abort += res->threads[i].nr_abort;
+	}
+
+	/* The text report leaves them to the library, e.g. mvrlu_print_stats() */
+	if (bench_lib_stats && format != BENCH_FMT_TEXT)
+		nr_lib = bench_lib_stats(lib, BENCH_MAX_LIB_STATS);
+
+	if (format == BENCH_FMT_JSON)
+		bench_report_json(fp, res, &tot, lib, nr_lib);
+	else if (format == BENCH_FMT_CSV)
+		bench_report_csv(fp, res, &tot, lib, nr_lib);
+	else
+		bench_report_text(fp, res, &tot);
+	fflush(fp);
+}
+
+/*
+ * Common options
+ */
+int bench_parse_opt(bench_opts_t *o, int c, const char *arg)
+{
+	switch (c) {
+	case 'n':
+		o->nr_threads = atoi(arg);
+		return o->nr_threads < 1 ? -1 : 0;
+	case 'd':
+		o->duration = atoi(arg);
+		return o->duration < 1 ? -1 : 0;
+	case 'f':
+		o->format = bench_parse_format(arg);
+		return o->format < 0 ? -1 : 0;
+	case 'h':
+		return 1;
+	}
+	return -1;
+}
+
+void bench_print_opts(const bench_opts_t *defaults)
+{
+	printf("  -n <threads>   worker threads (default %d)\n",
+	       defaults->nr_threads);
+	printf("  -d <ms>        duration (default %d)\n", defaults->duration);
+	printf("  -f <format>    text, json or csv (default text)\n");
+	printf("  -h             this help\n");
+}
+
+/*
+ * Worker pool
+ */
+int bench_run_start(bench_run_t *run, int nr_threads, void *(*fn)(void *),
+		    void *arg, volatile int *stop, unsigned int seed)
+{
+	bench_worker_t *w;
+	int i;
+
+	memset(run, 0, sizeof(*run));
+	run->nr_threads = nr_threads;
+	run->stop = stop ? stop : &run->stop_flag;
+	run->workers = aligned_alloc(64, nr_threads * sizeof(*run->workers));
+	run->threads = calloc(nr_threads, sizeof(*run->threads));
+	if (!run->workers || !run->threads)
+		return -1;
+	memset(run->workers, 0, nr_threads * sizeof(*run->workers));
+
+	gettimeofday(&run->start, NULL);
+	run->tsc_start = lat_hist_now();
+	for (i = 0; i < nr_threads; i++) {
+		w = &run->workers[i];
+		w->id = i;
+		w->seed = seed ^ (i * 7919);
+		w->stop = run->stop;
+		w->arg = arg;
+		if (pthread_create(&w->thread, NULL, fn, w)) {
+			run->nr_threads = i;
+			bench_run_stop(run);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+void bench_run_stop(bench_run_t *run)
+{
+	struct timeval end;
+	uint64_t tsc_end;
+	bench_worker_t *w;
+	int i, k;
+
+	*run->stop = 1;
+	for (i = 0; i < run->nr_threads; i++)
+		pthread_join(run->workers[i].thread, NULL);
+	tsc_end = lat_hist_now();
+	gettimeofday(&end, NULL);
+
+	run->duration = (end.tv_sec - run->start.tv_sec) * 1000 +
+			(end.tv_usec - run->start.tv_usec) / 1000;
+	if (run->duration < 1)
+		run->duration = 1;
+	run->cycles_per_ns =
+		(tsc_end - run->tsc_start) / (run->duration * 1000000.0);
+	for (i = 0; i < run->nr_threads; i++) {
+		w = &run->workers[i];
+		run->threads[i] = w->res;
+		for (k = 0; k < BENCH_MAX_CNT; k++)
+			run->cnt[k] += w->cnt[k];
+		for (k = 0; k < LAT_NR; k++)
+			lat_hist_merge(&run->lat[k], &w->lat[k]);
+	}
+}
+
+int bench_run(bench_run_t *run, int nr_threads, int duration,
+	      void *(*fn)(void *), void *arg, unsigned int seed)
+{
+	if (bench_run_start(run, nr_threads, fn, arg, NULL, seed))
+		return -1;
+	usleep(duration * 1000ul);
+	bench_run_stop(run);
+	return 0;
+}
+
+void bench_run_result(const bench_run_t *run, bench_result_t *res)
+{
+	res->nr_threads = run->nr_threads;
+	res->duration = run->duration;
+	res->threads = run->threads;
+	res->lat = run->lat;
+	res->cycles_per_ns = run->cycles_per_ns;
+}
+
+void bench_run_free(bench_run_t *run)
+{
+	free(run->workers);
+	free(run->threads);
+	run->workers = NULL;
+	run->threads = NULL;
+}
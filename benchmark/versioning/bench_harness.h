@@ -0,0 +1,176 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "lat_hist.h"
+
+/*
+ * Pieces shared by the benchmark drivers: thread barrier, CPU placement and
+ * the result schema.  Every driver prints the same JSON or CSV records, so a
+ * runner parses one format whatever data structure or backend it runs.  The
+ * single-binary MV-RLU drivers (benchmark/{diff,durable,shm,task}) also use
+ * the common options and the worker pool below and only add their workload.
+ */
+
+typedef struct barrier {
+	pthread_cond_t complete;
+	pthread_mutex_t mutex;
+	int count;
+	int crossing;
+} barrier_t;
+
+void barrier_init(barrier_t *b, int n);
+
+void barrier_cross(barrier_t *b);
+
+/* CPU placement: all threads share the first N CPUs, or one CPU each */
+enum {
+	BENCH_PIN_SHARED = 0,
+	BENCH_PIN_THREAD,
+};
+
+void bench_cpu_init(int nr_threads, int pinning);
+
+void bench_cpu_bind(int id);
+
+/* Result formats */
+enum {
+	BENCH_FMT_TEXT = 0,
+	BENCH_FMT_JSON,
+	BENCH_FMT_CSV,
+};
+
+int bench_parse_format(const char *name);
+
+typedef struct bench_backend {
+	const char *prog;	/* name of the driver binary */
+	const char *ds;		/* data structure */
+	const char *sync;	/* synchronization backend */
+} bench_backend_t;
+
+const bench_backend_t *bench_lookup_backend(const char *argv0);
+
+typedef struct bench_thread_result {
+	unsigned long nr_read;
+	unsigned long nr_write;
+	unsigned long nr_txn;
+	unsigned long nr_abort;
+} bench_thread_result_t;
+
+/* A driver-specific parameter or counter, reported after the common fields */
+typedef struct bench_extra {
+	const char *name;
+	double val;
+} bench_extra_t;
+
+typedef struct bench_result {
+	const bench_backend_t *backend;
+	int nr_threads;
+	int duration;		/* measured run time in msec */
+	int init_size;
+	int value_range;
+	int update_ratio;	/* per mille, -1 if not applicable */
+	double zipf_dist_val;
+	unsigned int seed;
+	bench_thread_result_t *threads;
+	const struct lat_hist *lat;	/* LAT_NR merged histograms, or NULL */
+	double cycles_per_ns;
+	const bench_extra_t *extra;
+	int nr_extra;
+} bench_result_t;
+
+/* The CSV header is printed by the first report of a process only */
+void bench_report(FILE *fp, int format, const bench_result_t *res);
+
+/*
+ * Counters of the synchronization library, such as bench_mvrlu_stats().
+ * A backend registers its snapshot function once and every JSON or CSV
+ * report then carries them under "lib" or as lib_<name> columns.  They
+ * are cumulative for the process, not per run.
+ */
+#define BENCH_MAX_LIB_STATS 64
+
+typedef int (*bench_lib_stats_fn)(bench_extra_t *out, int max);
+
+void bench_set_lib_stats(bench_lib_stats_fn fn);
+
+/*
+ * Options common to the MV-RLU drivers; a driver appends its own letters
+ * to BENCH_OPTS and hands the ones it does not know to bench_parse_opt().
+ */
+#define BENCH_OPTS "n:d:f:h"
+
+typedef struct bench_opts {
+	int nr_threads;
+	int duration;		/* msec */
+	int format;
+} bench_opts_t;
+
+/* 0 if parsed, 1 for -h, -1 for an unknown option or a bad value */
+int bench_parse_opt(bench_opts_t *o, int c, const char *arg);
+
+void bench_print_opts(const bench_opts_t *defaults);
+
+/*
+ * Worker pool: nr_threads workers run fn until *stop is set, then the
+ * pool sums up their results, counters and latency histograms.
+ */
+#define BENCH_MAX_CNT 4
+
+typedef struct bench_worker {
+	pthread_t thread;
+	int id;
+	unsigned int seed;
+	volatile int *stop;
+	void *arg;			/* workload of the driver */
+	bench_thread_result_t res;
+	unsigned long cnt[BENCH_MAX_CNT];	/* driver counters */
+	struct lat_hist lat[LAT_NR];
+} __attribute__((aligned(64))) bench_worker_t;
+
+typedef struct bench_run {
+	int nr_threads;
+	int duration;		/* measured run time in msec */
+	volatile int *stop;
+	volatile int stop_flag;
+	bench_worker_t *workers;
+	bench_thread_result_t *threads;
+	unsigned long cnt[BENCH_MAX_CNT];
+	struct lat_hist lat[LAT_NR];
+	double cycles_per_ns;
+	struct timeval start;
+	uint64_t tsc_start;
+} bench_run_t;
+
+/* A NULL stop uses a flag of the run, set by bench_run_stop() */
+int bench_run_start(bench_run_t *run, int nr_threads, void *(*fn)(void *),
+		    void *arg, volatile int *stop, unsigned int seed);
+
+void bench_run_stop(bench_run_t *run);
+
+/* Start the workers, let them run for duration msec and stop them */
+int bench_run(bench_run_t *run, int nr_threads, int duration,
+	      void *(*fn)(void *), void *arg, unsigned int seed);
+
+/* Fill the measured fields of a result */
+void bench_run_result(const bench_run_t *run, bench_result_t *res);
+
+void bench_run_free(bench_run_t *run);
+
+/* Account one operation that started at start (lat_hist_now()) */
+static inline void bench_op_done(bench_worker_t *w, int kind, uint64_t start,
+				 int aborted)
+{
+	lat_hist_record(&w->lat[aborted ? LAT_ABORT : kind],
+			lat_hist_now() - start);
+	if (kind == LAT_READ)
+		w->res.nr_read++;
+	else
+		w->res.nr_write++;
+}
+
+#endif
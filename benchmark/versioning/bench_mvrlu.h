@@ -0,0 +1,48 @@
+#ifndef BENCH_MVRLU_H
+#define BENCH_MVRLU_H
+
+#include <stddef.h>
+#include <mvrlu.h>
+
+#include "bench_harness.h"
+
+/*
+ * Library counters of an MV-RLU backend for bench_set_lib_stats(): every
+ * MVRLU_STAT_NAMES() counter, then the gauges, of mvrlu_get_stats().
+ */
+static inline int bench_mvrlu_stats(bench_extra_t *out, int max)
+{
+	static const struct {
+		const char *name;
+		size_t off;
+	} gauges[] = {
+#define BENCH_MVRLU_GAUGE(x) { #x, offsetof(mvrlu_gauge_t, x) }
+		BENCH_MVRLU_GAUGE(nr_live_threads),
+		BENCH_MVRLU_GAUGE(nr_zombie_threads),
+		BENCH_MVRLU_GAUGE(log_used_bytes),
+		BENCH_MVRLU_GAUGE(max_thread_log_used_bytes),
+		BENCH_MVRLU_GAUGE(qp_period_usec),
+		BENCH_MVRLU_GAUGE(qp_wait_usec),
+		BENCH_MVRLU_GAUGE(qp_nap_usec),
+		BENCH_MVRLU_GAUGE(reclaim_bytes_per_sec),
+#undef BENCH_MVRLU_GAUGE
+	};
+	mvrlu_stat_t st;
+	int i, n = 0;
+
+	if (mvrlu_get_stats(&st, MVRLU_STAT_ALL))
+		return 0;
+	for (i = 0; i < MVRLU_STAT_NR && n < max; i++, n++) {
+		out[n].name = mvrlu_stat_name(i);
+		out[n].val = st.cnt[i];
+	}
+	for (i = 0; i < sizeof(gauges) / sizeof(gauges[0]) && n < max;
+	     i++, n++) {
+		out[n].name = gauges[i].name;
+		out[n].val = *(unsigned long *)((char *)&st.gauge +
+						gauges[i].off);
+	}
+	return n;
+}
+
+#endif
@@ -3,29 +3,7 @@
 #include <sys/time.h>
 
 #include "benchmark_list.h"
-#include "numa-config.h"
 #include "zipf/zipf.h"
-int getCPUid(int index, int reset);
-static void barrier_init(barrier_t *b, int n)
-{
-	pthread_cond_init(&b->complete, NULL);
-	pthread_mutex_init(&b->mutex, NULL);
-	b->count = n;
-	b->crossing = 0;
-}
-
-static void barrier_cross(barrier_t *b)
-{
-	pthread_mutex_lock(&b->mutex);
-	b->crossing++;
-	if (b->crossing < b->count)
-		pthread_cond_wait(&b->complete, &b->mutex);
-	else {
-		pthread_cond_broadcast(&b->complete);
-		b->crossing = 0;
-	}
-	pthread_mutex_unlock(&b->mutex);
-}
 
 #define DEFAULT_DURATION 1000
 #define DEFAULT_NTHREADS 1
@@ -45,6 +23,10 @@ void print_args(void)
 	printf("  -r: range of value (default %d)\n", DEFAULT_VRANGE);
 	printf("  -u: update ratio (0~1000, default %d/1000)\n", DEFAULT_URATIO);
 	printf("  -z: zipf-dist-val (greater than or equal 0, default %lf)\n", DEFAULT_ZIPF_DIST_VAL);
+	printf("  -s: random seed (default: time)\n");
+	printf("  -p: pin each thread to its own CPU\n");
+	printf("  -f: output format: text, json or csv (default text)\n");
+	printf("  -l: record the latency of every Nth operation (default 0: off)\n");
 }
 
 
@@ -52,7 +34,6 @@ void print_args(void)
 // GLOBALS
 //////////////////////////////////////
 static volatile int stop;
-static cpu_set_t cpu_set[450];
 
 static void *bench_thread(void *data)
 {
@@ -60,16 +41,15 @@ static void *bench_thread(void *data)
 	int key;
 	pthread_data_t *d = (pthread_data_t *)data;
 	struct zipf_state zs;
+	int sample = 0, kind;
+	unsigned long nr_abort = 0;
+	uint64_t lat_start = 0;
 
 	zipf_init(&zs, d->range, d->zipf_dist_val, rand_r(&d->seed));
 
 	// thread_init
 
-#ifdef THREAD_PINNING
-	sched_setaffinity(0, sizeof(cpu_set_t), &cpu_set[d->id]);
-#else
-	sched_setaffinity(0, sizeof(cpu_set_t), &cpu_set[0]);
-#endif
+	bench_cpu_bind(d->id);
 	barrier_cross(d->barrier);
 	while (stop == 0) {
 		// do somthing;
@@ -78,7 +58,13 @@ static void *bench_thread(void *data)
 			key = zipf_next(&zs);
 		else
 			key = rand_r(&d->seed) % d->range;
-		
+
+		if (d->lat_interval && --sample <= 0) {
+			sample = d->lat_interval;
+			nr_abort = d->nr_abort;
+			lat_start = lat_hist_now();
+		}
+
 		if (op < d->update_ratio) {
 			if (op < d->update_ratio / 2) {
 				list_ins(key, d);
@@ -87,9 +73,18 @@ static void *bench_thread(void *data)
 				list_del(key, d);
 				d->nr_del++;
 			}
+			kind = LAT_WRITE;
 		} else {
 			list_find(key, d);
 			d->nr_find++;
+			kind = LAT_READ;
+		}
+
+		if (lat_start) {
+			if (d->nr_abort != nr_abort)
+				kind = LAT_ABORT;
+			lat_hist_record(&d->lat[kind], lat_hist_now() - lat_start);
+			lat_start = 0;
 		}
 	}
 
@@ -98,39 +93,6 @@ static void *bench_thread(void *data)
 	return NULL;
 }
 
-int getCPUid(int index, int reset)
-{
-
-        static int cur_socket = 0;
-        static int cur_physical_cpu = 0;
-        static int cur_smt = 0;
-
-        if(reset){
-                cur_socket = 0;
-                cur_physical_cpu = 0;
-                cur_smt = 0;
-                return 1;
-        }
-
-        int ret_val = OS_CPU_ID[cur_socket][cur_physical_cpu][cur_smt];
-        cur_physical_cpu++;
-
-        if(cur_physical_cpu == NUM_PHYSICAL_CPU_PER_SOCKET){
-                cur_physical_cpu = 0;
-                cur_socket++;
-                if(cur_socket == NUM_SOCKET){
-                        cur_socket = 0;
-                        cur_smt++;
-                        if(cur_smt == SMT_LEVEL)
-                                cur_smt = 0;
-                }
-        }
-
-        return ret_val;
-
-}
-
-
 int main(int argc, char *argv[]) {
 	struct option bench_options[] = {
 		{"help",           no_argument,       NULL, 'h'},
@@ -139,6 +101,11 @@ int main(int argc, char *argv[]) {
 		{"initial-size",   required_argument, NULL, 'i'},
 		{"range",          required_argument, NULL, 'r'},
 		{"update-rate",    required_argument, NULL, 'u'},
+		{"zipf",           required_argument, NULL, 'z'},
+		{"seed",           required_argument, NULL, 's'},
+		{"pin",            no_argument,       NULL, 'p'},
+		{"format",         required_argument, NULL, 'f'},
+		{"latency",        required_argument, NULL, 'l'},
 		{0,                0,                 0,    0  }
 	};
 
@@ -158,11 +125,19 @@ int main(int argc, char *argv[]) {
 	int zipf = 0;
 	double zipf_dist_val = DEFAULT_ZIPF_DIST_VAL;
 	void *list;
+	unsigned int seed = time(0);
+	int pinning = BENCH_PIN_SHARED;
+	int format = BENCH_FMT_TEXT;
+	bench_result_t res = { 0 };
+	int lat_interval = 0;
+	struct lat_hist *lat = NULL;
+	uint64_t tsc_start, tsc_end;
+	double cycles_per_ns;
 
 	stop = 0;
 
 	while (1) {
-		c = getopt_long(argc, argv, "hd:n:i:r:u:z:", bench_options, &i);
+		c = getopt_long(argc, argv, "hd:n:i:r:u:z:s:pf:l:", bench_options, &i);
 
 		if (c == -1)
 			break;
@@ -192,6 +167,22 @@ int main(int argc, char *argv[]) {
 		case 'z':
 			zipf_dist_val = atof(optarg);
 			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			pinning = BENCH_PIN_THREAD;
+			break;
+		case 'f':
+			format = bench_parse_format(optarg);
+			if (format < 0) {
+				printf("unknown output format %s\n", optarg);
+				goto out;
+			}
+			break;
+		case 'l':
+			lat_interval = atoi(optarg);
+			break;
 		default:
 			printf("Error while processing options.\n");
 			goto out;
@@ -214,6 +205,10 @@ int main(int argc, char *argv[]) {
 		printf("update ratio should be between 0 and 1000\n");
 		goto out;
 	}
+	if (lat_interval < 0) {
+		printf("latency sampling interval should not be negative\n");
+		goto out;
+	}
 	if (zipf_dist_val < 0.0) {
 		printf("zipf dist val should be greater than or equal 0\n");
 		goto out;
@@ -222,14 +217,16 @@ int main(int argc, char *argv[]) {
 	if (zipf_dist_val > 0.0)
 		zipf = 1;
 
-	printf("List benchmark\n");
-	printf("Test time:     %d\n", duration);
-	printf("Thread number: %d\n", nr_threads);
-	printf("Initial size:  %d\n", init_size);
-	printf("Value range:   %d\n", value_range);
-	printf("Update Ratio:  %d/1000\n", update_ratio);
-	printf("Zipf dist:     %d\n", zipf);
-	printf("Zipf dist val: %lf\n", zipf_dist_val);
+	if (format == BENCH_FMT_TEXT) {
+		printf("List benchmark\n");
+		printf("Test time:     %d\n", duration);
+		printf("Thread number: %d\n", nr_threads);
+		printf("Initial size:  %d\n", init_size);
+		printf("Value range:   %d\n", value_range);
+		printf("Update Ratio:  %d/1000\n", update_ratio);
+		printf("Zipf dist:     %d\n", zipf);
+		printf("Zipf dist val: %lf\n", zipf_dist_val);
+	}
 
 	timeout.tv_sec = duration / 1000;
 	timeout.tv_nsec = (duration % 1000) * 1000000;
@@ -249,42 +246,43 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
-	srand(time(0));
+	if (lat_interval) {
+		lat = calloc((nr_threads + 1) * LAT_NR, sizeof(*lat));
+		if (lat == NULL) {
+			printf("failed to malloc latency histograms\n");
+			goto out;
+		}
+	}
+
+	srand(seed);
 	// global init
 	if ((list = list_global_init(init_size, value_range)) == NULL) {
 		printf("failed to do list_global_init\n");
 		goto out;
 	}
-#ifndef THREAD_PINNING
-	int j = 0;
-	CPU_ZERO(&cpu_set[0]);
-	for(j = 0; j < nr_threads;j++){
-		int cpuid = getCPUid(j,0);
-		CPU_SET(cpuid, &cpu_set[0]);
-	}
-	getCPUid(0,1);
+#ifdef THREAD_PINNING
+	pinning = BENCH_PIN_THREAD;
 #endif
+	bench_cpu_init(nr_threads, pinning);
 
 	barrier_init(&barrier, nr_threads + 1);
 	pthread_attr_init(&attr);
 	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
 	for (i = 0; i < nr_threads; i++) {
-#ifdef THREAD_PINNING
-		int cpuid = getCPUid(i, 0);
-		CPU_ZERO(&cpu_set[i]);
-		CPU_SET(cpuid, &cpu_set[i]);
-#endif
 		data[i]->id = i;
 		data[i]->nr_ins = 0;
 		data[i]->nr_del = 0;
 		data[i]->nr_find = 0;
 		data[i]->nr_txn = 0;
+		data[i]->nr_abort = 0;
 		data[i]->range = value_range;
 		data[i]->update_ratio = update_ratio;
 		data[i]->seed = rand();
 		data[i]->zipf = zipf;
 		data[i]->zipf_dist_val = zipf_dist_val;
 		data[i]->barrier = &barrier;
+		data[i]->lat_interval = lat_interval;
+		data[i]->lat = lat ? &lat[(i + 1) * LAT_NR] : NULL;
 		data[i]->list = list;
 		if (list_thread_init(data[i], data, nr_threads)) {
 			printf("failed to do list_thread_init\n");
@@ -297,14 +295,18 @@ int main(int argc, char *argv[]) {
 	}
 	pthread_attr_destroy(&attr);
 
-	printf("STARTING THREADS...\n");
+	if (format == BENCH_FMT_TEXT)
+		printf("STARTING THREADS...\n");
 	barrier_cross(&barrier);
 
 	gettimeofday(&start, NULL);
+	tsc_start = lat_hist_now();
 	nanosleep(&timeout, NULL);
 	stop = 1;
+	tsc_end = lat_hist_now();
 	gettimeofday(&end, NULL);
-	printf("STOPPING THREADS...\n");
+	if (format == BENCH_FMT_TEXT)
+		printf("STOPPING THREADS...\n");
 
 	for (i = 0; i < nr_threads; i++) {
 		if (pthread_join(threads[i], NULL) != 0) {
@@ -315,6 +317,41 @@ int main(int argc, char *argv[]) {
 
 	duration = (end.tv_sec * 1000 + end.tv_usec / 1000) -
 	           (start.tv_sec * 1000 + start.tv_usec / 1000);
+	cycles_per_ns = (tsc_end - tsc_start) / (duration * 1000000.0);
+	if (lat) {
+		/* lat[0 .. LAT_NR) holds the merged histograms */
+		for (i = 0; i < nr_threads; i++) {
+			int k;
+
+			for (k = 0; k < LAT_NR; k++)
+				lat_hist_merge(&lat[k], &data[i]->lat[k]);
+		}
+	}
+	if (format != BENCH_FMT_TEXT) {
+		res.backend = bench_lookup_backend(argv[0]);
+		res.nr_threads = nr_threads;
+		res.duration = duration;
+		res.init_size = init_size;
+		res.value_range = value_range;
+		res.update_ratio = update_ratio;
+		res.zipf_dist_val = zipf_dist_val;
+		res.seed = seed;
+		res.lat = lat;
+		res.cycles_per_ns = cycles_per_ns;
+		res.threads = calloc(nr_threads, sizeof(*res.threads));
+		if (res.threads) {
+			for (i = 0; i < nr_threads; i++) {
+				res.threads[i].nr_read = data[i]->nr_find;
+				res.threads[i].nr_write = data[i]->nr_ins + data[i]->nr_del;
+				res.threads[i].nr_txn = data[i]->nr_txn;
+				res.threads[i].nr_abort = data[i]->nr_abort;
+			}
+			bench_report(stdout, format, &res);
+			free(res.threads);
+		}
+		goto free_out;
+	}
+
 	nr_read = 0;
 	nr_write = 0;
 	nr_txn = 0;
@@ -334,12 +371,18 @@ int main(int argc, char *argv[]) {
 	printf("  txn:      %lu (%f/s)\n", nr_txn, (nr_txn) * 1000.0 / duration);
 	printf("  abort_ratio:      %f \n", 1.0*(nr_abort)/(nr_read+nr_write+nr_abort));
 	printf("  abort:      %lu \n", (nr_abort));
+	if (lat) {
+		for (i = 0; i < LAT_NR; i++)
+			lat_hist_print(stdout, lat_hist_names[i], &lat[i], cycles_per_ns);
+	}
 
+free_out:
 	for (i = 0; i < nr_threads; i++)
 		free_pthread_data(data[i]);
 	list_global_exit(list);
 	free(data);
 	free(threads);
+	free(lat);
 
 out:
 	return 0;
@@ -6,12 +6,7 @@
 #include <pthread.h>
 #include <limits.h>
 
-typedef struct barrier {
-	pthread_cond_t complete;
-	pthread_mutex_t mutex;
-	int count;
-	int crossing;
-} barrier_t;
+#include "bench_harness.h"
 
 #define CACHE_ALIGN (192)
 
@@ -33,6 +28,8 @@ typedef struct pthread_data {
 	int zipf;
 	double zipf_dist_val;
 	barrier_t *barrier;
+	int lat_interval; // record the latency of every Nth operation, 0 = off
+	struct lat_hist *lat; // LAT_NR histograms
 	void *list;
 	void *ds_data; // data structure specific data
 } pthread_data_t;
@@ -3,27 +3,6 @@
 
 #include "benchmark_list_move.h"
 
-static void barrier_init(barrier_t *b, int n)
-{
-	pthread_cond_init(&b->complete, NULL);
-	pthread_mutex_init(&b->mutex, NULL);
-	b->count = n;
-	b->crossing = 0;
-}
-
-static void barrier_cross(barrier_t *b)
-{
-	pthread_mutex_lock(&b->mutex);
-	b->crossing++;
-	if (b->crossing < b->count)
-		pthread_cond_wait(&b->complete, &b->mutex);
-	else {
-		pthread_cond_broadcast(&b->complete);
-		b->crossing = 0;
-	}
-	pthread_mutex_unlock(&b->mutex);
-}
-
 #define DEFAULT_DURATION 1000
 #define DEFAULT_NTHREADS 1
 #define DEFAULT_ISIZE    256
@@ -38,6 +17,9 @@ void print_args(void)
 	printf("  -n: number of threads (default %d)\n", DEFAULT_NTHREADS);
 	printf("  -i: initial size of the list (default %d)\n", DEFAULT_ISIZE);
 	printf("  -r: range of value (default %d)\n", DEFAULT_VRANGE);
+	printf("  -s: random seed (default: time)\n");
+	printf("  -p: pin each thread to its own CPU\n");
+	printf("  -f: output format: text, json or csv (default text)\n");
 }
 
 static volatile int stop;
@@ -49,6 +31,7 @@ static void *bench_thread(void *data)
 	pthread_data_t *d = (pthread_data_t *)data;
 
 	// thread_init
+	bench_cpu_bind(d->id);
 
 	barrier_cross(d->barrier);
 	while (stop == 0) {
@@ -72,6 +55,9 @@ int main(int argc, char *argv[])
 		{"num-of-threads", required_argument, NULL, 'n'},
 		{"initial-size",   required_argument, NULL, 'i'},
 		{"range",          required_argument, NULL, 'r'},
+		{"seed",           required_argument, NULL, 's'},
+		{"pin",            no_argument,       NULL, 'p'},
+		{"format",         required_argument, NULL, 'f'},
 		{0,                0,                 0,    0  }
 	};
 
@@ -88,11 +74,15 @@ int main(int argc, char *argv[])
 	struct timespec timeout;
 	unsigned long nr_move, nr_txn;
 	void *list;
+	unsigned int seed = time(0);
+	int pinning = BENCH_PIN_SHARED;
+	int format = BENCH_FMT_TEXT;
+	bench_result_t res = { 0 };
 
 	stop = 0;
 
 	while (1) {
-		c = getopt_long(argc, argv, "hd:n:i:r:", bench_options, &i);
+		c = getopt_long(argc, argv, "hd:n:i:r:s:pf:", bench_options, &i);
 
 		if (c == -1)
 			break;
@@ -116,6 +106,19 @@ int main(int argc, char *argv[])
 		case 'r':
 			value_range = atoi(optarg);
 			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			pinning = BENCH_PIN_THREAD;
+			break;
+		case 'f':
+			format = bench_parse_format(optarg);
+			if (format < 0) {
+				printf("unknown output format %s\n", optarg);
+				goto out;
+			}
+			break;
 		default:
 			printf("Error while processing options.\n");
 			goto out;
@@ -135,11 +138,13 @@ int main(int argc, char *argv[])
 		goto out;
 	}
 
-	printf("List move benchmark\n");
-	printf("Test time:     %d\n", duration);
-	printf("Thread number: %d\n", nr_threads);
-	printf("Initial size:  %d\n", init_size);
-	printf("Value range:   %d\n", value_range);
+	if (format == BENCH_FMT_TEXT) {
+		printf("List move benchmark\n");
+		printf("Test time:     %d\n", duration);
+		printf("Thread number: %d\n", nr_threads);
+		printf("Initial size:  %d\n", init_size);
+		printf("Value range:   %d\n", value_range);
+	}
 
 	timeout.tv_sec = duration / 1000;
 	timeout.tv_nsec = (duration % 1000) * 1000000;
@@ -159,13 +164,18 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	srand(time(0));
+	srand(seed);
 	// global init
 	if ((list = list_global_init(init_size, value_range)) == NULL) {
 		printf("failed to do list_global_init\n");
 		goto out;
 	}
 
+#ifdef THREAD_PINNING
+	pinning = BENCH_PIN_THREAD;
+#endif
+	bench_cpu_init(nr_threads, pinning);
+
 	barrier_init(&barrier, nr_threads + 1);
 	pthread_attr_init(&attr);
 	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
@@ -188,14 +198,16 @@ int main(int argc, char *argv[])
 	}
 	pthread_attr_destroy(&attr);
 
-	printf("STARTING THREADS...\n");
+	if (format == BENCH_FMT_TEXT)
+		printf("STARTING THREADS...\n");
 	barrier_cross(&barrier);
 
 	gettimeofday(&start, NULL);
 	nanosleep(&timeout, NULL);
 	stop = 1;
 	gettimeofday(&end, NULL);
-	printf("STOPPING THREADS...\n");
+	if (format == BENCH_FMT_TEXT)
+		printf("STOPPING THREADS...\n");
 
 	for (i = 0; i < nr_threads; i++) {
 		if (pthread_join(threads[i], NULL) != 0) {
@@ -206,6 +218,28 @@ int main(int argc, char *argv[])
 
 	duration = (end.tv_sec * 1000 + end.tv_usec / 1000) -
 	           (start.tv_sec * 1000 + start.tv_usec / 1000);
+	if (format != BENCH_FMT_TEXT) {
+		res.backend = bench_lookup_backend(argv[0]);
+		res.nr_threads = nr_threads;
+		res.duration = duration;
+		res.init_size = init_size;
+		res.value_range = value_range;
+		res.update_ratio = -1;
+		res.zipf_dist_val = 0.0;
+		res.seed = seed;
+		res.lat = NULL;
+		res.threads = calloc(nr_threads, sizeof(*res.threads));
+		if (res.threads) {
+			for (i = 0; i < nr_threads; i++) {
+				res.threads[i].nr_write = data[i]->nr_move;
+				res.threads[i].nr_txn = data[i]->nr_txn;
+			}
+			bench_report(stdout, format, &res);
+			free(res.threads);
+		}
+		goto free_out;
+	}
+
 	nr_move = 0;
 	nr_txn = 0;
 	for (i = 0;  i < nr_threads; i++) {
@@ -219,6 +253,7 @@ int main(int argc, char *argv[])
 	printf("  ops:      %lu (%f/s)\n", nr_move, (nr_move) * 1000.0 / duration);
 	printf("  txns:     %lu (%f/s)\n", nr_txn, (nr_txn) * 1000.0 / duration);
 
+free_out:
 	for (i = 0; i < nr_threads; i++)
 		free_pthread_data(data[i]);
 	list_global_exit(list);
@@ -6,12 +6,7 @@
 #include <pthread.h>
 #include <limits.h>
 
-typedef struct barrier {
-	pthread_cond_t complete;
-	pthread_mutex_t mutex;
-	int count;
-	int crossing;
-} barrier_t;
+#include "bench_harness.h"
 
 #define CACHE_ALIGN (64)
 
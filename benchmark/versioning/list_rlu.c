@@ -1,6 +1,7 @@
 #include "benchmark_list.h"
 #ifdef MVRLU
 #include "mvrlu.h"
+#include "bench_mvrlu.h"
 #else
 #include "rlu.h"
 #endif
@@ -80,6 +81,9 @@ void *list_global_init(int init_size, int value_range)
 	node->next = NULL;
 
 	RLU_INIT();
+#ifdef MVRLU
+	bench_set_lib_stats(bench_mvrlu_stats);
+#endif
 
 	return list;
 }
@@ -102,7 +106,7 @@ int list_ins(int key, pthread_data_t *data)
 {
 	rlu_list_t *list = (rlu_list_t *)data->list;
 	rlu_thread_data_t *rlu_data = (rlu_thread_data_t *)data->ds_data;
-	node_t *prev, *next, *new_node;
+	node_t *prev, *next, *new_node = NULL;
 	int ret, val;
 
 restart:
@@ -121,10 +125,12 @@ restart:
 
 	if (ret) {
 		if (!RLU_TRY_LOCK(rlu_data, &prev)) {
+			data->nr_abort++;
 			RLU_ABORT(rlu_data);
 			goto restart;
 		}
-		if (!RLU_TRY_LOCK(rlu_data, &next)) {
+		if (!RLU_TRACK_READ(rlu_data, next)) {
+			data->nr_abort++;
 			RLU_ABORT(rlu_data);
 			goto restart;
 		}
@@ -135,7 +141,12 @@ restart:
 		RLU_ASSIGN_PTR(rlu_data, &(prev->next), new_node);
 	}
 
-	RLU_READER_UNLOCK(rlu_data);
+	if (!RLU_READER_UNLOCK_VALID(rlu_data)) {
+		/* Nobody has seen the new node */
+		RLU_FREE(NULL, new_node);
+		data->nr_abort++;
+		goto restart;
+	}
 
 	return ret;
 }
@@ -165,10 +176,12 @@ restart:
 	if (ret) {
 		n = (node_t *)RLU_DEREF(rlu_data, (next->next));
 		if (!RLU_TRY_LOCK(rlu_data, &prev)) {
+			data->nr_abort++;
 			RLU_ABORT(rlu_data);
 			goto restart;
 		}
 		if (!RLU_TRY_LOCK(rlu_data, &next)) {
+			data->nr_abort++;
 			RLU_ABORT(rlu_data);
 			goto restart;
 		}
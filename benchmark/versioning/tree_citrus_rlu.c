@@ -1,6 +1,7 @@
 #include "benchmark_list.h"
 #ifdef MVRLU
 #include "mvrlu.h"
+#include "bench_mvrlu.h"
 #else
 #include "rlu.h"
 #endif
@@ -141,6 +142,9 @@ void *list_global_init(int init_size, int value_range)
 #endif
 
 	RLU_INIT();
+#ifdef MVRLU
+	bench_set_lib_stats(bench_mvrlu_stats);
+#endif
 
 	return tree;
 }
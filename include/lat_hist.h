@@ -0,0 +1,141 @@
+// SPDX-FileCopyrightText: Copyright (c) 2018-2019 Virginia Tech
+// SPDX-License-Identifier: Apache-2.0
+#ifndef _LAT_HIST_H
+#define _LAT_HIST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Log-bucketed latency histogram for benchmark drivers
+ *
+ * Values are TSC cycles. Each power of two is split into LAT_HIST_SUB
+ * linear sub-buckets (HDR-style), so a recorded value is reported with
+ * at most 1/LAT_HIST_SUB relative error. A histogram belongs to one
+ * thread and is only merged after the threads are joined.
+ */
+#define LAT_HIST_SUB_BITS 5
+#define LAT_HIST_SUB (1 << LAT_HIST_SUB_BITS)
+#define LAT_HIST_NR_BUCKETS ((64 - LAT_HIST_SUB_BITS + 1) * LAT_HIST_SUB)
+
+enum {
+	LAT_READ = 0,
+	LAT_WRITE,
+	LAT_ABORT, /* operations that aborted and retried at least once */
+	LAT_NR,
+};
+
+struct lat_hist {
+	uint64_t count;
+	uint64_t max;
+	uint64_t bucket[LAT_HIST_NR_BUCKETS];
+};
+
+static const char *const lat_hist_names[LAT_NR] = { "read", "write",
+						     "abort" };
+
+static inline uint64_t __attribute__((__always_inline__)) lat_hist_now(void)
+{
+	uint32_t a, d;
+	__asm __volatile("rdtsc" : "=a"(a), "=d"(d)::"memory");
+	return ((uint64_t)a) | (((uint64_t)d) << 32);
+}
+
+static inline unsigned int lat_hist_index(uint64_t v)
+{
+	unsigned int e;
+
+	if (v < LAT_HIST_SUB)
+		return v;
+	e = 63 - __builtin_clzll(v);
+	return (e - LAT_HIST_SUB_BITS + 1) * LAT_HIST_SUB +
+	       ((v >> (e - LAT_HIST_SUB_BITS)) & (LAT_HIST_SUB - 1));
+}
+
+static inline uint64_t lat_hist_value(unsigned int idx)
+{
+	unsigned int e;
+
+	/* Highest value that falls into the bucket */
+	if (idx < LAT_HIST_SUB)
+		return idx;
+	e = idx / LAT_HIST_SUB + LAT_HIST_SUB_BITS - 1;
+	return ((1ULL << e) | ((uint64_t)(idx % LAT_HIST_SUB)
+			       << (e - LAT_HIST_SUB_BITS))) +
+	       (1ULL << (e - LAT_HIST_SUB_BITS)) - 1;
+}
+
+static inline void lat_hist_init(struct lat_hist *h)
+{
+	memset(h, 0, sizeof(*h));
+}
+
+static inline void lat_hist_record(struct lat_hist *h, uint64_t cycles)
+{
+	h->bucket[lat_hist_index(cycles)]++;
+	h->count++;
+	if (cycles > h->max)
+		h->max = cycles;
+}
+
+static inline void lat_hist_merge(struct lat_hist *dst,
+				  const struct lat_hist *src)
+{
+	unsigned int i;
+
+	for (i = 0; i < LAT_HIST_NR_BUCKETS; i++)
+		dst->bucket[i] += src->bucket[i];
+	dst->count += src->count;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+/* Value at quantile q (0 < q <= 1), in cycles */
+static inline uint64_t lat_hist_quantile(const struct lat_hist *h, double q)
+{
+	uint64_t target, sum = 0, v;
+	unsigned int i;
+
+	if (!h->count)
+		return 0;
+	target = (uint64_t)(q * h->count);
+	if (target < q * h->count)
+		target++;
+	if (!target)
+		target = 1;
+	for (i = 0; i < LAT_HIST_NR_BUCKETS; i++) {
+		sum += h->bucket[i];
+		if (sum >= target) {
+			v = lat_hist_value(i);
+			return v < h->max ? v : h->max;
+		}
+	}
+	return h->max;
+}
+
+static inline void lat_hist_print(FILE *fp, const char *name,
+				  const struct lat_hist *h,
+				  double cycles_per_ns)
+{
+	if (cycles_per_ns <= 0.0)
+		cycles_per_ns = 1.0;
+	fprintf(fp,
+		"  %-5s latency (ns): count %lu p50 %.0f p99 %.0f "
+		"p99.9 %.0f max %.0f\n",
+		name, (unsigned long)h->count,
+		lat_hist_quantile(h, 0.5) / cycles_per_ns,
+		lat_hist_quantile(h, 0.99) / cycles_per_ns,
+		lat_hist_quantile(h, 0.999) / cycles_per_ns,
+		h->max / cycles_per_ns);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LAT_HIST_H */
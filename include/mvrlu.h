@@ -17,9 +17,75 @@ extern "C" {
 #endif /* __KERNEL__ */
 
 /*
- * Forward declaration of mvrlu_thread_struct_t
+ * Forward declaration of mvrlu_thread_struct_t and mvrlu_task_struct_t
  */
 typedef struct mvrlu_thread_struct mvrlu_thread_struct_t;
+typedef struct mvrlu_task_struct mvrlu_task_struct_t;
+
+/*
+ * Runtime statistics
+ */
+#define MVRLU_STAT_NAMES(S)                                                    \
+	S(n_starts)                                                            \
+	S(n_finish)                                                            \
+	S(n_aborts)                                                            \
+	S(n_low_mark_wakeup)                                                   \
+	S(n_high_mark_block)                                                   \
+	S(max_log_used_bytes)                                                  \
+	S(n_reclaim)                                                           \
+	S(n_reclaim_wrt_set)                                                   \
+	S(n_reclaim_copy)                                                      \
+	S(n_reclaim_free)                                                      \
+	S(n_qp_detect)                                                         \
+	S(n_qp_nap)                                                            \
+	S(n_qp_help_reclaim)                                                   \
+	S(n_qp_zombie_reclaim)                                                 \
+	S(n_task_expired)                                                      \
+	S(max_qp_wait_usec)                                                    \
+	S(n_qp_back_to_back)                                                   \
+	S(sum_qp_nap_usec)                                                     \
+	S(n_reclaim_steal)                                                     \
+	S(sum_reclaim_bytes)                                                   \
+	S(sum_reclaim_nsecs)                                                   \
+	S(sum_log_bytes)                                                       \
+	S(sum_writeback_bytes)                                                 \
+	S(n_diff_copy)                                                         \
+	S(n_diff_overlay)                                                      \
+	S(n_diff_overlay_scratch)                                              \
+	S(n_read_set_abort)                                                    \
+	S(n_abort_locked)                                                      \
+	S(n_abort_newer)                                                       \
+	S(n_abort_cas)                                                         \
+	S(n_abort_aba)
+
+#define __MVRLU_STAT_ID(x) MVRLU_STAT_##x,
+enum { MVRLU_STAT_NAMES(__MVRLU_STAT_ID) MVRLU_STAT_NR };
+
+/* Length of the version chains walked by mvrlu_deref(): 1, 2, 3-4, 5-8,
+ * ..., and more than 64 copies in the last bucket. */
+#define MVRLU_CHAIN_HIST_NR 8
+
+typedef struct mvrlu_gauge {
+	unsigned long nr_live_threads;
+	unsigned long nr_zombie_threads;
+	unsigned long log_used_bytes; /* sum over the threads in the snapshot */
+	unsigned long max_thread_log_used_bytes;
+	unsigned long qp_period_usec; /* last quiescent period detected */
+	unsigned long qp_wait_usec; /* time spent waiting in that period */
+	unsigned long qp_nap_usec; /* nap chosen before the next period */
+	unsigned long reclaim_bytes_per_sec; /* while log_reclaim() runs */
+} mvrlu_gauge_t;
+
+typedef struct mvrlu_stat {
+	unsigned long cnt[MVRLU_STAT_NR];
+	unsigned long chain_len[MVRLU_CHAIN_HIST_NR];
+	mvrlu_gauge_t gauge; /* only filled by mvrlu_get_stats() */
+} mvrlu_stat_t;
+
+/* mvrlu_get_stats() flags */
+#define MVRLU_STAT_LIVE 0x1 /* add counters of running threads */
+#define MVRLU_STAT_GAUGE 0x2 /* fill gauges */
+#define MVRLU_STAT_ALL (MVRLU_STAT_LIVE | MVRLU_STAT_GAUGE)
 
 /*
  * MV-RLU API
@@ -27,6 +93,11 @@ typedef struct mvrlu_thread_struct mvrlu_thread_struct_t;
 int mvrlu_init(void);
 void mvrlu_finish(void);
 void mvrlu_print_stats(void);
+int mvrlu_get_stats(mvrlu_stat_t *out, int flags);
+int mvrlu_get_thread_stats(mvrlu_thread_struct_t *self, mvrlu_stat_t *out);
+const char *mvrlu_stat_name(int s);
+int mvrlu_gc_trace_dump(const char *path);
+void mvrlu_print_contention(void);
 
 mvrlu_thread_struct_t *mvrlu_thread_alloc(void);
 void mvrlu_thread_free(mvrlu_thread_struct_t *self);
@@ -36,15 +107,132 @@ void mvrlu_thread_finish(mvrlu_thread_struct_t *self);
 
 void *mvrlu_alloc(size_t size);
 void *mvrlu_alloc_x(size_t size, unsigned int flags);
+void *mvrlu_alloc_diff(size_t size);
 void mvrlu_free(mvrlu_thread_struct_t *self, void *p_obj);
+void *mvrlu_realloc(mvrlu_thread_struct_t *self, void *p_obj, size_t size);
 
 void mvrlu_reader_lock(mvrlu_thread_struct_t *self);
-void mvrlu_reader_unlock(mvrlu_thread_struct_t *self);
+int mvrlu_reader_unlock(mvrlu_thread_struct_t *self);
 void mvrlu_abort(mvrlu_thread_struct_t *self);
 
+/*
+ * Read-set validation
+ *
+ * A section reads a snapshot, so a writer whose update depends on an
+ * object it does not change has to lock that object as well. Instead,
+ * mvrlu_track_read() adds the object to the read set of the section.
+ * At commit, mvrlu_reader_unlock() checks that no other thread has
+ * locked any of them or committed a newer version since the snapshot.
+ * If one did, it aborts the section and returns 0, and the caller
+ * restarts. mvrlu_track_read() returns 0 if the object has already
+ * changed, and the caller aborts. A full read set (MVRLU_MAX_READ_SET)
+ * const-locks the object instead. Sections without writes are not
+ * validated. A task keeps its read set across mvrlu_task_suspend() and
+ * mvrlu_task_resume(), so the reads it tracked on any thread are
+ * validated when it commits.
+ */
+int mvrlu_track_read(mvrlu_thread_struct_t *self, void *p_obj);
+
+/*
+ * Abort reasons
+ *
+ * A try_lock or mvrlu_track_read() that fails, and a commit that fails
+ * its read-set validation, leave the reason in the thread until the
+ * next section starts; mvrlu_abort_reason() returns it. mvrlu_abort()
+ * counts the abort under the reason of the last failure (n_abort_*,
+ * n_read_set_abort). MVRLU_ABORT_NONE means that nothing failed, e.g.,
+ * the caller aborts on its own.
+ */
+enum { MVRLU_ABORT_NONE = 0,
+       MVRLU_ABORT_LOCKED, /* p_lock is held by another thread */
+       MVRLU_ABORT_NEWER, /* the head copy is newer than the snapshot */
+       MVRLU_ABORT_CAS, /* another thread took p_lock or committed first */
+       MVRLU_ABORT_ABA, /* a copy was committed while taking p_lock */
+       MVRLU_ABORT_READ_SET, /* the read-set validation at commit failed */
+       MVRLU_ABORT_RO, /* try_lock in a read-only section */
+       MVRLU_ABORT_NR,
+};
+
+int mvrlu_abort_reason(mvrlu_thread_struct_t *self);
+
+/*
+ * Read-only critical sections
+ *
+ * mvrlu_reader_lock_ro() enters a section that only dereferences
+ * objects. It skips the log maintenance and statistics of
+ * mvrlu_reader_lock(); the next write section catches up. A try_lock
+ * in it fails (and asserts in debug builds), so the caller aborts with
+ * mvrlu_abort(). Leave it with mvrlu_reader_unlock_ro().
+ */
+void mvrlu_reader_lock_ro(mvrlu_thread_struct_t *self);
+void mvrlu_reader_unlock_ro(mvrlu_thread_struct_t *self);
+
+/*
+ * Tasks: critical sections that outlive a suspension point
+ *
+ * A task (e.g., a coroutine) keeps one snapshot from
+ * mvrlu_task_reader_lock() to mvrlu_task_reader_unlock() or
+ * mvrlu_task_abort() and may move between threads in between. The
+ * thread running it is passed as self; the task leaves it with
+ * mvrlu_task_suspend() and enters another with mvrlu_task_resume().
+ * Objects are locked in the log of the thread, so a task must not
+ * suspend with objects locked or freed: lock, update and unlock
+ * without suspending. A suspended snapshot delays reclamation like a
+ * long reader, so instead of waiting for a nearly full log both
+ * mvrlu_task_reader_lock() and mvrlu_task_resume() return -EAGAIN;
+ * the latter also drops the snapshot. The qp thread waits at most
+ * MVRLU_QP_TASK_WAIT_USEC per round for suspended tasks and then
+ * expires their snapshots; mvrlu_task_resume() of an expired task
+ * returns -EAGAIN as well (n_task_expired). Run other tasks, then
+ * restart the task with mvrlu_task_reader_lock().
+ */
+mvrlu_task_struct_t *mvrlu_task_alloc(void);
+void mvrlu_task_free(mvrlu_task_struct_t *task);
+void mvrlu_task_init(mvrlu_task_struct_t *task);
+void mvrlu_task_finish(mvrlu_task_struct_t *task);
+
+int mvrlu_task_reader_lock(mvrlu_thread_struct_t *self,
+			   mvrlu_task_struct_t *task);
+void mvrlu_task_suspend(mvrlu_thread_struct_t *self, mvrlu_task_struct_t *task);
+int mvrlu_task_resume(mvrlu_thread_struct_t *self, mvrlu_task_struct_t *task);
+int mvrlu_task_reader_unlock(mvrlu_thread_struct_t *self,
+			     mvrlu_task_struct_t *task);
+void mvrlu_task_abort(mvrlu_thread_struct_t *self, mvrlu_task_struct_t *task);
+
+/*
+ * Variable-length objects
+ *
+ * mvrlu_try_lock() copies sizeof(**p_p_obj) bytes, which misses data
+ * past the end of the type. mvrlu_try_lock_full() copies the size the
+ * object was allocated with; mvrlu_try_lock_range() also declares that
+ * only len bytes at off change. mvrlu_realloc() resizes an object
+ * locked in this write set: it returns a new object with the content of
+ * the locked copy, to be published through a locked pointer, and frees
+ * the old one at commit. New objects are freed if the write set aborts.
+ */
 int _mvrlu_try_lock(mvrlu_thread_struct_t *self, void **p_p_obj, size_t size);
+int _mvrlu_try_lock_full(mvrlu_thread_struct_t *self, void **p_p_obj);
+int _mvrlu_try_lock_range(mvrlu_thread_struct_t *self, void **p_p_obj,
+			  size_t off, size_t len);
 int _mvrlu_try_lock_const(mvrlu_thread_struct_t *self, void *obj, size_t size);
 
+/*
+ * Diff copies
+ *
+ * A copy of an object from mvrlu_alloc_diff() keeps only the chunks, of
+ * 1/64 of the object in whole cache lines, that may differ from the
+ * actual object, and its write-back touches only those. A copy is as
+ * dirty as the version it was made from plus the range given to
+ * mvrlu_try_lock_range(); other try_locks dirty the whole copy. Declare
+ * further ranges of a locked copy with mvrlu_mark_dirty() and never
+ * change a byte outside of them. A reader of a copy younger than two
+ * quiescent periods rebuilds it in its own log, so the copies a critical
+ * section reads count toward the log like the ones it writes. Ignored
+ * in durable and shm mode.
+ */
+void mvrlu_mark_dirty(mvrlu_thread_struct_t *self, void *p_obj, size_t off,
+		      size_t len);
+
 int mvrlu_cmp_ptrs(void *p_obj_1, void *p_obj_2);
 
 void _mvrlu_assign_pointer(void **p_ptr, void *p_obj);
@@ -54,11 +242,48 @@ void mvrlu_dump_stack(void);
 void mvrlu_attach_gdb(void);
 
 void mvrlu_flush_log(mvrlu_thread_struct_t *self);
+void mvrlu_reclaim_log(mvrlu_thread_struct_t *self);
+int mvrlu_help_reclaim(mvrlu_thread_struct_t *self, unsigned long usecs);
+
+/*
+ * Durable MV-RLU (user space only)
+ *
+ * mvrlu_durable_init() replaces mvrlu_init(). It maps the file at a
+ * fixed address, creating it with the given size if it is new, replays
+ * the write sets committed before a crash and returns 1 if the file
+ * was recovered, 0 if it is new or a negative errno. Objects from
+ * mvrlu_alloc() then live in the file and a commit is durable once
+ * mvrlu_reader_unlock() returns. Persistent data is found again through
+ * the root pointer.
+ */
+#define MVRLU_DURABLE_SYNC_NONE 0 /* survive process crashes only */
+#define MVRLU_DURABLE_SYNC_MSYNC 1 /* msync() at every commit */
+#define MVRLU_DURABLE_SYNC_CLWB 2 /* cache line write-back, for DAX files */
+
+int mvrlu_durable_init(const char *path, size_t size, int sync);
+void *mvrlu_durable_get_root(void);
+void mvrlu_durable_set_root(void *p_obj);
+
+/*
+ * Shared-memory MV-RLU (user space only)
+ *
+ * mvrlu_shm_init() replaces mvrlu_init() in every process sharing the
+ * durable file at path. The first process creates or recovers it like
+ * mvrlu_durable_init() without syncing; the others attach to it. It
+ * returns 1 if it attached, 0 otherwise or a negative errno. Objects,
+ * locks and the root pointer are shared by all processes; the threads
+ * of a process that dies are aborted or committed and reaped.
+ */
+int mvrlu_shm_init(const char *path, size_t size);
 
 #define mvrlu_try_lock(self, p_p_obj)                                          \
 	_mvrlu_try_lock(self, (void **)p_p_obj, sizeof(**p_p_obj))
 #define mvrlu_try_lock_const(self, obj)                                        \
 	_mvrlu_try_lock_const(self, obj, sizeof(*obj))
+#define mvrlu_try_lock_full(self, p_p_obj)                                     \
+	_mvrlu_try_lock_full(self, (void **)p_p_obj)
+#define mvrlu_try_lock_range(self, p_p_obj, off, len)                          \
+	_mvrlu_try_lock_range(self, (void **)p_p_obj, off, len)
 #define mvrlu_assign_ptr(self, p_ptr, p_obj)                                   \
 	_mvrlu_assign_pointer((void **)p_ptr, p_obj)
 
@@ -96,19 +321,44 @@ static inline void *kmvrlu_alloc(size_t size)
 	return mvrlu_alloc(size);
 }
 
+static inline void *kmvrlu_alloc_diff(size_t size)
+{
+	return mvrlu_alloc_diff(size);
+}
+
 static inline void kmvrlu_free(void *p_obj)
 {
 	return mvrlu_free(current->mvrlu_self, p_obj);
 }
 
+static inline void *kmvrlu_realloc(void *p_obj, size_t size)
+{
+	return mvrlu_realloc(current->mvrlu_self, p_obj, size);
+}
+
 static inline void kmvrlu_reader_lock(void)
 {
 	return mvrlu_reader_lock(current->mvrlu_self);
 }
 
-static inline void kmvrlu_reader_unlock(void)
+static inline int kmvrlu_reader_unlock(void)
+{
+	return mvrlu_reader_unlock(current->mvrlu_self);
+}
+
+static inline int kmvrlu_track_read(void *p_obj)
 {
-	mvrlu_reader_unlock(current->mvrlu_self);
+	return mvrlu_track_read(current->mvrlu_self, p_obj);
+}
+
+static inline void kmvrlu_reader_lock_ro(void)
+{
+	mvrlu_reader_lock_ro(current->mvrlu_self);
+}
+
+static inline void kmvrlu_reader_unlock_ro(void)
+{
+	mvrlu_reader_unlock_ro(current->mvrlu_self);
 }
 
 static inline void kmvrlu_abort(void)
@@ -116,6 +366,16 @@ static inline void kmvrlu_abort(void)
 	mvrlu_abort(current->mvrlu_self);
 }
 
+static inline int kmvrlu_abort_reason(void)
+{
+	return mvrlu_abort_reason(current->mvrlu_self);
+}
+
+static inline void kmvrlu_mark_dirty(void *p_obj, size_t off, size_t len)
+{
+	mvrlu_mark_dirty(current->mvrlu_self, p_obj, off, len);
+}
+
 static inline int kmvrlu_cmp_ptrs(void *p_obj_1, void *p_obj_2)
 {
 	return mvrlu_cmp_ptrs(p_obj_1, p_obj_2);
@@ -136,6 +396,10 @@ static inline void kmvrlu_flush_log(void)
 			sizeof(**p_p_obj))
 #define kmvrlu_try_lock_const(obj)                                             \
 	_mvrlu_try_lock_const(current->mvrlu_self, obj, sizeof(*obj))
+#define kmvrlu_try_lock_full(p_p_obj)                                          \
+	_mvrlu_try_lock_full(current->mvrlu_self, (void **)p_p_obj)
+#define kmvrlu_try_lock_range(p_p_obj, off, len)                               \
+	_mvrlu_try_lock_range(current->mvrlu_self, (void **)p_p_obj, off, len)
 #define kmvrlu_assign_ptr(p_ptr, p_obj)                                        \
 	_mvrlu_assign_pointer((void **)p_ptr, p_obj)
 
@@ -149,6 +413,7 @@ typedef mvrlu_thread_struct_t rlu_thread_data_t;
 #define RLU_INIT() mvrlu_init()
 #define RLU_FINISH() mvrlu_finish()
 #define RLU_PRINT_STATS() mvrlu_print_stats()
+#define RLU_GET_STATS(out, flags) mvrlu_get_stats(out, flags)
 
 #define RLU_THREAD_ALLOC() mvrlu_thread_alloc()
 #define RLU_THREAD_FREE(self) mvrlu_thread_free(self)
@@ -158,12 +423,16 @@ typedef mvrlu_thread_struct_t rlu_thread_data_t;
 
 #define RLU_READER_LOCK(self) mvrlu_reader_lock(self)
 #define RLU_READER_UNLOCK(self) mvrlu_reader_unlock(self)
+#define RLU_READER_UNLOCK_VALID(self) mvrlu_reader_unlock(self)
+#define RLU_READER_LOCK_RO(self) mvrlu_reader_lock_ro(self)
+#define RLU_READER_UNLOCK_RO(self) mvrlu_reader_unlock_ro(self)
 
 #define RLU_ALLOC(size) mvrlu_alloc(size)
 #define RLU_FREE(self, p_obj) mvrlu_free(self, p_obj)
 
 #define RLU_TRY_LOCK(self, p_p_obj) mvrlu_try_lock(self, p_p_obj)
 #define RLU_TRY_LOCK_CONST(self, obj) mvrlu_try_lock_const(self, obj)
+#define RLU_TRACK_READ(self, obj) mvrlu_track_read(self, obj)
 #define RLU_ABORT(self) mvrlu_abort(self)
 
 #define RLU_IS_SAME_PTRS(p_obj_1, p_obj_2) mvrlu_cmp_ptrs(p_obj_1, p_obj_2)
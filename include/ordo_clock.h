@@ -58,14 +58,16 @@ static inline unsigned long ordo_get_clock_relaxed(void)
 	return read_tsc();
 }
 
+/* Callers compare against sentinels near ULONG_MAX, such as the version
+ * of an uncommitted copy, so adding the boundary must not wrap around. */
 static inline int ordo_lt_clock(unsigned long t1, unsigned long t2)
 {
-	return (t1 + g_ordo_boundary) < t2;
+	return t1 < t2 && (t2 - t1) > g_ordo_boundary;
 }
 
 static inline int ordo_gt_clock(unsigned long t1, unsigned long t2)
 {
-	return t1 > (t2 + g_ordo_boundary);
+	return t1 > t2 && (t1 - t2) > g_ordo_boundary;
 }
 
 static inline int ordo_cmp_clock(unsigned long t1, unsigned long t2)
@@ -9,13 +9,33 @@
 #define MVRLU_MAX_THREAD_NUM (1ul << 14) /* 16384 (2**18 * 2**14 = 2**32) */
 
 #define MVRLU_MAX_FREE_PTRS 512
-#define MVRLU_QP_INTERVAL_USEC 500 /* 0.5 msec */
+#define MVRLU_MAX_CONST_LOCKS 64 /* try_lock_const() locks kept out of the log */
+#define MVRLU_MAX_READ_SET 64 /* objects validated at commit */
+#define MVRLU_MAX_OVERLAYS 8 /* diff copies a reader remembers */
+#define MVRLU_COPY_MIN_SIZE 128 /* shorter copies go to memcpy() */
+#define MVRLU_COPY_NT_MIN_SIZE 0 /* log copies with streaming stores, 0: never */
+#define MVRLU_QP_INTERVAL_USEC 500 /* 0.5 msec, initial nap */
+#define MVRLU_QP_MIN_INTERVAL_USEC 50
+#define MVRLU_QP_MAX_INTERVAL_USEC 10000 /* 10 msec */
+#define MVRLU_QP_TASK_WAIT_USEC 1000 /* 1 msec, then suspended tasks expire */
 
 #define MVRLU_LOG_LOW_MARK (MVRLU_LOG_SIZE >> 1) /* 50% */
 #define MVRLU_LOG_HIGH_MARK (MVRLU_LOG_SIZE - (MVRLU_LOG_SIZE >> 2)) /* 75% */
 #define MVRLU_DEREF_MIN_ACT_OBJ 50
 #define MVRLU_DEREF_MARK 3
 
+#define MVRLU_GC_TRACE_RING_SIZE (1ul << 12) /* events per thread */
+#define MVRLU_GC_TRACE_MAX_RINGS 1024
+#define MVRLU_CONTENTION_SLOTS (1ul << 10) /* per table, a power of two */
+#define MVRLU_CONTENTION_MAX_PROBE 16
+#define MVRLU_CONTENTION_TOP_N 16 /* entries printed per table */
+
+#define MVRLU_DURABLE_BASE (0x600000000000ul) /* fixed file mapping */
+#define MVRLU_DURABLE_MAX_LOGS 64 /* threads with a log at a time */
+#define MVRLU_DURABLE_CHUNK_SIZE (1ul << 16) /* heap growth per size class */
+#define MVRLU_SHM_MAX_PROCS 64 /* processes attached to a segment at a time */
+#define MVRLU_SHM_CHECK_USEC 1000 /* 1 msec, look for dead processes */
+
 #define MVRLU_CACHE_LINE_SIZE L1_CACHE_BYTES
 #define MVRLU_CACHE_LINE_MASK (~(MVRLU_CACHE_LINE_SIZE - 1))
 #define MVRLU_DEFAULT_PADDING CACHE_DEFAULT_PADDING
@@ -0,0 +1,144 @@
+// SPDX-FileCopyrightText: Copyright (c) 2018-2019 Virginia Tech
+// SPDX-License-Identifier: Apache-2.0
+#ifndef __KERNEL__
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mvrlu.h"
+#else
+#include <linux/mvrlu.h>
+#endif /* __KERNEL__ */
+
+#include "contention.h"
+
+#ifdef MVRLU_ENABLE_CONTENTION_PROFILE
+static contention_tab_t g_cp_sites = { .name = "call site" };
+static contention_tab_t g_cp_objs = { .name = "object" };
+
+unsigned long g_contention_period __read_mostly;
+__thread unsigned long contention_countdown;
+
+static const char *const cp_reason_names[MVRLU_ABORT_NR] = {
+	[MVRLU_ABORT_NONE] = "none",	 [MVRLU_ABORT_LOCKED] = "locked",
+	[MVRLU_ABORT_NEWER] = "newer",	 [MVRLU_ABORT_CAS] = "cas",
+	[MVRLU_ABORT_ABA] = "aba",	 [MVRLU_ABORT_READ_SET] = "read_set",
+	[MVRLU_ABORT_RO] = "ro",
+};
+
+void contention_init(void)
+{
+	const char *period = getenv("MVRLU_CONTENTION_PROFILE");
+
+	g_contention_period = period ? strtoul(period, NULL, 0) : 0;
+}
+
+static inline unsigned long cp_hash(unsigned long key)
+{
+	/* Objects and code are at least 8-byte aligned */
+	return ((key >> 3) * 0x9e3779b97f4a7c15ul) >> 32;
+}
+
+static void cp_tab_add(contention_tab_t *tab, unsigned long key, int reason)
+{
+	contention_ent_t *ent;
+	unsigned long h, i, k;
+
+	h = cp_hash(key);
+	for (i = 0; i < MVRLU_CONTENTION_MAX_PROBE; ++i) {
+		ent = &tab->ents[(h + i) & (MVRLU_CONTENTION_SLOTS - 1)];
+		k = ent->key;
+		if (!k && smp_cas(&ent->key, 0, key))
+			k = key;
+		else if (!k)
+			k = ent->key; /* claimed by another thread */
+		if (k == key) {
+			smp_faa(&ent->cnt[reason], 1);
+			return;
+		}
+	}
+	smp_faa(&tab->nr_dropped, 1);
+}
+
+void contention_sample(int reason, void *call_site, void *p_act)
+{
+	mvrlu_assert(reason > MVRLU_ABORT_NONE && reason < MVRLU_ABORT_NR);
+	if (call_site)
+		cp_tab_add(&g_cp_sites, (unsigned long)call_site, reason);
+	if (p_act)
+		cp_tab_add(&g_cp_objs, (unsigned long)p_act, reason);
+}
+
+static unsigned long cp_ent_total(const contention_ent_t *ent)
+{
+	unsigned long sum = 0;
+	int r;
+
+	for (r = 0; r < MVRLU_ABORT_NR; ++r)
+		sum += ent->cnt[r];
+	return sum;
+}
+
+static int cp_ent_cmp(const void *a, const void *b)
+{
+	unsigned long ta = cp_ent_total(a), tb = cp_ent_total(b);
+
+	return ta < tb ? 1 : ta > tb ? -1 : 0;
+}
+
+static void cp_tab_print(contention_tab_t *tab)
+{
+	contention_ent_t *ents;
+	unsigned long i, n = 0;
+	int r;
+
+	/* Sort a snapshot; samples taken meanwhile may be missed */
+	ents = malloc(sizeof(tab->ents));
+	if (!ents)
+		return;
+	for (i = 0; i < MVRLU_CONTENTION_SLOTS; ++i) {
+		if (tab->ents[i].key)
+			memcpy(&ents[n++], &tab->ents[i], sizeof(ents[0]));
+	}
+	qsort(ents, n, sizeof(ents[0]), cp_ent_cmp);
+
+	printf("  %18s %10s", tab->name, "total");
+	for (r = MVRLU_ABORT_NONE + 1; r < MVRLU_ABORT_NR; ++r)
+		printf(" %10s", cp_reason_names[r]);
+	printf("\n");
+	for (i = 0; i < n && i < MVRLU_CONTENTION_TOP_N; ++i) {
+		printf("  %#18lx %10lu", ents[i].key, cp_ent_total(&ents[i]));
+		for (r = MVRLU_ABORT_NONE + 1; r < MVRLU_ABORT_NR; ++r)
+			printf(" %10lu", ents[i].cnt[r]);
+		printf("\n");
+	}
+	if (tab->nr_dropped)
+		printf("  %lu samples found no free slot\n", tab->nr_dropped);
+	free(ents);
+}
+
+void mvrlu_print_contention(void)
+{
+	if (!g_contention_period)
+		return;
+	printf("Contention profile: 1 of %lu failures sampled, "
+	       "top %d of %lu slots\n",
+	       g_contention_period, MVRLU_CONTENTION_TOP_N,
+	       MVRLU_CONTENTION_SLOTS);
+	cp_tab_print(&g_cp_sites);
+	cp_tab_print(&g_cp_objs);
+}
+
+void contention_finish(void)
+{
+	mvrlu_print_contention();
+	memset(g_cp_sites.ents, 0, sizeof(g_cp_sites.ents));
+	memset(g_cp_objs.ents, 0, sizeof(g_cp_objs.ents));
+	g_cp_sites.nr_dropped = g_cp_objs.nr_dropped = 0;
+	g_contention_period = 0;
+}
+#else /* MVRLU_ENABLE_CONTENTION_PROFILE */
+void mvrlu_print_contention(void)
+{
+}
+#endif /* MVRLU_ENABLE_CONTENTION_PROFILE */
+EXPORT_SYMBOL(mvrlu_print_contention);
@@ -0,0 +1,73 @@
+// SPDX-FileCopyrightText: Copyright (c) 2018-2019 Virginia Tech
+// SPDX-License-Identifier: Apache-2.0
+#ifndef _CONTENTION_H
+#define _CONTENTION_H
+
+#include "config.h"
+#include "debug.h"
+#include "port.h"
+
+/*
+ * Contention profile
+ *
+ * Samples the failed try_locks and read-set validations and counts
+ * them per reason (MVRLU_ABORT_*) in two global tables, one keyed by
+ * the call site of the try_lock (or of mvrlu_reader_unlock()) and one
+ * by the actual object. A table is an open-addressing hash table whose
+ * slots are claimed with a CAS on the key and never released, so a
+ * sample costs a few atomic adds. The profile is compiled in only with
+ * MVRLU_ENABLE_CONTENTION_PROFILE and activated at run time by setting
+ * the MVRLU_CONTENTION_PROFILE environment variable to the sampling
+ * period (1 samples every failure). The top MVRLU_CONTENTION_TOP_N
+ * entries of each table are printed at mvrlu_finish() or by
+ * mvrlu_print_contention().
+ */
+
+typedef struct contention_ent {
+	volatile unsigned long key; /* call site or p_act, 0 if free */
+	volatile unsigned long cnt[MVRLU_ABORT_NR];
+} contention_ent_t;
+
+typedef struct contention_tab {
+	const char *name;
+	volatile unsigned long nr_dropped; /* samples that found no slot */
+
+	long __padding_0[MVRLU_DEFAULT_PADDING];
+
+	contention_ent_t ents[MVRLU_CONTENTION_SLOTS];
+} contention_tab_t;
+
+#ifdef MVRLU_ENABLE_CONTENTION_PROFILE
+extern unsigned long g_contention_period;
+extern __thread unsigned long contention_countdown;
+
+void contention_init(void);
+void contention_finish(void);
+void contention_sample(int reason, void *call_site, void *p_act);
+
+static inline void contention_record(int reason, void *call_site, void *p_act)
+{
+	if (likely(!g_contention_period))
+		return;
+	if (contention_countdown) {
+		contention_countdown--;
+		return;
+	}
+	contention_countdown = g_contention_period - 1;
+	contention_sample(reason, call_site, p_act);
+}
+#else /* MVRLU_ENABLE_CONTENTION_PROFILE */
+static inline void contention_init(void)
+{
+}
+
+static inline void contention_finish(void)
+{
+}
+
+static inline void contention_record(int reason, void *call_site, void *p_act)
+{
+}
+#endif /* MVRLU_ENABLE_CONTENTION_PROFILE */
+
+#endif /* _CONTENTION_H */
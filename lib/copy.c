@@ -0,0 +1,188 @@
+// SPDX-FileCopyrightText: Copyright (c) 2018-2019 Virginia Tech
+// SPDX-License-Identifier: Apache-2.0
+#ifndef __KERNEL__
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include "mvrlu.h"
+#include "copy.h"
+
+static void copy_memcpy(void *dst, const void *src, size_t len)
+{
+	memcpy(dst, src, len);
+}
+
+static void copy_memcpy_nt(void *dst, const void *src, size_t len)
+{
+	memcpy(dst, src, len);
+}
+
+#if defined(__x86_64__)
+/*
+ * The kernels copy the first vector unaligned, continue from the next
+ * aligned destination address and finish with an unaligned vector that
+ * ends at the last byte, so they need len to be at least two vectors
+ * (MVRLU_COPY_MIN_SIZE).
+ */
+
+__attribute__((target("avx2"))) static void
+copy_avx2(void *dst, const void *src, size_t len)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+	size_t head;
+
+	_mm256_storeu_si256((__m256i *)d, _mm256_loadu_si256((__m256i *)s));
+	head = 32 - ((uintptr_t)d & 31);
+	d += head;
+	s += head;
+	len -= head;
+	for (; len >= 128; len -= 128, d += 128, s += 128) {
+		__m256i v0 = _mm256_loadu_si256((__m256i *)s);
+		__m256i v1 = _mm256_loadu_si256((__m256i *)(s + 32));
+		__m256i v2 = _mm256_loadu_si256((__m256i *)(s + 64));
+		__m256i v3 = _mm256_loadu_si256((__m256i *)(s + 96));
+
+		_mm256_store_si256((__m256i *)d, v0);
+		_mm256_store_si256((__m256i *)(d + 32), v1);
+		_mm256_store_si256((__m256i *)(d + 64), v2);
+		_mm256_store_si256((__m256i *)(d + 96), v3);
+	}
+	for (; len >= 32; len -= 32, d += 32, s += 32)
+		_mm256_store_si256((__m256i *)d,
+				   _mm256_loadu_si256((__m256i *)s));
+	if (len)
+		_mm256_storeu_si256((__m256i *)(d + len - 32),
+				    _mm256_loadu_si256((__m256i *)(s + len - 32)));
+}
+
+__attribute__((target("avx2"))) static void
+copy_avx2_nt(void *dst, const void *src, size_t len)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+	size_t head;
+
+	/* Stream whole cache lines only */
+	_mm256_storeu_si256((__m256i *)d, _mm256_loadu_si256((__m256i *)s));
+	_mm256_storeu_si256((__m256i *)(d + 32),
+			    _mm256_loadu_si256((__m256i *)(s + 32)));
+	head = L1_CACHE_BYTES - ((uintptr_t)d & (L1_CACHE_BYTES - 1));
+	d += head;
+	s += head;
+	len -= head;
+	for (; len >= 64; len -= 64, d += 64, s += 64) {
+		__m256i v0 = _mm256_loadu_si256((__m256i *)s);
+		__m256i v1 = _mm256_loadu_si256((__m256i *)(s + 32));
+
+		_mm256_stream_si256((__m256i *)d, v0);
+		_mm256_stream_si256((__m256i *)(d + 32), v1);
+	}
+	if (len) {
+		_mm256_storeu_si256((__m256i *)(d + len - 64),
+				    _mm256_loadu_si256((__m256i *)(s + len - 64)));
+		_mm256_storeu_si256((__m256i *)(d + len - 32),
+				    _mm256_loadu_si256((__m256i *)(s + len - 32)));
+	}
+	_mm_sfence();
+}
+
+__attribute__((target("avx512f"))) static void
+copy_avx512(void *dst, const void *src, size_t len)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+	size_t head;
+
+	_mm512_storeu_si512(d, _mm512_loadu_si512(s));
+	head = 64 - ((uintptr_t)d & 63);
+	d += head;
+	s += head;
+	len -= head;
+	for (; len >= 256; len -= 256, d += 256, s += 256) {
+		__m512i v0 = _mm512_loadu_si512(s);
+		__m512i v1 = _mm512_loadu_si512(s + 64);
+		__m512i v2 = _mm512_loadu_si512(s + 128);
+		__m512i v3 = _mm512_loadu_si512(s + 192);
+
+		_mm512_store_si512(d, v0);
+		_mm512_store_si512(d + 64, v1);
+		_mm512_store_si512(d + 128, v2);
+		_mm512_store_si512(d + 192, v3);
+	}
+	for (; len >= 64; len -= 64, d += 64, s += 64)
+		_mm512_store_si512(d, _mm512_loadu_si512(s));
+	if (len)
+		_mm512_storeu_si512(d + len - 64, _mm512_loadu_si512(s + len - 64));
+}
+
+__attribute__((target("avx512f"))) static void
+copy_avx512_nt(void *dst, const void *src, size_t len)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+	size_t head;
+
+	_mm512_storeu_si512(d, _mm512_loadu_si512(s));
+	head = 64 - ((uintptr_t)d & 63);
+	d += head;
+	s += head;
+	len -= head;
+	for (; len >= 64; len -= 64, d += 64, s += 64)
+		_mm512_stream_si512((__m512i *)d, _mm512_loadu_si512(s));
+	if (len)
+		_mm512_storeu_si512(d + len - 64, _mm512_loadu_si512(s + len - 64));
+	_mm_sfence();
+}
+#endif /* __x86_64__ */
+
+static const struct copy_kernel_desc {
+	copy_kernel_t kernel;
+	const char *cpu_feature; /* NULL if any CPU has it */
+} copy_kernels[] = {
+	/* The default: libc picks AVX2 or AVX-512 moves by itself, and the
+	 * kernels below only won on some object sizes */
+	{ { "memcpy", copy_memcpy, copy_memcpy_nt }, NULL },
+#if defined(__x86_64__)
+	{ { "avx2", copy_avx2, copy_avx2_nt }, "avx2" },
+	{ { "avx512", copy_avx512, copy_avx512_nt }, "avx512f" },
+#endif
+};
+
+copy_kernel_t g_copy_kernel __read_mostly = { "memcpy", copy_memcpy,
+					      copy_memcpy_nt };
+
+static int copy_kernel_supported(const struct copy_kernel_desc *desc)
+{
+	if (!desc->cpu_feature)
+		return 1;
+#if defined(__x86_64__)
+	__builtin_cpu_init();
+	if (!strcmp(desc->cpu_feature, "avx512f"))
+		return __builtin_cpu_supports("avx512f");
+	if (!strcmp(desc->cpu_feature, "avx2"))
+		return __builtin_cpu_supports("avx2");
+#endif
+	return 0;
+}
+
+void copy_init(void)
+{
+	const char *name = getenv("MVRLU_COPY_KERNEL");
+	unsigned int i;
+
+	/* The named kernel if the CPU has it, or else memcpy() */
+	g_copy_kernel = copy_kernels[0].kernel;
+	for (i = 0; name && i < sizeof(copy_kernels) / sizeof(copy_kernels[0]);
+	     ++i) {
+		if (!strcmp(copy_kernels[i].kernel.name, name) &&
+		    copy_kernel_supported(&copy_kernels[i])) {
+			g_copy_kernel = copy_kernels[i].kernel;
+			return;
+		}
+	}
+}
+#endif /* __KERNEL__ */
@@ -0,0 +1,86 @@
+// SPDX-FileCopyrightText: Copyright (c) 2018-2019 Virginia Tech
+// SPDX-License-Identifier: Apache-2.0
+#ifndef _COPY_H
+#define _COPY_H
+
+#include "config.h"
+#include "port.h"
+
+/*
+ * Object copy kernels (user space only)
+ *
+ * copy_obj() copies an object or a copy of it, e.g., on write-back.
+ * copy_to_log() fills a new copy in the log on try_lock. With
+ * MVRLU_COPY_NT_MIN_SIZE set, a copy that large is written with
+ * non-temporal stores since its writer touches only a few lines of it.
+ * That pays off only when the logs do not fit in the LLC: otherwise
+ * write-back reads the copy from memory instead of the cache, and the
+ * fence after the stores costs more than a small copy.
+ *
+ * copy_init() picks memcpy(), which libc already runs with AVX2 or
+ * AVX-512 moves. The MVRLU_COPY_KERNEL environment variable opts into
+ * another one (avx2 or avx512) if the CPU has it: AVX-512 was slower
+ * than memcpy() on 16KB objects. Objects start 16 bytes into a cache
+ * line, so the kernels align the destination and load the source
+ * unaligned. Copies shorter than MVRLU_COPY_MIN_SIZE are left to
+ * memcpy().
+ */
+
+typedef void (*copy_fn_t)(void *dst, const void *src, size_t len);
+
+typedef struct copy_kernel {
+	const char *name;
+	copy_fn_t copy; /* cached stores */
+	copy_fn_t copy_nt; /* non-temporal stores, ordered by a fence */
+} copy_kernel_t;
+
+#ifndef __KERNEL__
+extern copy_kernel_t g_copy_kernel;
+
+void copy_init(void);
+
+static inline void copy_obj(void *dst, const void *src, size_t len)
+{
+	if (len < MVRLU_COPY_MIN_SIZE)
+		memcpy(dst, src, len);
+	else
+		g_copy_kernel.copy(dst, src, len);
+}
+
+static inline void copy_to_log(void *dst, const void *src, size_t len)
+{
+#if MVRLU_COPY_NT_MIN_SIZE
+	if (len >= MVRLU_COPY_NT_MIN_SIZE) {
+		g_copy_kernel.copy_nt(dst, src, len);
+		return;
+	}
+#endif
+	copy_obj(dst, src, len);
+}
+
+static inline const char *copy_kernel_name(void)
+{
+	return g_copy_kernel.name;
+}
+#else /* __KERNEL__ */
+static inline void copy_init(void)
+{
+}
+
+static inline void copy_obj(void *dst, const void *src, size_t len)
+{
+	memcpy(dst, src, len);
+}
+
+static inline void copy_to_log(void *dst, const void *src, size_t len)
+{
+	memcpy(dst, src, len);
+}
+
+static inline const char *copy_kernel_name(void)
+{
+	return "memcpy";
+}
+#endif /* __KERNEL__ */
+
+#endif /* _COPY_H */
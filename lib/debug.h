@@ -10,12 +10,16 @@
 //#define MVRLU_ENABLE_FREE_POISIONING
 #define MVRLU_ENABLE_STATS
 //#define MVRLU_TIME_MEASUREMENT
+//#define MVRLU_ENABLE_GC_TRACE /* or make GC_TRACE=1 */
+//#define MVRLU_ENABLE_CONTENTION_PROFILE /* or make PROFILE=1 */
 #define MVRLU_ATTACH_GDB_ASSERT_FAIL                                           \
 	0 /* attach gdb at MVRLU_ASSERT() failure */
 
 #ifdef __KERNEL__
 #undef MVRLU_TIME_MEASUREMENT
 #undef MVRLU_ENABLE_STATS
+#undef MVRLU_ENABLE_GC_TRACE
+#undef MVRLU_ENABLE_CONTENTION_PROFILE
 #endif
 
 #define MVRLU_FREE_POSION ((unsigned char)(0xbd))
@@ -0,0 +1,632 @@
+// SPDX-FileCopyrightText: Copyright (c) 2018-2019 Virginia Tech
+// SPDX-License-Identifier: Apache-2.0
+#ifndef __KERNEL__
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "mvrlu.h"
+#else
+#include <linux/mvrlu.h>
+#endif /* __KERNEL__ */
+
+#include "durable.h"
+
+#ifndef __KERNEL__
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+#ifndef F_OFD_SETLKW
+#define F_OFD_SETLKW 38
+#endif
+
+#define DURABLE_MAX_TRACKED 64
+
+/* File byte locked while a process opens the file, past those of shm.h */
+#define DURABLE_OPEN_LOCK_OFF (SHM_QP_LOCK_OFF + 1)
+
+typedef struct durable {
+	int fd;
+	int open_fd; /* serializes opens until durable_open_done() */
+	int sync;
+	int shared;
+	int attached;
+} durable_t;
+
+durable_hdr_t *g_durable_hdr __read_mostly;
+static durable_t g_durable;
+
+#define g_heap (g_durable_hdr->heap)
+
+/* Objects allocated by this thread since its last commit */
+static __thread durable_blk_t *durable_allocs[DURABLE_MAX_TRACKED];
+static __thread unsigned int durable_nr_allocs;
+static __thread int durable_allocs_overflow;
+
+/* Dirty range to msync() at the next fence (MVRLU_DURABLE_SYNC_MSYNC) */
+static __thread unsigned long durable_dirty_lo = ULONG_MAX;
+static __thread unsigned long durable_dirty_hi;
+
+/*
+ * Flush and fence
+ */
+
+static inline void durable_clwb(const volatile void *p)
+{
+#if defined(__CLWB__)
+	asm volatile("clwb %0" : "+m"(*(volatile char *)p));
+#elif defined(__CLFLUSHOPT__)
+	asm volatile("clflushopt %0" : "+m"(*(volatile char *)p));
+#else
+	asm volatile("clflush %0" : "+m"(*(volatile char *)p));
+#endif
+}
+
+void durable_flush(const volatile void *addr, size_t len)
+{
+	unsigned long p = (unsigned long)addr;
+	unsigned long end = p + len;
+
+	switch (g_durable.sync) {
+	case MVRLU_DURABLE_SYNC_CLWB:
+		for (p &= MVRLU_CACHE_LINE_MASK; p < end;
+		     p += MVRLU_CACHE_LINE_SIZE)
+			durable_clwb((void *)p);
+		break;
+	case MVRLU_DURABLE_SYNC_MSYNC:
+		if (p < durable_dirty_lo)
+			durable_dirty_lo = p;
+		if (end > durable_dirty_hi)
+			durable_dirty_hi = end;
+		break;
+	default:
+		/* The page cache outlives the process */
+		break;
+	}
+}
+
+void durable_fence(void)
+{
+	unsigned long lo;
+
+	switch (g_durable.sync) {
+	case MVRLU_DURABLE_SYNC_CLWB:
+		smp_wmb();
+		break;
+	case MVRLU_DURABLE_SYNC_MSYNC:
+		if (!durable_dirty_hi)
+			break;
+		lo = durable_dirty_lo & ~(PAGE_SIZE - 1ul);
+		if (msync((void *)lo, durable_dirty_hi - lo, MS_SYNC))
+			mvrlu_trace_global("msync failed: %d\n", errno);
+		durable_dirty_lo = ULONG_MAX;
+		durable_dirty_hi = 0;
+		break;
+	default:
+		barrier();
+		break;
+	}
+}
+
+static inline void durable_persist(const volatile void *addr, size_t len)
+{
+	durable_flush(addr, len);
+	durable_fence();
+}
+
+/*
+ * Heap
+ */
+
+static inline void *durable_at(unsigned long off)
+{
+	return (void *)g_durable_hdr + off;
+}
+
+static inline durable_blk_t **blk_next(durable_blk_t *blk)
+{
+	return (durable_blk_t **)(blk + 1);
+}
+
+static inline void list_push(durable_list_t *list, durable_blk_t *blk)
+{
+	*blk_next(blk) = list->head;
+	list->head = blk;
+	if (!list->tail)
+		list->tail = blk;
+}
+
+static inline durable_blk_t *list_pop(durable_list_t *list)
+{
+	durable_blk_t *blk = list->head;
+
+	if (blk) {
+		list->head = *blk_next(blk);
+		if (!list->head)
+			list->tail = NULL;
+	}
+	return blk;
+}
+
+static inline void list_splice(durable_list_t *dst, durable_list_t *src)
+{
+	if (!src->head)
+		return;
+	*blk_next(src->tail) = dst->head;
+	if (!dst->tail)
+		dst->tail = src->tail;
+	dst->head = src->head;
+	src->head = src->tail = NULL;
+}
+
+static inline unsigned int size_class(size_t size)
+{
+	unsigned int c = DURABLE_MIN_CLASS;
+
+	size += sizeof(durable_blk_t);
+	while ((1ul << c) < size)
+		++c;
+	return c;
+}
+
+/* Called with g_heap.lock held */
+static int durable_carve(unsigned int c)
+{
+	durable_hdr_t *hdr = g_durable_hdr;
+	unsigned long bsize = 1ul << c;
+	unsigned long csize, off, end;
+	durable_blk_t *blk;
+
+	/* Persist the headers of a new chunk before the chunk becomes part
+	 * of the heap. */
+	csize = bsize > MVRLU_DURABLE_CHUNK_SIZE ? bsize :
+						   MVRLU_DURABLE_CHUNK_SIZE;
+	off = hdr->bump;
+	if (off + csize > hdr->size)
+		return -ENOMEM;
+	for (end = off + csize; off < end; off += bsize) {
+		blk = durable_at(off);
+		blk->size_class = c;
+		blk->state = DURABLE_BLK_FREE;
+		blk->wrt_clk = 0;
+		durable_flush(blk, sizeof(*blk));
+		list_push(&g_heap.free[c - DURABLE_MIN_CLASS], blk);
+	}
+	durable_fence();
+
+	hdr->bump = end;
+	durable_persist(&hdr->bump, sizeof(hdr->bump));
+	return 0;
+}
+
+static inline void durable_track(durable_blk_t *blk)
+{
+	if (g_durable.sync == MVRLU_DURABLE_SYNC_NONE)
+		return;
+	if (durable_nr_allocs < DURABLE_MAX_TRACKED)
+		durable_allocs[durable_nr_allocs++] = blk;
+	else
+		durable_allocs_overflow = 1;
+}
+
+/* Flush the objects allocated since the last commit; they may be
+ * reachable once the commit is durable. */
+static void durable_flush_allocs(void)
+{
+	mvrlu_act_hdr_struct_t *ahs;
+	durable_blk_t *blk;
+	unsigned int i;
+
+	if (unlikely(durable_allocs_overflow)) {
+		durable_flush(durable_at(g_durable_hdr->heap_off),
+			      g_durable_hdr->bump - g_durable_hdr->heap_off);
+	} else {
+		for (i = 0; i < durable_nr_allocs; ++i) {
+			blk = durable_allocs[i];
+			ahs = (mvrlu_act_hdr_struct_t *)(blk + 1);
+			durable_flush(blk, sizeof(*blk) + sizeof(*ahs) +
+						   ahs->obj_hdr.obj_size);
+		}
+	}
+	durable_nr_allocs = 0;
+	durable_allocs_overflow = 0;
+}
+
+static durable_blk_t *durable_alloc_blk(size_t size, unsigned int state)
+{
+	durable_list_t *list;
+	durable_blk_t *blk;
+	unsigned int c;
+
+	c = size_class(size);
+	if (unlikely(c >= DURABLE_MIN_CLASS + DURABLE_NR_CLASSES))
+		return NULL;
+	list = &g_heap.free[c - DURABLE_MIN_CLASS];
+
+	shm_spin_lock(&g_heap.lock);
+	if (unlikely(!list->head) && durable_carve(c)) {
+		shm_spin_unlock(&g_heap.lock);
+		return NULL;
+	}
+	blk = list_pop(list);
+	shm_spin_unlock(&g_heap.lock);
+
+	blk->state = state;
+	blk->wrt_clk = 0;
+	return blk;
+}
+
+void *durable_alloc(size_t size)
+{
+	durable_blk_t *blk = durable_alloc_blk(size, DURABLE_BLK_ALLOC);
+
+	if (unlikely(!blk))
+		return NULL;
+	durable_track(blk);
+	return blk + 1;
+}
+
+void *durable_alloc_raw(size_t size)
+{
+	durable_blk_t *blk = durable_alloc_blk(size, DURABLE_BLK_RAW);
+
+	return blk ? blk + 1 : NULL;
+}
+
+void durable_free(void *ahs)
+{
+	durable_blk_t *blk = durable_blk_of(ahs);
+	unsigned int state = blk->state;
+
+	/* A reclamation pass cut short by the death of its process is
+	 * redone, so a block may be freed twice. The state is persisted
+	 * lazily; losing it only leaks the block. */
+	if (state == DURABLE_BLK_FREE ||
+	    !smp_cas(&blk->state, state, DURABLE_BLK_FREE))
+		return;
+	shm_spin_lock(&g_heap.lock);
+	list_push(&g_heap.deferred[0][blk->size_class - DURABLE_MIN_CLASS],
+		  blk);
+	shm_spin_unlock(&g_heap.lock);
+}
+
+/* Called by the qp thread when every live log has been reclaimed up to
+ * the qp clock of a round and there is no zombie log */
+void durable_reclaim_round(void)
+{
+	unsigned int c;
+
+	shm_spin_lock(&g_heap.lock);
+	for (c = 0; c < DURABLE_NR_CLASSES; ++c) {
+		list_splice(&g_heap.free[c], &g_heap.deferred[1][c]);
+		list_splice(&g_heap.deferred[1][c], &g_heap.deferred[0][c]);
+	}
+	shm_spin_unlock(&g_heap.lock);
+}
+
+/*
+ * Logs
+ */
+
+static inline durable_slot_t *durable_slot_of(mvrlu_log_t *log)
+{
+	unsigned long slot;
+
+	slot = ((void *)log->buffer - durable_log_at(0)) /
+	       g_durable_hdr->log_size;
+	mvrlu_assert(slot < g_durable_hdr->nr_logs);
+	return &g_durable_hdr->slots[slot];
+}
+
+static void durable_flush_log(mvrlu_log_t *log, unsigned long start_cnt,
+			      unsigned long end_cnt)
+{
+	unsigned long start = start_cnt & ~MVRLU_LOG_MASK;
+	unsigned long end = end_cnt & ~MVRLU_LOG_MASK;
+
+	if (start_cnt == end_cnt)
+		return;
+	if (start < end) {
+		durable_flush(&log->buffer[start], end - start);
+	} else {
+		/* The range wraps around the end of the log */
+		durable_flush(&log->buffer[start], MVRLU_LOG_SIZE - start);
+		durable_flush(&log->buffer[0], end);
+	}
+}
+
+void durable_log_reset(mvrlu_log_t *log)
+{
+	durable_slot_t *slot = durable_slot_of(log);
+
+	slot->head_cnt = log->head_cnt;
+	slot->tail_cnt = log->tail_cnt;
+	durable_persist(slot, sizeof(*slot));
+}
+
+void durable_log_commit(mvrlu_log_t *log, unsigned long start_cnt)
+{
+	durable_slot_t *slot = durable_slot_of(log);
+
+	durable_flush_log(log, start_cnt, log->tail_cnt);
+	durable_flush_allocs();
+	durable_fence();
+
+	/* Commit point */
+	slot->tail_cnt = log->tail_cnt;
+	durable_persist(&slot->tail_cnt, sizeof(slot->tail_cnt));
+}
+
+void durable_log_persist_head(mvrlu_log_t *log, unsigned long head_cnt)
+{
+	durable_slot_t *slot = durable_slot_of(log);
+
+	/* Objects written back by this pass first */
+	durable_fence();
+	if (slot->head_cnt == head_cnt)
+		return;
+	slot->head_cnt = head_cnt;
+	durable_persist(&slot->head_cnt, sizeof(slot->head_cnt));
+}
+
+/*
+ * Open, recovery and close
+ */
+
+static void durable_format(durable_hdr_t *hdr, unsigned long size)
+{
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->version = DURABLE_VERSION;
+	hdr->nr_logs = MVRLU_DURABLE_MAX_LOGS;
+	hdr->base = MVRLU_DURABLE_BASE;
+	hdr->size = size;
+	hdr->log_size = MVRLU_LOG_SIZE;
+	hdr->log_off = (sizeof(*hdr) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1ul);
+	hdr->heap_off = hdr->log_off + hdr->nr_logs * hdr->log_size;
+	hdr->shm_size = sizeof(shm_seg_t);
+	hdr->bump = hdr->heap_off;
+	durable_persist(hdr, sizeof(*hdr));
+
+	/* A file without the magic is formatted again at the next open */
+	memcpy(hdr->magic, DURABLE_MAGIC, sizeof(DURABLE_MAGIC));
+	durable_persist(hdr->magic, sizeof(hdr->magic));
+}
+
+static int durable_check(const durable_hdr_t *hdr, unsigned long file_size)
+{
+	if (hdr->version != DURABLE_VERSION ||
+	    hdr->nr_logs != MVRLU_DURABLE_MAX_LOGS ||
+	    hdr->base != MVRLU_DURABLE_BASE ||
+	    hdr->log_size != MVRLU_LOG_SIZE || hdr->size != file_size ||
+	    hdr->shm_size != sizeof(shm_seg_t) ||
+	    hdr->bump < hdr->heap_off || hdr->bump > hdr->size)
+		return -EINVAL;
+	return 0;
+}
+
+/*
+ * A durable file belongs to one process while the processes sharing a
+ * segment hold it shared; the first of them recovers it exclusively.
+ * Opens queue up on a byte lock of a second descriptor, so nobody else
+ * tries to lock the file while the first converts its lock.
+ */
+static int durable_lock(int fd, int open_fd, int shared)
+{
+	struct flock fl;
+
+	memset(&fl, 0, sizeof(fl));
+	fl.l_type = F_WRLCK;
+	fl.l_whence = SEEK_SET;
+	fl.l_start = DURABLE_OPEN_LOCK_OFF;
+	fl.l_len = 1;
+	if (fcntl(open_fd, F_OFD_SETLKW, &fl))
+		return -errno;
+	if (!flock(fd, LOCK_EX | LOCK_NB))
+		return 0;
+	if (shared && !flock(fd, LOCK_SH | LOCK_NB))
+		return 1;
+	return -EBUSY;
+}
+
+int durable_open(const char *path, size_t size, int sync, int shared)
+{
+	durable_hdr_t hdr;
+	struct stat st;
+	void *addr;
+	int fd, open_fd, fresh, attached, rc;
+
+	if (g_durable_hdr)
+		return -EBUSY;
+	if (sync < MVRLU_DURABLE_SYNC_NONE || sync > MVRLU_DURABLE_SYNC_CLWB)
+		return -EINVAL;
+
+	fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+		return -errno;
+	open_fd = open(path, O_RDWR);
+	if (open_fd < 0) {
+		rc = -errno;
+		goto err_close;
+	}
+	attached = durable_lock(fd, open_fd, shared);
+	if (attached < 0) {
+		rc = attached;
+		goto err_close;
+	}
+	if (fstat(fd, &st)) {
+		rc = -errno;
+		goto err_close;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	if (st.st_size &&
+	    pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr)) {
+		rc = -EINVAL;
+		goto err_close;
+	}
+	fresh = memcmp(hdr.magic, DURABLE_MAGIC, sizeof(DURABLE_MAGIC)) != 0;
+	if (fresh) {
+		if (hdr.magic[0] || attached) {
+			/* Not ours */
+			rc = -EINVAL;
+			goto err_close;
+		}
+		size = (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1ul);
+		if (size < (size_t)st.st_size)
+			size = st.st_size;
+		if (size < sizeof(hdr) + PAGE_SIZE +
+				   MVRLU_DURABLE_MAX_LOGS * MVRLU_LOG_SIZE +
+				   MVRLU_DURABLE_CHUNK_SIZE) {
+			rc = -EINVAL;
+			goto err_close;
+		}
+		if (ftruncate(fd, size)) {
+			rc = -errno;
+			goto err_close;
+		}
+	} else {
+		rc = durable_check(&hdr, st.st_size);
+		if (rc)
+			goto err_close;
+		size = hdr.size;
+	}
+
+	/* Objects and logs point to each other, so the file is always
+	 * mapped at the same address. */
+	addr = mmap((void *)MVRLU_DURABLE_BASE, size, PROT_READ | PROT_WRITE,
+		    MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+	if (addr == MAP_FAILED) {
+		rc = -errno;
+		goto err_close;
+	}
+	if (addr != (void *)MVRLU_DURABLE_BASE) {
+		munmap(addr, size);
+		rc = -EEXIST;
+		goto err_close;
+	}
+
+	memset(&g_durable, 0, sizeof(g_durable));
+	g_durable.fd = fd;
+	g_durable.open_fd = open_fd;
+	g_durable.sync = sync;
+	g_durable.shared = shared;
+	g_durable.attached = attached;
+	g_durable_hdr = addr;
+	if (fresh)
+		durable_format(g_durable_hdr, size);
+	if (shared) {
+		if (!attached)
+			shm_format(&g_durable_hdr->shm);
+		rc = shm_attach(&g_durable_hdr->shm, fd);
+		if (rc) {
+			durable_close();
+			return rc;
+		}
+	}
+	if (attached)
+		return DURABLE_OPEN_ATTACHED;
+	return fresh ? DURABLE_OPEN_NEW : DURABLE_OPEN_EXISTING;
+
+err_close:
+	if (open_fd >= 0)
+		close(open_fd);
+	close(fd);
+	return rc;
+}
+
+/* Let the next process open the file */
+void durable_open_done(void)
+{
+	if (g_durable.shared && !g_durable.attached)
+		flock(g_durable.fd, LOCK_SH);
+	close(g_durable.open_fd);
+	g_durable.open_fd = -1;
+}
+
+/* Called after the logs are replayed and before any thread starts */
+void durable_recover_heap(void)
+{
+	durable_hdr_t *hdr = g_durable_hdr;
+	mvrlu_act_hdr_struct_t *ahs;
+	durable_blk_t *blk;
+	unsigned long off;
+	unsigned int c;
+
+	/* Drop the logs; they are already applied. */
+	for (c = 0; c < hdr->nr_logs; ++c)
+		hdr->slots[c].head_cnt = hdr->slots[c].tail_cnt = 0;
+	durable_persist(hdr->slots, sizeof(hdr->slots));
+	memset((void *)hdr->log_bitmap, 0, sizeof(hdr->log_bitmap));
+	memset(&g_heap, 0, sizeof(g_heap));
+	shm_spin_init(&g_heap.lock);
+
+	/* Lock and copy pointers referred to the old logs, and clocks start
+	 * over, so reset them and rebuild the free lists. */
+	for (off = hdr->heap_off; off < hdr->bump; off += 1ul << c) {
+		blk = durable_at(off);
+		c = blk->size_class;
+		if (unlikely(c < DURABLE_MIN_CLASS ||
+			     c >= DURABLE_MIN_CLASS + DURABLE_NR_CLASSES ||
+			     off + (1ul << c) > hdr->bump)) {
+			mvrlu_trace_global("Corrupted heap block at %lu\n", off);
+			hdr->bump = off;
+			durable_persist(&hdr->bump, sizeof(hdr->bump));
+			break;
+		}
+		blk->wrt_clk = 0;
+		if (blk->state == DURABLE_BLK_ALLOC) {
+			ahs = (mvrlu_act_hdr_struct_t *)(blk + 1);
+			ahs->act_hdr.p_lock = NULL;
+			ahs->obj_hdr.p_copy = NULL;
+		} else {
+			/* Thread structures died with their processes */
+			blk->state = DURABLE_BLK_FREE;
+			list_push(&g_heap.free[c - DURABLE_MIN_CLASS], blk);
+		}
+	}
+}
+
+void durable_close(void)
+{
+	size_t size = g_durable_hdr->size;
+
+	durable_fence();
+	if (shm_enabled())
+		shm_detach();
+	munmap(g_durable_hdr, size);
+	if (g_durable.open_fd >= 0)
+		close(g_durable.open_fd);
+	close(g_durable.fd);
+	g_durable_hdr = NULL;
+}
+
+void *mvrlu_durable_get_root(void)
+{
+	return g_durable_hdr ? g_durable_hdr->root : NULL;
+}
+
+void mvrlu_durable_set_root(void *p_obj)
+{
+	if (!g_durable_hdr)
+		return;
+	durable_flush_allocs();
+	durable_fence();
+	g_durable_hdr->root = p_obj;
+	durable_persist(&g_durable_hdr->root, sizeof(g_durable_hdr->root));
+}
+#else /* __KERNEL__ */
+void *mvrlu_durable_get_root(void)
+{
+	return NULL;
+}
+
+void mvrlu_durable_set_root(void *p_obj)
+{
+}
+#endif /* __KERNEL__ */
+EXPORT_SYMBOL(mvrlu_durable_get_root);
+EXPORT_SYMBOL(mvrlu_durable_set_root);
@@ -0,0 +1,220 @@
+// SPDX-FileCopyrightText: Copyright (c) 2018-2019 Virginia Tech
+// SPDX-License-Identifier: Apache-2.0
+#ifndef _DURABLE_H
+#define _DURABLE_H
+
+#include "config.h"
+#include "port.h"
+#include "mvrlu_i.h"
+#include "shm.h"
+
+/*
+ * Durable MV-RLU (user space only)
+ *
+ * mvrlu_durable_init() maps a file at MVRLU_DURABLE_BASE and places
+ * both the logs and the actual objects in it, so every pointer stays
+ * valid after a restart:
+ *
+ *   +--------+-------+-------+-----+--------+----------------------+
+ *   | header | log 0 | log 1 | ... | log 63 | heap: actual objects |
+ *   +--------+-------+-------+-----+--------+----------------------+
+ *
+ * The header keeps a persistent [head, tail) per log. A commit flushes
+ * its write set and the objects allocated since the previous commit,
+ * then persists the log tail; that store is the commit point. A
+ * reclamation pass persists the objects it wrote back before it moves
+ * the log head. Recovery replays the write sets between head and tail
+ * in wrt_clk order and ignores everything past a tail.
+ *
+ * The header also keeps the state that is rebuilt at every recovery:
+ * the free lists of the heap, the log bitmap and, in shm mode, the
+ * state shared by the attached processes (see shm.h).
+ */
+
+#define DURABLE_MAGIC "MVRLUDR"
+#define DURABLE_VERSION 11
+
+#define DURABLE_MIN_CLASS 6 /* 64 bytes */
+#define DURABLE_NR_CLASSES 26 /* up to 2GB */
+
+/* A write-back in progress marks the block with the id of its process
+ * (shm_self_id()), far above any clock. */
+#define DURABLE_WRT_CLK_BUSY_MIN (ULONG_MAX - INT_MAX)
+#define DURABLE_WRT_CLK_BUSY (DURABLE_WRT_CLK_BUSY_MIN + shm_self_id())
+#define durable_wrt_clk_busy(clk) ((clk) >= DURABLE_WRT_CLK_BUSY_MIN)
+#define durable_wrt_clk_owner(clk) ((int)((clk)-DURABLE_WRT_CLK_BUSY_MIN))
+
+enum { DURABLE_BLK_FREE = 0,
+       DURABLE_BLK_ALLOC, /* an object */
+       DURABLE_BLK_RAW, /* library memory, freed by recovery */
+};
+
+enum { DURABLE_OPEN_NEW = 0,
+       DURABLE_OPEN_EXISTING, /* the file needs recovery */
+       DURABLE_OPEN_ATTACHED, /* other processes use it (shm mode) */
+};
+
+typedef struct durable_slot {
+	volatile unsigned long head_cnt;
+	volatile unsigned long tail_cnt;
+	long __padding_0[L1_CACHE_BYTES / sizeof(long) - 2];
+} durable_slot_t;
+
+/*
+ * Every heap block below hdr->bump starts with this header. The heap
+ * grows by chunks of same-sized blocks whose headers are persisted
+ * before the chunk becomes part of the heap, so recovery can always
+ * walk it block by block.
+ */
+typedef struct durable_blk {
+	volatile unsigned int size_class; /* block size is 1 << size_class */
+	volatile unsigned int state;
+	volatile unsigned long wrt_clk; /* clock of the last written-back copy */
+} durable_blk_t;
+
+typedef struct durable_list {
+	durable_blk_t *head;
+	durable_blk_t *tail;
+} durable_list_t;
+
+typedef struct durable_heap {
+	volatile int lock; /* see shm_spin_lock() */
+
+	/* Reusable blocks per size class. A freed block waits in
+	 * deferred[0] during the reclamation round it was freed in and in
+	 * deferred[1] during the next one, so no log still holds a copy
+	 * of it when it is reused; recovery would replay such a copy
+	 * over the new object. */
+	durable_list_t free[DURABLE_NR_CLASSES];
+	durable_list_t deferred[2][DURABLE_NR_CLASSES];
+} durable_heap_t;
+
+typedef struct durable_hdr {
+	char magic[8];
+	unsigned int version;
+	unsigned int nr_logs;
+	unsigned long base; /* the file is only valid at this address */
+	unsigned long size;
+	unsigned long log_size;
+	unsigned long log_off;
+	unsigned long heap_off;
+	unsigned long shm_size; /* the library build has to match */
+
+	long __padding_0[MVRLU_DEFAULT_PADDING];
+
+	volatile unsigned long bump; /* end of the carved heap, file offset */
+	void *volatile root;
+
+	long __padding_1[MVRLU_DEFAULT_PADDING];
+
+	durable_slot_t slots[MVRLU_DURABLE_MAX_LOGS];
+
+	/* Rebuilt at every recovery */
+	durable_heap_t heap ____cacheline_aligned2;
+	volatile unsigned long log_bitmap[MVRLU_DURABLE_MAX_LOGS / 64];
+	shm_seg_t shm ____cacheline_aligned2;
+} durable_hdr_t;
+
+#ifndef __KERNEL__
+extern durable_hdr_t *g_durable_hdr;
+
+int durable_open(const char *path, size_t size, int sync, int shared);
+void durable_open_done(void);
+void durable_close(void);
+void durable_recover_heap(void);
+
+void *durable_alloc(size_t size);
+void *durable_alloc_raw(size_t size);
+void durable_free(void *ahs);
+void durable_reclaim_round(void);
+
+void durable_flush(const volatile void *addr, size_t len);
+void durable_fence(void);
+
+void durable_log_reset(mvrlu_log_t *log);
+void durable_log_commit(mvrlu_log_t *log, unsigned long start_cnt);
+void durable_log_persist_head(mvrlu_log_t *log, unsigned long head_cnt);
+
+static inline int durable_enabled(void)
+{
+	return unlikely(g_durable_hdr != NULL);
+}
+
+static inline void *durable_log_at(unsigned int slot)
+{
+	return (void *)g_durable_hdr + g_durable_hdr->log_off +
+	       slot * g_durable_hdr->log_size;
+}
+
+static inline durable_blk_t *durable_blk_of(volatile void *ahs)
+{
+	return (durable_blk_t *)ahs - 1;
+}
+
+static inline int durable_contains(volatile void *p)
+{
+	return (void *)p >= (void *)g_durable_hdr &&
+	       (void *)p < (void *)g_durable_hdr + g_durable_hdr->size;
+}
+#else /* __KERNEL__ */
+static inline int durable_enabled(void)
+{
+	return 0;
+}
+
+static inline void durable_close(void)
+{
+}
+
+static inline void *durable_alloc(size_t size)
+{
+	return NULL;
+}
+
+static inline void *durable_alloc_raw(size_t size)
+{
+	return NULL;
+}
+
+static inline void durable_free(void *ahs)
+{
+}
+
+static inline void durable_reclaim_round(void)
+{
+}
+
+static inline void durable_flush(const volatile void *addr, size_t len)
+{
+}
+
+static inline void durable_fence(void)
+{
+}
+
+static inline void durable_log_reset(mvrlu_log_t *log)
+{
+}
+
+static inline void durable_log_commit(mvrlu_log_t *log,
+				      unsigned long start_cnt)
+{
+}
+
+static inline void durable_log_persist_head(mvrlu_log_t *log,
+					    unsigned long head_cnt)
+{
+}
+
+static inline durable_blk_t *durable_blk_of(volatile void *ahs)
+{
+	return NULL;
+}
+
+static inline int durable_contains(volatile void *p)
+{
+	return 0;
+}
+#endif /* __KERNEL__ */
+
+#endif /* _DURABLE_H */
@@ -0,0 +1,170 @@
+// SPDX-FileCopyrightText: Copyright (c) 2018-2019 Virginia Tech
+// SPDX-License-Identifier: Apache-2.0
+#ifndef __KERNEL__
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mvrlu.h"
+#else
+#include <linux/mvrlu.h>
+#endif /* __KERNEL__ */
+
+#include "gc_trace.h"
+
+#ifdef MVRLU_ENABLE_GC_TRACE
+/*
+ * Rings are never freed while the library is running. A finished
+ * thread releases its ring and the next thread to start reuses it, so
+ * the events of short-lived threads survive until the dump.
+ */
+static gc_trace_ring_t *g_gc_rings[MVRLU_GC_TRACE_MAX_RINGS];
+static volatile unsigned int g_gc_nr_rings;
+static const char *g_gc_trace_path;
+
+__thread gc_trace_ring_t *gc_trace_self;
+static __thread int gc_trace_nested;
+
+void gc_trace_init(void)
+{
+	g_gc_trace_path = getenv("MVRLU_GC_TRACE");
+	if (g_gc_trace_path && !*g_gc_trace_path)
+		g_gc_trace_path = NULL;
+}
+
+static gc_trace_ring_t *gc_trace_ring_get(void)
+{
+	gc_trace_ring_t *ring;
+	unsigned int i, n;
+
+	/* Reuse a ring released by a finished thread */
+	n = smp_atomic_load(&g_gc_nr_rings);
+	for (i = 0; i < n && i < MVRLU_GC_TRACE_MAX_RINGS; ++i) {
+		ring = g_gc_rings[i];
+		if (ring && !ring->in_use && smp_cas(&ring->in_use, 0, 1))
+			return ring;
+	}
+
+	/* Otherwise allocate a new one */
+	i = smp_faa(&g_gc_nr_rings, 1);
+	if (i >= MVRLU_GC_TRACE_MAX_RINGS)
+		return NULL;
+	ring = port_alloc(sizeof(*ring));
+	if (!ring)
+		return NULL;
+	memset(ring, 0, offsetof(gc_trace_ring_t, evs));
+	ring->in_use = 1;
+	smp_wmb();
+	g_gc_rings[i] = ring;
+	return ring;
+}
+
+void gc_trace_thread_init(unsigned int tid)
+{
+	/* A thread may drive several mvrlu_thread_struct_t; they share
+	 * the ring of the first one. */
+	if (!g_gc_trace_path || gc_trace_nested++)
+		return;
+	gc_trace_self = gc_trace_ring_get();
+	if (gc_trace_self)
+		gc_trace_self->tid = tid;
+}
+
+void gc_trace_thread_finish(void)
+{
+	gc_trace_ring_t *ring = gc_trace_self;
+
+	if (!g_gc_trace_path || --gc_trace_nested)
+		return;
+	gc_trace_self = NULL;
+	if (ring)
+		smp_atomic_store(&ring->in_use, 0);
+}
+
+static unsigned long gc_trace_ring_nr_evs(gc_trace_ring_t *ring)
+{
+	unsigned long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+	return head < MVRLU_GC_TRACE_RING_SIZE ? head :
+						 MVRLU_GC_TRACE_RING_SIZE;
+}
+
+int mvrlu_gc_trace_dump(const char *path)
+{
+	gc_trace_file_hdr_t hdr;
+	gc_trace_ring_t *ring;
+	unsigned long head, nr, i;
+	unsigned int r, n;
+	FILE *fp;
+	int rc = 0;
+
+	fp = fopen(path, "wb");
+	if (!fp)
+		return -errno;
+
+	/* Events recorded while dumping may be torn or missed; dump after
+	 * the traced threads are quiet to get a consistent file. */
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, GC_TRACE_MAGIC, sizeof(GC_TRACE_MAGIC));
+	hdr.version = GC_TRACE_VERSION;
+	hdr.ev_size = sizeof(gc_trace_ev_t);
+	n = smp_atomic_load(&g_gc_nr_rings);
+	if (n > MVRLU_GC_TRACE_MAX_RINGS)
+		n = MVRLU_GC_TRACE_MAX_RINGS;
+	for (r = 0; r < n; ++r) {
+		if (g_gc_rings[r])
+			hdr.nr_evs += gc_trace_ring_nr_evs(g_gc_rings[r]);
+	}
+	if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1)
+		rc = -EIO;
+
+	for (r = 0; r < n && !rc; ++r) {
+		ring = g_gc_rings[r];
+		if (!ring)
+			continue;
+		head = ring->head;
+		nr = gc_trace_ring_nr_evs(ring);
+		for (i = head - nr; i < head; ++i) {
+			if (fwrite(&ring->evs[i & (MVRLU_GC_TRACE_RING_SIZE - 1)],
+				   sizeof(gc_trace_ev_t), 1, fp) != 1) {
+				rc = -EIO;
+				break;
+			}
+		}
+	}
+
+	if (fclose(fp) && !rc)
+		rc = -EIO;
+	return rc;
+}
+
+void gc_trace_finish(void)
+{
+	unsigned int r, n;
+	int rc;
+
+	if (!g_gc_trace_path)
+		return;
+
+	rc = mvrlu_gc_trace_dump(g_gc_trace_path);
+	if (rc)
+		mvrlu_trace_global("Fail to dump GC trace to %s: %d\n",
+				   g_gc_trace_path, rc);
+
+	n = smp_atomic_load(&g_gc_nr_rings);
+	if (n > MVRLU_GC_TRACE_MAX_RINGS)
+		n = MVRLU_GC_TRACE_MAX_RINGS;
+	for (r = 0; r < n; ++r) {
+		port_free(g_gc_rings[r]);
+		g_gc_rings[r] = NULL;
+	}
+	g_gc_nr_rings = 0;
+	g_gc_trace_path = NULL;
+}
+#else /* MVRLU_ENABLE_GC_TRACE */
+int mvrlu_gc_trace_dump(const char *path)
+{
+	return -EOPNOTSUPP;
+}
+#endif /* MVRLU_ENABLE_GC_TRACE */
+EXPORT_SYMBOL(mvrlu_gc_trace_dump);
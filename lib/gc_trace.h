@@ -0,0 +1,131 @@
+// SPDX-FileCopyrightText: Copyright (c) 2018-2019 Virginia Tech
+// SPDX-License-Identifier: Apache-2.0
+#ifndef _GC_TRACE_H
+#define _GC_TRACE_H
+
+#include "config.h"
+#include "debug.h"
+#include "port.h"
+
+/*
+ * GC event tracer
+ *
+ * Each thread (including the qp thread) appends timestamped events to
+ * its own ring buffer, overwriting the oldest ones, so recording needs
+ * neither locks nor atomic RMW. Tracing is compiled in only with
+ * MVRLU_ENABLE_GC_TRACE and activated at run time by setting the
+ * MVRLU_GC_TRACE environment variable to the dump file path. The dump
+ * is written at mvrlu_finish() or by mvrlu_gc_trace_dump(), and
+ * tools/mvrlu-gc-trace.py converts it to Chrome trace JSON.
+ */
+
+enum { GC_EV_QP_BEGIN = 0, /* arg0: qp clock */
+       GC_EV_QP_END, /* arg0: straggler tid, arg1: nsecs waited for it */
+       GC_EV_NAP_BEGIN, /* arg0: nap in usec */
+       GC_EV_NAP_END, /* arg0: reclaim requested */
+       GC_EV_RECLAIM_BEGIN, /* arg0: log owner tid */
+       GC_EV_RECLAIM_END, /* arg0: log owner tid, arg1: bytes freed */
+       GC_EV_HIGH_MARK_BLOCK, /* arg0: log used bytes */
+       GC_EV_HIGH_MARK_UNBLOCK, /* arg0: log used bytes */
+       GC_EV_WAKEUP, /* arg0: GC_WAKEUP_* */
+       GC_EV_NR,
+};
+
+enum { GC_WAKEUP_LOW_MARK = 0, /* log usage crossed the low mark */
+       GC_WAKEUP_DEREF, /* too many dereferences hit copies */
+       GC_WAKEUP_FORCE, /* a writer blocks on its log */
+};
+
+#define GC_TRACE_NO_TID (~0u)
+#define GC_TRACE_QP_TID (~0u - 1)
+
+#define GC_TRACE_MAGIC "MVRLUGC"
+#define GC_TRACE_VERSION 1
+
+typedef struct gc_trace_ev {
+	unsigned long ts; /* CLOCK_MONOTONIC in nsec */
+	unsigned int type;
+	unsigned int tid;
+	unsigned long arg0;
+	unsigned long arg1;
+} gc_trace_ev_t;
+
+/* Dump file: a header followed by nr_evs events of each ring in turn */
+typedef struct gc_trace_file_hdr {
+	char magic[8];
+	unsigned int version;
+	unsigned int ev_size;
+	unsigned long nr_evs;
+} gc_trace_file_hdr_t;
+
+typedef struct gc_trace_ring {
+	volatile unsigned long head; /* number of events ever recorded */
+	volatile int in_use;
+	unsigned int tid;
+
+	long __padding_0[MVRLU_DEFAULT_PADDING];
+
+	gc_trace_ev_t evs[MVRLU_GC_TRACE_RING_SIZE];
+} gc_trace_ring_t;
+
+#ifdef MVRLU_ENABLE_GC_TRACE
+extern __thread gc_trace_ring_t *gc_trace_self;
+
+void gc_trace_init(void);
+void gc_trace_finish(void);
+void gc_trace_thread_init(unsigned int tid);
+void gc_trace_thread_finish(void);
+
+static inline unsigned long gc_trace_now(void)
+{
+	return gc_trace_self ? port_get_nsecs() : 0;
+}
+
+static inline void gc_trace(unsigned int type, unsigned long arg0,
+			    unsigned long arg1)
+{
+	gc_trace_ring_t *ring = gc_trace_self;
+	gc_trace_ev_t *ev;
+	unsigned long head;
+
+	if (likely(ring == NULL))
+		return;
+
+	head = ring->head;
+	ev = &ring->evs[head & (MVRLU_GC_TRACE_RING_SIZE - 1)];
+	ev->ts = port_get_nsecs();
+	ev->type = type;
+	ev->tid = ring->tid;
+	ev->arg0 = arg0;
+	ev->arg1 = arg1;
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+#else /* MVRLU_ENABLE_GC_TRACE */
+static inline void gc_trace_init(void)
+{
+}
+
+static inline void gc_trace_finish(void)
+{
+}
+
+static inline void gc_trace_thread_init(unsigned int tid)
+{
+}
+
+static inline void gc_trace_thread_finish(void)
+{
+}
+
+static inline unsigned long gc_trace_now(void)
+{
+	return 0;
+}
+
+static inline void gc_trace(unsigned int type, unsigned long arg0,
+			    unsigned long arg1)
+{
+}
+#endif /* MVRLU_ENABLE_GC_TRACE */
+
+#endif /* _GC_TRACE_H */
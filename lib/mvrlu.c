@@ -9,17 +9,26 @@
 #include "mvrlu_i.h"
 #include "debug.h"
 #include "port.h"
+#include "gc_trace.h"
+#include "contention.h"
+#include "durable.h"
+#include "shm.h"
+#include "copy.h"
 
 /*
  * Global data structures
  */
-static mvrlu_thread_list_t g_live_threads ____cacheline_aligned2;
-static mvrlu_thread_list_t g_zombie_threads ____cacheline_aligned2;
-static mvrlu_qp_thread_t g_qp_thread ____cacheline_aligned2;
-
-#ifdef MVRLU_ENABLE_STATS
-static mvrlu_stat_t g_stat ____cacheline_aligned2;
-#endif
+static mvrlu_global_t g_mvrlu_local ____cacheline_aligned2;
+static mvrlu_global_t *g_mvrlu __read_mostly = &g_mvrlu_local;
+static mvrlu_qp_worker_t g_qp_worker ____cacheline_aligned2;
+static int g_shm_attached __read_mostly; /* shared state is set up */
+
+#define g_live_threads (g_mvrlu->live_threads)
+#define g_zombie_threads (g_mvrlu->zombie_threads)
+#define g_live_tasks (g_mvrlu->live_tasks)
+#define g_qp_thread (g_mvrlu->qp_thread)
+#define g_reclaim_tasks (g_mvrlu->reclaim_tasks)
+#define g_stat (g_mvrlu->stat)
 
 /*
  * Forward declarations
@@ -27,7 +36,7 @@ static mvrlu_stat_t g_stat ____cacheline_aligned2;
 
 static void qp_update_qp_clk_for_reclaim(mvrlu_qp_thread_t *qp_thread,
 					 mvrlu_thread_struct_t *thread);
-static int wakeup_qp_thread_for_reclaim(void);
+static int wakeup_qp_thread_for_reclaim(int reason);
 static void print_config(void);
 
 /*
@@ -35,16 +44,16 @@ static void print_config(void);
  */
 
 #ifndef MVRLU_ORDO_TIMESTAMPING
-static volatile unsigned long
-	__g_wrt_clk[2 * CACHE_DEFAULT_PADDING] ____cacheline_aligned2;
-#define g_wrt_clk __g_wrt_clk[CACHE_DEFAULT_PADDING]
+#define g_wrt_clk (g_mvrlu->wrt_clk)
 #define gte_clock(__t1, __t2) ((__t1) >= (__t2))
+#define gt_clock(__t1, __t2) ((__t1) > (__t2))
 #define lte_clock(__t1, __t2) ((__t1) <= (__t2))
 #define get_clock() g_wrt_clk
 #define get_clock_relaxed() get_clock()
 #define init_clock()                                                           \
 	do {                                                                   \
-		g_wrt_clk = 0;                                                 \
+		if (!g_shm_attached)                                           \
+			g_wrt_clk = 0;                                         \
 	} while (0)
 #define new_clock(__x) (g_wrt_clk + 1)
 #define advance_clock() smp_faa(&g_wrt_clk, 1)
@@ -52,6 +61,7 @@ static volatile unsigned long
 #else /* MVRLU_ORDO_TIMESTAMPING */
 #include "ordo_clock.h"
 #define gte_clock(__t1, __t2) ordo_gt_clock(__t1, __t2)
+#define gt_clock(__t1, __t2) ordo_gt_clock(__t1, __t2)
 #define lte_clock(__t1, __t2) ordo_lt_clock(__t1, __t2)
 #define get_clock() ordo_get_clock()
 #define get_clock_relaxed() ordo_get_clock_relaxed()
@@ -67,18 +77,26 @@ static volatile unsigned long
 
 #define log_to_thread(__log)                                                   \
 	({                                                                     \
-		void *p = (void *)(__log);                                     \
-		void *q;                                                       \
-		q = p - ((size_t) & ((mvrlu_thread_struct_t *)0)->log);        \
-		(mvrlu_thread_struct_t *)q;                                    \
+		void *__p = (void *)(__log);                                   \
+		void *__q;                                                     \
+		__q = __p - ((size_t) & ((mvrlu_thread_struct_t *)0)->log);    \
+		(mvrlu_thread_struct_t *)__q;                                  \
 	})
 
 #define list_to_thread(__list)                                                 \
 	({                                                                     \
-		void *p = (void *)(__list);                                    \
-		void *q;                                                       \
-		q = p - ((size_t) & ((mvrlu_thread_struct_t *)0)->list);       \
-		(mvrlu_thread_struct_t *)q;                                    \
+		void *__p = (void *)(__list);                                  \
+		void *__q;                                                     \
+		__q = __p - ((size_t) & ((mvrlu_thread_struct_t *)0)->list);   \
+		(mvrlu_thread_struct_t *)__q;                                  \
+	})
+
+#define list_to_task(__list)                                                   \
+	({                                                                     \
+		void *__p = (void *)(__list);                                  \
+		void *__q;                                                     \
+		__q = __p - ((size_t) & ((mvrlu_task_struct_t *)0)->list);     \
+		(mvrlu_task_struct_t *)__q;                                    \
 	})
 
 #define chs_to_thread(__chs)                                                   \
@@ -94,7 +112,9 @@ static inline void assert_chs_type(const mvrlu_cpy_hdr_struct_t *chs)
 	mvrlu_assert(chs->obj_hdr.type == TYPE_WRT_SET ||
 		     chs->obj_hdr.type == TYPE_COPY ||
 		     chs->obj_hdr.type == TYPE_FREE ||
-		     chs->obj_hdr.type == TYPE_BOGUS);
+		     chs->obj_hdr.type == TYPE_BOGUS ||
+		     chs->obj_hdr.type == TYPE_DIFF ||
+		     chs->obj_hdr.type == TYPE_OVERLAY);
 }
 
 /*
@@ -105,6 +125,8 @@ static inline void assert_chs_type(const mvrlu_cpy_hdr_struct_t *chs)
 #define stat_thread_inc(self, x) stat_inc(&(self)->stat, stat_##x)
 #define stat_thread_acc(self, x, y) stat_acc(&(self)->stat, stat_##x, y)
 #define stat_thread_max(self, x, y) stat_max(&(self)->stat, stat_##x, y)
+#define stat_thread_chain(self, len) stat_chain(&(self)->stat, len)
+#define stat_thread_abort(self, reason) stat_abort(&(self)->stat, reason)
 #define stat_qp_inc(qp, x) stat_inc(&(qp)->stat, stat_##x)
 #define stat_qp_acc(qp, x, y) stat_acc(&(qp)->stat, stat_##x, y)
 #define stat_qp_max(qp, x, y) stat_max(&(qp)->stat, stat_##x, y)
@@ -113,10 +135,13 @@ static inline void assert_chs_type(const mvrlu_cpy_hdr_struct_t *chs)
 #define stat_log_max(log, x, y) stat_thread_max(log_to_thread(log), x, y)
 #define stat_thread_merge(self) stat_atomic_merge(&g_stat, &(self)->stat)
 #define stat_qp_merge(qp) stat_atomic_merge(&g_stat, &(qp)->stat)
+#define stat_now() port_get_nsecs()
 #else /* MVRLU_ENABLE_STATS */
 #define stat_thread_inc(self, x)
 #define stat_thread_acc(self, x, y)
 #define stat_thread_max(self, x, y)
+#define stat_thread_chain(self, len)
+#define stat_thread_abort(self, reason)
 #define stat_qp_inc(qp, x)
 #define stat_qp_acc(qp, x, y)
 #define stat_qp_max(qp, x, y)
@@ -125,6 +150,7 @@ static inline void assert_chs_type(const mvrlu_cpy_hdr_struct_t *chs)
 #define stat_log_max(log, x, y)
 #define stat_thread_merge(self)
 #define stat_qp_merge(qp)
+#define stat_now() 0ul
 #endif /* MVRLU_ENABLE_STATS */
 
 static const char *stat_get_name(int s)
@@ -146,12 +172,39 @@ static const char *stat_get_name(int s)
 	return stat_string[s];
 }
 
+/* Bytes reclaimed per second spent in log_reclaim() */
+static inline unsigned long stat_reclaim_rate(const mvrlu_stat_t *stat)
+{
+	unsigned long usecs = stat->cnt[stat_sum_reclaim_nsecs] / 1000;
+
+	return usecs ? stat->cnt[stat_sum_reclaim_bytes] * 1000000 / usecs : 0;
+}
+
+static inline int stat_is_max(int s)
+{
+	return s == stat_max_log_used_bytes || s == stat_max_qp_wait_usec;
+}
+
 static void stat_print_cnt(mvrlu_stat_t *stat)
 {
 	int i;
 	for (i = 0; i < stat_max__; ++i) {
 		printf("  %30s = %lu\n", stat_get_name(i), stat->cnt[i]);
 	}
+	printf("  %30s = %lu\n", "reclaim_bytes_per_sec",
+	       stat_reclaim_rate(stat));
+	for (i = 0; i < MVRLU_CHAIN_HIST_NR; ++i) {
+		char name[32];
+		unsigned int lo = i ? (1u << (i - 1)) + 1 : 1, hi = 1u << i;
+
+		if (i == MVRLU_CHAIN_HIST_NR - 1)
+			snprintf(name, sizeof(name), "chain_len[%u-]", lo);
+		else if (lo == hi)
+			snprintf(name, sizeof(name), "chain_len[%u]", lo);
+		else
+			snprintf(name, sizeof(name), "chain_len[%u-%u]", lo, hi);
+		printf("  %30s = %lu\n", name, stat->chain_len[i]);
+	}
 }
 
 static void stat_reset(mvrlu_stat_t *stat)
@@ -160,29 +213,106 @@ static void stat_reset(mvrlu_stat_t *stat)
 	for (i = 0; i < stat_max__; ++i) {
 		stat->cnt[i] = 0;
 	}
+	for (i = 0; i < MVRLU_CHAIN_HIST_NR; ++i) {
+		stat->chain_len[i] = 0;
+	}
+}
+
+static inline unsigned long stat_read(const unsigned long *cnt)
+{
+	return __atomic_load_n(cnt, __ATOMIC_RELAXED);
+}
+
+static void stat_atomic_max(unsigned long *tgt, unsigned long v)
+{
+	unsigned long old;
+
+	do {
+		old = *tgt;
+		if (v <= old)
+			return;
+	} while (!smp_cas(tgt, old, v));
 }
+
 static void stat_atomic_merge(mvrlu_stat_t *tgt, mvrlu_stat_t *src)
 {
 	int i;
 	for (i = 0; i < stat_max__; ++i) {
-		smp_faa(&tgt->cnt[i], src->cnt[i]);
+		if (stat_is_max(i))
+			stat_atomic_max(&tgt->cnt[i], src->cnt[i]);
+		else
+			smp_faa(&tgt->cnt[i], src->cnt[i]);
+	}
+	for (i = 0; i < MVRLU_CHAIN_HIST_NR; ++i) {
+		smp_faa(&tgt->chain_len[i], src->chain_len[i]);
+	}
+}
+
+static void stat_snapshot_merge(mvrlu_stat_t *tgt, const mvrlu_stat_t *src)
+{
+	unsigned long v;
+	int i;
+
+	/* src may be updated concurrently by its owner. */
+	for (i = 0; i < stat_max__; ++i) {
+		v = stat_read(&src->cnt[i]);
+		if (!stat_is_max(i))
+			tgt->cnt[i] += v;
+		else if (v > tgt->cnt[i])
+			tgt->cnt[i] = v;
+	}
+	for (i = 0; i < MVRLU_CHAIN_HIST_NR; ++i) {
+		tgt->chain_len[i] += stat_read(&src->chain_len[i]);
 	}
 }
 
+/*
+ * A counter has a single writer at a time: its owner thread, or the
+ * holder of log->reclaim_lock for the reclamation counters. Relaxed
+ * stores are enough to let mvrlu_get_stats() read them while running.
+ */
 static inline void stat_inc(mvrlu_stat_t *stat, int s)
 {
-	stat->cnt[s]++;
+	__atomic_store_n(&stat->cnt[s], stat->cnt[s] + 1, __ATOMIC_RELAXED);
 }
 
 static inline void stat_acc(mvrlu_stat_t *stat, int s, unsigned long v)
 {
-	stat->cnt[s] += v;
+	__atomic_store_n(&stat->cnt[s], stat->cnt[s] + v, __ATOMIC_RELAXED);
 }
 
 static inline void stat_max(mvrlu_stat_t *stat, int s, unsigned long v)
 {
 	if (v > stat->cnt[s])
-		stat->cnt[s] = v;
+		__atomic_store_n(&stat->cnt[s], v, __ATOMIC_RELAXED);
+}
+
+static inline void stat_abort(mvrlu_stat_t *stat, int reason)
+{
+	static const int reason_stat[MVRLU_ABORT_NR] = {
+		[MVRLU_ABORT_NONE] = -1,
+		[MVRLU_ABORT_LOCKED] = stat_n_abort_locked,
+		[MVRLU_ABORT_NEWER] = stat_n_abort_newer,
+		[MVRLU_ABORT_CAS] = stat_n_abort_cas,
+		[MVRLU_ABORT_ABA] = stat_n_abort_aba,
+		[MVRLU_ABORT_READ_SET] = stat_n_read_set_abort,
+		[MVRLU_ABORT_RO] = -1,
+	};
+
+	if (reason_stat[reason] >= 0)
+		stat_inc(stat, reason_stat[reason]);
+}
+
+static inline void stat_chain(mvrlu_stat_t *stat, unsigned int len)
+{
+	unsigned int i;
+
+	/* 1, 2, 3-4, 5-8, ... */
+	i = len <= 1 ? 0 : 32 - __builtin_clz(len - 1);
+	if (i >= MVRLU_CHAIN_HIST_NR)
+		i = MVRLU_CHAIN_HIST_NR - 1;
+	__atomic_store_n(&stat->chain_len[i], stat->chain_len[i] + 1,
+			 __ATOMIC_RELAXED);
 }
 
 /*
@@ -242,6 +372,12 @@ static inline void mvrlu_list_rotate_left(mvrlu_list_t *head)
 	     pos != &(tl)->list;                                               \
 	     pos = n, n = (pos)->next, thread = list_to_thread(pos))
 
+#define task_list_for_each_safe(tl, pos, n, task)                              \
+	for (pos = (tl)->list.next, n = (pos)->next,                           \
+	    task = list_to_task(pos);                                          \
+	     pos != &(tl)->list;                                               \
+	     pos = n, n = (pos)->next, task = list_to_task(pos))
+
 static inline int thread_list_has_waiter(mvrlu_thread_list_t *tl)
 {
 	return tl->thread_wait;
@@ -249,7 +385,12 @@ static inline int thread_list_has_waiter(mvrlu_thread_list_t *tl)
 
 static inline void init_thread_list(mvrlu_thread_list_t *tl)
 {
-	port_spin_init(&tl->lock);
+	/* A process may die holding a lock on a shared list; the pid in
+	 * shm_lock lets another take it over. */
+	if (shm_enabled())
+		shm_spin_init(&tl->shm_lock);
+	else
+		port_spin_init(&tl->lock);
 
 	tl->cur_tid = 0;
 	tl->num = 0;
@@ -258,32 +399,47 @@ static inline void init_thread_list(mvrlu_thread_list_t *tl)
 
 static inline void thread_list_destroy(mvrlu_thread_list_t *tl)
 {
-	port_spin_destroy(&tl->lock);
+	if (!shm_enabled())
+		port_spin_destroy(&tl->lock);
 }
 
 static inline void thread_list_lock(mvrlu_thread_list_t *tl)
 {
 	/* Lock acquisition with a normal priority */
-	port_spin_lock(&tl->lock);
+	if (shm_enabled())
+		shm_spin_lock(&tl->shm_lock);
+	else
+		port_spin_lock(&tl->lock);
+}
+
+static inline int thread_list_trylock(mvrlu_thread_list_t *tl)
+{
+	if (shm_enabled())
+		return shm_spin_trylock(&tl->shm_lock);
+	return port_spin_trylock(&tl->lock);
 }
 
 static inline void thread_list_lock_force(mvrlu_thread_list_t *tl)
 {
 	/* Lock acquisition with a high priority
-	 * which turns on the thread_wait flag
+	 * which counts us in thread_wait
 	 * so a lengthy task can stop voluntarily
-	 * stop and resume later. */
-	if (!port_spin_trylock(&tl->lock)) {
-		smp_cas(&tl->thread_wait, 0, 1);
-		port_spin_lock(&tl->lock);
+	 * stop and resume later. We stay counted until we
+	 * hold the lock: a holder that retries at once could
+	 * otherwise take it back before we run. */
+	if (!thread_list_trylock(tl)) {
+		smp_faa(&tl->thread_wait, 1);
+		thread_list_lock(tl);
+		smp_faa(&tl->thread_wait, -1);
 	}
 }
 
 static inline void thread_list_unlock(mvrlu_thread_list_t *tl)
 {
-	if (tl->thread_wait)
-		smp_atomic_store(&tl->thread_wait, 0);
-	port_spin_unlock(&tl->lock);
+	if (shm_enabled())
+		shm_spin_unlock(&tl->shm_lock);
+	else
+		port_spin_unlock(&tl->lock);
 }
 
 static inline void thread_list_add(mvrlu_thread_list_t *tl,
@@ -393,6 +549,104 @@ static inline void *align_ptr_to_cacheline(void *p)
 			MVRLU_CACHE_LINE_MASK);
 }
 
+static inline unsigned int align_uint_to_ulong(unsigned int unum)
+{
+	return (unum + sizeof(long) - 1) & ~(unsigned int)(sizeof(long) - 1);
+}
+
+/*
+ * Diff copies
+ */
+
+static inline int is_diff_obj(mvrlu_act_hdr_struct_t *ahs)
+{
+	return ahs->obj_hdr.flags & OBJ_DIFF;
+}
+
+static inline mvrlu_diff_t *chs_to_diff(mvrlu_cpy_hdr_struct_t *chs)
+{
+	void *p = chs->obj_hdr.obj;
+
+	return p + align_uint_to_ulong(chs->obj_hdr.obj_size);
+}
+
+static inline int chs_has_diff(mvrlu_cpy_hdr_struct_t *chs,
+			       mvrlu_act_hdr_struct_t *ahs)
+{
+	/* try_lock_const() copies carry no data */
+	return chs->obj_hdr.type == TYPE_DIFF ||
+	       (chs->obj_hdr.obj_size && is_diff_obj(ahs));
+}
+
+static inline unsigned int diff_chunk_size(unsigned int size)
+{
+	unsigned int chunk;
+
+	chunk = align_uint_to_cacheline((size + 63) / 64);
+	return chunk ? chunk : MVRLU_CACHE_LINE_SIZE;
+}
+
+static inline unsigned long diff_mask(const mvrlu_diff_t *diff, size_t off,
+				      size_t len)
+{
+	size_t first, last;
+
+	if (!len || off >= diff->size)
+		return 0;
+	if (len > diff->size - off)
+		len = diff->size - off;
+	first = off / diff->chunk;
+	last = (off + len - 1) / diff->chunk;
+	return (~0ul >> (63 - last)) & (~0ul << first);
+}
+
+#define diff_for_each_chunk(diff, mask, off)                                   \
+	for ((mask) = (diff)->mask;                                            \
+	     (mask) &&                                                         \
+	     ((off) = __builtin_ctzl(mask) * (diff)->chunk) < (diff)->size;    \
+	     (mask) &= (mask)-1)
+
+static inline unsigned int diff_chunk_len(const mvrlu_diff_t *diff,
+					  unsigned int off)
+{
+	unsigned int len = diff->size - off;
+
+	return len < diff->chunk ? len : diff->chunk;
+}
+
+static unsigned int diff_packed_size(const mvrlu_diff_t *diff)
+{
+	unsigned long mask;
+	unsigned int off, size = 0;
+
+	diff_for_each_chunk (diff, mask, off)
+		size += diff_chunk_len(diff, off);
+	return size;
+}
+
+/* Copy the dirty chunks of a diff copy within size bytes to dst */
+static unsigned int diff_apply(void *dst, unsigned int size,
+			       mvrlu_cpy_hdr_struct_t *chs,
+			       const mvrlu_diff_t *diff)
+{
+	const unsigned char *src = chs->obj_hdr.obj;
+	int packed = chs->obj_hdr.type == TYPE_DIFF;
+	unsigned long mask;
+	unsigned int off, len, bytes = 0;
+
+	diff_for_each_chunk (diff, mask, off) {
+		if (off >= size)
+			break;
+		len = diff_chunk_len(diff, off);
+		copy_obj(dst + off, packed ? src : src + off,
+			 len < size - off ? len : size - off);
+		bytes += len < size - off ? len : size - off;
+		if (packed)
+			src += len;
+	}
+	return bytes;
+}
+
 /*
  * Object copy operations
  */
@@ -410,32 +664,41 @@ static inline unsigned long get_wrt_clk(const mvrlu_cpy_hdr_struct_t *chs)
 	if (unlikely(wrt_clk == MAX_VERSION)) {
 		smp_rmb();
 		wrt_clk = *chs->cpy_hdr.p_wrt_clk;
+		/* Wait for the clock of a commit in progress (see
+		 * log_commit()) */
+		while (unlikely(wrt_clk == PENDING_VERSION)) {
+			port_cpu_relax_and_yield();
+			smp_rmb();
+			wrt_clk = *chs->cpy_hdr.p_wrt_clk;
+		}
 	}
 	return wrt_clk;
 }
 
+/* Returns MVRLU_ABORT_NONE on success or why it failed */
 static int try_lock_obj(mvrlu_act_hdr_struct_t *ahs, volatile void *p_old_copy,
 			volatile void *p_new_copy)
 {
 	int ret;
 
+	/* The caller has checked both; another writer came in since */
 	if (ahs->act_hdr.p_lock != NULL || ahs->obj_hdr.p_copy != p_old_copy)
-		return 0;
+		return MVRLU_ABORT_CAS;
 
 	ret = smp_cas(&ahs->act_hdr.p_lock, NULL, p_new_copy);
 	if (!ret)
-		return 0; /* smp_cas() failed */
+		return MVRLU_ABORT_CAS; /* smp_cas() failed */
 
 	if (unlikely(ahs->obj_hdr.p_copy != p_old_copy)) {
 		/* If it is ABA, unlock and return false */
 		smp_wmb();
 		ahs->act_hdr.p_lock = NULL;
-		return 0;
+		return MVRLU_ABORT_ABA;
 	}
 
 	/* Finally succeeded. Updating p_copy of p_new_copy
 	 * will be done upon commit. */
-	return 1;
+	return MVRLU_ABORT_NONE;
 }
 
 static void try_detach_obj(mvrlu_cpy_hdr_struct_t *chs)
@@ -460,24 +723,110 @@ static void try_detach_obj(mvrlu_cpy_hdr_struct_t *chs)
 	}
 }
 
-static int try_writeback_obj(mvrlu_cpy_hdr_struct_t *chs)
+/*
+ * A durable object takes every copy that reaches the write-back range,
+ * not only the latest one, because the newer copy may not be durable
+ * yet when this one is reclaimed. Nobody reads the object through an
+ * older version any more, so it is safe. The clock in the block header
+ * orders concurrent write-backs and tells recovery which logged copies
+ * are older than the object. A write-back cut short by the death of its
+ * process is redone when its log is reclaimed again.
+ */
+static int durable_writeback_obj(mvrlu_act_hdr_struct_t *ahs,
+				 mvrlu_cpy_hdr_struct_t *chs)
+{
+	durable_blk_t *blk = durable_blk_of(ahs);
+	unsigned long wrt_clk = get_wrt_clk(chs);
+	unsigned long clk;
+	unsigned int spins = 0;
+
+	/* try_lock_const() copies carry no data */
+	if (!chs->obj_hdr.obj_size)
+		return 0;
+
+	for (;;) {
+		clk = blk->wrt_clk;
+		if (unlikely(durable_wrt_clk_busy(clk))) {
+			if (unlikely(!(++spins % (1u << 16))) &&
+			    shm_enabled() &&
+			    shm_pid_dead(durable_wrt_clk_owner(clk)))
+				smp_cas(&blk->wrt_clk, clk, 0);
+			port_cpu_relax_and_yield();
+			continue;
+		}
+		if (clk >= wrt_clk)
+			return 0;
+		if (smp_cas(&blk->wrt_clk, clk, DURABLE_WRT_CLK_BUSY))
+			break;
+	}
+
+	copy_obj((void *)chs->cpy_hdr.p_act, chs->obj_hdr.obj,
+		 chs->obj_hdr.obj_size);
+	durable_flush(chs->cpy_hdr.p_act, chs->obj_hdr.obj_size);
+	smp_wmb_tso();
+	blk->wrt_clk = wrt_clk;
+	durable_flush(blk, sizeof(*blk));
+	return 1;
+}
+
+static int try_writeback_obj(mvrlu_log_t *log, mvrlu_cpy_hdr_struct_t *chs,
+			     unsigned long qp_clk1)
 {
 	mvrlu_act_hdr_struct_t *ahs;
+	volatile void *p;
 	void *p_act, *p_copy;
+	unsigned int bytes;
 
-	/* Copy to the actual object when it is the latest copy */
 	p_act = (void *)chs->cpy_hdr.p_act;
 	ahs = obj_to_ahs(p_act);
+	if (durable_enabled()) {
+		if (!durable_writeback_obj(ahs, chs))
+			return 0;
+		stat_log_acc(log, sum_writeback_bytes, chs->obj_hdr.obj_size);
+		return 1;
+	}
+
+	/* Copy to the actual object when it is the newest copy in the
+	 * write-back range. A newer copy may be committed already, but
+	 * mvrlu_deref() reads the actual object instead of this copy
+	 * once it is older than qp_clk2. A detached object holds a newer
+	 * copy. */
 	p_copy = (void *)chs->obj_hdr.obj;
-	if (ahs->obj_hdr.p_copy != p_copy)
-		return 0;
+	for (p = ahs->obj_hdr.p_copy; p != p_copy;
+	     p = vobj_to_obj_hdr(p)->p_copy) {
+		if (!p || lte_clock(get_wrt_clk(vobj_to_chs(p)), qp_clk1))
+			return 0;
+	}
 
-	/* Write back the copy to the master */
-	memcpy(p_act, p_copy, chs->obj_hdr.obj_size);
+	/* Write back the copy to the master, only its dirty chunks if
+	 * it has any */
+	if (chs_has_diff(chs, ahs)) {
+		bytes = diff_apply(p_act, chs_to_diff(chs)->size, chs,
+				   chs_to_diff(chs));
+	} else {
+		bytes = chs->obj_hdr.obj_size;
+		copy_obj(p_act, p_copy, bytes);
+	}
 	smp_wmb_tso();
+	stat_log_acc(log, sum_writeback_bytes, bytes);
 	return 1;
 }
 
+static inline void *obj_alloc(size_t size, unsigned int flags)
+{
+	if (durable_enabled())
+		return durable_alloc(size);
+	return port_alloc_x(size, flags);
+}
+
+static inline void obj_free(void *ahs)
+{
+	if (durable_enabled())
+		durable_free(ahs);
+	else
+		port_free(ahs);
+}
+
 static void free_obj(mvrlu_cpy_hdr_struct_t *chs)
 {
 #ifdef MVRLU_ENABLE_FREE_POISIONING
@@ -488,7 +837,7 @@ static void free_obj(mvrlu_cpy_hdr_struct_t *chs)
 	memset((void *)ahs, MVRLU_FREE_POSION, sizeof(*ahs));
 #endif
 
-	port_free(vobj_to_ahs(chs->cpy_hdr.p_act));
+	obj_free(vobj_to_ahs(chs->cpy_hdr.p_act));
 }
 
 /*
@@ -521,6 +870,16 @@ static inline mvrlu_wrt_set_struct_t *log_at_wss(mvrlu_log_t *log,
 	return wss;
 }
 
+/* The write set at cnt, by offset rather than by the address of a
+ * member of the packed header (-Waddress-of-packed-member); it is
+ * aligned since the header is. */
+static inline mvrlu_wrt_set_t *log_at_ws(mvrlu_log_t *log, unsigned long cnt)
+{
+	void *wss = log_at_wss(log, cnt);
+
+	return wss + offsetof(mvrlu_wrt_set_struct_t, wrt_set);
+}
+
 static inline mvrlu_cpy_hdr_struct_t *log_at_chs(mvrlu_log_t *log,
 						 unsigned long cnt)
 {
@@ -692,11 +1051,175 @@ static inline void fp_reset(mvrlu_free_ptrs_t *free_ptrs)
 	free_ptrs->num_ptrs = 0;
 }
 
+/* Objects from mvrlu_realloc() in a write set that aborts */
+static void fp_free_new(mvrlu_free_ptrs_t *new_ptrs)
+{
+	unsigned int i;
+
+	for (i = 0; i < new_ptrs->num_ptrs; ++i)
+		obj_free(obj_to_ahs(new_ptrs->ptrs[i]));
+	fp_reset(new_ptrs);
+}
+
+/*
+ * A try_lock_const() lock has no copy, so it is kept in an array of the
+ * thread instead of the log. Its p_lock is the thread with the lowest
+ * bit set, which no copy has.
+ */
+static inline void *const_lock_tag(mvrlu_thread_struct_t *thread)
+{
+	return (void *)((unsigned long)thread | 0x1ul);
+}
+
+static inline int is_const_lock(volatile void *p_lock)
+{
+	return (unsigned long)p_lock & 0x1ul;
+}
+
+static void cl_unlock(mvrlu_const_locks_t *const_locks)
+{
+	unsigned int i;
+
+	for (i = 0; i < const_locks->num_locks; ++i)
+		obj_to_ahs(const_locks->ptrs[i])->act_hdr.p_lock = NULL;
+	const_locks->num_locks = 0;
+}
+
+/* Turn a const lock into a copy of size zero in the log */
+static void cl_move_to_log(mvrlu_thread_struct_t *self,
+			   mvrlu_act_hdr_struct_t *ahs)
+{
+	mvrlu_const_locks_t *const_locks = &self->const_locks;
+	mvrlu_cpy_hdr_struct_t *chs;
+	int bogus_allocated;
+	unsigned int i;
+
+	chs = log_append_begin(&self->log, ahs->obj_hdr.obj, 0,
+			       &bogus_allocated);
+	ahs->act_hdr.p_lock = chs->obj_hdr.obj;
+	for (i = 0; i < const_locks->num_locks; ++i) {
+		if (const_locks->ptrs[i] == ahs->obj_hdr.obj) {
+			const_locks->ptrs[i] =
+				const_locks->ptrs[--const_locks->num_locks];
+			break;
+		}
+	}
+	log_append_end(&self->log, chs, bogus_allocated);
+}
+
 #define ws_for_each(log, ws, obj_idx, log_cnt)                                 \
 	for ((obj_idx) = 0, (log_cnt) = ws_iter_begin(ws);                     \
 	     (obj_idx) < (ws)->num_objs;                                       \
 	     ++(obj_idx), (log_cnt) = ws_iter_next(log_cnt, chs))
 
+/* Log size of a copy without the padding at the end of a log */
+static inline unsigned int copy_log_size(mvrlu_cpy_hdr_struct_t *chs,
+					 int has_diff)
+{
+	unsigned int size = chs->obj_hdr.obj_size;
+
+	if (has_diff)
+		size = align_uint_to_ulong(size) + sizeof(mvrlu_diff_t);
+	return align_uint_to_cacheline(size + sizeof(*chs));
+}
+
+/* Shrink a diff copy to its dirty chunks at dst_chs, which is not after
+ * it. Returns the new log size. */
+static unsigned int diff_compact(mvrlu_log_t *log, mvrlu_cpy_hdr_struct_t *chs,
+				 mvrlu_cpy_hdr_struct_t *dst_chs)
+{
+	mvrlu_diff_t diff = *chs_to_diff(chs);
+	unsigned char *src = chs->obj_hdr.obj, *dst;
+	unsigned long mask;
+	unsigned int off, len, packed;
+
+	packed = diff_packed_size(&diff);
+	if (packed >= diff.size) {
+		if (dst_chs != chs)
+			memmove(dst_chs, chs, copy_log_size(chs, 1));
+		return copy_log_size(dst_chs, 1);
+	}
+
+	/* A chunk never moves forward, and the header ends before the
+	 * data it is moved from. */
+	if (dst_chs != chs)
+		memmove(dst_chs, chs, sizeof(*chs));
+	dst = dst_chs->obj_hdr.obj;
+	diff_for_each_chunk (&diff, mask, off) {
+		len = diff_chunk_len(&diff, off);
+		memmove(dst, src + off, len);
+		dst += len;
+	}
+	dst_chs->obj_hdr.type = TYPE_DIFF;
+	dst_chs->obj_hdr.obj_size = packed;
+	*chs_to_diff(dst_chs) = diff;
+	stat_log_inc(log, n_diff_copy);
+	return copy_log_size(dst_chs, 1);
+}
+
+/*
+ * Shrink the diff copies of the write set to their dirty chunks and
+ * drop the overlays of the critical section, which nobody reads after
+ * it. Later copies move toward the head with their locks. Nobody else
+ * reads a copy before ws_move_lock_to_copy() publishes it.
+ */
+static void ws_compact(mvrlu_log_t *log)
+{
+	mvrlu_wrt_set_t *ws;
+	mvrlu_act_hdr_struct_t *ahs;
+	mvrlu_cpy_hdr_struct_t *chs, *dst_chs = NULL;
+	unsigned long cnt, next_cnt, dst_cnt;
+	unsigned int log_size = 0, num_objs, i;
+
+#ifdef MVRLU_NESTED_LOCKING
+	/* Other threads find the owner of a lock through its copy */
+	return;
+#endif
+	/* A copy cannot move across the end of the log */
+	ws = log->cur_wrt_set;
+	if (log_index(ws->start_tail_cnt) + (log->tail_cnt - ws->start_tail_cnt) >
+	    MVRLU_LOG_SIZE)
+		return;
+
+	num_objs = 0;
+	cnt = dst_cnt = ws_iter_begin(ws);
+	for (i = 0; i < ws->num_objs; ++i, cnt = next_cnt) {
+		chs = log_at_chs(log, cnt);
+		mvrlu_assert(chs->obj_hdr.type == TYPE_COPY ||
+			     chs->obj_hdr.type == TYPE_OVERLAY);
+		next_cnt = ws_iter_next(cnt, chs);
+		if (chs->obj_hdr.type == TYPE_OVERLAY)
+			continue;
+
+		dst_chs = log_at_chs(log, dst_cnt);
+		ahs = vobj_to_ahs(chs->cpy_hdr.p_act);
+		if (chs_has_diff(chs, ahs))
+			log_size = diff_compact(log, chs, dst_chs);
+		else {
+			log_size = copy_log_size(chs, 0);
+			if (dst_chs != chs)
+				memmove(dst_chs, chs, log_size);
+		}
+		dst_chs->obj_hdr.padding_size =
+			log_size - dst_chs->obj_hdr.obj_size;
+		if (dst_chs != chs)
+			ahs->act_hdr.p_lock = dst_chs->obj_hdr.obj;
+		dst_cnt += log_size;
+		num_objs++;
+	}
+	if (dst_cnt == log->tail_cnt)
+		return;
+
+	/* Keep the header of the next write set from wrapping around, as
+	 * log_alloc() does */
+	log->tail_cnt = dst_cnt - log_size;
+	dst_chs->obj_hdr.padding_size +=
+		add_extra_padding(log, log_size, sizeof(mvrlu_wrt_set_struct_t),
+				  0);
+	ws->num_objs = num_objs;
+	log->tail_cnt += get_log_size(dst_chs);
+}
+
 static void ws_move_lock_to_copy(mvrlu_log_t *log, mvrlu_free_ptrs_t *free_ptrs)
 {
 	mvrlu_wrt_set_t *ws;
@@ -714,11 +1237,13 @@ static void ws_move_lock_to_copy(mvrlu_log_t *log, mvrlu_free_ptrs_t *free_ptrs)
 
 		chs = log_at_chs(log, cnt);
 		assert_chs_type(chs);
-		if (unlikely(chs->obj_hdr.type == TYPE_BOGUS)) {
+		/* Skip bogus ones, overlays and, when finishing the write
+		 * set of a dead thread, copies it already marked free. */
+		if (unlikely(chs->obj_hdr.type != TYPE_COPY &&
+			     chs->obj_hdr.type != TYPE_DIFF)) {
 			continue;
 		}
 		ahs = vobj_to_ahs(chs->cpy_hdr.p_act);
-		mvrlu_assert(chs->obj_hdr.type == TYPE_COPY);
 		mvrlu_assert(ahs->act_hdr.p_lock == chs->obj_hdr.obj);
 
 		/* If an object is free()-ed, change its type. */
@@ -737,8 +1262,10 @@ static void ws_move_lock_to_copy(mvrlu_log_t *log, mvrlu_free_ptrs_t *free_ptrs)
 			continue;
 
 		/* Move a locked object to the version chain
-		 * of an actual object. */
+		 * of an actual object unless a dead thread did. */
 		p_old_copy = ahs->obj_hdr.p_copy;
+		if (unlikely(p_old_copy == chs->obj_hdr.obj))
+			continue;
 
 		while (1) {
 			/* Initialize p_copy and wrt_clk_next. */
@@ -779,10 +1306,12 @@ static void ws_unlock(mvrlu_log_t *log, unsigned long wrt_clk)
 	ws_for_each (log, ws, i, cnt) {
 		chs = log_at_chs(log, cnt);
 		assert_chs_type(chs);
-		if (unlikely(chs->obj_hdr.type == TYPE_BOGUS)) {
+		if (unlikely(chs->obj_hdr.type == TYPE_BOGUS ||
+			     chs->obj_hdr.type == TYPE_OVERLAY)) {
 			continue;
 		}
 		mvrlu_assert(chs->obj_hdr.type == TYPE_COPY ||
+			     chs->obj_hdr.type == TYPE_DIFF ||
 			     chs->obj_hdr.type == TYPE_FREE);
 
 		/* Mark version */
@@ -792,7 +1321,7 @@ static void ws_unlock(mvrlu_log_t *log, unsigned long wrt_clk)
 		}
 
 		/* Unlock */
-		if (likely(chs->obj_hdr.type == TYPE_COPY)) {
+		if (likely(chs->obj_hdr.type != TYPE_FREE)) {
 			mvrlu_act_hdr_struct_t *ahs;
 			ahs = vobj_to_ahs(chs->cpy_hdr.p_act);
 			mvrlu_assert(ahs->act_hdr.p_lock == chs->obj_hdr.obj);
@@ -801,20 +1330,92 @@ static void ws_unlock(mvrlu_log_t *log, unsigned long wrt_clk)
 	}
 }
 
-static void log_commit(mvrlu_log_t *log, mvrlu_free_ptrs_t *free_ptrs,
-		       unsigned long local_clk)
+static void log_abort(mvrlu_log_t *log, mvrlu_free_ptrs_t *free_ptrs)
+{
+	/* Unlock objects without marking wrt_clk */
+	ws_unlock(log, MAX_VERSION);
+
+	/* Reset the current write set */
+	log->tail_cnt = log->cur_wrt_set->start_tail_cnt;
+	log->cur_wrt_set = NULL;
+	log->num_diffs = 0;
+	fp_reset(free_ptrs);
+}
+
+/* Does the lock belong to the thread? */
+static inline int is_own_lock(mvrlu_thread_struct_t *thread,
+			      volatile void *p_lock)
+{
+	return p_lock == const_lock_tag(thread) ||
+	       (unsigned long)p_lock - (unsigned long)thread->log.buffer <
+		       MVRLU_LOG_SIZE;
+}
+
+/* Is every object of the read set still at the version of the
+ * snapshot and not locked by another thread? */
+static int rs_validate(mvrlu_thread_struct_t *thread,
+		       mvrlu_read_set_t *read_set, unsigned long local_clk)
+{
+	mvrlu_act_hdr_struct_t *ahs;
+	volatile void *p_lock, *p_copy;
+	unsigned int i;
+
+	for (i = 0; i < read_set->num_objs; ++i) {
+		ahs = obj_to_ahs(read_set->ptrs[i]);
+		p_lock = ahs->act_hdr.p_lock;
+		if (p_lock && !is_own_lock(thread, p_lock))
+			goto conflict;
+		smp_rmb();
+		p_copy = ahs->obj_hdr.p_copy;
+		if (p_copy &&
+		    !lte_clock(get_wrt_clk(vobj_to_chs(p_copy)), local_clk))
+			goto conflict;
+	}
+	return 1;
+conflict:
+	read_set->conflict = read_set->ptrs[i];
+	return 0;
+}
+
+static int log_commit(mvrlu_log_t *log, mvrlu_free_ptrs_t *free_ptrs,
+		      mvrlu_read_set_t *read_set, unsigned long local_clk)
 {
 	mvrlu_assert(log->cur_wrt_set);
 	mvrlu_assert(obj_to_chs(log->cur_wrt_set)->obj_hdr.type ==
 		     TYPE_WRT_SET);
 
+	/* Validate the read set while the write set is locked. Of two
+	 * writers that each depend on what the other changes, the later
+	 * one to validate sees the lock or the commit of the other. */
+	if (unlikely(read_set->num_objs) &&
+	    !rs_validate(log_to_thread(log), read_set, local_clk)) {
+		log_abort(log, free_ptrs);
+		return 0;
+	}
+
+	if (log->num_diffs) {
+		ws_compact(log);
+		log->num_diffs = 0;
+	}
+	stat_log_acc(log, sum_log_bytes,
+		     log->tail_cnt - log->cur_wrt_set->start_tail_cnt);
+
 	/* Move a committed object to its version chain */
 	ws_move_lock_to_copy(log, free_ptrs);
 	smp_wmb();
 
-	/* Make them public atomically */
+	/* Make them public atomically. A reader that starts after
+	 * PENDING_VERSION is visible waits for the clock, so a writer
+	 * preempted between taking and storing the clock cannot show
+	 * half of the write set to a reader whose clock is later. */
+	smp_atomic_store(&log->cur_wrt_set->wrt_clk, PENDING_VERSION);
 	smp_atomic_store(&log->cur_wrt_set->wrt_clk, new_clock(local_clk));
 
+	/* Persist the write set before unlocking so no writer builds on
+	 * a commit that a crash could lose */
+	if (durable_enabled())
+		durable_log_commit(log, log->cur_wrt_set->start_tail_cnt);
+
 	/* Advance global clock */
 	advance_clock();
 
@@ -824,22 +1425,25 @@ static void log_commit(mvrlu_log_t *log, mvrlu_free_ptrs_t *free_ptrs,
 	/* Clean up */
 	log->cur_wrt_set = NULL;
 	fp_reset(free_ptrs);
+	return 1;
 }
 
-static void log_abort(mvrlu_log_t *log, mvrlu_free_ptrs_t *free_ptrs)
+/*
+ * End a write set of overlays only. They stay until the qp thread is
+ * done with readers as old as the critical section, like the copies of
+ * a commit.
+ */
+static void log_retire(mvrlu_log_t *log, unsigned long local_clk)
 {
-	/* Unlock objects without marking wrt_clk */
-	ws_unlock(log, MAX_VERSION);
-
-	/* Reset the current write set */
-	log->tail_cnt = log->cur_wrt_set->start_tail_cnt;
+	mvrlu_assert(!log->num_diffs);
+	log->cur_wrt_set->wrt_clk = local_clk;
 	log->cur_wrt_set = NULL;
-	fp_reset(free_ptrs);
 }
 
 static inline int try_lock(volatile unsigned int *lock)
 {
-	if (*lock == 0 && smp_cas(lock, 0, 1))
+	/* The holder is known if its process dies */
+	if (*lock == 0 && smp_cas(lock, 0, shm_self_id()))
 		return 1;
 	return 0;
 }
@@ -849,6 +1453,36 @@ static inline void unlock(volatile unsigned int *lock)
 	*lock = 0;
 }
 
+/*
+ * Event count: a waiter registers itself, samples seq, re-checks its
+ * wake-up condition and sleeps only if seq is unchanged. A signaler
+ * makes the condition true before bumping seq, and enters the kernel
+ * only if someone is registered.
+ */
+static inline unsigned int event_prepare(mvrlu_event_t *ev)
+{
+	smp_faa(&ev->nr_waiters, 1);
+	return ev->seq;
+}
+
+static inline void event_wait(mvrlu_event_t *ev, unsigned int seq,
+			      unsigned long usecs)
+{
+	port_wait_on(&ev->seq, seq, usecs, shm_enabled());
+}
+
+static inline void event_finish(mvrlu_event_t *ev)
+{
+	smp_fas(&ev->nr_waiters, 1);
+}
+
+static inline void event_signal(mvrlu_event_t *ev)
+{
+	smp_faa(&ev->seq, 1);
+	if (ev->nr_waiters)
+		port_wake_up(&ev->seq, shm_enabled());
+}
+
 static void log_reclaim(mvrlu_log_t *log)
 {
 	/*
@@ -857,15 +1491,15 @@ static void log_reclaim(mvrlu_log_t *log)
 	 *                       ======
 	 *
 	 *                           head'
-	 *            head           qp2        qp1    tail
-	 *              \           /          /      /
-	 *     +---------+====================+------+------+
-	 *     |         |..........|/////////|      |      |
-	 *     +---------+====================+------+------+
+	 *            head           qp3       qp2        qp1    tail
+	 *              \           /         /          /      /
+	 *     +---------+==============================+------+------+
+	 *     |         |..........|         |/////////|      |      |
+	 *     +---------+==============================+------+------+
 	 *               ~~~~~~~~~~>
 	 *               reclaim
-	 *                          ~~~~~~~~~~>
-	 *                          writeback
+	 *                                    ~~~~~~~~~~>
+	 *                                    writeback
 	 *
 	 * 1. (qp1, tail)
 	 *   - The master is still accessible.
@@ -873,18 +1507,24 @@ static void log_reclaim(mvrlu_log_t *log)
 	 *   - Nobody accesses the master because all threads
 	 *   access the copy. Thus, we can safely write back
 	 *   the copy to the master.
-	 *   - Write back only if the copy is the latest.
+	 *   - Write back only if the copy is the newest one
+	 *   up to qp1.
 	 *   - While nobody accesses the master, the copy is
 	 *   still accessible. So we cannot free the master yet.
-	 * 3. [head, qp2]
+	 * 3. (qp3, qp2]
+	 *   - Written back already. A reader that is still
+	 *   running may have read qp2 of its log before this
+	 *   round started, so it can still step from a newer
+	 *   copy to this one. Keep it for one more round.
+	 * 4. [head, qp3]
 	 *   - Nobobdy accesses this copy because a thread
 	 *   accesses either of the master or a newer copy.
 	 *   Thus, we can safely reclaim this copy.
 	 *   - Since nobody accesses either the master
 	 *   or the copy, we can free the master.
-	 * 4. head' = qp2
-	 *   - head is updated to qp2 because log reclamation
-	 *   will resume from qp2.
+	 * 5. head' = qp3
+	 *   - head is updated to qp3 because log reclamation
+	 *   will resume from qp3.
 	 *
 	 */
 
@@ -894,9 +1534,13 @@ static void log_reclaim(mvrlu_log_t *log)
 	unsigned long cnt;
 	unsigned long qp_clk1;
 	unsigned long qp_clk2;
+	unsigned long qp_clk3;
 	unsigned int i;
 	unsigned long start_cnt;
 	unsigned long tail_cnt;
+	unsigned long head_cnt;
+	unsigned long new_head_cnt;
+	unsigned long start_nsecs;
 	unsigned int index;
 	int reclaim;
 	int try_writeback;
@@ -906,9 +1550,20 @@ static void log_reclaim(mvrlu_log_t *log)
 	if (!try_lock(&log->reclaim_lock))
 		return;
 
+	/* The round may be over and the next one being set up; only a
+	 * pending request guarantees a consistent set of qp clocks. */
+	smp_mb();
+	if (!log->need_reclaim) {
+		unlock(&log->reclaim_lock);
+		return;
+	}
+
+	start_nsecs = stat_now();
+	gc_trace(GC_EV_RECLAIM_BEGIN, log_to_thread(log)->tid, 0);
 	qp_clk1 = log->qp_clk1;
 	qp_clk2 = log->qp_clk2;
-	start_cnt = log->head_cnt;
+	qp_clk3 = log->qp_clk3;
+	start_cnt = head_cnt = new_head_cnt = log->head_cnt;
 	tail_cnt = log->tail_cnt;
 	while (start_cnt < tail_cnt) {
 		reclaim = 0;
@@ -919,9 +1574,9 @@ static void log_reclaim(mvrlu_log_t *log)
 
 		if (gte_clock(ws->wrt_clk, qp_clk1) && ws->wrt_clk != qp_clk1)
 			break;
-		else if (lte_clock(ws->wrt_clk, qp_clk2))
+		else if (lte_clock(ws->wrt_clk, qp_clk3))
 			reclaim = 1;
-		else if (lte_clock(ws->wrt_clk, qp_clk1))
+		else if (!lte_clock(ws->wrt_clk, qp_clk2))
 			try_writeback = 1;
 
 		ws_for_each (log, ws, i, cnt) {
@@ -929,7 +1584,12 @@ static void log_reclaim(mvrlu_log_t *log)
 			assert_chs_type(chs);
 			switch (chs->obj_hdr.type) {
 			case TYPE_COPY:
-				if (try_writeback && try_writeback_obj(chs))
+			case TYPE_DIFF:
+				/* A durable copy must reach its object before
+				 * the head passes it. */
+				if ((try_writeback ||
+				     (reclaim && durable_enabled())) &&
+				    try_writeback_obj(log, chs, qp_clk1))
 					try_detach_obj(chs);
 				stat_log_inc(log, n_reclaim_copy);
 				break;
@@ -940,6 +1600,7 @@ static void log_reclaim(mvrlu_log_t *log)
 				}
 				break;
 			case TYPE_BOGUS:
+			case TYPE_OVERLAY:
 				break; /* Do nothing */
 			default:
 				mvrlu_assert(0 && "Never be here");
@@ -950,10 +1611,20 @@ static void log_reclaim(mvrlu_log_t *log)
 		start_cnt = cnt;
 		mvrlu_assert(start_cnt <= log->tail_cnt);
 		if (reclaim)
-			log->head_cnt = start_cnt;
+			new_head_cnt = start_cnt;
 		stat_log_inc(log, n_reclaim_wrt_set);
 	}
+
+	/* The owner reuses the log space as soon as the head moves, so a
+	 * durable head has to move first. */
+	if (durable_enabled())
+		durable_log_persist_head(log, new_head_cnt);
+	log->head_cnt = new_head_cnt;
 	stat_log_inc(log, n_reclaim);
+	stat_log_acc(log, sum_reclaim_bytes, log->head_cnt - head_cnt);
+	stat_log_acc(log, sum_reclaim_nsecs, stat_now() - start_nsecs);
+	gc_trace(GC_EV_RECLAIM_END, log_to_thread(log)->tid,
+		 log->head_cnt - head_cnt);
 	log->need_reclaim = 0;
 
 	unlock(&log->reclaim_lock);
@@ -967,29 +1638,146 @@ static void log_reclaim_force(mvrlu_log_t *log)
 	}
 
 	if (log->head_cnt != log->tail_cnt) {
-		int count = 0; /* TODO FIXME */
-		wakeup_qp_thread_for_reclaim();
+		mvrlu_event_t *ev = &g_qp_thread.reclaim;
+		unsigned long head_cnt = log->head_cnt;
+		unsigned int seq;
+
+		/* Sleep until the qp thread hands this log over for
+		 * reclamation. It may also reclaim the log on our behalf
+		 * (qp_help_reclaim_log), clearing need_reclaim before we
+		 * observe it, so stop waiting once the head moves. */
 		do {
-			port_cpu_relax_and_yield();
-			smp_mb();
-			count++;
-			if (count == 1000) {
-				wakeup_qp_thread_for_reclaim();
-				count = 0;
+			seq = event_prepare(ev);
+			if (!log->need_reclaim && log->head_cnt == head_cnt) {
+				wakeup_qp_thread_for_reclaim(GC_WAKEUP_FORCE);
+				event_wait(ev, seq, MVRLU_QP_MAX_INTERVAL_USEC);
 			}
-		} while (!log->need_reclaim);
+			event_finish(ev);
+		} while (!log->need_reclaim && log->head_cnt == head_cnt);
 		log_reclaim(log);
 	}
 }
 
+/*
+ * Reclamation tasks
+ */
+
+static inline int reclaim_tasks_pending(void)
+{
+	mvrlu_reclaim_tasks_t *rt = &g_reclaim_tasks;
+
+	return rt->next < rt->nr;
+}
+
+static int reclaim_steal(void)
+{
+	mvrlu_reclaim_tasks_t *rt = &g_reclaim_tasks;
+	volatile unsigned int *nr_stealers = &rt->nr_stealers;
+	mvrlu_log_t *log;
+	unsigned int i;
+	int rc = 0;
+
+	/* A registered stealer holds off reclaim_tasks_reset() and
+	 * reclaim_tasks_remove(), so the log it takes stays valid.
+	 * Processes count their stealers apart, so a dead one can be
+	 * written off. */
+	if (shm_enabled())
+		nr_stealers = shm_stealers();
+	smp_faa(nr_stealers, 1);
+	i = smp_faa(&rt->next, 1);
+	if (i < rt->nr) {
+		log = rt->logs[i];
+		if (log)
+			log_reclaim(log);
+		rc = 1;
+	}
+	smp_fas(nr_stealers, 1);
+	return rc;
+}
+
+static void reclaim_tasks_drain(mvrlu_reclaim_tasks_t *rt)
+{
+	unsigned int spins = 0;
+
+	smp_mb();
+	while (rt->nr_stealers || (shm_enabled() && shm_nr_stealers())) {
+		if (shm_enabled() && !(++spins % (1u << 16)))
+			shm_drop_dead_stealers();
+		port_cpu_relax_and_yield();
+	}
+}
+
+/* Called with the live thread list locked */
+static void reclaim_tasks_reset(void)
+{
+	mvrlu_reclaim_tasks_t *rt = &g_reclaim_tasks;
+
+	smp_atomic_store(&rt->nr, 0);
+	reclaim_tasks_drain(rt);
+}
+
+/* Called with the live thread list locked */
+static void reclaim_tasks_publish(unsigned int nr)
+{
+	mvrlu_reclaim_tasks_t *rt = &g_reclaim_tasks;
+
+	rt->next = 0;
+	smp_mb();
+	smp_atomic_store(&rt->nr, nr);
+}
+
+/* Called with the live thread list locked */
+static void reclaim_tasks_remove(mvrlu_log_t *log)
+{
+	mvrlu_reclaim_tasks_t *rt = &g_reclaim_tasks;
+	unsigned int i;
+
+	for (i = 0; i < rt->nr; ++i) {
+		if (rt->logs[i] == log)
+			rt->logs[i] = NULL;
+	}
+	reclaim_tasks_drain(rt);
+}
+
 /*
  * Quiescent detection functions
  */
 
-static void qp_init(mvrlu_qp_thread_t *qp_thread, unsigned long qp_clk)
+static unsigned long qp_pace_thread(mvrlu_thread_struct_t *thread,
+				    unsigned long elapsed_usec)
+{
+	mvrlu_qp_info_t *qp_info = &thread->qp_info;
+	unsigned long tail_cnt, used, rate;
+
+	/* Update the fill rate of the log. A burst is taken as is while
+	 * a slowdown decays, so we rather wake up too early. */
+	tail_cnt = thread->log.tail_cnt;
+	rate = (tail_cnt - qp_info->tail_cnt) * 1000 / (elapsed_usec + 1);
+	qp_info->tail_cnt = tail_cnt;
+	if (rate < qp_info->fill_rate)
+		rate = (qp_info->fill_rate * 3 + rate) / 4;
+	qp_info->fill_rate = rate;
+
+	/* Predict when the log reaches the low mark. */
+	used = log_used(&thread->log);
+	if (used >= MVRLU_LOG_LOW_MARK)
+		return 0;
+	if (rate == 0)
+		return ULONG_MAX;
+	return (MVRLU_LOG_LOW_MARK - used) * 1000 / rate;
+}
+
+static void qp_init(mvrlu_qp_thread_t *qp_thread, unsigned long qp_clk,
+		    unsigned long now_usec)
 {
 	mvrlu_thread_struct_t *thread;
+	mvrlu_task_struct_t *task;
 	mvrlu_list_t *pos, *n;
+	unsigned long elapsed_usec, low_mark_usec, usec;
+
+	elapsed_usec = now_usec - qp_thread->qp_init_usec;
+	qp_thread->qp_init_usec = now_usec;
+	low_mark_usec = ULONG_MAX;
 
 	thread_list_lock(&g_live_threads);
 	{
@@ -997,16 +1785,106 @@ static void qp_init(mvrlu_qp_thread_t *qp_thread, unsigned long qp_clk)
 			thread->qp_info.run_cnt = thread->run_cnt;
 			thread->qp_info.need_wait =
 				thread->qp_info.run_cnt & 0x1;
+
+			usec = qp_pace_thread(thread, elapsed_usec);
+			if (usec < low_mark_usec)
+				low_mark_usec = usec;
 		}
 	}
 	thread_list_unlock(&g_live_threads);
+
+	thread_list_lock(&g_live_tasks);
+	{
+		task_list_for_each_safe (&g_live_tasks, pos, n, task) {
+			task->qp_info.run_cnt = task->run_cnt;
+			task->qp_info.need_wait = task->qp_info.run_cnt & 0x1;
+		}
+	}
+	thread_list_unlock(&g_live_tasks);
+
+	/* Copies become reclaimable three quiescent periods after they are
+	 * written, so nap for a third of the time until the first log hits
+	 * the low mark. Under pressure, request reclamation and detect
+	 * periods back-to-back until it is done. */
+	if (low_mark_usec == 0) {
+		usec = 0;
+		if (!qp_thread->need_reclaim)
+			smp_cas(&qp_thread->need_reclaim, 0, 1);
+	} else if (low_mark_usec / 3 < MVRLU_QP_MIN_INTERVAL_USEC)
+		usec = MVRLU_QP_MIN_INTERVAL_USEC;
+	else if (low_mark_usec / 3 > MVRLU_QP_MAX_INTERVAL_USEC)
+		usec = MVRLU_QP_MAX_INTERVAL_USEC;
+	else
+		usec = low_mark_usec / 3;
+	smp_atomic_store(&qp_thread->qp_nap_usec, usec);
+}
+
+/*
+ * A suspended task is a reader that runs on no thread, and may stay
+ * suspended for as long as its server likes. Past MVRLU_QP_TASK_WAIT_USEC
+ * in a round, a task that is still suspended expires instead: its
+ * snapshot is dropped and mvrlu_task_resume() fails. A running task
+ * leaves its section on its own, so it is waited for.
+ */
+static void qp_wait_tasks(unsigned long qp_clk)
+{
+	mvrlu_task_struct_t *task;
+	mvrlu_list_t *pos, *n;
+	unsigned long deadline;
+	unsigned int spins;
+
+	deadline = port_get_usecs() + MVRLU_QP_TASK_WAIT_USEC;
+retry:
+	thread_list_lock(&g_live_tasks);
+	{
+		task_list_for_each_safe (&g_live_tasks, pos, n, task) {
+			if (!task->qp_info.need_wait)
+				continue;
+
+			spins = 0;
+			while (task->qp_info.run_cnt == task->run_cnt &&
+			       !gt_clock(task->local_clk, qp_clk)) {
+				++spins;
+				if (shm_enabled() && !(spins % (1u << 16)) &&
+				    shm_pid_dead(task->pid))
+					break;
+
+				if (task->state == TASK_EXPIRED)
+					break;
+				if (task->state == TASK_SUSPENDED &&
+				    !(spins % (1u << 10)) &&
+				    port_get_usecs() >= deadline &&
+				    smp_cas(&task->state, TASK_SUSPENDED,
+					    TASK_EXPIRED))
+					break;
+
+				/* A task may be waiting to leave the list
+				 * while we wait for it, so let it run. */
+				if (thread_list_has_waiter(&g_live_tasks)) {
+					thread_list_unlock(&g_live_tasks);
+					port_yield();
+					goto retry;
+				}
+
+				port_cpu_relax_and_yield();
+				smp_mb();
+			}
+			task->qp_info.need_wait = 0;
+		}
+	}
+	thread_list_unlock(&g_live_tasks);
 }
 
-static void qp_wait(mvrlu_qp_thread_t *qp_thread, unsigned long qp_clk)
+static void qp_wait(mvrlu_qp_thread_t *qp_thread, unsigned long qp_clk,
+		    unsigned int *straggler, unsigned long *straggler_nsecs)
 {
 	mvrlu_thread_struct_t *thread;
 	mvrlu_list_t *pos, *n;
+	unsigned long spin_nsecs;
+	unsigned int spins;
 
+	*straggler = GC_TRACE_NO_TID;
+	*straggler_nsecs = 0;
 retry:
 	thread_list_lock(&g_live_threads);
 	{
@@ -1014,49 +1892,96 @@ retry:
 			if (!thread->qp_info.need_wait)
 				continue;
 
+			/* Remember who we waited for the longest. */
+			spin_nsecs = gc_trace_now();
+			spins = 0;
 			while (1) {
-				/* Check if a thread passed quiescent period. */
+				/* Check if a thread passed quiescent period.
+				 * A reader with the same clock may have
+				 * started before the last write-back, so
+				 * it has to leave. */
 				if (thread->qp_info.run_cnt !=
 					    thread->run_cnt ||
-				    gte_clock(thread->local_clk, qp_clk)) {
+				    gt_clock(thread->local_clk, qp_clk)) {
+					thread->qp_info.need_wait = 0;
+					break;
+				}
+
+				/* A dead thread never reads again; it is
+				 * reaped after this period. */
+				if (shm_enabled() && !(++spins % (1u << 16)) &&
+				    shm_pid_dead(thread->pid)) {
 					thread->qp_info.need_wait = 0;
 					break;
 				}
 
 				/* If a thread is waiting for adding or deleting
-				 * from/to the thread list, yield and retry. */
+				 * from/to the thread list, yield and retry. The
+				 * waiter may be adding a context inside a
+				 * section we wait for, so let it run even on a
+				 * single CPU. */
 				if (thread_list_has_waiter(&g_live_threads)) {
 					thread_list_unlock(&g_live_threads);
+					port_yield();
 					goto retry;
 				}
 
 				port_cpu_relax_and_yield();
 				smp_mb();
 			}
+			spin_nsecs = gc_trace_now() - spin_nsecs;
+			if (spin_nsecs > *straggler_nsecs) {
+				*straggler = thread->tid;
+				*straggler_nsecs = spin_nsecs;
+			}
 		}
 	}
 	thread_list_unlock(&g_live_threads);
+
+	qp_wait_tasks(qp_clk);
 }
 
-static void qp_take_nap(mvrlu_qp_thread_t *qp_thread)
+static void qp_take_nap(mvrlu_qp_thread_t *qp_thread, unsigned long usecs)
 {
-	port_initiate_nap(&qp_thread->cond_mutex, &qp_thread->cond,
-			  MVRLU_QP_INTERVAL_USEC);
+	unsigned int seq;
+
+	gc_trace(GC_EV_NAP_BEGIN, usecs, 0);
+	seq = event_prepare(&qp_thread->wakeup);
+	if (!qp_thread->need_reclaim && !g_qp_worker.stop_requested)
+		event_wait(&qp_thread->wakeup, seq, usecs);
+	event_finish(&qp_thread->wakeup);
+	gc_trace(GC_EV_NAP_END, qp_thread->need_reclaim, 0);
 }
 
 static void qp_detect(mvrlu_qp_thread_t *qp_thread)
 {
 	unsigned long qp_clk;
+	unsigned long start_usec, wait_usec, end_usec;
+	unsigned long straggler_nsecs;
+	unsigned int straggler;
+	unsigned long nap_usec;
 
+	start_usec = port_get_usecs();
 	qp_clk = get_clock();
-	qp_init(qp_thread, qp_clk);
+	gc_trace(GC_EV_QP_BEGIN, qp_clk, 0);
+	qp_init(qp_thread, qp_clk, start_usec);
 	stat_qp_inc(qp_thread, n_qp_detect);
-	if (!qp_thread->need_reclaim) {
-		qp_take_nap(qp_thread);
+	nap_usec = qp_thread->qp_nap_usec;
+	if (!qp_thread->need_reclaim && nap_usec) {
+		qp_take_nap(qp_thread, nap_usec);
 		stat_qp_inc(qp_thread, n_qp_nap);
-	}
-	qp_wait(qp_thread, qp_clk);
+		stat_qp_acc(qp_thread, sum_qp_nap_usec, nap_usec);
+	} else
+		stat_qp_inc(qp_thread, n_qp_back_to_back);
+	wait_usec = port_get_usecs();
+	qp_wait(qp_thread, qp_clk, &straggler, &straggler_nsecs);
 	qp_thread->qp_clk = correct_qp_clk(qp_clk);
+	end_usec = port_get_usecs();
+	gc_trace(GC_EV_QP_END, straggler, straggler_nsecs);
+
+	smp_atomic_store(&qp_thread->qp_period_usec, end_usec - start_usec);
+	smp_atomic_store(&qp_thread->qp_wait_usec, end_usec - wait_usec);
+	stat_qp_max(qp_thread, max_qp_wait_usec, end_usec - wait_usec);
 }
 
 static void qp_help_reclaim_log(mvrlu_qp_thread_t *qp_thread)
@@ -1064,6 +1989,12 @@ static void qp_help_reclaim_log(mvrlu_qp_thread_t *qp_thread)
 	mvrlu_thread_struct_t *thread;
 	mvrlu_list_t *pos, *n;
 
+	/* Take the logs nobody else has stolen yet. */
+	while (reclaim_tasks_pending() && reclaim_steal())
+		stat_qp_inc(qp_thread, n_qp_help_reclaim);
+
+	/* Some logs could not be reclaimed because their owner was
+	 * reclaiming them; walk the list for the rest. */
 retry:
 	thread_list_lock(&g_live_threads);
 	{
@@ -1073,6 +2004,7 @@ retry:
 			 * from/to the thread list, yield and retry. */
 			if (thread_list_has_waiter(&g_live_threads)) {
 				thread_list_unlock(&g_live_threads);
+				port_yield();
 				goto retry;
 			}
 
@@ -1087,6 +2019,9 @@ retry:
 		thread_list_rotate_left_unsafe(&g_live_threads);
 	}
 	thread_list_unlock(&g_live_threads);
+
+	/* Some logs may have been reclaimed on behalf of their owners */
+	event_signal(&qp_thread->reclaim);
 }
 
 static void qp_reap_zombie_threads(mvrlu_qp_thread_t *qp_thread)
@@ -1103,6 +2038,7 @@ retry:
 			 * from/to the thread list, yield and retry. */
 			if (thread_list_has_waiter(&g_zombie_threads)) {
 				thread_list_unlock(&g_zombie_threads);
+				port_yield();
 				goto retry;
 			}
 
@@ -1156,8 +2092,10 @@ static int qp_check_reclaim_done(mvrlu_qp_thread_t *qp_thread)
 static void qp_update_qp_clk_for_reclaim(mvrlu_qp_thread_t *qp_thread,
 					 mvrlu_thread_struct_t *thread)
 {
+	thread->log.qp_clk3 = thread->log.qp_clk2;
 	thread->log.qp_clk2 = thread->log.qp_clk1;
 	thread->log.qp_clk1 = qp_thread->qp_clk;
+	smp_wmb();
 	thread->log.need_reclaim = 1;
 }
 
@@ -1165,28 +2103,271 @@ static void qp_trigger_reclaim(mvrlu_qp_thread_t *qp_thread)
 {
 	mvrlu_thread_struct_t *thread;
 	mvrlu_list_t *pos, *n;
+	unsigned int nr = 0;
 
 	thread_list_lock(&g_live_threads);
 	{
+		reclaim_tasks_reset();
 		thread_list_for_each_safe (&g_live_threads, pos, n, thread) {
 			qp_update_qp_clk_for_reclaim(qp_thread, thread);
+			g_reclaim_tasks.logs[nr++] = &thread->log;
 		}
+		reclaim_tasks_publish(nr);
 	}
 	thread_list_unlock(&g_live_threads);
 	smp_mb();
+
+	/* Logs are ready to reclaim; wake up blocked writers and helpers */
+	event_signal(&qp_thread->reclaim);
+}
+
+/*
+ * Dead processes (shm mode)
+ */
+
+#ifndef __KERNEL__
+/* A lock taken right before the death is not in the write set yet */
+static void shm_unlock_uncounted(mvrlu_log_t *log)
+{
+	mvrlu_cpy_hdr_struct_t *chs;
+	mvrlu_act_hdr_struct_t *ahs;
+
+	chs = log_at(log, log->tail_cnt);
+	if (chs->obj_hdr.type != TYPE_COPY ||
+	    !durable_contains(vobj_to_ahs(chs->cpy_hdr.p_act)))
+		return;
+	ahs = vobj_to_ahs(chs->cpy_hdr.p_act);
+	smp_cas(&ahs->act_hdr.p_lock, (void *)chs->obj_hdr.obj, NULL);
+}
+
+/* cl_unlock() of locks that may be released or not taken yet */
+static void shm_cl_unlock(mvrlu_thread_struct_t *thread)
+{
+	mvrlu_const_locks_t *const_locks = &thread->const_locks;
+	unsigned int i;
+
+	for (i = 0; i < const_locks->num_locks; ++i)
+		smp_cas(&obj_to_ahs(const_locks->ptrs[i])->act_hdr.p_lock,
+			const_lock_tag(thread), NULL);
+	const_locks->num_locks = 0;
+}
+
+/* Did the commit of the write set start? */
+static int shm_ws_published(mvrlu_log_t *log)
+{
+	mvrlu_wrt_set_t *ws = log->cur_wrt_set;
+	mvrlu_cpy_hdr_struct_t *chs;
+	mvrlu_act_hdr_struct_t *ahs;
+	unsigned long cnt;
+	unsigned int i;
+
+	if (ws->wrt_clk != MAX_VERSION)
+		return 1;
+	ws_for_each (log, ws, i, cnt) {
+		chs = log_at_chs(log, cnt);
+		if (chs->obj_hdr.type == TYPE_FREE)
+			return 1;
+		if (chs->obj_hdr.type != TYPE_COPY)
+			continue;
+		ahs = vobj_to_ahs(chs->cpy_hdr.p_act);
+		if (ahs->obj_hdr.p_copy == chs->obj_hdr.obj)
+			return 1;
+	}
+	return 0;
+}
+
+/* ws_unlock() of a write set that may be unlocked in part already */
+static void shm_ws_unlock(mvrlu_log_t *log)
+{
+	mvrlu_wrt_set_t *ws = log->cur_wrt_set;
+	mvrlu_cpy_hdr_struct_t *chs;
+	mvrlu_act_hdr_struct_t *ahs;
+	unsigned long cnt;
+	unsigned int i;
+
+	ws_for_each (log, ws, i, cnt) {
+		chs = log_at_chs(log, cnt);
+		if (chs->obj_hdr.type == TYPE_BOGUS)
+			continue;
+		if (ws->wrt_clk != MAX_VERSION)
+			chs->cpy_hdr.__wrt_clk = ws->wrt_clk;
+		if (chs->obj_hdr.type != TYPE_COPY)
+			continue;
+		ahs = vobj_to_ahs(chs->cpy_hdr.p_act);
+		smp_cas(&ahs->act_hdr.p_lock, (void *)chs->obj_hdr.obj, NULL);
+	}
+}
+
+/*
+ * Finish the write set a dead thread left behind. Once the commit has
+ * put a copy in a version chain, the write set cannot be rolled back
+ * because the copy it replaced may be reclaimed already, so the commit
+ * is completed. Otherwise, the write set is aborted.
+ */
+static void shm_recover_wrt_set(mvrlu_thread_struct_t *thread)
+{
+	mvrlu_log_t *log = &thread->log;
+	mvrlu_wrt_set_t *ws = log->cur_wrt_set;
+
+	if (!ws)
+		return;
+	shm_unlock_uncounted(log);
+	if (!shm_ws_published(log)) {
+		shm_ws_unlock(log);
+		log->tail_cnt = ws->start_tail_cnt;
+		fp_free_new(&thread->new_ptrs);
+	} else {
+		if (ws->wrt_clk == MAX_VERSION ||
+		    ws->wrt_clk == PENDING_VERSION) {
+			ws_move_lock_to_copy(log, &thread->free_ptrs);
+			smp_wmb();
+			smp_atomic_store(&ws->wrt_clk,
+					 new_clock(thread->local_clk));
+		}
+		durable_log_commit(log, ws->start_tail_cnt);
+		advance_clock();
+		shm_ws_unlock(log);
+	}
+	log->cur_wrt_set = NULL;
+	fp_reset(&thread->free_ptrs);
+	fp_reset(&thread->new_ptrs);
+}
+
+static void shm_release_reclaim_locks(mvrlu_thread_list_t *tl, int pid)
+{
+	mvrlu_thread_struct_t *thread;
+	mvrlu_list_t *pos, *n;
+
+	thread_list_for_each_safe (tl, pos, n, thread) {
+		if (thread->log.reclaim_lock == (unsigned int)pid)
+			unlock(&thread->log.reclaim_lock);
+	}
+}
+
+/* Turn the threads of a dead process into dead zombies and drop its
+ * tasks */
+static void qp_reap_dead_proc(mvrlu_qp_thread_t *qp_thread, unsigned int slot,
+			      int pid)
+{
+	mvrlu_thread_struct_t *thread;
+	mvrlu_task_struct_t *task;
+	mvrlu_list_t *pos, *n;
+
+	mvrlu_trace_global("Reaping threads of dead process %d\n", pid);
+	shm_drop_dead_stealers();
+	thread_list_lock_force(&g_live_threads);
+	{
+		thread_list_for_each_safe (&g_live_threads, pos, n, thread) {
+			if (thread->pid != pid)
+				continue;
+			shm_recover_wrt_set(thread);
+			shm_cl_unlock(thread);
+			thread->qp_info.need_wait = 0;
+			thread_list_del_unsafe(&g_live_threads, thread);
+			reclaim_tasks_remove(&thread->log);
+			smp_atomic_store(&thread->live_status,
+					 THREAD_DEAD_ZOMBIE);
+			thread_list_add(&g_zombie_threads, thread);
+		}
+		shm_release_reclaim_locks(&g_live_threads, pid);
+
+		thread_list_lock(&g_zombie_threads);
+		thread_list_for_each_safe (&g_zombie_threads, pos, n, thread) {
+			if (thread->pid == pid)
+				smp_atomic_store(&thread->live_status,
+						 THREAD_DEAD_ZOMBIE);
+		}
+		shm_release_reclaim_locks(&g_zombie_threads, pid);
+		thread_list_unlock(&g_zombie_threads);
+	}
+	thread_list_unlock(&g_live_threads);
+
+	thread_list_lock_force(&g_live_tasks);
+	{
+		task_list_for_each_safe (&g_live_tasks, pos, n, task) {
+			if (task->pid != pid)
+				continue;
+			g_live_tasks.num--;
+			mvrlu_list_del(&task->list);
+			durable_free(task);
+		}
+	}
+	thread_list_unlock(&g_live_tasks);
+	shm_reaped(slot, pid);
+
+	/* Reclaim their logs */
+	if (!qp_thread->need_reclaim)
+		smp_cas(&qp_thread->need_reclaim, 0, 1);
+}
+
+static void qp_reap_dead_procs(mvrlu_qp_thread_t *qp_thread)
+{
+	unsigned int slot = 0;
+	int pid;
+
+	while ((pid = shm_find_dead(&slot)) != 0)
+		qp_reap_dead_proc(qp_thread, slot++, pid);
+}
+
+/* Wait until this process owns the segment or is asked to stop */
+static int qp_own_segment(mvrlu_qp_worker_t *worker)
+{
+	mvrlu_event_t *ev = &g_qp_thread.wakeup;
+	unsigned int seq;
+
+	while (!worker->stop_requested) {
+		if (shm_qp_own())
+			return 1;
+		seq = event_prepare(ev);
+		if (!worker->stop_requested)
+			event_wait(ev, seq, MVRLU_QP_MAX_INTERVAL_USEC);
+		event_finish(ev);
+	}
+	return 0;
+}
+#else /* __KERNEL__ */
+static void qp_reap_dead_procs(mvrlu_qp_thread_t *qp_thread)
+{
+}
+
+static int qp_own_segment(mvrlu_qp_worker_t *worker)
+{
+	return 1;
+}
+
+static void shm_qp_disown(void)
+{
 }
+#endif /* __KERNEL__ */
 
 static void __qp_thread_main(void *arg)
 {
-	mvrlu_qp_thread_t *qp_thread = arg;
+	mvrlu_qp_worker_t *worker = arg;
+	mvrlu_qp_thread_t *qp_thread = &g_qp_thread;
+	unsigned long check_usec = 0, now_usec;
 	int reclaim_done;
 	int i;
 
+	gc_trace_thread_init(GC_TRACE_QP_TID);
+
+	/* In shm mode, only one process detects quiescent periods. The
+	 * others stand by in case it dies. */
+	if (shm_enabled() && !qp_own_segment(worker))
+		goto out;
+
 	/* qp detection loop */
 	reclaim_done = 1;
-	while (!qp_thread->stop_requested) {
+	while (!worker->stop_requested) {
 		qp_detect(qp_thread);
 
+		if (shm_enabled()) {
+			now_usec = port_get_usecs();
+			if (now_usec - check_usec >= MVRLU_SHM_CHECK_USEC) {
+				check_usec = now_usec;
+				qp_reap_dead_procs(qp_thread);
+			}
+		}
+
 		if (!reclaim_done) {
 			qp_reap_zombie_threads(qp_thread);
 			qp_help_reclaim_log(qp_thread);
@@ -1194,6 +2375,8 @@ static void __qp_thread_main(void *arg)
 			if (reclaim_done) {
 				smp_cas(&qp_thread->need_reclaim, 1, 0);
 				smp_mb();
+				if (durable_enabled() && !g_zombie_threads.num)
+					durable_reclaim_round();
 			}
 		}
 
@@ -1203,13 +2386,22 @@ static void __qp_thread_main(void *arg)
 		}
 	}
 
+	/* Other processes may still read the logs; the next owner
+	 * carries on and the last one leaves them to recovery. */
+	if (shm_enabled()) {
+		shm_qp_disown();
+		goto out;
+	}
+
 	/* This is the final reclamation so we should completely reclaim
-	 * all logs. To do that, we have to reclaim twice because we need
-	 * two qp duration for complete reclamation. */
-	for (i = 0; i < 2; ++i) {
+	 * all logs. To do that, we have to reclaim three times because we
+	 * need three qp durations for complete reclamation. */
+	for (i = 0; i < 3; ++i) {
 		qp_thread->qp_clk = get_clock();
 		qp_reap_zombie_threads(qp_thread);
 	}
+out:
+	gc_trace_thread_finish();
 }
 
 #ifdef __KERNEL__
@@ -1226,16 +2418,20 @@ static void *qp_thread_main(void *arg)
 }
 #endif
 
-static int init_qp_thread(mvrlu_qp_thread_t *qp_thread)
+static void init_qp_state(mvrlu_qp_thread_t *qp_thread)
+{
+	memset(qp_thread, 0, sizeof(*qp_thread));
+	qp_thread->qp_nap_usec = MVRLU_QP_INTERVAL_USEC;
+	qp_thread->qp_init_usec = port_get_usecs();
+}
+
+static int init_qp_thread(mvrlu_qp_worker_t *worker)
 {
 	int rc;
 
-	memset(qp_thread, 0, sizeof(*qp_thread));
-	port_cond_init(&qp_thread->cond);
-	port_mutex_init(&qp_thread->cond_mutex);
-	rc = port_create_thread("qp_thread", &qp_thread->thread,
-				&qp_thread_main, qp_thread,
-				&qp_thread->completion);
+	memset(worker, 0, sizeof(*worker));
+	rc = port_create_thread("qp_thread", &worker->thread, &qp_thread_main,
+				worker, &worker->completion);
 	if (rc) {
 		mvrlu_trace_global("Error creating builder thread: %d\n", rc);
 		return rc;
@@ -1245,34 +2441,136 @@ static int init_qp_thread(mvrlu_qp_thread_t *qp_thread)
 
 static inline void wakeup_qp_thread(mvrlu_qp_thread_t *qp_thread)
 {
-	port_initiate_wakeup(&qp_thread->cond_mutex, &qp_thread->cond);
+	event_signal(&qp_thread->wakeup);
 }
 
-static void finish_qp_thread(mvrlu_qp_thread_t *qp_thread)
+static void finish_qp_thread(mvrlu_qp_worker_t *worker)
 {
-	wakeup_qp_thread(qp_thread);
-
-	smp_atomic_store(&qp_thread->stop_requested, 1);
+	smp_atomic_store(&worker->stop_requested, 1);
 	smp_mb();
+	wakeup_qp_thread(&g_qp_thread);
 
-	port_wait_for_finish(&qp_thread->thread, &qp_thread->completion);
-	port_mutex_destroy(&qp_thread->cond_mutex);
-	port_cond_destroy(&qp_thread->cond);
-	stat_qp_merge(qp_thread);
+	port_wait_for_finish(&worker->thread, &worker->completion);
+	/* The qp thread of a segment outlives this process */
+	if (!shm_enabled())
+		stat_qp_merge(&g_qp_thread);
 }
 
-static inline int wakeup_qp_thread_for_reclaim(void)
+static inline int wakeup_qp_thread_for_reclaim(int reason)
 {
 	mvrlu_qp_thread_t *qp_thread = &g_qp_thread;
 
 	if (!qp_thread->need_reclaim &&
 	    smp_cas(&qp_thread->need_reclaim, 0, 1)) {
+		gc_trace(GC_EV_WAKEUP, reason, 0);
 		wakeup_qp_thread(qp_thread);
 		return 1;
 	}
 	return 0;
 }
 
+/*
+ * Durable mode
+ */
+
+static int init_log_region(void)
+{
+#ifndef __KERNEL__
+	if (durable_enabled())
+		return port_log_region_attach(durable_log_at(0), MVRLU_LOG_SIZE,
+					      MVRLU_DURABLE_MAX_LOGS,
+					      g_durable_hdr->log_bitmap);
+#endif
+	return port_log_region_init(MVRLU_LOG_SIZE, MVRLU_MAX_THREAD_NUM);
+}
+
+#ifndef __KERNEL__
+typedef struct durable_ws_ref {
+	unsigned long wrt_clk;
+	unsigned long cnt;
+	unsigned int slot;
+} durable_ws_ref_t;
+
+static int durable_ws_ref_cmp(const void *p1, const void *p2)
+{
+	const durable_ws_ref_t *r1 = p1, *r2 = p2;
+
+	if (r1->wrt_clk != r2->wrt_clk)
+		return r1->wrt_clk < r2->wrt_clk ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Apply the write sets committed between the durable head and tail of
+ * every log in wrt_clk order. A copy may be older than its object:
+ * a newer copy in another log may have been written back and reclaimed
+ * already. The clock recorded at write-back tells them apart. A torn
+ * write-back is redone since its write set is still in the log.
+ */
+static int durable_replay_logs(void)
+{
+	durable_hdr_t *hdr = g_durable_hdr;
+	durable_ws_ref_t *refs = NULL, *tmp;
+	mvrlu_cpy_hdr_struct_t *chs;
+	mvrlu_wrt_set_t *ws;
+	mvrlu_log_t log;
+	durable_blk_t *blk;
+	unsigned long nr = 0, max = 0, n, cnt;
+	unsigned int slot, i;
+
+	memset(&log, 0, sizeof(log));
+	for (slot = 0; slot < hdr->nr_logs; ++slot) {
+		log.buffer = durable_log_at(slot);
+		cnt = hdr->slots[slot].head_cnt;
+		while (cnt < hdr->slots[slot].tail_cnt) {
+			if (nr == max) {
+				max = max ? max * 2 : 1024;
+				tmp = realloc(refs, max * sizeof(*refs));
+				if (!tmp) {
+					free(refs);
+					return -ENOMEM;
+				}
+				refs = tmp;
+			}
+			ws = log_at_ws(&log, cnt);
+			refs[nr].wrt_clk = ws->wrt_clk;
+			refs[nr].cnt = cnt;
+			refs[nr].slot = slot;
+			++nr;
+
+			ws_for_each (&log, ws, i, cnt) {
+				chs = log_at_chs(&log, cnt);
+			}
+		}
+	}
+	qsort(refs, nr, sizeof(*refs), durable_ws_ref_cmp);
+
+	for (n = 0; n < nr; ++n) {
+		log.buffer = durable_log_at(refs[n].slot);
+		ws = log_at_ws(&log, refs[n].cnt);
+		ws_for_each (&log, ws, i, cnt) {
+			chs = log_at_chs(&log, cnt);
+			if (chs->obj_hdr.type != TYPE_COPY ||
+			    !chs->obj_hdr.obj_size)
+				continue;
+			blk = durable_blk_of(vobj_to_ahs(chs->cpy_hdr.p_act));
+			if (durable_wrt_clk_busy(blk->wrt_clk))
+				blk->wrt_clk = 0; /* torn write-back */
+			if (refs[n].wrt_clk < blk->wrt_clk)
+				continue;
+			memcpy((void *)chs->cpy_hdr.p_act, chs->obj_hdr.obj,
+			       chs->obj_hdr.obj_size);
+			blk->wrt_clk = refs[n].wrt_clk;
+			durable_flush(chs->cpy_hdr.p_act, chs->obj_hdr.obj_size);
+		}
+	}
+	durable_fence();
+
+	free(refs);
+	return 0;
+}
+#endif /* __KERNEL__ */
+
 /*
  * External APIs
  */
@@ -1286,21 +2584,31 @@ int __init mvrlu_init(void)
 	static_assert(sizeof(mvrlu_act_hdr_struct_t) < L1_CACHE_BYTES);
 	static_assert(sizeof(mvrlu_cpy_hdr_struct_t) < L1_CACHE_BYTES);
 	static_assert((MVRLU_LOG_SIZE & (MVRLU_LOG_SIZE - 1)) == 0);
+	static_assert((int)stat_max__ == (int)MVRLU_STAT_NR);
 
 	/* Make sure whether it is initialized once */
 	if (!smp_cas(&init, 0, 1))
 		return -EBUSY;
 
-	/* Initialize */
+	/* Initialize. A process attaching to a segment finds the global
+	 * state initialized already. */
+	gc_trace_init();
+	contention_init();
+	copy_init();
+	if (!g_shm_attached) {
+		memset(g_mvrlu, 0, sizeof(*g_mvrlu));
+		init_thread_list(&g_live_threads);
+		init_thread_list(&g_zombie_threads);
+		init_thread_list(&g_live_tasks);
+		init_qp_state(&g_qp_thread);
+	}
 	init_clock();
-	init_thread_list(&g_live_threads);
-	init_thread_list(&g_zombie_threads);
-	rc = port_log_region_init(MVRLU_LOG_SIZE, MVRLU_MAX_THREAD_NUM);
+	rc = init_log_region();
 	if (rc) {
 		mvrlu_trace_global("Fail to initialize a log region\n");
 		return rc;
 	}
-	rc = init_qp_thread(&g_qp_thread);
+	rc = init_qp_thread(&g_qp_worker);
 	if (rc) {
 		mvrlu_trace_global("Fail to initialize a qp thread\n");
 		return rc;
@@ -1312,29 +2620,122 @@ early_initcall(mvrlu_init);
 
 void mvrlu_finish(void)
 {
-	finish_qp_thread(&g_qp_thread);
-	thread_list_destroy(&g_live_threads);
-	thread_list_destroy(&g_zombie_threads);
+	finish_qp_thread(&g_qp_worker);
+	if (shm_enabled()) {
+		/* Keep the statistics for mvrlu_print_stats() */
+#ifdef MVRLU_ENABLE_STATS
+		mvrlu_stat_t stat;
+
+		mvrlu_get_stats(&stat, MVRLU_STAT_LIVE);
+		g_mvrlu_local.stat = stat;
+#endif
+		g_mvrlu = &g_mvrlu_local;
+	} else {
+		thread_list_destroy(&g_live_threads);
+		thread_list_destroy(&g_zombie_threads);
+		thread_list_destroy(&g_live_tasks);
+	}
 	port_log_region_destroy();
+	if (durable_enabled())
+		durable_close();
+	gc_trace_finish();
+	contention_finish();
 }
 
-mvrlu_thread_struct_t *mvrlu_thread_alloc(void)
+#ifndef __KERNEL__
+int mvrlu_durable_init(const char *path, size_t size, int sync)
 {
-	return port_alloc(sizeof(mvrlu_thread_struct_t));
-}
-EXPORT_SYMBOL(mvrlu_thread_alloc);
+	int recovered, rc;
+
+	recovered = durable_open(path, size, sync, 0);
+	if (recovered < 0)
+		return recovered;
+	if (recovered) {
+		rc = durable_replay_logs();
+		if (rc)
+			goto err_close;
+	}
+	durable_recover_heap();
+
+	rc = mvrlu_init();
+	if (rc)
+		goto err_close;
+	durable_open_done();
+	return recovered;
+
+err_close:
+	durable_close();
+	return rc;
+}
+
+int mvrlu_shm_init(const char *path, size_t size)
+{
+	int state, rc;
+
+	state = durable_open(path, size, MVRLU_DURABLE_SYNC_NONE, 1);
+	if (state < 0)
+		return state;
+	if (state != DURABLE_OPEN_ATTACHED) {
+		/* The first process recovers the file */
+		if (state == DURABLE_OPEN_EXISTING) {
+			rc = durable_replay_logs();
+			if (rc)
+				goto err_close;
+		}
+		durable_recover_heap();
+	}
+
+	g_mvrlu = &g_shm->global;
+	g_shm_attached = state == DURABLE_OPEN_ATTACHED;
+	rc = mvrlu_init();
+	if (rc)
+		goto err_close;
+	durable_open_done();
+	return g_shm_attached;
+
+err_close:
+	g_mvrlu = &g_mvrlu_local;
+	g_shm_attached = 0;
+	durable_close();
+	return rc;
+}
+#else
+int mvrlu_durable_init(const char *path, size_t size, int sync)
+{
+	return -EOPNOTSUPP;
+}
+
+int mvrlu_shm_init(const char *path, size_t size)
+{
+	return -EOPNOTSUPP;
+}
+#endif /* __KERNEL__ */
+EXPORT_SYMBOL(mvrlu_durable_init);
+EXPORT_SYMBOL(mvrlu_shm_init);
+
+mvrlu_thread_struct_t *mvrlu_thread_alloc(void)
+{
+	/* Other processes walk the thread lists of a segment */
+	if (shm_enabled())
+		return durable_alloc_raw(sizeof(mvrlu_thread_struct_t));
+	return port_alloc(sizeof(mvrlu_thread_struct_t));
+}
+EXPORT_SYMBOL(mvrlu_thread_alloc);
 
 void mvrlu_thread_free(mvrlu_thread_struct_t *self)
 {
-	smp_atomic_store(&self->live_status, THREAD_DEAD_ZOMBIE);
+	/* If the log is not completely reclaimed yet, the thread
+	 * is on the zombie list and the qp thread frees it once the
+	 * log is reclaimed. Hand it over in one atomic step: checking
+	 * the log here races with the qp thread reaping the thread,
+	 * and both sides would free it. */
+	if (smp_cas(&self->live_status, THREAD_LIVE_ZOMBIE,
+		    THREAD_DEAD_ZOMBIE))
+		return;
 
-	/* If the log is not completely reclaimed yet,
-	 * defer the free until it is completely reclaimed.
-	 * In this case, we just move the thread to the zombie
-	 * list and the qp thread will eventually reclaim
-	 * the log. */
-	smp_mb();
-	if (self->log.head_cnt == self->log.tail_cnt)
+	if (shm_enabled())
+		durable_free(self);
+	else
 		port_free(self);
 }
 EXPORT_SYMBOL(mvrlu_thread_free);
@@ -1343,40 +2744,59 @@ void mvrlu_thread_init(mvrlu_thread_struct_t *self)
 {
 	/* Zero out self */
 	memset(self, 0, sizeof(*self));
+	self->pid = shm_self_id();
 
 	/* Allocate cacheline-aligned log space */
 	self->log.buffer = port_alloc_log_mem();
 	mvrlu_assert(self->log.buffer ==
 		     align_ptr_to_cacheline((void *)self->log.buffer));
+	if (durable_enabled())
+		durable_log_reset(&self->log);
 
 	/* Add this to the global list */
 	thread_list_add(&g_live_threads, self);
+	gc_trace_thread_init(self->tid);
 	smp_mb();
 }
 EXPORT_SYMBOL(mvrlu_thread_init);
 
 void mvrlu_thread_finish(mvrlu_thread_struct_t *self)
 {
+	int log_empty;
+
 	/* Reclaim data as much as it can */
 	if (self->log.need_reclaim)
 		log_reclaim(&self->log);
 
-	/* Deregister this thread from the live list */
+	/* Deregister this thread from the live list. Its statistics move
+	 * to g_stat or the zombie list before the live list is unlocked
+	 * so mvrlu_get_stats() counts them exactly once. */
 	self->qp_info.need_wait = 0;
-	thread_list_del(&g_live_threads, self);
+	thread_list_lock_force(&g_live_threads);
+	{
+		thread_list_del_unsafe(&g_live_threads, self);
+		reclaim_tasks_remove(&self->log);
 
-	/* If the log is empty, free log space and update statistics */
-	smp_mb();
-	if (self->log.head_cnt == self->log.tail_cnt) {
+		/* If the log is empty, update statistics */
+		smp_mb();
+		log_empty = self->log.head_cnt == self->log.tail_cnt;
+		if (log_empty)
+			stat_thread_merge(self);
+		/* Otherwise add it to the zombie list to reclaim the log later */
+		else {
+			smp_atomic_store(&self->live_status,
+					 THREAD_LIVE_ZOMBIE);
+			thread_list_add(&g_zombie_threads, self);
+		}
+	}
+	thread_list_unlock(&g_live_threads);
+
+	/* Free log space */
+	if (log_empty) {
 		port_free_log_mem((void *)self->log.buffer);
 		self->log.buffer = NULL;
-		stat_thread_merge(self);
-	}
-	/* Otherwise add it to the zombie list to reclaim the log later */
-	else {
-		smp_atomic_store(&self->live_status, THREAD_LIVE_ZOMBIE);
-		thread_list_add(&g_zombie_threads, self);
 	}
+	gc_trace_thread_finish();
 }
 EXPORT_SYMBOL(mvrlu_thread_finish);
 
@@ -1384,7 +2804,7 @@ void *mvrlu_alloc_x(size_t size, unsigned int flags)
 {
 	mvrlu_act_hdr_struct_t *ahs;
 
-	ahs = (void *)port_alloc_x(sizeof(*ahs) + size, flags);
+	ahs = obj_alloc(sizeof(*ahs) + size, flags);
 	if (unlikely(ahs == NULL))
 		return NULL;
 
@@ -1401,6 +2821,18 @@ void *mvrlu_alloc(size_t size)
 }
 EXPORT_SYMBOL(mvrlu_alloc);
 
+void *mvrlu_alloc_diff(size_t size)
+{
+	void *obj;
+
+	obj = mvrlu_alloc_x(size, PORT_DEFAULT_ALLOC_FLAG);
+	/* Recovery replays whole copies */
+	if (likely(obj != NULL) && !durable_enabled())
+		obj_to_obj_hdr(obj)->flags = OBJ_DIFF;
+	return obj;
+}
+EXPORT_SYMBOL(mvrlu_alloc_diff);
+
 void mvrlu_free(mvrlu_thread_struct_t *self, void *obj)
 {
 	void *p_act;
@@ -1409,91 +2841,259 @@ void mvrlu_free(mvrlu_thread_struct_t *self, void *obj)
 		return;
 
 	if (unlikely(self == NULL)) {
-		port_free(obj_to_ahs(obj));
+		obj_free(obj_to_ahs(obj));
 		return;
 	}
 	mvrlu_assert(self->run_cnt & 0x1);
+	mvrlu_warning(!self->is_ro);
 
 	p_act = get_act_obj(obj);
 	mvrlu_warning(obj_to_ahs(p_act)->act_hdr.p_lock != NULL);
 
+	/* A freed object needs a copy in the log to become TYPE_FREE */
+	if (unlikely(obj_to_ahs(p_act)->act_hdr.p_lock == const_lock_tag(self)))
+		cl_move_to_log(self, obj_to_ahs(p_act));
+
 	self->free_ptrs.ptrs[self->free_ptrs.num_ptrs++] = p_act;
 	mvrlu_assert(self->free_ptrs.num_ptrs < MVRLU_MAX_FREE_PTRS);
 }
 EXPORT_SYMBOL(mvrlu_free);
 
-void mvrlu_reader_lock(mvrlu_thread_struct_t *self)
+/*
+ * Resize a locked object. The new object holds the locked copy and
+ * replaces the old one, which is freed when the write set commits; the
+ * caller publishes it through a locked pointer. An object reallocated
+ * again in the same write set is replaced in place, and the new objects
+ * are freed if the write set aborts.
+ */
+void *mvrlu_realloc(mvrlu_thread_struct_t *self, void *obj, size_t size)
 {
-	/* Secure a large enough log space */
-	if (unlikely(self->log.need_reclaim))
-		log_reclaim(&self->log);
-	/* - capacity water mark */
-	if (unlikely(log_used(&self->log) >= MVRLU_LOG_HIGH_MARK)) {
-		do {
-			log_reclaim_force(&self->log);
-			stat_thread_inc(self, n_high_mark_block);
-		} while (log_used(&self->log) >= MVRLU_LOG_HIGH_MARK);
+	mvrlu_free_ptrs_t *new_ptrs = &self->new_ptrs;
+	void *new_obj;
+	size_t old_size;
+	unsigned int i;
+
+	mvrlu_assert(self->run_cnt & 0x1);
+	new_obj = mvrlu_alloc(size);
+	if (unlikely(new_obj == NULL))
+		return NULL;
+	obj_to_obj_hdr(new_obj)->flags =
+		obj_to_obj_hdr(get_act_obj(obj))->flags;
+	old_size = obj_to_obj_hdr(obj)->obj_size;
+	memcpy(new_obj, obj, size < old_size ? size : old_size);
+
+	/* Nobody has seen a new object of this write set yet */
+	for (i = 0; i < new_ptrs->num_ptrs; ++i) {
+		if (new_ptrs->ptrs[i] == obj) {
+			new_ptrs->ptrs[i] = new_obj;
+			obj_free(obj_to_ahs(obj));
+			return new_obj;
+		}
+	}
+
+	mvrlu_free(self, obj);
+	new_ptrs->ptrs[new_ptrs->num_ptrs++] = new_obj;
+	mvrlu_assert(new_ptrs->num_ptrs < MVRLU_MAX_FREE_PTRS);
+	return new_obj;
+}
+EXPORT_SYMBOL(mvrlu_realloc);
+
+/*
+ * The log cannot wait for reclamation in the middle of a section, since
+ * reclamation may wait for this very section. An overlay takes the log
+ * only while the worst case of a new write set, a bogus object at the
+ * end of the log and the overlay stays below the section's limit: the
+ * whole log in a read-only section, the high mark otherwise, so that the
+ * copies of a write section keep their headroom. The rest go to scratch
+ * memory that lives until the section ends.
+ */
+static inline int overlay_fits_log(mvrlu_thread_struct_t *self,
+				   unsigned int obj_size)
+{
+	unsigned long limit, worst;
+
+	limit = self->is_ro ? MVRLU_LOG_SIZE : MVRLU_LOG_HIGH_MARK;
+	worst = align_uint_to_cacheline(sizeof(mvrlu_wrt_set_struct_t)) +
+		2 * align_uint_to_cacheline(obj_size +
+					    sizeof(mvrlu_cpy_hdr_struct_t)) +
+		align_uint_to_cacheline(sizeof(mvrlu_wrt_set_struct_t) +
+					sizeof(mvrlu_cpy_hdr_struct_t));
+	return log_used(&self->log) + worst <= limit;
+}
+
+static void scratch_free(mvrlu_scratch_t **p_scratch)
+{
+	mvrlu_scratch_t *sc, *next;
+
+	for (sc = *p_scratch; sc; sc = next) {
+		next = sc->next;
+		port_free(sc);
 	}
+	*p_scratch = NULL;
+}
 
+/* Enter a critical section with a new snapshot or the one of a task */
+static inline void reader_enter(mvrlu_thread_struct_t *self,
+				mvrlu_task_struct_t *task)
+{
 	/* Object data writes should not be reordered with metadata writes. */
 	smp_wmb_tso();
 
 	/* Get it started */
 	smp_faa(&(self->run_cnt), 1);
+	self->is_ro = 0;
 	self->num_act_obj = 0;
 	self->num_deref = 0;
-	self->local_clk = get_clock_relaxed();
+	self->num_overlays = 0;
+	self->read_set.num_objs = 0;
+	self->abort_reason = MVRLU_ABORT_NONE;
+	self->local_clk = task ? task->local_clk : get_clock_relaxed();
 
 	/* Get the latest view */
 	smp_rmb();
 
-	stat_thread_inc(self, n_starts);
 	mvrlu_assert(self->log.cur_wrt_set == NULL);
 	mvrlu_assert(self->free_ptrs.num_ptrs == 0);
 }
+
+void mvrlu_reader_lock(mvrlu_thread_struct_t *self)
+{
+	/* Secure a large enough log space */
+	if (unlikely(self->log.need_reclaim))
+		log_reclaim(&self->log);
+	/* - capacity water mark */
+	if (unlikely(log_used(&self->log) >= MVRLU_LOG_HIGH_MARK)) {
+		gc_trace(GC_EV_HIGH_MARK_BLOCK, log_used(&self->log), 0);
+		do {
+			log_reclaim_force(&self->log);
+			stat_thread_inc(self, n_high_mark_block);
+		} while (log_used(&self->log) >= MVRLU_LOG_HIGH_MARK);
+		gc_trace(GC_EV_HIGH_MARK_UNBLOCK, log_used(&self->log), 0);
+	}
+
+	reader_enter(self, NULL);
+	stat_thread_inc(self, n_starts);
+}
 EXPORT_SYMBOL(mvrlu_reader_lock);
 
-void mvrlu_reader_unlock(mvrlu_thread_struct_t *self)
+int mvrlu_reader_unlock(mvrlu_thread_struct_t *self)
 {
+	int is_committed, is_valid = 1;
+
 	/* Object data writes should not be reordered with metadata writes. */
 	smp_wmb_tso();
 
 	mvrlu_assert(self->run_cnt & 0x1);
+
+	/* Commit before leaving the critical section. Otherwise a
+	 * quiescent period that does not wait for us could end before
+	 * a write set older than its clock is public, and that write set
+	 * would miss its write-back range. */
+	is_committed = self->is_write_detected;
+	if (is_committed) {
+		self->is_write_detected = 0;
+		/* Const locks alone leave nothing to commit */
+		if (likely(self->log.cur_wrt_set))
+			is_valid = log_commit(&self->log, &self->free_ptrs,
+					      &self->read_set, self->local_clk);
+		cl_unlock(&self->const_locks);
+		if (likely(is_valid))
+			fp_reset(&self->new_ptrs);
+		else
+			fp_free_new(&self->new_ptrs);
+		smp_wmb();
+	} else if (unlikely(self->log.cur_wrt_set))
+		log_retire(&self->log, self->local_clk);
 	self->run_cnt++;
+	if (unlikely(self->scratch))
+		scratch_free(&self->scratch);
 
 	/* If dereference takes too much overhead, reclaim log */
 	/* - dereference water mark */
 	if (self->num_deref && self->num_act_obj > MVRLU_DEREF_MIN_ACT_OBJ &&
 	    self->num_act_obj < (MVRLU_DEREF_MARK * self->num_deref)) {
-		wakeup_qp_thread_for_reclaim();
+		wakeup_qp_thread_for_reclaim(GC_WAKEUP_DEREF);
 	}
 
 	/* If write or log reclaim is needed, we need write memory
 	 * barrier to avoid reordering of metadata updates. */
-	if (self->is_write_detected || self->log.need_reclaim) {
-		if (self->is_write_detected) {
-			self->is_write_detected = 0;
-			log_commit(&self->log, &self->free_ptrs,
-				   self->local_clk);
-		}
-
+	if (is_committed || self->log.need_reclaim) {
 		if (unlikely(self->log.need_reclaim))
 			log_reclaim(&self->log);
 
 		if (unlikely(log_used(&self->log) >= MVRLU_LOG_LOW_MARK)) {
-			if (wakeup_qp_thread_for_reclaim()) {
+			if (wakeup_qp_thread_for_reclaim(GC_WAKEUP_LOW_MARK)) {
 				stat_thread_inc(self, n_low_mark_wakeup);
 			}
 		}
 		smp_wmb();
 	}
 
-	stat_thread_inc(self, n_finish);
+	/* Help reclaiming a log of another thread */
+	if (unlikely(reclaim_tasks_pending()) && reclaim_steal())
+		stat_thread_inc(self, n_reclaim_steal);
+
+	if (unlikely(!is_valid)) {
+		self->abort_reason = MVRLU_ABORT_READ_SET;
+		contention_record(MVRLU_ABORT_READ_SET,
+				  __builtin_return_address(0),
+				  self->read_set.conflict);
+		stat_thread_inc(self, n_aborts);
+		stat_thread_abort(self, MVRLU_ABORT_READ_SET);
+	} else
+		stat_thread_inc(self, n_finish);
 	mvrlu_assert(self->log.cur_wrt_set == NULL);
 	mvrlu_assert(self->free_ptrs.num_ptrs == 0);
+	return is_valid;
 }
 EXPORT_SYMBOL(mvrlu_reader_unlock);
 
+/*
+ * A read-only critical section touches little more than run_cnt and
+ * local_clk. Log reclamation waits for the next write section or the
+ * qp thread, which reclaims logs on behalf of their owners, and the
+ * deref water mark is skipped. A nearly full log is still taken care
+ * of since an overlay of a diff copy takes log space. Starts and
+ * finishes are counted on every path so that they stay balanced.
+ */
+void mvrlu_reader_lock_ro(mvrlu_thread_struct_t *self)
+{
+	if (unlikely(self->log.tail_cnt - self->log.head_cnt >=
+		     MVRLU_LOG_HIGH_MARK)) {
+		mvrlu_reader_lock(self);
+		self->is_ro = 1;
+		return;
+	}
+
+	smp_wmb_tso();
+	smp_faa(&(self->run_cnt), 1);
+	self->is_ro = 1;
+	self->abort_reason = MVRLU_ABORT_NONE;
+	self->num_act_obj = 0;
+	self->num_deref = 0;
+	self->num_overlays = 0;
+	self->local_clk = get_clock_relaxed();
+	smp_rmb();
+	stat_thread_inc(self, n_starts);
+}
+EXPORT_SYMBOL(mvrlu_reader_lock_ro);
+
+void mvrlu_reader_unlock_ro(mvrlu_thread_struct_t *self)
+{
+	mvrlu_assert(self->run_cnt & 0x1);
+	mvrlu_assert(self->is_ro && !self->is_write_detected);
+
+	/* Only overlays can be in the log */
+	if (unlikely(self->log.cur_wrt_set))
+		log_retire(&self->log, self->local_clk);
+	smp_wmb_tso();
+	self->run_cnt++;
+	if (unlikely(self->scratch))
+		scratch_free(&self->scratch);
+	stat_thread_inc(self, n_finish);
+}
+EXPORT_SYMBOL(mvrlu_reader_unlock_ro);
+
 void mvrlu_abort(mvrlu_thread_struct_t *self)
 {
 	/* Object data writes should not be reordered with metadata writes. */
@@ -1504,8 +3104,12 @@ void mvrlu_abort(mvrlu_thread_struct_t *self)
 
 	if (self->log.cur_wrt_set) {
 		log_abort(&self->log, &self->free_ptrs);
-		self->is_write_detected = 0;
+		fp_free_new(&self->new_ptrs);
 	}
+	cl_unlock(&self->const_locks);
+	self->is_write_detected = 0;
+	if (unlikely(self->scratch))
+		scratch_free(&self->scratch);
 
 	if (unlikely(self->log.need_reclaim))
 		log_reclaim(&self->log);
@@ -1514,17 +3118,285 @@ void mvrlu_abort(mvrlu_thread_struct_t *self)
 	smp_mb();
 
 	stat_thread_inc(self, n_aborts);
+	stat_thread_abort(self, self->abort_reason);
 	mvrlu_assert(self->log.cur_wrt_set == NULL);
 	mvrlu_assert(self->free_ptrs.num_ptrs == 0);
 }
 EXPORT_SYMBOL(mvrlu_abort);
 
+int mvrlu_abort_reason(mvrlu_thread_struct_t *self)
+{
+	return self->abort_reason;
+}
+EXPORT_SYMBOL(mvrlu_abort_reason);
+
+/* Tasks and their buffers live in the file in shm mode, so that the
+ * qp thread of any process can read them */
+static void *task_mem_alloc(size_t size)
+{
+	if (shm_enabled())
+		return durable_alloc_raw(size);
+	return port_alloc(size);
+}
+
+static void task_mem_free(void *p)
+{
+	if (shm_enabled())
+		durable_free(p);
+	else
+		port_free(p);
+}
+
+mvrlu_task_struct_t *mvrlu_task_alloc(void)
+{
+	return task_mem_alloc(sizeof(mvrlu_task_struct_t));
+}
+EXPORT_SYMBOL(mvrlu_task_alloc);
+
+void mvrlu_task_free(mvrlu_task_struct_t *task)
+{
+	task_mem_free(task);
+}
+EXPORT_SYMBOL(mvrlu_task_free);
+
+void mvrlu_task_init(mvrlu_task_struct_t *task)
+{
+	memset(task, 0, sizeof(*task));
+	task->pid = shm_self_id();
+
+	thread_list_lock_force(&g_live_tasks);
+	{
+		g_live_tasks.num++;
+		mvrlu_list_add(&task->list, &g_live_tasks.list);
+	}
+	thread_list_unlock(&g_live_tasks);
+}
+EXPORT_SYMBOL(mvrlu_task_init);
+
+void mvrlu_task_finish(mvrlu_task_struct_t *task)
+{
+	mvrlu_assert(!(task->run_cnt & 0x1));
+
+	thread_list_lock_force(&g_live_tasks);
+	{
+		g_live_tasks.num--;
+		mvrlu_list_del(&task->list);
+	}
+	thread_list_unlock(&g_live_tasks);
+
+	if (task->read_set) {
+		task_mem_free(task->read_set);
+		task->read_set = NULL;
+	}
+}
+EXPORT_SYMBOL(mvrlu_task_finish);
+
+int mvrlu_task_reader_lock(mvrlu_thread_struct_t *self,
+			   mvrlu_task_struct_t *task)
+{
+	mvrlu_assert(!(task->run_cnt & 0x1));
+
+	/* Blocking on a full log could wait for a suspended task that only
+	 * this thread would resume, so let the caller run others first. */
+	if (unlikely(self->log.need_reclaim))
+		log_reclaim(&self->log);
+	if (unlikely(log_used(&self->log) >= MVRLU_LOG_HIGH_MARK)) {
+		wakeup_qp_thread_for_reclaim(GC_WAKEUP_FORCE);
+		stat_thread_inc(self, n_high_mark_block);
+		return -EAGAIN;
+	}
+
+	/* The task holds the snapshot from now on. Its run_cnt is odd
+	 * before the clock is taken, like the one of a thread. */
+	smp_faa(&task->run_cnt, 1);
+	task->local_clk = get_clock_relaxed();
+	reader_enter(self, task);
+	stat_thread_inc(self, n_starts);
+	return 0;
+}
+EXPORT_SYMBOL(mvrlu_task_reader_lock);
+
+/* The read set of a task moves with it from thread to thread */
+static void rs_save(mvrlu_task_struct_t *task, mvrlu_read_set_t *read_set)
+{
+	unsigned int n = read_set->num_objs;
+
+	if (likely(!n)) {
+		if (task->read_set)
+			task->read_set->num_objs = 0;
+		return;
+	}
+	if (!task->read_set) {
+		task->read_set = task_mem_alloc(sizeof(*task->read_set));
+		mvrlu_panic(task->read_set);
+	}
+	memcpy(task->read_set->ptrs, read_set->ptrs, n * sizeof(void *));
+	task->read_set->num_objs = n;
+	read_set->num_objs = 0;
+}
+
+static void rs_restore(mvrlu_task_struct_t *task, mvrlu_read_set_t *read_set)
+{
+	unsigned int n;
+
+	if (likely(!task->read_set || !task->read_set->num_objs))
+		return;
+	n = task->read_set->num_objs;
+	memcpy(read_set->ptrs, task->read_set->ptrs, n * sizeof(void *));
+	read_set->num_objs = n;
+	task->read_set->num_objs = 0;
+}
+
+void mvrlu_task_suspend(mvrlu_thread_struct_t *self, mvrlu_task_struct_t *task)
+{
+	/* Locked objects live in the log of this thread; overlays stay
+	 * there or in the scratch memory of the task */
+	mvrlu_assert(task->run_cnt & 0x1);
+	mvrlu_assert(self->run_cnt & 0x1);
+	if (unlikely(self->log.cur_wrt_set) && !self->is_write_detected)
+		log_retire(&self->log, task->local_clk);
+	task->scratch = self->scratch;
+	self->scratch = NULL;
+	rs_save(task, &self->read_set);
+	mvrlu_assert(self->log.cur_wrt_set == NULL);
+	mvrlu_assert(self->free_ptrs.num_ptrs == 0);
+
+	/* The qp thread may expire the task from now on */
+	task->state = TASK_SUSPENDED;
+	smp_wmb_tso();
+	self->run_cnt++;
+
+	if (unlikely(self->log.need_reclaim))
+		log_reclaim(&self->log);
+}
+EXPORT_SYMBOL(mvrlu_task_suspend);
+
+int mvrlu_task_resume(mvrlu_thread_struct_t *self, mvrlu_task_struct_t *task)
+{
+	mvrlu_assert(task->run_cnt & 0x1);
+
+	/* The qp thread did not wait for an expired task */
+	if (unlikely(!smp_cas(&task->state, TASK_SUSPENDED, TASK_RUNNING))) {
+		mvrlu_assert(task->state == TASK_EXPIRED);
+		stat_thread_inc(self, n_task_expired);
+		goto drop;
+	}
+
+	/* Waiting for a full log could wait for this very task, so drop
+	 * its snapshot instead; the log then gets reclaimed. */
+	if (unlikely(self->log.need_reclaim))
+		log_reclaim(&self->log);
+	if (unlikely(log_used(&self->log) >= MVRLU_LOG_HIGH_MARK)) {
+		wakeup_qp_thread_for_reclaim(GC_WAKEUP_FORCE);
+		stat_thread_inc(self, n_high_mark_block);
+		goto drop;
+	}
+	reader_enter(self, task);
+	self->scratch = task->scratch;
+	task->scratch = NULL;
+	rs_restore(task, &self->read_set);
+	return 0;
+drop:
+	stat_thread_inc(self, n_aborts);
+	scratch_free(&task->scratch);
+	if (task->read_set)
+		task->read_set->num_objs = 0;
+	task->state = TASK_RUNNING;
+	smp_mb();
+	task->run_cnt++;
+	return -EAGAIN;
+}
+EXPORT_SYMBOL(mvrlu_task_resume);
+
+int mvrlu_task_reader_unlock(mvrlu_thread_struct_t *self,
+			     mvrlu_task_struct_t *task)
+{
+	int is_valid;
+
+	mvrlu_assert(task->run_cnt & 0x1);
+	is_valid = mvrlu_reader_unlock(self);
+	smp_wmb();
+	task->run_cnt++;
+	return is_valid;
+}
+EXPORT_SYMBOL(mvrlu_task_reader_unlock);
+
+void mvrlu_task_abort(mvrlu_thread_struct_t *self, mvrlu_task_struct_t *task)
+{
+	mvrlu_assert(task->run_cnt & 0x1);
+	mvrlu_abort(self);
+	task->run_cnt++;
+}
+EXPORT_SYMBOL(mvrlu_task_abort);
+
+/*
+ * A diff copy older than qp_clk2 has been written back, like the copies
+ * that mvrlu_deref() steps over, so the actual object is that version.
+ * A younger one is rebuilt on top of the actual object in the log of
+ * the reader: its chunks are the only ones in which the versions that
+ * can still be written back differ.
+ */
+static void *diff_overlay(mvrlu_thread_struct_t *self,
+			  mvrlu_cpy_hdr_struct_t *chs, unsigned long wrt_clk,
+			  unsigned long qp_clk2)
+{
+	volatile void *p_act = chs->cpy_hdr.p_act;
+	mvrlu_cpy_hdr_struct_t *ochs = NULL;
+	mvrlu_scratch_t *sc;
+	mvrlu_overlay_t *ov;
+	mvrlu_diff_t *diff;
+	int bogus_allocated;
+	unsigned int i;
+	void *obj;
+
+	if (lte_clock(wrt_clk, qp_clk2))
+		return (void *)p_act;
+
+	for (i = 0; i < self->num_overlays; ++i) {
+		if (self->overlays[i].p_copy == chs->obj_hdr.obj)
+			return self->overlays[i].obj;
+	}
+
+	diff = chs_to_diff(chs);
+	if (likely(overlay_fits_log(self, diff->size))) {
+		ochs = log_append_begin(&self->log, p_act, diff->size,
+					&bogus_allocated);
+		ochs->obj_hdr.type = TYPE_OVERLAY;
+		obj = ochs->obj_hdr.obj;
+	} else {
+		sc = port_alloc(sizeof(*sc) + diff->size);
+		mvrlu_panic(sc);
+		memset(&sc->chs, 0, sizeof(sc->chs));
+		sc->chs.cpy_hdr.__wrt_clk = wrt_clk; /* never MAX_VERSION */
+		sc->chs.cpy_hdr.p_act = p_act;
+		sc->chs.obj_hdr.obj_size = diff->size;
+		sc->chs.obj_hdr.type = TYPE_OVERLAY;
+		sc->next = self->scratch;
+		self->scratch = sc;
+		obj = sc->chs.obj_hdr.obj;
+		stat_thread_inc(self, n_diff_overlay_scratch);
+	}
+	copy_obj(obj, (void *)p_act, diff->size);
+	diff_apply(obj, diff->size, chs, diff);
+	if (ochs)
+		log_append_end(&self->log, ochs, bogus_allocated);
+
+	if (self->num_overlays < MVRLU_MAX_OVERLAYS) {
+		ov = &self->overlays[self->num_overlays++];
+		ov->p_copy = chs->obj_hdr.obj;
+		ov->obj = obj;
+	}
+	stat_thread_inc(self, n_diff_overlay);
+	return obj;
+}
+
 void *mvrlu_deref(mvrlu_thread_struct_t *self, void *obj)
 {
 	volatile void *p_act, *p_copy;
 	mvrlu_cpy_hdr_struct_t *chs;
 	unsigned long wrt_clk;
 	unsigned long qp_clk2;
+	unsigned int chain_len;
 
 	if (unlikely(!obj))
 		return NULL;
@@ -1537,33 +3409,73 @@ void *mvrlu_deref(mvrlu_thread_struct_t *self, void *obj)
 	if (unlikely(p_copy)) {
 		qp_clk2 = self->log.qp_clk2;
 		self->num_deref++;
+		chain_len = 0;
 		do {
+			chain_len++;
 			chs = vobj_to_chs(p_copy);
 			wrt_clk = get_wrt_clk(chs);
-			if (lte_clock(wrt_clk, self->local_clk))
+			if (lte_clock(wrt_clk, self->local_clk)) {
+				stat_thread_chain(self, chain_len);
+				if (unlikely(chs->obj_hdr.type == TYPE_DIFF))
+					return diff_overlay(self, chs, wrt_clk,
+							    qp_clk2);
 				return (void *)p_copy;
+			}
 
 			if (unlikely(lte_clock(chs->cpy_hdr.wrt_clk_next,
 					       qp_clk2)))
 				break;
 			p_copy = chs->obj_hdr.p_copy;
 		} while (p_copy);
+		stat_thread_chain(self, chain_len);
 	}
 	return (void *)p_act;
 }
 EXPORT_SYMBOL(mvrlu_deref);
 
-int _mvrlu_try_lock(mvrlu_thread_struct_t *self, void **pp_obj, size_t size)
+/* Start the trailer of a diff copy: [off, off + len) is dirty, and so
+ * is the copy it was made from unless that one is in the actual object
+ * already (see diff_overlay()) */
+static void diff_init(mvrlu_thread_struct_t *self, mvrlu_act_hdr_struct_t *ahs,
+		      mvrlu_cpy_hdr_struct_t *chs, volatile void *p_old_copy,
+		      unsigned long old_wrt_clk, size_t off, size_t len)
+{
+	mvrlu_diff_t *diff = chs_to_diff(chs), *old;
+	unsigned int size = chs->obj_hdr.obj_size;
+
+	diff->size = size;
+	diff->chunk = diff_chunk_size(size > ahs->obj_hdr.obj_size ?
+					      size :
+					      ahs->obj_hdr.obj_size);
+	diff->mask = 0;
+	if (p_old_copy && !lte_clock(old_wrt_clk, self->log.qp_clk2)) {
+		old = chs_to_diff(vobj_to_chs(p_old_copy));
+		diff->mask = old->chunk == diff->chunk ? old->mask : ~0ul;
+	}
+	diff->mask |= diff_mask(diff, off, len);
+}
+
+/* Returns MVRLU_ABORT_NONE on success or why it failed */
+static int try_lock_copy(mvrlu_thread_struct_t *self, void **pp_obj,
+			 size_t size, size_t off, size_t len)
 {
 	volatile void *p_act, *p_lock, *p_old_copy, *p_new_copy;
 	mvrlu_act_hdr_struct_t *ahs;
-	mvrlu_cpy_hdr_struct_t *chs;
+	mvrlu_cpy_hdr_struct_t *chs, *old_chs;
 	void *obj;
 	int bogus_allocated;
+	unsigned long old_wrt_clk = MIN_VERSION;
+	int is_diff, reason;
+	size_t log_obj_size;
 
 	obj = *pp_obj;
 	mvrlu_warning(obj != NULL);
 
+	/* A read-only section cannot lock; the caller aborts */
+	mvrlu_warning(!self->is_ro);
+	if (unlikely(self->is_ro))
+		return MVRLU_ABORT_RO;
+
 	p_act = get_act_obj(obj);
 	mvrlu_assert(p_act && vobj_to_obj_hdr(p_act)->type == TYPE_ACTUAL);
 
@@ -1573,20 +3485,23 @@ int _mvrlu_try_lock(mvrlu_thread_struct_t *self, void **pp_obj, size_t size)
 	p_lock = ahs->act_hdr.p_lock;
 	if (unlikely(p_lock)) {
 #ifdef MVRLU_NESTED_LOCKING
+		/* WARNING: We do not promote immutable try_lock_const()
+		 * to mutable try_lock(). */
+		if (is_const_lock(p_lock))
+			return p_lock == const_lock_tag(self) && !size ?
+				       MVRLU_ABORT_NONE :
+				       MVRLU_ABORT_LOCKED;
 		if (self == chs_to_thread(vobj_to_chs(p_lock))) {
 			/* If the lock is acquired by the same thread,
 			 * allow to lock again according to the original
-			 * RLU semantics.
-			 *
-			 * WARNING: We do not promote immutable try_lock_const()
-			 * to mutable try_lock_const().
-			 */
+			 * RLU semantics. */
 			mvrlu_warning(size <= ahs->obj_hdr.obj_size);
 			*pp_obj = (void *)p_lock;
-			return 1;
+			mvrlu_mark_dirty(self, (void *)p_lock, off, len);
+			return MVRLU_ABORT_NONE;
 		}
 #endif
-		return 0;
+		return MVRLU_ABORT_LOCKED;
 	}
 
 	/* To maintain a linear version history, we should allow
@@ -1599,27 +3514,46 @@ int _mvrlu_try_lock(mvrlu_thread_struct_t *self, void **pp_obj, size_t size)
 	p_old_copy = ahs->obj_hdr.p_copy;
 	if (p_old_copy) {
 		chs = vobj_to_chs(p_old_copy);
+		old_wrt_clk = get_wrt_clk(chs);
 		/* It guarantees that clock gap between two versions of
 		 * an object is greater than 2x ORDO_BOUNDARY. */
-		if (!lte_clock(get_wrt_clk(chs), self->local_clk))
-			return 0;
+		if (!lte_clock(old_wrt_clk, self->local_clk))
+			return MVRLU_ABORT_NEWER;
 	}
 
-	/* Secure log space and initialize a header */
-	chs = log_append_begin(&self->log, p_act, size, &bogus_allocated);
+	/* Secure log space and initialize a header. A diff copy has its
+	 * trailer in the padding. */
+	is_diff = size && is_diff_obj(ahs);
+	log_obj_size = size;
+	if (is_diff)
+		log_obj_size = align_uint_to_ulong(size) + sizeof(mvrlu_diff_t);
+	chs = log_append_begin(&self->log, p_act, log_obj_size,
+			       &bogus_allocated);
+	chs->obj_hdr.obj_size = size;
+	chs->obj_hdr.padding_size += log_obj_size - size;
 	p_new_copy = (volatile void *)chs->obj_hdr.obj;
 
 	/* Try lock */
-	if (!try_lock_obj(ahs, p_old_copy, p_new_copy)) {
+	reason = try_lock_obj(ahs, p_old_copy, p_new_copy);
+	if (reason != MVRLU_ABORT_NONE) {
 		log_append_abort(&self->log, chs);
-		return 0;
+		return reason;
 	}
 
 	/* Duplicate the copy */
 	if (!p_old_copy)
-		memcpy((void *)p_new_copy, (void *)p_act, size);
-	else
-		memcpy((void *)p_new_copy, (void *)p_old_copy, size);
+		copy_to_log((void *)p_new_copy, (void *)p_act, size);
+	else if (vobj_to_chs(p_old_copy)->obj_hdr.type == TYPE_DIFF) {
+		old_chs = vobj_to_chs(p_old_copy);
+		copy_obj((void *)p_new_copy, (void *)p_act, size);
+		diff_apply((void *)p_new_copy, size, old_chs,
+			   chs_to_diff(old_chs));
+	} else
+		copy_to_log((void *)p_new_copy, (void *)p_old_copy, size);
+	if (is_diff) {
+		diff_init(self, ahs, chs, p_old_copy, old_wrt_clk, off, len);
+		self->log.num_diffs++;
+	}
 	log_append_end(&self->log, chs, bogus_allocated);
 
 	/* Succeed in locking */
@@ -1628,20 +3562,162 @@ int _mvrlu_try_lock(mvrlu_thread_struct_t *self, void **pp_obj, size_t size)
 	*pp_obj = (void *)p_new_copy;
 
 	mvrlu_assert(ahs->act_hdr.p_lock);
-	return 1;
+	return MVRLU_ABORT_NONE;
+}
+
+/* Keep why a lock failed for mvrlu_abort() and the contention profile,
+ * and turn the reason into the 1/0 of the API */
+static inline int lock_result(mvrlu_thread_struct_t *self, void *obj,
+			      int reason, void *call_site)
+{
+	if (likely(reason == MVRLU_ABORT_NONE))
+		return 1;
+	self->abort_reason = reason;
+	contention_record(reason, call_site, get_act_obj(obj));
+	return 0;
+}
+
+int _mvrlu_try_lock(mvrlu_thread_struct_t *self, void **pp_obj, size_t size)
+{
+	void *obj = *pp_obj;
+
+	return lock_result(self, obj,
+			   try_lock_copy(self, pp_obj, size, 0, size),
+			   __builtin_return_address(0));
 }
 EXPORT_SYMBOL(_mvrlu_try_lock);
 
-int _mvrlu_try_lock_const(mvrlu_thread_struct_t *self, void *obj, size_t size)
+int _mvrlu_try_lock_full(mvrlu_thread_struct_t *self, void **pp_obj)
+{
+	void *p_act = get_act_obj(*pp_obj);
+	size_t size = obj_to_obj_hdr(p_act)->obj_size;
+
+	/* The actual object knows its size, including trailing data */
+	return lock_result(self, p_act,
+			   try_lock_copy(self, pp_obj, size, 0, size),
+			   __builtin_return_address(0));
+}
+EXPORT_SYMBOL(_mvrlu_try_lock_full);
+
+int _mvrlu_try_lock_range(mvrlu_thread_struct_t *self, void **pp_obj,
+			  size_t off, size_t len)
+{
+	void *p_act = get_act_obj(*pp_obj);
+	size_t size = obj_to_obj_hdr(p_act)->obj_size;
+
+	/* A version is read as a whole, so the copy covers the entire
+	 * object and only the range may change; a diff copy keeps only
+	 * that range and the chunks of older copies. */
+	mvrlu_warning(off <= size && len <= size - off);
+	return lock_result(self, p_act,
+			   try_lock_copy(self, pp_obj, size, off, len),
+			   __builtin_return_address(0));
+}
+EXPORT_SYMBOL(_mvrlu_try_lock_range);
+
+/* Returns MVRLU_ABORT_NONE on success or why it failed */
+static int try_lock_const(mvrlu_thread_struct_t *self, void *obj)
 {
-	/* Try_lock_const is nothing but a try lock with size zero
-	 * so we can omit copy from/to p_act.
+	mvrlu_const_locks_t *const_locks = &self->const_locks;
+	volatile void *p_act, *p_lock, *p_old_copy;
+	mvrlu_act_hdr_struct_t *ahs;
+	int reason;
+
+	/* Once the array is full, try_lock_const is a try lock with
+	 * size zero, which omits copy from/to p_act but takes a log entry.
 	 *
 	 * NOTE: obj is not updated after the call (not void ** but void *) */
-	return _mvrlu_try_lock(self, &obj, 0);
+	if (unlikely(const_locks->num_locks == MVRLU_MAX_CONST_LOCKS ||
+		     self->is_ro))
+		return try_lock_copy(self, &obj, 0, 0, 0);
+
+	mvrlu_warning(obj != NULL);
+	p_act = get_act_obj(obj);
+	mvrlu_assert(p_act && vobj_to_obj_hdr(p_act)->type == TYPE_ACTUAL);
+
+	ahs = vobj_to_ahs(p_act);
+	p_lock = ahs->act_hdr.p_lock;
+	if (unlikely(p_lock)) {
+#ifdef MVRLU_NESTED_LOCKING
+		if (p_lock == const_lock_tag(self) ||
+		    (!is_const_lock(p_lock) &&
+		     self == chs_to_thread(vobj_to_chs(p_lock))))
+			return MVRLU_ABORT_NONE;
+#endif
+		return MVRLU_ABORT_LOCKED;
+	}
+
+	/* The same linear version history as try_lock_copy() */
+	p_old_copy = ahs->obj_hdr.p_copy;
+	if (p_old_copy &&
+	    !lte_clock(get_wrt_clk(vobj_to_chs(p_old_copy)), self->local_clk))
+		return MVRLU_ABORT_NEWER;
+
+	/* Record the lock before taking it so that the locks of a dead
+	 * thread are all in the array */
+	const_locks->ptrs[const_locks->num_locks++] = (void *)p_act;
+	reason = try_lock_obj(ahs, p_old_copy, const_lock_tag(self));
+	if (reason != MVRLU_ABORT_NONE) {
+		const_locks->num_locks--;
+		return reason;
+	}
+
+	if (self->is_write_detected == 0)
+		self->is_write_detected = 1;
+	return MVRLU_ABORT_NONE;
+}
+
+int _mvrlu_try_lock_const(mvrlu_thread_struct_t *self, void *obj, size_t size)
+{
+	return lock_result(self, obj, try_lock_const(self, obj),
+			   __builtin_return_address(0));
 }
 EXPORT_SYMBOL(_mvrlu_try_lock_const);
 
+int mvrlu_track_read(mvrlu_thread_struct_t *self, void *obj)
+{
+	mvrlu_read_set_t *read_set = &self->read_set;
+	volatile void *p_act, *p_copy;
+	mvrlu_act_hdr_struct_t *ahs;
+
+	mvrlu_assert(self->run_cnt & 0x1);
+	/* A read-only section commits nothing */
+	if (unlikely(self->is_ro))
+		return 1;
+	if (unlikely(read_set->num_objs == MVRLU_MAX_READ_SET))
+		return lock_result(self, obj, try_lock_const(self, obj),
+				   __builtin_return_address(0));
+
+	/* Fail early if the validation would */
+	p_act = get_act_obj(obj);
+	ahs = vobj_to_ahs(p_act);
+	p_copy = ahs->obj_hdr.p_copy;
+	if (p_copy &&
+	    !lte_clock(get_wrt_clk(vobj_to_chs(p_copy)), self->local_clk))
+		return lock_result(self, obj, MVRLU_ABORT_NEWER,
+				   __builtin_return_address(0));
+
+	read_set->ptrs[read_set->num_objs++] = (void *)p_act;
+	return 1;
+}
+EXPORT_SYMBOL(mvrlu_track_read);
+
+void mvrlu_mark_dirty(mvrlu_thread_struct_t *self, void *obj, size_t off,
+		      size_t len)
+{
+	mvrlu_cpy_hdr_struct_t *chs;
+
+	mvrlu_assert(self->run_cnt & 0x1);
+	if (unlikely(is_obj_actual(obj_to_obj_hdr(obj))))
+		return;
+	chs = obj_to_chs(obj);
+	mvrlu_warning(vobj_to_ahs(chs->cpy_hdr.p_act)->act_hdr.p_lock == obj);
+	if (chs->obj_hdr.type == TYPE_COPY &&
+	    chs_has_diff(chs, vobj_to_ahs(chs->cpy_hdr.p_act)))
+		chs_to_diff(chs)->mask |= diff_mask(chs_to_diff(chs), off, len);
+}
+EXPORT_SYMBOL(mvrlu_mark_dirty);
+
 int mvrlu_cmp_ptrs(void *obj1, void *obj2)
 {
 	if (likely(obj1 != NULL))
@@ -1671,6 +3747,49 @@ void mvrlu_flush_log(mvrlu_thread_struct_t *self)
 }
 EXPORT_SYMBOL(mvrlu_flush_log);
 
+/*
+ * Wait until the log drops below the low water mark. A thread that runs
+ * sections of another context inside its own sections calls it for that
+ * context outside all of them: a section inside another one cannot wait
+ * at the high mark, since reclamation waits for the outer section.
+ */
+void mvrlu_reclaim_log(mvrlu_thread_struct_t *self)
+{
+	mvrlu_assert(!(self->run_cnt & 0x1));
+
+	if (unlikely(self->log.need_reclaim))
+		log_reclaim(&self->log);
+	while (unlikely(log_used(&self->log) >= MVRLU_LOG_LOW_MARK))
+		log_reclaim_force(&self->log);
+}
+EXPORT_SYMBOL(mvrlu_reclaim_log);
+
+int mvrlu_help_reclaim(mvrlu_thread_struct_t *self, unsigned long usecs)
+{
+	mvrlu_event_t *ev = &g_qp_thread.reclaim;
+	unsigned int seq;
+	int nr = 0;
+
+	while (reclaim_tasks_pending() && reclaim_steal())
+		nr++;
+
+	/* Dedicated helpers sleep until the next reclamation round. */
+	if (!nr && usecs) {
+		seq = event_prepare(ev);
+		if (!reclaim_tasks_pending())
+			event_wait(ev, seq, usecs);
+		event_finish(ev);
+
+		while (reclaim_tasks_pending() && reclaim_steal())
+			nr++;
+	}
+
+	if (self)
+		stat_thread_acc(self, n_reclaim_steal, nr);
+	return nr;
+}
+EXPORT_SYMBOL(mvrlu_help_reclaim);
+
 void mvrlu_print_stats(void)
 {
 	printf("=================================================\n");
@@ -1679,15 +3798,109 @@ void mvrlu_print_stats(void)
 	print_config();
 	printf("-------------------------------------------------\n");
 
-	/* It should be called after mvrlu_finish(). */
 #ifdef MVRLU_ENABLE_STATS
 	printf("MV-RLU statistics:\n");
 	printf("-------------------------------------------------\n");
-	stat_print_cnt(&g_stat);
+	/* Once mvrlu_finish() is done, every thread is merged to g_stat. */
+	if (g_qp_worker.stop_requested)
+		stat_print_cnt(&g_stat);
+	else {
+		mvrlu_stat_t stat;
+
+		mvrlu_get_stats(&stat, MVRLU_STAT_LIVE);
+		stat_print_cnt(&stat);
+	}
 	printf("-------------------------------------------------\n");
 #endif
 }
 
+static void stat_log_gauge(mvrlu_gauge_t *gauge, mvrlu_thread_struct_t *thread)
+{
+	unsigned long used;
+
+	if (!thread->log.buffer)
+		return;
+	used = thread->log.tail_cnt - thread->log.head_cnt;
+	gauge->log_used_bytes += used;
+	if (used > gauge->max_thread_log_used_bytes)
+		gauge->max_thread_log_used_bytes = used;
+}
+
+int mvrlu_get_stats(mvrlu_stat_t *out, int flags)
+{
+	mvrlu_qp_thread_t *qp_thread = &g_qp_thread;
+	mvrlu_gauge_t *gauge = &out->gauge;
+	mvrlu_thread_struct_t *thread;
+	mvrlu_list_t *pos, *n;
+
+	/* Counters of live threads are read while they keep running, so
+	 * a snapshot is not atomic across threads, but each thread is
+	 * counted exactly once: a thread moves between the lists and
+	 * g_stat only while holding the list locks held here. */
+	memset(out, 0, sizeof(*out));
+	thread_list_lock(&g_live_threads);
+	thread_list_lock(&g_zombie_threads);
+	{
+#ifdef MVRLU_ENABLE_STATS
+		stat_snapshot_merge(out, &g_stat);
+#endif
+		thread_list_for_each_safe (&g_live_threads, pos, n, thread) {
+#ifdef MVRLU_ENABLE_STATS
+			if (flags & MVRLU_STAT_LIVE)
+				stat_snapshot_merge(out, &thread->stat);
+#endif
+			gauge->nr_live_threads++;
+			stat_log_gauge(gauge, thread);
+		}
+		thread_list_for_each_safe (&g_zombie_threads, pos, n, thread) {
+#ifdef MVRLU_ENABLE_STATS
+			/* A reclaimed zombie is already merged to g_stat. */
+			if ((flags & MVRLU_STAT_LIVE) && thread->log.buffer)
+				stat_snapshot_merge(out, &thread->stat);
+#endif
+			gauge->nr_zombie_threads++;
+			stat_log_gauge(gauge, thread);
+		}
+#ifdef MVRLU_ENABLE_STATS
+		/* The qp thread merges its statistics when it stops; the
+		 * one of a segment never does. */
+		if ((flags & MVRLU_STAT_LIVE) &&
+		    (shm_enabled() || !g_qp_worker.stop_requested))
+			stat_snapshot_merge(out, &qp_thread->stat);
+#endif
+	}
+	thread_list_unlock(&g_zombie_threads);
+	thread_list_unlock(&g_live_threads);
+
+	gauge->qp_period_usec = qp_thread->qp_period_usec;
+	gauge->qp_wait_usec = qp_thread->qp_wait_usec;
+	gauge->qp_nap_usec = qp_thread->qp_nap_usec;
+	gauge->reclaim_bytes_per_sec = stat_reclaim_rate(out);
+	if (!(flags & MVRLU_STAT_GAUGE))
+		memset(gauge, 0, sizeof(*gauge));
+	return 0;
+}
+EXPORT_SYMBOL(mvrlu_get_stats);
+
+int mvrlu_get_thread_stats(mvrlu_thread_struct_t *self, mvrlu_stat_t *out)
+{
+	memset(out, 0, sizeof(*out));
+#ifdef MVRLU_ENABLE_STATS
+	stat_snapshot_merge(out, &self->stat);
+#endif
+	stat_log_gauge(&out->gauge, self);
+	return 0;
+}
+EXPORT_SYMBOL(mvrlu_get_thread_stats);
+
+const char *mvrlu_stat_name(int s)
+{
+	if (s < 0 || s >= stat_max__)
+		return NULL;
+	return stat_get_name(s);
+}
+EXPORT_SYMBOL(mvrlu_stat_name);
+
 static void print_config(void)
 {
 	printf(MVRLU_COLOR_GREEN
@@ -1705,6 +3918,8 @@ static void print_config(void)
 	printf(MVRLU_COLOR_GREEN
 	       "  MVRLU_LOG_HIGH_MARK = %ld\n" MVRLU_COLOR_RESET,
 	       MVRLU_LOG_HIGH_MARK);
+	printf(MVRLU_COLOR_GREEN "  copy kernel = %s\n" MVRLU_COLOR_RESET,
+	       copy_kernel_name());
 #ifdef MVRLU_ENABLE_ASSERT
 	printf(MVRLU_COLOR_RED "  MVRLU_ENABLE_ASSERT is on.          "
 			       "DO NOT USE FOR BENCHMARK!\n" MVRLU_COLOR_RESET);
@@ -1714,8 +3929,17 @@ static void print_config(void)
 			       "DO NOT USE FOR BENCHMARK!\n" MVRLU_COLOR_RESET);
 #endif
 #ifdef MVRLU_ENABLE_STATS
-	printf(MVRLU_COLOR_RED "  MVRLU_ENABLE_STATS is on.       "
-			       "DO NOT USE FOR BENCHMARK!\n" MVRLU_COLOR_RESET);
+	printf(MVRLU_COLOR_GREEN "  MVRLU_ENABLE_STATS = 1\n" MVRLU_COLOR_RESET);
+#endif
+#ifdef MVRLU_ENABLE_GC_TRACE
+	printf(MVRLU_COLOR_MAGENTA
+	       "  MVRLU_ENABLE_GC_TRACE is on.        "
+	       "IT MAY AFFECT BENCHMARK RESULTS!\n" MVRLU_COLOR_RESET);
+#endif
+#ifdef MVRLU_ENABLE_CONTENTION_PROFILE
+	printf(MVRLU_COLOR_MAGENTA
+	       "  MVRLU_ENABLE_CONTENTION_PROFILE is on. "
+	       "IT MAY AFFECT BENCHMARK RESULTS!\n" MVRLU_COLOR_RESET);
 #endif
 #ifdef MVRLU_TIME_MEASUREMENT
 	printf(MVRLU_COLOR_RED "  MVRLU_TIME_MEASUREMENT is on.       "
@@ -2,29 +2,20 @@
 // SPDX-License-Identifier: Apache-2.0
 #ifndef _MVRLU_I_H
 #define _MVRLU_I_H
+#ifndef __KERNEL__
+#include "mvrlu.h"
+#else
+#include <linux/mvrlu.h>
+#endif
 #include "arch.h"
 #include "config.h"
 #include "debug.h"
 
 #define MAX_VERSION (ULONG_MAX - 1)
+#define PENDING_VERSION (ULONG_MAX - 2) /* commit taking its clock */
 #define MIN_VERSION (0ul)
 
-#define STAT_NAMES                                                             \
-	S(n_starts)                                                            \
-	S(n_finish)                                                            \
-	S(n_aborts)                                                            \
-	S(n_low_mark_wakeup)                                                   \
-	S(n_high_mark_block)                                                   \
-	S(max_log_used_bytes)                                                  \
-	S(n_reclaim)                                                           \
-	S(n_reclaim_wrt_set)                                                   \
-	S(n_reclaim_copy)                                                      \
-	S(n_reclaim_free)                                                      \
-	S(n_qp_detect)                                                         \
-	S(n_qp_nap)                                                            \
-	S(n_qp_help_reclaim)                                                   \
-	S(n_qp_zombie_reclaim)                                                 \
-	S(max__)
+#define STAT_NAMES MVRLU_STAT_NAMES(S) S(max__)
 #define S(x) stat_##x,
 
 enum { STAT_NAMES };
@@ -34,6 +25,11 @@ enum { TYPE_ACTUAL = 0, /* actual object */
        TYPE_COPY, /* log: copied version */
        TYPE_FREE, /* log: copy whose actual object is requested to free */
        TYPE_BOGUS, /* log: bogus to skip the end of a log */
+       TYPE_DIFF, /* log: copied version, dirty chunks only */
+       TYPE_OVERLAY, /* log: diff copy rebuilt for a reader */
+};
+
+enum { OBJ_DIFF = 0x1, /* actual object: its copies track dirty chunks */
 };
 
 enum { THREAD_LIVE = 0, /* live thread */
@@ -41,13 +37,17 @@ enum { THREAD_LIVE = 0, /* live thread */
        THREAD_DEAD_ZOMBIE, /* zombie thread that is requested to be reclaimed */
 };
 
-typedef struct mvrlu_stat {
-	unsigned long cnt[stat_max__];
-} mvrlu_stat_t;
+enum { TASK_RUNNING = 0, /* idle or in a section on a thread */
+       TASK_SUSPENDED, /* in a section, between suspend and resume */
+       TASK_EXPIRED, /* suspended snapshot dropped by the qp thread */
+};
 
 typedef struct mvrlu_obj_hdr {
 	volatile unsigned int obj_size; /* object size for copy */
-	volatile unsigned short padding_size; /* passing size in log */
+	union {
+		volatile unsigned short padding_size; /* passing size in log */
+		volatile unsigned short flags; /* OBJ_* of an actual object */
+	};
 	volatile unsigned short type;
 	volatile void *p_copy;
 	unsigned char obj[0]; /* start address of a read object */
@@ -74,6 +74,23 @@ typedef struct mvrlu_cpy_hdr_struct {
 	mvrlu_obj_hdr_t obj_hdr;
 } __packed mvrlu_cpy_hdr_struct_t;
 
+/* An overlay that did not fit the log, freed when the section ends. It
+ * has the header of a TYPE_OVERLAY, so a writer can lock the object. */
+typedef struct mvrlu_scratch {
+	struct mvrlu_scratch *next;
+	mvrlu_cpy_hdr_struct_t chs;
+} mvrlu_scratch_t;
+
+/* Trailer of a copy of an OBJ_DIFF object, after its data. The object
+ * is split into at most 64 chunks of whole cache lines; mask has the
+ * chunks in which the copy may differ from the actual object. A
+ * TYPE_DIFF copy holds only those chunks, in order. */
+typedef struct mvrlu_diff {
+	unsigned long mask;
+	unsigned int size; /* size of the copied object */
+	unsigned int chunk; /* chunk size */
+} ____ptr_aligned mvrlu_diff_t;
+
 typedef struct mvrlu_thread_struct mvrlu_thread_struct_t;
 
 typedef struct mvrlu_wrt_set {
@@ -91,11 +108,13 @@ typedef struct mvrlu_wrt_set_struct {
 typedef struct mvrlu_log {
 	volatile unsigned long qp_clk1;
 	volatile unsigned long qp_clk2;
+	volatile unsigned long qp_clk3;
 	volatile unsigned int reclaim_lock;
 	volatile unsigned int need_reclaim;
 	volatile unsigned long head_cnt;
 	volatile unsigned long tail_cnt;
 	mvrlu_wrt_set_t *cur_wrt_set;
+	unsigned int num_diffs; /* diff copies in cur_wrt_set */
 
 	long __padding_0[MVRLU_DEFAULT_PADDING];
 	volatile unsigned char *buffer;
@@ -106,21 +125,44 @@ typedef struct mvrlu_free_ptrs {
 	void *ptrs[MVRLU_MAX_FREE_PTRS]; /* p_act */
 } mvrlu_free_ptrs_t;
 
+typedef struct mvrlu_const_locks {
+	unsigned int num_locks;
+	void *ptrs[MVRLU_MAX_CONST_LOCKS]; /* p_act */
+} mvrlu_const_locks_t;
+
+typedef struct mvrlu_read_set {
+	unsigned int num_objs;
+	void *conflict; /* p_act that failed the validation */
+	void *ptrs[MVRLU_MAX_READ_SET]; /* p_act */
+} mvrlu_read_set_t;
+
 typedef struct mvrlu_qp_info {
 	unsigned int need_wait;
 	unsigned int run_cnt;
+	unsigned long tail_cnt; /* log tail at the last qp_init() */
+	unsigned long fill_rate; /* log bytes per msec (EWMA) */
 } mvrlu_qp_info_t;
 
 typedef struct mvrlu_list {
 	struct mvrlu_list *next, *prev;
 } mvrlu_list_t;
 
+
+typedef struct mvrlu_overlay {
+	void *p_copy; /* TYPE_DIFF copy */
+	void *obj; /* its TYPE_OVERLAY in the log of the reader or scratch */
+} mvrlu_overlay_t;
+
 typedef struct mvrlu_thread_struct {
 	long __padding_0[MVRLU_DEFAULT_PADDING];
 
 	unsigned int tid;
 	int is_write_detected;
+	int abort_reason; /* MVRLU_ABORT_* of the last failure */
 	mvrlu_free_ptrs_t free_ptrs;
+	mvrlu_free_ptrs_t new_ptrs; /* from mvrlu_realloc() */
+	mvrlu_const_locks_t const_locks; /* from mvrlu_try_lock_const() */
+	mvrlu_read_set_t read_set; /* from mvrlu_track_read() */
 
 #ifdef MVRLU_ENABLE_STATS
 	mvrlu_stat_t stat;
@@ -129,8 +171,10 @@ typedef struct mvrlu_thread_struct {
 	long __padding_1[MVRLU_DEFAULT_PADDING];
 
 	volatile unsigned int run_cnt;
+	unsigned int is_ro; /* in mvrlu_reader_lock_ro() */
 	volatile unsigned long local_clk;
 	volatile int live_status;
+	int pid; /* owner process in shm mode */
 
 	long __padding_2[MVRLU_DEFAULT_PADDING];
 
@@ -141,18 +185,36 @@ typedef struct mvrlu_thread_struct {
 
 	int num_act_obj;
 	int num_deref;
+	unsigned int num_overlays;
+	mvrlu_overlay_t overlays[MVRLU_MAX_OVERLAYS]; /* in this section */
+	mvrlu_scratch_t *scratch; /* overlays of this section off the log */
 
 	long __padding_4[MVRLU_DEFAULT_PADDING];
 
 	mvrlu_list_t list;
 } mvrlu_thread_struct_t;
 
+/* A logical task, such as a coroutine, that keeps its snapshot across
+ * suspension points. It has no log; it borrows the one of the thread
+ * that runs it between mvrlu_task_resume() and mvrlu_task_suspend(). */
+typedef struct mvrlu_task_struct {
+	volatile unsigned int run_cnt;
+	volatile unsigned int state; /* TASK_* */
+	volatile unsigned long local_clk;
+	int pid; /* owner process in shm mode */
+	mvrlu_qp_info_t qp_info;
+	mvrlu_scratch_t *scratch; /* overlays off the log while suspended */
+	mvrlu_read_set_t *read_set; /* tracked reads while suspended */
+	mvrlu_list_t list;
+} mvrlu_task_struct_t;
+
 typedef struct mvrlu_thread_list {
 #ifdef __KERNEL__
 	spinlock_t lock;
 #else
 	pthread_spinlock_t lock;
 #endif
+	volatile int shm_lock; /* lock in shm mode, see shm.h */
 
 	long __padding_0[MVRLU_DEFAULT_PADDING];
 
@@ -162,27 +224,69 @@ typedef struct mvrlu_thread_list {
 	mvrlu_list_t list;
 } mvrlu_thread_list_t;
 
+/* Logs handed over for reclamation by the last qp_trigger_reclaim().
+ * Any thread may take a log with next and reclaim it; reclaim_lock
+ * keeps a log from being reclaimed twice at the same time. */
+typedef struct mvrlu_reclaim_tasks {
+	volatile unsigned int nr;
+	volatile unsigned int next;
+	volatile unsigned int nr_stealers; /* per process in shm mode */
+
+	long __padding_0[MVRLU_DEFAULT_PADDING];
+
+	mvrlu_log_t *volatile logs[MVRLU_MAX_THREAD_NUM];
+} mvrlu_reclaim_tasks_t;
+
+typedef struct mvrlu_event {
+	volatile unsigned int seq;
+	volatile unsigned int nr_waiters;
+} mvrlu_event_t;
+
 typedef struct mvrlu_qp_thread {
 	unsigned long qp_clk;
 
+	mvrlu_event_t wakeup; /* the qp thread naps on it */
+	mvrlu_event_t reclaim; /* writers blocked at the high mark wait on it */
+
+	volatile int need_reclaim;
+
+	volatile unsigned long qp_period_usec; /* last quiescent period */
+	volatile unsigned long qp_wait_usec; /* waiting time in that period */
+	volatile unsigned long qp_nap_usec; /* next nap, 0 under pressure */
+	unsigned long qp_init_usec; /* time of the last qp_init() */
+
+#ifdef MVRLU_ENABLE_STATS
+	mvrlu_stat_t stat;
+#endif
+} mvrlu_qp_thread_t;
+
+/* The qp thread of this process. In shm mode, every process runs one
+ * but only the owner of the segment detects quiescent periods. */
+typedef struct mvrlu_qp_worker {
 #ifdef __KERNEL__
 	struct task_struct *thread;
 	struct completion completion;
-	struct mutex cond_mutex;
-	struct completion cond;
 #else
 	pthread_t thread;
 	intptr_t completion;
-	pthread_mutex_t cond_mutex;
-	pthread_cond_t cond;
 #endif
-
 	volatile int stop_requested;
-	volatile int need_reclaim;
-
+} mvrlu_qp_worker_t;
+
+/* State shared by all threads; it lives in the segment in shm mode */
+typedef struct mvrlu_global {
+	mvrlu_thread_list_t live_threads ____cacheline_aligned2;
+	mvrlu_thread_list_t zombie_threads ____cacheline_aligned2;
+	mvrlu_thread_list_t live_tasks ____cacheline_aligned2;
+	mvrlu_qp_thread_t qp_thread ____cacheline_aligned2;
+	mvrlu_reclaim_tasks_t reclaim_tasks ____cacheline_aligned2;
+#ifndef MVRLU_ORDO_TIMESTAMPING
+	volatile unsigned long wrt_clk ____cacheline_aligned2;
+#endif
 #ifdef MVRLU_ENABLE_STATS
-	mvrlu_stat_t stat;
+	mvrlu_stat_t stat ____cacheline_aligned2;
 #endif
-} mvrlu_qp_thread_t;
+	long __padding_0[MVRLU_DEFAULT_PADDING];
+} mvrlu_global_t;
 
 #endif /* _MVRLU_I_H */
@@ -6,6 +6,7 @@
 #include <linux/mutex.h>
 #include <linux/sched.h>
 #include <linux/wait.h>
+#include <linux/wait_bit.h>
 #include <linux/sched.h>
 #include <linux/errno.h>
 #include <linux/timekeeping.h>
@@ -77,6 +78,11 @@ static inline void port_cpu_relax_and_yield(void)
 	cpu_relax();
 }
 
+static inline void port_yield(void)
+{
+	yield();
+}
+
 static inline void port_spin_init(spinlock_t *lock)
 {
 	spin_lock_init(lock);
@@ -126,14 +132,18 @@ static inline int port_mutex_unlock(struct mutex *mutex)
 	return 0;
 }
 
-static inline void port_cond_init(struct completion *cond)
+/*
+ * Time
+ */
+
+static inline unsigned long port_get_usecs(void)
 {
-	init_completion(cond);
+	return ktime_to_us(ktime_get());
 }
 
-static inline void port_cond_destroy(struct completion *cond)
+static inline unsigned long port_get_nsecs(void)
 {
-	/* do nothing */
+	return ktime_get_ns();
 }
 
 /*
@@ -166,19 +176,21 @@ static void port_wait_for_finish(void *x, struct completion *completion)
 	wait_for_completion(completion);
 }
 
-static inline void port_initiate_wakeup(struct mutex *mutex,
-					struct completion *cond)
+/*
+ * Sleep while *addr == val, for at most usecs
+ */
+static inline void port_wait_on(volatile unsigned int *addr, unsigned int val,
+				unsigned long usecs, int shared)
 {
-	complete(cond);
-	set_current_state(TASK_RUNNING);
+	wait_var_event_timeout((void *)addr, READ_ONCE(*addr) != val,
+			       usecs_to_jiffies(usecs));
 }
 
-static inline void port_initiate_nap(struct mutex *mutex,
-				     struct completion *cond,
-				     unsigned long usecs)
+/*
+ * Wake up all threads sleeping on addr
+ */
+static inline void port_wake_up(volatile unsigned int *addr, int shared)
 {
-	reinit_completion(cond);
-	wait_for_completion_interruptible_timeout(cond,
-						  usecs_to_jiffies(usecs));
+	wake_up_var((void *)addr);
 }
 #endif /* _PORT_KERNEL_H */
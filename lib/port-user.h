@@ -3,7 +3,10 @@
 #ifndef _PORT_USER_H
 #define _PORT_USER_H
 
+#include <sched.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #define __init
 #define EXPORT_SYMBOL(sym)
@@ -29,7 +32,9 @@ typedef struct log_region_allocator {
 	 */
 	unsigned long size;
 	int num;
-	volatile unsigned long bitmap[BITMAP_SIZE]; /* 2**16 */
+	int attached; /* the region is not ours to unmap */
+	volatile unsigned long *bitmap;
+	volatile unsigned long __bitmap[BITMAP_SIZE]; /* 2**16 */
 } log_region_allocator_t;
 
 static log_region_allocator_t g_lr;
@@ -44,6 +49,7 @@ static inline int port_log_region_init(unsigned long size, unsigned long num)
 	region_size = size * num;
 	g_lr.size = size;
 	g_lr.num = num;
+	g_lr.bitmap = g_lr.__bitmap;
 	g_start_addr = mmap(NULL, region_size, PROT_READ | PROT_WRITE,
 			    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 	if (unlikely(g_start_addr == MAP_FAILED))
@@ -52,12 +58,31 @@ static inline int port_log_region_init(unsigned long size, unsigned long num)
 	return 0;
 }
 
+/*
+ * Carve logs out of memory mapped by the caller (durable mode). The
+ * bitmap lives there too, so processes sharing the memory share logs.
+ */
+static inline int port_log_region_attach(void *start, unsigned long size,
+					 unsigned long num,
+					 volatile unsigned long *bitmap)
+{
+	memset(&g_lr, 0, sizeof(g_lr));
+	g_lr.size = size;
+	g_lr.num = num;
+	g_lr.attached = 1;
+	g_lr.bitmap = bitmap;
+	g_start_addr = start;
+	g_end_addr = g_start_addr + size * num;
+	return 0;
+}
+
 static inline void port_log_region_destroy(void)
 {
 	if (unlikely(g_start_addr == NULL))
 		return;
 
-	munmap(g_start_addr, g_lr.size * g_lr.num);
+	if (!g_lr.attached)
+		munmap(g_start_addr, g_lr.size * g_lr.num);
 	g_start_addr = g_end_addr = NULL;
 }
 
@@ -143,6 +168,11 @@ static inline void port_free(void *ptr)
 
 #define port_cpu_relax_and_yield cpu_relax
 
+static inline void port_yield(void)
+{
+	sched_yield();
+}
+
 static inline void port_spin_init(pthread_spinlock_t *lock)
 {
 	pthread_spin_init(lock, PTHREAD_PROCESS_PRIVATE);
@@ -188,14 +218,24 @@ static inline int port_mutex_unlock(pthread_mutex_t *mutex)
 	return pthread_mutex_unlock(mutex);
 }
 
-static inline void port_cond_init(pthread_cond_t *cond)
+/*
+ * Time
+ */
+
+static inline unsigned long port_get_usecs(void)
 {
-	pthread_cond_init(cond, NULL);
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ul + ts.tv_nsec / 1000;
 }
 
-static inline void port_cond_destroy(pthread_cond_t *cond)
+static inline unsigned long port_get_nsecs(void)
 {
-	pthread_cond_destroy(cond);
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ul + ts.tv_nsec;
 }
 
 /*
@@ -218,32 +258,27 @@ static void port_wait_for_finish(pthread_t *t, void *x)
 	pthread_join(*t, NULL);
 }
 
-static inline void port_initiate_wakeup(pthread_mutex_t *mutex,
-					pthread_cond_t *cond)
-{
-	port_mutex_lock(mutex);
-	{
-		pthread_cond_broadcast(cond);
-	}
-	port_mutex_unlock(mutex);
-}
-
-static inline void port_initiate_nap(pthread_mutex_t *mutex,
-				     pthread_cond_t *cond, unsigned long usecs)
+/*
+ * Sleep while *addr == val, for at most usecs. Set shared if addr is in
+ * memory shared with other processes.
+ */
+static inline void port_wait_on(volatile unsigned int *addr, unsigned int val,
+				unsigned long usecs, int shared)
 {
 	struct timespec ts;
-	unsigned long nsecs;
 
-	clock_gettime(CLOCK_REALTIME, &ts);
-	nsecs = usecs * 1000;
-	if (ts.tv_nsec + nsecs > 1000000000)
-		ts.tv_sec += 1;
-	ts.tv_nsec += nsecs % 1000000000;
+	ts.tv_sec = usecs / 1000000;
+	ts.tv_nsec = (usecs % 1000000) * 1000;
+	syscall(SYS_futex, addr, shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE, val,
+		&ts, NULL, 0);
+}
 
-	port_mutex_lock(mutex);
-	{
-		pthread_cond_timedwait(cond, mutex, &ts);
-	}
-	port_mutex_unlock(mutex);
+/*
+ * Wake up all threads sleeping on addr
+ */
+static inline void port_wake_up(volatile unsigned int *addr, int shared)
+{
+	syscall(SYS_futex, addr, shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE,
+		INT_MAX, NULL, NULL, 0);
 }
 #endif /* _PORT_USER_H */
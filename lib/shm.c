@@ -0,0 +1,203 @@
+// SPDX-FileCopyrightText: Copyright (c) 2018-2019 Virginia Tech
+// SPDX-License-Identifier: Apache-2.0
+#ifndef __KERNEL__
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include "mvrlu.h"
+#else
+#include <linux/mvrlu.h>
+#endif /* __KERNEL__ */
+
+#include "shm.h"
+
+#ifndef __KERNEL__
+#ifndef F_OFD_GETLK
+#define F_OFD_GETLK 36
+#define F_OFD_SETLK 37
+#endif
+
+#define SHM_SPIN_CHECK (1u << 16) /* spins between looks at a lock holder */
+
+shm_seg_t *g_shm __read_mostly;
+int g_shm_pid __read_mostly = 1;
+static int g_shm_fd = -1;
+static unsigned int g_shm_slot;
+
+/*
+ * OFD locks belong to the open file, not to a thread, and the kernel
+ * drops them when the last descriptor of the process goes away.
+ */
+static int shm_lock_byte(off_t off, short type)
+{
+	struct flock fl;
+
+	memset(&fl, 0, sizeof(fl));
+	fl.l_type = type;
+	fl.l_whence = SEEK_SET;
+	fl.l_start = off;
+	fl.l_len = 1;
+	return fcntl(g_shm_fd, F_OFD_SETLK, &fl);
+}
+
+static int shm_byte_locked(off_t off)
+{
+	struct flock fl;
+
+	memset(&fl, 0, sizeof(fl));
+	fl.l_type = F_WRLCK;
+	fl.l_whence = SEEK_SET;
+	fl.l_start = off;
+	fl.l_len = 1;
+	if (fcntl(g_shm_fd, F_OFD_GETLK, &fl))
+		return 1; /* assume the best */
+	return fl.l_type != F_UNLCK;
+}
+
+/* Called by the first process, before anybody else attaches */
+void shm_format(shm_seg_t *shm)
+{
+	memset(shm->procs, 0, sizeof(shm->procs));
+}
+
+int shm_attach(shm_seg_t *shm, int fd)
+{
+	unsigned int slot;
+	int pid = getpid();
+
+	g_shm_fd = fd;
+	for (slot = 0; slot < MVRLU_SHM_MAX_PROCS; ++slot) {
+		if (shm->procs[slot].pid)
+			continue;
+		/* The lock first, so a slot with a pid and no lock is dead */
+		if (shm_lock_byte(SHM_PROC_LOCK_OFF(slot), F_WRLCK))
+			continue;
+		if (!smp_cas(&shm->procs[slot].pid, 0, pid)) {
+			shm_lock_byte(SHM_PROC_LOCK_OFF(slot), F_UNLCK);
+			continue;
+		}
+		shm->procs[slot].nr_stealers = 0;
+		g_shm_slot = slot;
+		g_shm_pid = pid;
+		g_shm = shm;
+		return 0;
+	}
+	g_shm_fd = -1;
+	return -EBUSY;
+}
+
+void shm_detach(void)
+{
+	shm_proc_t *proc = &g_shm->procs[g_shm_slot];
+
+	smp_atomic_store(&proc->pid, 0);
+	shm_lock_byte(SHM_PROC_LOCK_OFF(g_shm_slot), F_UNLCK);
+	g_shm = NULL;
+	g_shm_pid = 1;
+	g_shm_fd = -1;
+}
+
+/*
+ * The qp owner
+ */
+
+int shm_qp_own(void)
+{
+	return shm_lock_byte(SHM_QP_LOCK_OFF, F_WRLCK) == 0;
+}
+
+void shm_qp_disown(void)
+{
+	shm_lock_byte(SHM_QP_LOCK_OFF, F_UNLCK);
+}
+
+/*
+ * Dead processes
+ */
+
+static int shm_proc_dead(unsigned int slot, int pid)
+{
+	return pid && pid != g_shm_pid &&
+	       !shm_byte_locked(SHM_PROC_LOCK_OFF(slot));
+}
+
+int shm_pid_dead(int pid)
+{
+	unsigned int slot;
+
+	for (slot = 0; slot < MVRLU_SHM_MAX_PROCS; ++slot) {
+		if (g_shm->procs[slot].pid == pid)
+			return shm_proc_dead(slot, pid);
+	}
+	/* Reaped already */
+	return 1;
+}
+
+/* Return the pid of a dead process from *slot on, or 0 */
+int shm_find_dead(unsigned int *slot)
+{
+	int pid;
+
+	for (; *slot < MVRLU_SHM_MAX_PROCS; ++*slot) {
+		pid = g_shm->procs[*slot].pid;
+		if (shm_proc_dead(*slot, pid))
+			return pid;
+	}
+	return 0;
+}
+
+/* Called by the qp owner once nothing refers to the process any more */
+void shm_reaped(unsigned int slot, int pid)
+{
+	shm_proc_t *proc = &g_shm->procs[slot];
+
+	proc->nr_stealers = 0;
+	smp_cas(&proc->pid, pid, 0);
+}
+
+volatile unsigned int *shm_stealers(void)
+{
+	return &g_shm->procs[g_shm_slot].nr_stealers;
+}
+
+unsigned int shm_nr_stealers(void)
+{
+	unsigned int slot, nr = 0;
+
+	for (slot = 0; slot < MVRLU_SHM_MAX_PROCS; ++slot)
+		nr += g_shm->procs[slot].nr_stealers;
+	return nr;
+}
+
+void shm_drop_dead_stealers(void)
+{
+	unsigned int slot;
+	shm_proc_t *proc;
+
+	for (slot = 0; slot < MVRLU_SHM_MAX_PROCS; ++slot) {
+		proc = &g_shm->procs[slot];
+		if (proc->nr_stealers && shm_proc_dead(slot, proc->pid))
+			proc->nr_stealers = 0;
+	}
+}
+
+void shm_spin_lock_slow(volatile int *lock)
+{
+	unsigned int spins = 0;
+	int holder;
+
+	while (!shm_spin_trylock(lock)) {
+		cpu_relax();
+		if (++spins % SHM_SPIN_CHECK || !shm_enabled())
+			continue;
+		holder = *lock;
+		if (holder && shm_pid_dead(holder) &&
+		    smp_cas(lock, holder, g_shm_pid)) {
+			mvrlu_trace_global("Took over a lock of process %d\n",
+					   holder);
+			return;
+		}
+	}
+}
+#endif /* __KERNEL__ */
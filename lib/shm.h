@@ -0,0 +1,147 @@
+// SPDX-FileCopyrightText: Copyright (c) 2018-2019 Virginia Tech
+// SPDX-License-Identifier: Apache-2.0
+#ifndef _SHM_H
+#define _SHM_H
+
+#include "config.h"
+#include "port.h"
+#include "mvrlu_i.h"
+
+/*
+ * Shared-memory MV-RLU (user space only)
+ *
+ * mvrlu_shm_init() opens a durable file (see durable.h) that several
+ * processes map at the same address, so objects, logs and the pointers
+ * between them are valid in all of them. The state mvrlu.c keeps in
+ * globals moves to the segment next to a table of attached processes.
+ * Every process runs a qp thread but only the one holding the owner
+ * lock detects quiescent periods.
+ *
+ * A process may die at any point. It holds an OFD lock on the file
+ * byte of its slot, which the kernel drops when it dies, and the locks
+ * it takes on shared state record its pid. The qp owner finishes or
+ * aborts the write sets of a dead process, releases its locks and reaps
+ * its threads like zombies. Another process takes the owner lock over
+ * when the owner dies.
+ */
+
+typedef struct shm_proc {
+	volatile int pid; /* 0 if the slot is free */
+	volatile unsigned int nr_stealers; /* see mvrlu_reclaim_tasks_t */
+	long __padding_0[MVRLU_DEFAULT_PADDING - 1];
+} shm_proc_t;
+
+typedef struct shm_seg {
+	shm_proc_t procs[MVRLU_SHM_MAX_PROCS];
+	mvrlu_global_t global;
+} shm_seg_t;
+
+/* File bytes locked by the attached processes and by the qp owner */
+#define SHM_PROC_LOCK_OFF(slot) (slot)
+#define SHM_QP_LOCK_OFF MVRLU_SHM_MAX_PROCS
+
+#ifndef __KERNEL__
+extern shm_seg_t *g_shm;
+extern int g_shm_pid;
+
+void shm_format(shm_seg_t *shm);
+int shm_attach(shm_seg_t *shm, int fd);
+void shm_detach(void);
+
+int shm_qp_own(void);
+void shm_qp_disown(void);
+
+int shm_pid_dead(int pid);
+int shm_find_dead(unsigned int *slot);
+void shm_reaped(unsigned int slot, int pid);
+
+volatile unsigned int *shm_stealers(void);
+unsigned int shm_nr_stealers(void);
+void shm_drop_dead_stealers(void);
+
+void shm_spin_lock_slow(volatile int *lock);
+
+static inline int shm_enabled(void)
+{
+	return unlikely(g_shm != NULL);
+}
+
+/* The value a lock word takes while this process holds it */
+static inline int shm_self_id(void)
+{
+	return g_shm_pid;
+}
+
+/*
+ * Spinlock whose word is the pid of its holder. A waiter takes it over
+ * once the holder is dead.
+ */
+static inline void shm_spin_init(volatile int *lock)
+{
+	*lock = 0;
+}
+
+static inline int shm_spin_trylock(volatile int *lock)
+{
+	return *lock == 0 && smp_cas(lock, 0, g_shm_pid);
+}
+
+static inline void shm_spin_lock(volatile int *lock)
+{
+	if (unlikely(!shm_spin_trylock(lock)))
+		shm_spin_lock_slow(lock);
+}
+
+static inline void shm_spin_unlock(volatile int *lock)
+{
+	smp_atomic_store(lock, 0);
+}
+#else /* __KERNEL__ */
+static inline int shm_enabled(void)
+{
+	return 0;
+}
+
+static inline int shm_self_id(void)
+{
+	return 1;
+}
+
+static inline int shm_pid_dead(int pid)
+{
+	return 0;
+}
+
+static inline unsigned int shm_nr_stealers(void)
+{
+	return 0;
+}
+
+static inline volatile unsigned int *shm_stealers(void)
+{
+	return NULL;
+}
+
+static inline void shm_drop_dead_stealers(void)
+{
+}
+
+static inline void shm_spin_init(volatile int *lock)
+{
+}
+
+static inline int shm_spin_trylock(volatile int *lock)
+{
+	return 1;
+}
+
+static inline void shm_spin_lock(volatile int *lock)
+{
+}
+
+static inline void shm_spin_unlock(volatile int *lock)
+{
+}
+#endif /* __KERNEL__ */
+
+#endif /* _SHM_H */
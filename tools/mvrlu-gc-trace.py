@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+
+# SPDX-FileCopyrightText: Copyright (c) 2018-2019 Virginia Tech
+# SPDX-License-Identifier: Apache-2.0
+
+# Convert an MV-RLU GC trace (MVRLU_GC_TRACE=<file>, see lib/gc_trace.h)
+# to the Chrome trace event format (chrome://tracing, ui.perfetto.dev).
+
+import argparse
+import json
+import struct
+import sys
+
+HDR = struct.Struct("<8sIIQ")
+EV = struct.Struct("<QIIQQ")
+
+NO_TID = 0xffffffff
+QP_TID = 0xfffffffe
+
+(QP_BEGIN, QP_END, NAP_BEGIN, NAP_END, RECLAIM_BEGIN, RECLAIM_END,
+ HIGH_MARK_BLOCK, HIGH_MARK_UNBLOCK, WAKEUP) = range(9)
+
+WAKEUP_REASONS = ["low_mark", "deref", "force"]
+
+def read_events(path):
+    with open(path, "rb") as f:
+        magic, version, ev_size, nr_evs = HDR.unpack(f.read(HDR.size))
+        if magic.rstrip(b"\0") != b"MVRLUGC" or version != 1:
+            sys.exit("%s: not an MV-RLU GC trace" % path)
+        if ev_size != EV.size:
+            sys.exit("%s: unexpected event size %d" % (path, ev_size))
+        data = f.read(nr_evs * ev_size)
+    return [EV.unpack_from(data, i * ev_size)
+            for i in range(len(data) // ev_size)]
+
+def tid_name(tid):
+    if tid == QP_TID:
+        return "qp thread"
+    if tid == NO_TID:
+        return None
+    return "thread %d" % tid
+
+def convert(evs):
+    out = []
+    if not evs:
+        return out
+    evs.sort(key=lambda e: e[0])
+    t0 = evs[0][0]
+    for tid in sorted(set(e[2] for e in evs)):
+        out.append({"ph": "M", "name": "thread_name", "pid": 0,
+                    "tid": tid, "args": {"name": tid_name(tid)}})
+
+    for ts, ty, tid, arg0, arg1 in evs:
+        e = {"pid": 0, "tid": tid, "ts": (ts - t0) / 1000.0}
+        if ty == QP_BEGIN:
+            e.update(ph="B", name="qp", args={"qp_clk": arg0})
+        elif ty == QP_END:
+            e.update(ph="E", name="qp",
+                     args={"straggler": tid_name(arg0),
+                           "straggler_wait_us": arg1 / 1000.0})
+        elif ty == NAP_BEGIN:
+            e.update(ph="B", name="nap", args={"nap_us": arg0})
+        elif ty == NAP_END:
+            e.update(ph="E", name="nap", args={"reclaim_requested": arg0})
+        elif ty == RECLAIM_BEGIN:
+            e.update(ph="B", name="reclaim", args={"log": tid_name(arg0)})
+        elif ty == RECLAIM_END:
+            e.update(ph="E", name="reclaim", args={"bytes_freed": arg1})
+        elif ty == HIGH_MARK_BLOCK:
+            e.update(ph="B", name="high_mark_block",
+                     args={"log_used": arg0})
+        elif ty == HIGH_MARK_UNBLOCK:
+            e.update(ph="E", name="high_mark_block",
+                     args={"log_used": arg0})
+        elif ty == WAKEUP:
+            reason = WAKEUP_REASONS[arg0] \
+                if arg0 < len(WAKEUP_REASONS) else str(arg0)
+            e.update(ph="i", s="t", name="wakeup", args={"reason": reason})
+        else:
+            continue
+        out.append(e)
+    return out
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Convert an MV-RLU GC trace to Chrome trace JSON")
+    parser.add_argument("trace", help="binary trace file")
+    parser.add_argument("-o", "--output", help="JSON file (default: stdout)")
+    args = parser.parse_args()
+
+    doc = {"traceEvents": convert(read_events(args.trace)),
+           "displayTimeUnit": "ns"}
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(doc, f)
+    else:
+        json.dump(doc, sys.stdout)
+        sys.stdout.write("\n")
+
+if __name__ == "__main__":
+    main()